@@ -0,0 +1,344 @@
+#include "Config.h"
+#include "CountingSectorReader.h"
+#include "FAT32Recovery.h"
+#include "ImageFileReader.h"
+#include "MemorySectorReader.h"
+#include "NTFSRecovery.h"
+#include "SyntheticVolume.h"
+#include "exFATRecovery.h"
+#include <windows.h>
+#include <psapi.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+
+struct BenchOptions {
+    std::vector<FilesystemType> filesystems = { FilesystemType::FAT32_TYPE, FilesystemType::EXFAT_TYPE, FilesystemType::NTFS_TYPE };
+    VolumeSpec spec;
+    fs::path imageFolder;  // Empty keeps the images in memory
+    fs::path workFolder = fs::temp_directory_path() / "DataRecoveryBench";
+    uint32_t threadCount = 0;
+    uint32_t ioQueueDepth = 1;
+    bool keepOutput = false;
+    bool verbose = false;
+};
+
+// Timing and reads of one pass over a volume
+struct PassResult {
+    double seconds = 0;
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    uint64_t bytesRead = 0;
+    uint64_t mappedBytes = 0;
+    uint64_t failedRequests = 0;
+};
+
+// The engines report every file on the console, that output would dominate the timings.
+// Streams without a buffer drop what is written to them.
+class ConsoleSilencer {
+private:
+    std::streambuf* coutBuffer;
+    std::streambuf* cerrBuffer;
+    std::wstreambuf* wcoutBuffer;
+    std::wstreambuf* wcerrBuffer;
+
+public:
+    ConsoleSilencer()
+        : coutBuffer(std::cout.rdbuf(nullptr))
+        , cerrBuffer(std::cerr.rdbuf(nullptr))
+        , wcoutBuffer(std::wcout.rdbuf(nullptr))
+        , wcerrBuffer(std::wcerr.rdbuf(nullptr)) {
+    }
+
+    ~ConsoleSilencer() {
+        std::cout.rdbuf(coutBuffer);
+        std::cerr.rdbuf(cerrBuffer);
+        std::wcout.rdbuf(wcoutBuffer);
+        std::wcerr.rdbuf(wcerrBuffer);
+        std::cout.clear();
+        std::cerr.clear();
+        std::wcout.clear();
+        std::wcerr.clear();
+    }
+};
+
+const char* filesystemName(FilesystemType type) {
+    switch (type) {
+    case FilesystemType::FAT32_TYPE: return "FAT32";
+    case FilesystemType::EXFAT_TYPE: return "exFAT";
+    case FilesystemType::NTFS_TYPE: return "NTFS";
+    default: return "UNKNOWN";
+    }
+}
+
+double toMB(uint64_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [OPTIONS]\n"
+        << "Options:\n"
+        << "  -h, --help                          Show this help message\n"
+        << "      --fs <fat32|exfat|ntfs|all>     [OPTIONAL] Filesystem to benchmark (default: all)\n"
+        << "      --files <n>                     [OPTIONAL] Files on the volume (default: 10000)\n"
+        << "      --dirs <n>                      [OPTIONAL] Folders below the root (default: 20)\n"
+        << "      --deleted-ratio <0-1>           [OPTIONAL] Share of deleted files (default: 0.5)\n"
+        << "      --fragmentation <0-1>           [OPTIONAL] Share of fragmented files (default: 0.2)\n"
+        << "      --file-size-kb <size>           [OPTIONAL] Average file size in KB (default: 32)\n"
+        << "      --seed <n>                      [OPTIONAL] Seed of the generated layout (default: 1)\n"
+        << "      --image-dir <path>              [OPTIONAL] Write the images to this folder and read them as image files\n"
+        << "      --work-dir <path>               [OPTIONAL] Folder for the recovered files (default: temp folder)\n"
+        << "      --threads <n>                   [OPTIONAL] Worker threads, as for the tool (default: all cores)\n"
+        << "      --queue-depth <n>               [OPTIONAL] Reads kept in flight, as for the tool (default: 1)\n"
+        << "      --keep-output                   [OPTIONAL] Keep the recovered files and logs\n"
+        << "  -v, --verbose                       [OPTIONAL] Show the output of the engines\n";
+
+    std::cerr << "\nExamples:\n"
+        << "  1. All filesystems with the defaults:\n"
+        << "        " << programName << "\n"
+        << "  2. Large NTFS volume read from an image file:\n"
+        << "        " << programName << " --fs ntfs --files 200000 --image-dir D:\\BenchImages\n";
+}
+
+void parseCommandLine(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        try {
+            auto nextValue = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error(arg + " argument is missing");
+                return argv[++i];
+            };
+
+            if (arg == "--fs") {
+                std::string value = nextValue();
+                if (value == "fat32") options.filesystems = { FilesystemType::FAT32_TYPE };
+                else if (value == "exfat") options.filesystems = { FilesystemType::EXFAT_TYPE };
+                else if (value == "ntfs") options.filesystems = { FilesystemType::NTFS_TYPE };
+                else if (value != "all") throw std::runtime_error("Unknown filesystem: " + value);
+            }
+            else if (arg == "--files") {
+                options.spec.fileCount = std::stoul(nextValue());
+            }
+            else if (arg == "--dirs") {
+                options.spec.directoryCount = std::stoul(nextValue());
+            }
+            else if (arg == "--deleted-ratio") {
+                options.spec.deletedRatio = (std::min)(1.0, (std::max)(0.0, std::stod(nextValue())));
+            }
+            else if (arg == "--fragmentation") {
+                options.spec.fragmentedRatio = (std::min)(1.0, (std::max)(0.0, std::stod(nextValue())));
+            }
+            else if (arg == "--file-size-kb") {
+                options.spec.averageFileBytes = (std::max)(1ul, std::stoul(nextValue())) * 1024;
+            }
+            else if (arg == "--seed") {
+                options.spec.seed = std::stoul(nextValue());
+            }
+            else if (arg == "--image-dir") {
+                options.imageFolder = nextValue();
+            }
+            else if (arg == "--work-dir") {
+                options.workFolder = nextValue();
+            }
+            else if (arg == "--threads") {
+                options.threadCount = std::stoul(nextValue());
+            }
+            else if (arg == "--queue-depth") {
+                options.ioQueueDepth = (std::max)(1ul, std::stoul(nextValue()));
+            }
+            else if (arg == "--keep-output") {
+                options.keepOutput = true;
+            }
+            else if (arg == "-v" || arg == "--verbose") {
+                options.verbose = true;
+            }
+            else if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                exit(0);
+            }
+            else {
+                throw std::runtime_error("Unknown argument: " + arg);
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            printUsage(argv[0]);
+            exit(1);
+        }
+    }
+}
+
+template <typename Engine>
+void runEngine(std::unique_ptr<SectorReader> reader) {
+    DriveType driveType = DriveType::IMAGE_TYPE; // Held by reference in the engines
+    Engine engine(driveType, std::move(reader));
+    engine.startRecovery();
+}
+
+// One scan or recovery of the volume, with the reads counted on the way
+PassResult runPass(FilesystemType type, const std::function<std::unique_ptr<SectorReader>()>& openReader, bool verbose) {
+    auto stats = std::make_shared<ReadStats>();
+    auto reader = std::make_unique<CountingSectorReader>(openReader(), stats);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::unique_ptr<ConsoleSilencer> silencer = verbose ? nullptr : std::make_unique<ConsoleSilencer>();
+        switch (type) {
+        case FilesystemType::FAT32_TYPE: runEngine<FAT32Recovery>(std::move(reader)); break;
+        case FilesystemType::EXFAT_TYPE: runEngine<exFATRecovery>(std::move(reader)); break;
+        case FilesystemType::NTFS_TYPE: runEngine<NTFSRecovery>(std::move(reader)); break;
+        default: throw std::runtime_error("Unsupported filesystem type");
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    PassResult result;
+    result.seconds = elapsed.count();
+    result.requests = stats->requests;
+    result.batches = stats->batches;
+    result.bytesRead = stats->bytesRead;
+    result.mappedBytes = stats->mappedBytes;
+    result.failedRequests = stats->failedRequests;
+    return result;
+}
+
+// Recovered files and their bytes, the log folder is left out
+std::pair<uint64_t, uint64_t> countRecoveredFiles(const fs::path& outputFolder, const fs::path& logFolder) {
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    std::error_code error;
+    for (auto it = fs::recursive_directory_iterator(outputFolder, error); it != fs::recursive_directory_iterator(); it.increment(error)) {
+        if (error) break;
+        if (it->is_directory() && it->path() == logFolder) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (it->is_regular_file()) {
+            files++;
+            bytes += it->file_size();
+        }
+    }
+    return { files, bytes };
+}
+
+void printPass(const char* name, const PassResult& pass) {
+    std::cout << "    " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+        << pass.seconds << " s | " << pass.requests << " reads in " << pass.batches << " batches, "
+        << std::setprecision(1) << toMB(pass.bytesRead) << " MB copied, " << toMB(pass.mappedBytes) << " MB mapped";
+    if (pass.failedRequests) std::cout << ", " << pass.failedRequests << " failed";
+    std::cout << "\n";
+}
+
+void runBenchmark(FilesystemType type, const BenchOptions& options) {
+    VolumeSpec spec = options.spec;
+    spec.type = type;
+
+    auto generationStart = std::chrono::steady_clock::now();
+    SyntheticVolume volume = SyntheticVolumeBuilder(spec).build();
+    std::chrono::duration<double> generationTime = std::chrono::steady_clock::now() - generationStart;
+
+    std::function<std::unique_ptr<SectorReader>()> openReader;
+    fs::path imagePath;
+    if (!options.imageFolder.empty()) {
+        fs::create_directories(options.imageFolder);
+        imagePath = options.imageFolder / (std::string("bench_") + filesystemName(type) + ".img");
+        std::ofstream image(imagePath, std::ios::binary | std::ios::trunc);
+        image.write(reinterpret_cast<const char*>(volume.image->data()), static_cast<std::streamsize>(volume.image->size()));
+        if (!image) throw std::runtime_error("Failed to write " + imagePath.string());
+        image.close();
+        volume.image.reset(); // Read back from the file only
+        openReader = [imagePath] { return std::make_unique<ImageFileReader>(imagePath.wstring()); };
+    }
+    else {
+        std::shared_ptr<const std::vector<uint8_t>> image = volume.image;
+        openReader = [image] { return std::make_unique<MemorySectorReader>(image); };
+    }
+
+    Config& config = Config::getInstance();
+    fs::path outputFolder = options.workFolder / filesystemName(type);
+    fs::remove_all(outputFolder);
+    config.drivePath = imagePath.empty() ? L"memory" : imagePath.wstring();
+    config.outputFolder = outputFolder.wstring();
+    config.createFileDataLog = true;
+    config.recoverAll = true;
+    config.analyze = false;
+    config.carve = false;
+    config.threadCount = options.threadCount;
+    config.ioQueueDepth = options.ioQueueDepth;
+
+    std::cout << "[*] " << filesystemName(type) << ": " << spec.fileCount << " files in " << spec.directoryCount << " folders, "
+        << volume.deletedFiles << " deleted (" << std::fixed << std::setprecision(1) << toMB(volume.deletedBytes) << " MB), image "
+        << toMB(imagePath.empty() ? volume.image->size() : fs::file_size(imagePath)) << " MB, generated in "
+        << std::setprecision(3) << generationTime.count() << " s\n";
+
+    // The scan saves the index, recovery loads it so its time is spent on file data
+    config.recover = false;
+    config.useIndex = false;
+    PassResult scan = runPass(type, openReader, options.verbose);
+
+    config.recover = true;
+    config.useIndex = true;
+    PassResult recovery = runPass(type, openReader, options.verbose);
+
+    auto [files, bytes] = countRecoveredFiles(outputFolder, outputFolder / config.logFolder);
+    printPass("Scan", scan);
+    std::cout << "              " << std::setprecision(0) << volume.scanRecords / (std::max)(scan.seconds, 1e-9)
+        << " records/s (" << volume.scanRecords << " records)\n";
+    printPass("Recovery", recovery);
+    std::cout << "              " << std::setprecision(1) << toMB(bytes) / (std::max)(recovery.seconds, 1e-9) << " MB/s, "
+        << files << " of " << volume.deletedFiles << " files, " << toMB(bytes) << " of " << toMB(volume.deletedBytes) << " MB\n";
+
+    if (!options.keepOutput) {
+        std::error_code error;
+        fs::remove_all(outputFolder, error);
+        if (!imagePath.empty()) fs::remove(imagePath, error);
+    }
+}
+
+void printPeakMemory() {
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        std::cout << "[*] Peak working set " << std::fixed << std::setprecision(1) << toMB(counters.PeakWorkingSetSize)
+            << " MB, peak commit " << toMB(counters.PeakPagefileUsage) << " MB (in-memory images included)\n";
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchOptions options;
+        parseCommandLine(argc, argv, options);
+
+        for (FilesystemType type : options.filesystems) {
+            try {
+                runBenchmark(type, options);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "[-] " << filesystemName(type) << " benchmark failed: " << e.what() << std::endl;
+            }
+        }
+        printPeakMemory();
+
+        if (options.keepOutput) {
+            std::cout << "[*] Output kept in " << options.workFolder.string() << "\n";
+        }
+        else {
+            std::error_code error;
+            fs::remove(options.workFolder, error); // Only if nothing else is left in it
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[-] Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
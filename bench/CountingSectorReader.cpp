@@ -0,0 +1,56 @@
+#include "CountingSectorReader.h"
+#include <stdexcept>
+
+
+void ReadStats::reset() {
+    requests = 0;
+    batches = 0;
+    bytesRead = 0;
+    mappedSpans = 0;
+    mappedBytes = 0;
+    failedRequests = 0;
+}
+
+CountingSectorReader::CountingSectorReader(std::unique_ptr<SectorReader> inner, std::shared_ptr<ReadStats> stats)
+    : inner(std::move(inner))
+    , stats(std::move(stats)) {
+    if (!this->inner || !this->stats) {
+        throw std::runtime_error("Invalid sector reader");
+    }
+}
+
+void CountingSectorReader::countRead(bool success, uint64_t bytes) {
+    stats->requests.fetch_add(1, std::memory_order_relaxed);
+    if (success) stats->bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+    else stats->failedRequests.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CountingSectorReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    bool success = inner->readSector(sector, buffer, size);
+    countRead(success, size);
+    return success;
+}
+
+bool CountingSectorReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    bool success = inner->readSectors(startSector, count, buffer);
+    countRead(success, static_cast<uint64_t>(count) * inner->getBytesPerSector());
+    return success;
+}
+
+bool CountingSectorReader::readBatch(std::vector<ReadRequest>& requests) {
+    bool allSucceeded = inner->readBatch(requests);
+    stats->batches.fetch_add(1, std::memory_order_relaxed);
+    for (const ReadRequest& request : requests) {
+        countRead(request.success, static_cast<uint64_t>(request.sectorCount) * inner->getBytesPerSector());
+    }
+    return allSucceeded;
+}
+
+SectorSpan CountingSectorReader::mapSectors(uint64_t startSector, uint32_t count) {
+    SectorSpan span = inner->mapSectors(startSector, count);
+    if (span) {
+        stats->mappedSpans.fetch_add(1, std::memory_order_relaxed);
+        stats->mappedBytes.fetch_add(span.size, std::memory_order_relaxed);
+    }
+    return span;
+}
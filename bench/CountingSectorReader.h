@@ -0,0 +1,44 @@
+#pragma once
+#include "SectorReader.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reads issued by an engine, the counters are shared so they outlive the reader handed to the engine
+struct ReadStats {
+    std::atomic<uint64_t> requests{ 0 };    // readSector, readSectors and every request of a batch
+    std::atomic<uint64_t> batches{ 0 };
+    std::atomic<uint64_t> bytesRead{ 0 };
+    std::atomic<uint64_t> mappedSpans{ 0 };
+    std::atomic<uint64_t> mappedBytes{ 0 };
+    std::atomic<uint64_t> failedRequests{ 0 };
+
+    void reset();
+};
+
+// Forwards to another reader and counts what passes through, engines read from several threads
+class CountingSectorReader : public SectorReader {
+private:
+    std::unique_ptr<SectorReader> inner;
+    std::shared_ptr<ReadStats> stats;
+
+    void countRead(bool success, uint64_t bytes);
+
+public:
+    CountingSectorReader(std::unique_ptr<SectorReader> inner, std::shared_ptr<ReadStats> stats);
+
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    // Forwarded as a whole, so an overlapped backend still sees the batch
+    bool readBatch(std::vector<ReadRequest>& requests) override;
+    SectorSpan mapSectors(uint64_t startSector, uint32_t count) override;
+    uint64_t getTotalSectors() override { return inner->getTotalSectors(); }
+    uint32_t getBytesPerSector() override { return inner->getBytesPerSector(); }
+    std::wstring getFilesystemType() override { return inner->getFilesystemType(); }
+    uint64_t getTotalMftRecords() override { return inner->getTotalMftRecords(); }
+    bool isOpen() const override { return inner->isOpen(); }
+    bool reopen() override { return inner->reopen(); }
+    void close() override { inner->close(); }
+};
@@ -0,0 +1,39 @@
+#include "MemorySectorReader.h"
+#include <cstring>
+#include <stdexcept>
+
+
+MemorySectorReader::MemorySectorReader(std::shared_ptr<const std::vector<uint8_t>> image, uint32_t bytesPerSector)
+    : image(std::move(image))
+    , bytesPerSector(bytesPerSector) {
+    if (!this->image || this->image->empty() || bytesPerSector == 0) {
+        throw std::runtime_error("Invalid memory image");
+    }
+}
+
+bool MemorySectorReader::isInImage(uint64_t sector, uint64_t count) const {
+    uint64_t totalSectors = image->size() / bytesPerSector;
+    return sector < totalSectors && count <= totalSectors - sector;
+}
+
+bool MemorySectorReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    if (!isInImage(sector, 1) || size > image->size() - sector * bytesPerSector) return false;
+    std::memcpy(buffer, image->data() + sector * bytesPerSector, size);
+    return true;
+}
+
+bool MemorySectorReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    if (!isInImage(startSector, count)) return false;
+    std::memcpy(buffer, image->data() + startSector * bytesPerSector, static_cast<size_t>(count) * bytesPerSector);
+    return true;
+}
+
+SectorSpan MemorySectorReader::mapSectors(uint64_t startSector, uint32_t count) {
+    if (!isInImage(startSector, count)) return {};
+    return { image->data() + startSector * bytesPerSector, static_cast<uint64_t>(count) * bytesPerSector, image };
+}
+
+std::wstring MemorySectorReader::getFilesystemType() {
+    if (image->size() < 512) return L"UNKNOWN_TYPE";
+    return detectFilesystem(image->data());
+}
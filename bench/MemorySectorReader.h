@@ -0,0 +1,30 @@
+#pragma once
+#include "SectorReader.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reader over a volume image held in memory, lets the benchmark drive the engines without a drive.
+// Sectors are exposed in place like a mapped image file, so the engines take their zero-copy paths.
+class MemorySectorReader : public SectorReader {
+private:
+    std::shared_ptr<const std::vector<uint8_t>> image; // Shared with the spans handed out
+    uint32_t bytesPerSector;
+
+    bool isInImage(uint64_t sector, uint64_t count) const;
+
+public:
+    explicit MemorySectorReader(std::shared_ptr<const std::vector<uint8_t>> image, uint32_t bytesPerSector = 512);
+
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    SectorSpan mapSectors(uint64_t startSector, uint32_t count) override;
+    uint64_t getTotalSectors() override { return image->size() / bytesPerSector; }
+    uint32_t getBytesPerSector() override { return bytesPerSector; }
+    std::wstring getFilesystemType() override;
+    uint64_t getTotalMftRecords() override { return 0; }
+    bool isOpen() const override { return true; }
+    bool reopen() override { return true; }
+    void close() override {}
+};
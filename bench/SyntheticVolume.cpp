@@ -0,0 +1,690 @@
+#include "SyntheticVolume.h"
+#include "FAT32Structs.h"
+#include "exFATStructs.h"
+#include "NTFSStructs.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <iterator>
+#include <stdexcept>
+
+
+namespace {
+    const wchar_t* const EXTENSIONS[] = { L"jpg", L"png", L"pdf", L"docx", L"txt", L"zip" };
+
+    template <typename T>
+    void put(std::vector<uint8_t>& image, uint64_t offset, const T& value) {
+        std::memcpy(image.data() + offset, &value, sizeof(T));
+    }
+
+    template <typename T>
+    void putEntry(std::vector<uint8_t>& entries, const T& entry) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&entry);
+        entries.insert(entries.end(), bytes, bytes + sizeof(T));
+    }
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void setClusterBit(std::vector<uint8_t>& bitmap, uint64_t index) {
+        bitmap[index / 8] |= static_cast<uint8_t>(1u << (index % 8));
+    }
+
+
+    /* FAT32 */
+    constexpr uint32_t FAT32_LFN_CHARS = 13;
+    constexpr uint32_t FAT32_EOC = 0x0FFFFFFF;
+
+    uint8_t shortNameChecksum(const uint8_t* shortName) {
+        uint8_t sum = 0;
+        for (int i = 0; i < 11; i++) {
+            sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + shortName[i]);
+        }
+        return sum;
+    }
+
+    DirectoryEntry makeFAT32Entry(const char* shortName, uint8_t attributes, uint32_t cluster, uint32_t size) {
+        DirectoryEntry entry = {};
+        std::memcpy(entry.Name, shortName, 11);
+        entry.Attr = attributes;
+        entry.FstClusHI = static_cast<uint16_t>(cluster >> 16);
+        entry.FstClusLO = static_cast<uint16_t>(cluster & 0xFFFF);
+        entry.FileSize = size;
+        return entry;
+    }
+
+    // LFN entries, last part first, followed by the 8.3 entry
+    void appendFAT32EntrySet(std::vector<uint8_t>& entries, const std::wstring& name, uint32_t nodeIndex,
+        bool isDirectory, bool isDeleted, uint32_t cluster, uint32_t size) {
+        char shortName[12];
+        std::snprintf(shortName, sizeof(shortName), "%c%07X   ", isDirectory ? 'D' : 'F', nodeIndex);
+        size_t dot = name.rfind(L'.');
+        for (size_t i = 0; !isDirectory && dot != std::wstring::npos && i < 3 && dot + 1 + i < name.size(); i++) {
+            shortName[8 + i] = static_cast<char>(std::towupper(name[dot + 1 + i]));
+        }
+        uint8_t checksum = shortNameChecksum(reinterpret_cast<const uint8_t*>(shortName));
+
+        uint32_t parts = static_cast<uint32_t>((name.size() + FAT32_LFN_CHARS - 1) / FAT32_LFN_CHARS);
+        for (uint32_t part = parts; part >= 1; part--) {
+            uint16_t chars[FAT32_LFN_CHARS];
+            for (uint32_t k = 0; k < FAT32_LFN_CHARS; k++) {
+                size_t position = static_cast<size_t>(part - 1) * FAT32_LFN_CHARS + k;
+                chars[k] = position < name.size() ? static_cast<uint16_t>(name[position]) : position == name.size() ? 0x0000 : 0xFFFF;
+            }
+
+            LFNEntry lfn = {};
+            lfn.Ord = isDeleted ? 0xE5 : static_cast<uint8_t>(part | (part == parts ? 0x40 : 0x00));
+            lfn.Attr = 0x0F;
+            lfn.Chksum = checksum;
+            for (int k = 0; k < 5; k++) lfn.Name1[k] = chars[k];
+            for (int k = 0; k < 6; k++) lfn.Name2[k] = chars[5 + k];
+            for (int k = 0; k < 2; k++) lfn.Name3[k] = chars[11 + k];
+            putEntry(entries, lfn);
+        }
+
+        DirectoryEntry entry = makeFAT32Entry(shortName, isDirectory ? 0x10 : 0x20, cluster, size);
+        if (isDeleted) entry.Name[0] = 0xE5;
+        putEntry(entries, entry);
+    }
+
+
+    /* exFAT */
+    constexpr uint32_t EXFAT_NAME_CHARS = 15;
+    constexpr uint32_t EXFAT_EOC = 0xFFFFFFFF;
+    constexpr uint8_t EXFAT_IN_USE = 0x80;
+
+    uint16_t exFATSetChecksum(const uint8_t* entrySet, size_t bytes) {
+        uint16_t checksum = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            if (i == 2 || i == 3) continue; // The checksum field itself
+            checksum = static_cast<uint16_t>(((checksum & 1) ? 0x8000 : 0) + (checksum >> 1) + entrySet[i]);
+        }
+        return checksum;
+    }
+
+    uint16_t exFATNameHash(const std::wstring& name) {
+        uint16_t hash = 0;
+        for (wchar_t c : name) {
+            uint16_t upper = static_cast<uint16_t>(std::towupper(c));
+            hash = static_cast<uint16_t>(((hash & 1) ? 0x8000 : 0) + (hash >> 1) + (upper & 0xFF));
+            hash = static_cast<uint16_t>(((hash & 1) ? 0x8000 : 0) + (hash >> 1) + (upper >> 8));
+        }
+        return hash;
+    }
+
+    // File, stream extension and name entries, the in-use bit is cleared on all of them when deleted
+    void appendExFATEntrySet(std::vector<uint8_t>& entries, const std::wstring& name, bool isDirectory, bool isDeleted,
+        bool noFatChain, uint32_t cluster, uint64_t size) {
+        uint8_t inUse = isDeleted ? 0x00 : EXFAT_IN_USE;
+        uint32_t nameEntries = static_cast<uint32_t>((name.size() + EXFAT_NAME_CHARS - 1) / EXFAT_NAME_CHARS);
+        size_t setStart = entries.size();
+
+        DirectoryEntryExFAT file = {};
+        file.EntryType = 0x05 | inUse;
+        file.SecondaryCount = static_cast<uint8_t>(1 + nameEntries);
+        file.FileAttributes = isDirectory ? 0x10 : 0x20;
+        putEntry(entries, file);
+
+        StreamExtensionEntry stream = {};
+        stream.EntryType = 0x40 | inUse;
+        stream.GeneralFlags = 0x01 | (noFatChain ? 0x02 : 0x00); // AllocationPossible, NoFatChain
+        stream.NameLength = static_cast<uint8_t>(name.size());
+        stream.NameHash = exFATNameHash(name);
+        stream.ValidDataLength = size;
+        stream.FirstCluster = cluster;
+        stream.DataLength = size;
+        putEntry(entries, stream);
+
+        for (uint32_t part = 0; part < nameEntries; part++) {
+            FileNameEntry nameEntry = {};
+            nameEntry.EntryType = 0x41 | inUse;
+            for (uint32_t k = 0; k < EXFAT_NAME_CHARS; k++) {
+                size_t position = static_cast<size_t>(part) * EXFAT_NAME_CHARS + k;
+                nameEntry.FileName[k] = position < name.size() ? static_cast<uint16_t>(name[position]) : 0;
+            }
+            putEntry(entries, nameEntry);
+        }
+
+        uint16_t checksum = exFATSetChecksum(entries.data() + setStart, entries.size() - setStart);
+        std::memcpy(entries.data() + setStart + offsetof(DirectoryEntryExFAT, SetChecksum), &checksum, sizeof(checksum));
+    }
+
+
+    /* NTFS */
+    constexpr uint32_t NTFS_FILE_SIGNATURE = 0x454C4946; // "FILE"
+    constexpr uint16_t NTFS_USA_OFFSET = 48;
+    constexpr uint16_t NTFS_FIRST_ATTRIBUTE = 56;
+    constexpr uint16_t NTFS_RESIDENT_CONTENT = 24;       // Resident header rounded up to 8 bytes
+    constexpr uint16_t NTFS_UPDATE_SEQUENCE = 1;
+    constexpr uint32_t NTFS_FIXUP_STRIDE = 512;
+    constexpr uint64_t NTFS_ROOT_RECORD = 5;
+    constexpr uint64_t NTFS_BITMAP_RECORD = 6;
+    constexpr uint64_t NTFS_SEQUENCE_ONE = 1ULL << 48;   // Sequence number part of a file reference
+
+    // Builds one MFT record attribute by attribute
+    class MftRecordWriter {
+    private:
+        uint8_t* record;
+        uint32_t recordBytes;
+        uint32_t offset = NTFS_FIRST_ATTRIBUTE;
+        uint16_t attributeId = 0;
+
+        uint8_t* beginAttribute(uint32_t type, uint32_t length, bool nonResident) {
+            length = static_cast<uint32_t>(alignUp(length, 8));
+            if (offset + length + 8 > recordBytes) {
+                throw std::runtime_error("MFT record overflow");
+            }
+            uint8_t* attribute = record + offset;
+            AttributeHeader header = {};
+            header.type = type;
+            header.length = length;
+            header.nonResident = nonResident ? 1 : 0;
+            header.attributeId = attributeId++;
+            std::memcpy(attribute, &header, sizeof(header));
+            offset += length;
+            return attribute;
+        }
+
+        uint8_t* residentAttribute(uint32_t type, uint32_t contentLength) {
+            uint8_t* attribute = beginAttribute(type, NTFS_RESIDENT_CONTENT + contentLength, false);
+            ResidentAttributeHeader header = {};
+            std::memcpy(&header, attribute, sizeof(AttributeHeader));
+            header.contentLength = contentLength;
+            header.contentOffset = NTFS_RESIDENT_CONTENT;
+            std::memcpy(attribute, &header, sizeof(header));
+            return attribute + NTFS_RESIDENT_CONTENT;
+        }
+
+    public:
+        MftRecordWriter(uint8_t* record, uint32_t recordBytes, uint64_t recordNumber, uint16_t flags)
+            : record(record)
+            , recordBytes(recordBytes) {
+            MFTEntryHeader header = {};
+            header.signature = NTFS_FILE_SIGNATURE;
+            header.updateSequenceOffset = NTFS_USA_OFFSET;
+            header.updateSequenceSize = static_cast<uint16_t>(recordBytes / NTFS_FIXUP_STRIDE + 1);
+            header.sequenceNumber = 1;
+            header.hardLinkCount = 1;
+            header.firstAttributeOffset = NTFS_FIRST_ATTRIBUTE;
+            header.flags = flags;
+            header.allocatedSize = recordBytes;
+            header.recordNumber = static_cast<uint32_t>(recordNumber);
+            std::memcpy(record, &header, sizeof(header));
+        }
+
+        void addFileName(const std::wstring& name, uint64_t parentRecord, uint64_t size, bool isDirectory) {
+            uint32_t contentLength = static_cast<uint32_t>(offsetof(FileNameAttribute, name) + name.size() * sizeof(uint16_t));
+            uint8_t* content = residentAttribute(0x30, contentLength);
+
+            FileNameAttribute fileName = {};
+            fileName.parentDirectory = parentRecord | NTFS_SEQUENCE_ONE;
+            fileName.allocatedSize = alignUp(size, 8);
+            fileName.realSize = size;
+            fileName.flags = isDirectory ? 0x10000000 : 0x20;
+            fileName.nameLength = static_cast<uint8_t>(name.size());
+            fileName.nameType = 1; // Win32 name
+            std::memcpy(content, &fileName, offsetof(FileNameAttribute, name));
+
+            // Names are UTF-16 on disk
+            uint8_t* chars = content + offsetof(FileNameAttribute, name);
+            for (size_t i = 0; i < name.size(); i++) {
+                uint16_t c = static_cast<uint16_t>(name[i]);
+                std::memcpy(chars + i * sizeof(uint16_t), &c, sizeof(c));
+            }
+        }
+
+        void addResidentData(uint8_t fill, uint32_t size) {
+            std::memset(residentAttribute(0x80, size), fill, size);
+        }
+
+        void addNonResidentData(const std::vector<std::pair<uint64_t, uint64_t>>& runs, uint64_t size, uint32_t bytesPerCluster) {
+            // Run list: header byte with the field sizes, length, then the offset from the previous run
+            std::vector<uint8_t> runList;
+            uint64_t totalClusters = 0;
+            int64_t previousLcn = 0;
+            for (const auto& [lcn, length] : runs) {
+                uint8_t lengthBytes = 0;
+                for (uint64_t value = length; value; value >>= 8) lengthBytes++;
+
+                int64_t delta = static_cast<int64_t>(lcn) - previousLcn;
+                uint8_t offsetBytes = 1;
+                while (offsetBytes < 8 && (delta < -(1LL << (offsetBytes * 8 - 1)) || delta >= (1LL << (offsetBytes * 8 - 1)))) {
+                    offsetBytes++;
+                }
+
+                runList.push_back(static_cast<uint8_t>((offsetBytes << 4) | lengthBytes));
+                for (uint8_t i = 0; i < lengthBytes; i++) runList.push_back(static_cast<uint8_t>(length >> (i * 8)));
+                for (uint8_t i = 0; i < offsetBytes; i++) runList.push_back(static_cast<uint8_t>(static_cast<uint64_t>(delta) >> (i * 8)));
+
+                previousLcn = static_cast<int64_t>(lcn);
+                totalClusters += length;
+            }
+            runList.push_back(0);
+
+            uint8_t* attribute = beginAttribute(0x80, static_cast<uint32_t>(sizeof(NonResidentAttributeHeader) + runList.size()), true);
+            NonResidentAttributeHeader header = {};
+            std::memcpy(&header, attribute, sizeof(AttributeHeader));
+            header.startingVCN = 0;
+            header.lastVCN = totalClusters - 1;
+            header.dataRunOffset = sizeof(NonResidentAttributeHeader);
+            header.allocatedSize = totalClusters * bytesPerCluster;
+            header.realSize = size;
+            header.initializedSize = size;
+            std::memcpy(attribute, &header, sizeof(header));
+            std::memcpy(attribute + sizeof(NonResidentAttributeHeader), runList.data(), runList.size());
+        }
+
+        // End marker and update sequence, the last two bytes of every sector move into the array
+        void finish() {
+            uint32_t endMarker = 0xFFFFFFFF;
+            std::memcpy(record + offset, &endMarker, sizeof(endMarker));
+            uint32_t usedSize = offset + 8;
+            std::memcpy(record + offsetof(MFTEntryHeader, usedSize), &usedSize, sizeof(usedSize));
+
+            uint16_t* usa = reinterpret_cast<uint16_t*>(record + NTFS_USA_OFFSET);
+            usa[0] = NTFS_UPDATE_SEQUENCE;
+            for (uint32_t i = 1; i <= recordBytes / NTFS_FIXUP_STRIDE; i++) {
+                uint8_t* sectorTail = record + i * NTFS_FIXUP_STRIDE - sizeof(uint16_t);
+                std::memcpy(&usa[i], sectorTail, sizeof(uint16_t));
+                std::memcpy(sectorTail, &usa[0], sizeof(uint16_t));
+            }
+        }
+    };
+}
+
+
+SyntheticVolumeBuilder::SyntheticVolumeBuilder(const VolumeSpec& spec)
+    : spec(spec)
+    , random(spec.seed) {
+    if (spec.averageFileBytes == 0) {
+        throw std::runtime_error("Average file size must be positive");
+    }
+}
+
+uint64_t SyntheticVolumeBuilder::clustersFor(uint64_t bytes) {
+    return (std::max)(uint64_t{ 1 }, (bytes + BYTES_PER_CLUSTER - 1) / BYTES_PER_CLUSTER);
+}
+
+uint8_t SyntheticVolumeBuilder::fillByte(uint32_t nodeIndex) {
+    return static_cast<uint8_t>(nodeIndex * 37 + 11);
+}
+
+void SyntheticVolumeBuilder::createNodes() {
+    nodes.clear();
+    nodes.reserve(1 + static_cast<size_t>(spec.directoryCount) + spec.fileCount);
+    nodes.push_back({ L"", ROOT_NODE, true, false, 0, {}, {} });
+
+    wchar_t name[32];
+    for (uint32_t i = 0; i < spec.directoryCount; i++) {
+        std::swprintf(name, 32, L"Folder_%03u", i + 1);
+        nodes.push_back({ name, ROOT_NODE, true, false, 0, {}, {} });
+        nodes[ROOT_NODE].children.push_back(static_cast<uint32_t>(nodes.size() - 1));
+    }
+
+    std::uniform_int_distribution<uint64_t> sizeDistribution(1, 2ULL * spec.averageFileBytes);
+    std::bernoulli_distribution deletedDistribution(spec.deletedRatio);
+    for (uint32_t i = 0; i < spec.fileCount; i++) {
+        std::swprintf(name, 32, L"File_%06u.%ls", i + 1, EXTENSIONS[i % std::size(EXTENSIONS)]);
+        uint32_t parent = spec.directoryCount ? 1 + i % spec.directoryCount : ROOT_NODE;
+
+        Node file = { name, parent, false, deletedDistribution(random), sizeDistribution(random), {}, {} };
+        nodes.push_back(std::move(file));
+        nodes[parent].children.push_back(static_cast<uint32_t>(nodes.size() - 1));
+    }
+}
+
+void SyntheticVolumeBuilder::allocate(Node& node, uint64_t clusters, bool fragmented) {
+    if (!fragmented || clusters < 2) {
+        node.runs.push_back({ nextCluster, clusters });
+        nextCluster += clusters;
+        return;
+    }
+
+    uint64_t fragments = (std::min)(clusters, std::uniform_int_distribution<uint64_t>(2, MAX_FRAGMENTS)(random));
+    uint64_t remaining = clusters;
+    for (uint64_t fragment = 0; fragment < fragments; fragment++) {
+        uint64_t length = fragment + 1 == fragments ? remaining : (std::max)(uint64_t{ 1 }, remaining / (fragments - fragment));
+        node.runs.push_back({ nextCluster, length });
+        nextCluster += length;
+        remaining -= length;
+        if (fragment + 1 < fragments) {
+            nextCluster += std::uniform_int_distribution<uint64_t>(1, MAX_FRAGMENT_GAP)(random);
+        }
+    }
+}
+
+void SyntheticVolumeBuilder::writeFileData(std::vector<uint8_t>& image, uint64_t firstClusterByte, uint64_t firstClusterNumber) const {
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].isDirectory) continue;
+        for (const auto& [cluster, length] : nodes[i].runs) {
+            std::memset(image.data() + firstClusterByte + (cluster - firstClusterNumber) * BYTES_PER_CLUSTER,
+                fillByte(i), length * BYTES_PER_CLUSTER);
+        }
+    }
+}
+
+SyntheticVolume SyntheticVolumeBuilder::finish(std::vector<uint8_t>&& image, uint64_t scanRecords) const {
+    SyntheticVolume volume;
+    volume.image = std::make_shared<std::vector<uint8_t>>(std::move(image));
+    volume.scanRecords = scanRecords;
+    for (const Node& node : nodes) {
+        if (node.isDirectory || !node.isDeleted) continue;
+        volume.deletedFiles++;
+        volume.deletedBytes += node.size;
+    }
+    return volume;
+}
+
+SyntheticVolume SyntheticVolumeBuilder::build() {
+    createNodes();
+    switch (spec.type) {
+    case FilesystemType::FAT32_TYPE: return buildFAT32();
+    case FilesystemType::EXFAT_TYPE: return buildExFAT();
+    case FilesystemType::NTFS_TYPE: return buildNTFS();
+    default: throw std::runtime_error("Unsupported filesystem type");
+    }
+}
+
+/* FAT32 */
+// One FAT, the root directory at cluster 2 and the folders right after it
+SyntheticVolume SyntheticVolumeBuilder::buildFAT32() {
+    constexpr uint32_t RESERVED_SECTORS = 32;
+    auto entriesFor = [](const std::wstring& name) {
+        return (name.size() + FAT32_LFN_CHARS - 1) / FAT32_LFN_CHARS + 1;
+    };
+
+    // Directories first so the walk reads the start of the volume
+    nextCluster = 2;
+    std::bernoulli_distribution fragmentedDistribution(spec.fragmentedRatio);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        Node& node = nodes[i];
+        if (node.isDirectory) {
+            uint64_t entries = i == ROOT_NODE ? 0 : 2; // "." and ".."
+            for (uint32_t child : node.children) entries += entriesFor(nodes[child].name);
+            allocate(node, clustersFor(entries * sizeof(DirectoryEntry)), false);
+        }
+    }
+    for (Node& node : nodes) {
+        if (!node.isDirectory) allocate(node, clustersFor(node.size), fragmentedDistribution(random));
+    }
+
+    uint64_t clusterCount = nextCluster - 2 + SPARE_CLUSTERS;
+    uint64_t fatSectors = (clusterCount + 2) * sizeof(uint32_t);
+    fatSectors = (fatSectors + BYTES_PER_SECTOR - 1) / BYTES_PER_SECTOR;
+    uint64_t dataStartSector = RESERVED_SECTORS + fatSectors;
+    uint64_t totalSectors = dataStartSector + clusterCount * SECTORS_PER_CLUSTER;
+    if (totalSectors > UINT32_MAX) {
+        throw std::runtime_error("Volume too large for FAT32");
+    }
+    std::vector<uint8_t> image(totalSectors * BYTES_PER_SECTOR);
+
+    BootSector boot = {};
+    std::memcpy(boot.jmpBoot, "\xEB\x58\x90", 3);
+    std::memcpy(boot.OEMName, "MSWIN4.1", 8);
+    boot.BytesPerSector = BYTES_PER_SECTOR;
+    boot.SectorsPerCluster = SECTORS_PER_CLUSTER;
+    boot.ReservedSectorCount = RESERVED_SECTORS;
+    boot.NumFATs = 1;
+    boot.Media = 0xF8;
+    boot.TotalSectors32 = static_cast<uint32_t>(totalSectors);
+    boot.FATSize32 = static_cast<uint32_t>(fatSectors);
+    boot.RootCluster = 2;
+    boot.FSInfo = 1;
+    boot.BkBootSec = 6;
+    boot.BootSignature = 0x29;
+    boot.VolumeID = spec.seed;
+    std::memcpy(boot.VolumeLabel, "BENCH      ", 11);
+    std::memcpy(boot.FileSystemType, "FAT32   ", 8);
+    boot.BootSectorSignature = 0xAA55;
+    put(image, 0, boot);
+
+    // Chains for directories and live files, deleted files keep theirs only when fragmented
+    uint64_t fatByte = static_cast<uint64_t>(RESERVED_SECTORS) * BYTES_PER_SECTOR;
+    put(image, fatByte, uint32_t{ 0x0FFFFFF8 });
+    put(image, fatByte + 4, FAT32_EOC);
+    for (const Node& node : nodes) {
+        if (node.isDeleted && node.runs.size() == 1) continue;
+        std::vector<uint64_t> chain;
+        for (const auto& [cluster, length] : node.runs) {
+            for (uint64_t c = cluster; c < cluster + length; c++) chain.push_back(c);
+        }
+        for (size_t i = 0; i < chain.size(); i++) {
+            uint32_t next = i + 1 < chain.size() ? static_cast<uint32_t>(chain[i + 1]) : FAT32_EOC;
+            put(image, fatByte + chain[i] * sizeof(uint32_t), next);
+        }
+    }
+
+    uint64_t dataByte = dataStartSector * BYTES_PER_SECTOR;
+    uint64_t scanRecords = 0;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        const Node& directory = nodes[i];
+        if (!directory.isDirectory) continue;
+
+        std::vector<uint8_t> entries;
+        uint32_t cluster = static_cast<uint32_t>(directory.runs.front().first);
+        if (i != ROOT_NODE) {
+            uint32_t parentCluster = directory.parent == ROOT_NODE ? 0 : static_cast<uint32_t>(nodes[directory.parent].runs.front().first);
+            putEntry(entries, makeFAT32Entry(".          ", 0x10, cluster, 0));
+            putEntry(entries, makeFAT32Entry("..         ", 0x10, parentCluster, 0));
+        }
+        for (uint32_t child : directory.children) {
+            const Node& node = nodes[child];
+            appendFAT32EntrySet(entries, node.name, child, node.isDirectory, node.isDeleted,
+                static_cast<uint32_t>(node.runs.front().first), node.isDirectory ? 0 : static_cast<uint32_t>(node.size));
+        }
+        std::memcpy(image.data() + dataByte + (cluster - 2ULL) * BYTES_PER_CLUSTER, entries.data(), entries.size());
+        scanRecords += entries.size() / sizeof(DirectoryEntry);
+    }
+
+    writeFileData(image, dataByte, 2);
+    return finish(std::move(image), scanRecords);
+}
+
+/* exFAT */
+// The root is chained in the FAT, the folders below it are contiguous and marked NoFatChain
+SyntheticVolume SyntheticVolumeBuilder::buildExFAT() {
+    constexpr uint32_t FAT_OFFSET = 24;
+    auto entriesFor = [](const std::wstring& name) {
+        return (name.size() + EXFAT_NAME_CHARS - 1) / EXFAT_NAME_CHARS + 2;
+    };
+
+    nextCluster = 2;
+    std::bernoulli_distribution fragmentedDistribution(spec.fragmentedRatio);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        Node& node = nodes[i];
+        if (node.isDirectory) {
+            uint64_t entries = i == ROOT_NODE ? 1 : 0; // Allocation bitmap entry
+            for (uint32_t child : node.children) entries += entriesFor(nodes[child].name);
+            allocate(node, clustersFor(entries * sizeof(DirectoryEntryCommon)), false);
+        }
+    }
+    for (Node& node : nodes) {
+        if (!node.isDirectory) allocate(node, clustersFor(node.size), fragmentedDistribution(random));
+    }
+
+    // The bitmap goes last, it has to cover its own clusters
+    uint64_t usedClusters = nextCluster - 2;
+    uint64_t bitmapClusters = 1;
+    while (clustersFor((usedClusters + bitmapClusters + SPARE_CLUSTERS + 7) / 8) > bitmapClusters) bitmapClusters++;
+    uint64_t clusterCount = usedClusters + bitmapClusters + SPARE_CLUSTERS;
+    uint64_t bitmapCluster = nextCluster;
+    uint64_t bitmapBytes = (clusterCount + 7) / 8;
+
+    uint64_t fatSectors = ((clusterCount + 2) * sizeof(uint32_t) + BYTES_PER_SECTOR - 1) / BYTES_PER_SECTOR;
+    uint64_t heapSector = alignUp(FAT_OFFSET + fatSectors, SECTORS_PER_CLUSTER);
+    uint64_t totalSectors = heapSector + clusterCount * SECTORS_PER_CLUSTER;
+    if (clusterCount > UINT32_MAX - 16) {
+        throw std::runtime_error("Volume too large for exFAT");
+    }
+    std::vector<uint8_t> image(totalSectors * BYTES_PER_SECTOR);
+
+    ExFATBootSector boot = {};
+    std::memcpy(boot.JumpBoot, "\xEB\x76\x90", 3);
+    std::memcpy(boot.FileSystemName, "EXFAT   ", 8);
+    boot.VolumeLength = totalSectors;
+    boot.FatOffset = FAT_OFFSET;
+    boot.FatLength = static_cast<uint32_t>(fatSectors);
+    boot.ClusterHeapOffset = static_cast<uint32_t>(heapSector);
+    boot.ClusterCount = static_cast<uint32_t>(clusterCount);
+    boot.RootDirectoryCluster = static_cast<uint32_t>(nodes[ROOT_NODE].runs.front().first);
+    boot.VolumeSerialNumber = spec.seed;
+    boot.FileSystemRevision = 0x100;
+    boot.BytesPerSectorShift = 9;
+    boot.SectorsPerClusterShift = 3;
+    boot.NumberOfFats = 1;
+    boot.DriveSelect = 0x80;
+    boot.BootSignature = 0xAA55;
+    put(image, 0, boot);
+
+    // The root, the bitmap and fragmented files are chained, contiguous folders and files are marked NoFatChain
+    uint64_t fatByte = static_cast<uint64_t>(FAT_OFFSET) * BYTES_PER_SECTOR;
+    put(image, fatByte, uint32_t{ 0xFFFFFFF8 });
+    put(image, fatByte + 4, EXFAT_EOC);
+    auto writeChain = [&](const std::vector<std::pair<uint64_t, uint64_t>>& runs) {
+        std::vector<uint64_t> chain;
+        for (const auto& [cluster, length] : runs) {
+            for (uint64_t c = cluster; c < cluster + length; c++) chain.push_back(c);
+        }
+        for (size_t i = 0; i < chain.size(); i++) {
+            uint32_t next = i + 1 < chain.size() ? static_cast<uint32_t>(chain[i + 1]) : EXFAT_EOC;
+            put(image, fatByte + chain[i] * sizeof(uint32_t), next);
+        }
+    };
+    writeChain(nodes[ROOT_NODE].runs);
+    for (const Node& node : nodes) {
+        if (node.runs.size() > 1) writeChain(node.runs);
+    }
+    writeChain({ { bitmapCluster, bitmapClusters } });
+
+    // Live clusters: metadata, folders and the files that are not deleted
+    uint64_t heapByte = heapSector * BYTES_PER_SECTOR;
+    std::vector<uint8_t> bitmap(bitmapBytes);
+    auto markRuns = [&](const std::vector<std::pair<uint64_t, uint64_t>>& runs) {
+        for (const auto& [cluster, length] : runs) {
+            for (uint64_t c = cluster; c < cluster + length; c++) setClusterBit(bitmap, c - 2);
+        }
+    };
+    markRuns({ { bitmapCluster, bitmapClusters } });
+    for (const Node& node : nodes) {
+        if (!node.isDeleted) markRuns(node.runs);
+    }
+    std::memcpy(image.data() + heapByte + (bitmapCluster - 2) * BYTES_PER_CLUSTER, bitmap.data(), bitmap.size());
+
+    uint64_t scanRecords = 0;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        const Node& directory = nodes[i];
+        if (!directory.isDirectory) continue;
+
+        std::vector<uint8_t> entries;
+        if (i == ROOT_NODE) {
+            AllocationBitmapEntry bitmapEntry = {};
+            bitmapEntry.EntryType = 0x81;
+            bitmapEntry.FirstCluster = static_cast<uint32_t>(bitmapCluster);
+            bitmapEntry.DataLength = bitmapBytes;
+            putEntry(entries, bitmapEntry);
+        }
+        for (uint32_t child : directory.children) {
+            const Node& node = nodes[child];
+            uint64_t size = node.isDirectory ? node.runs.front().second * BYTES_PER_CLUSTER : node.size;
+            appendExFATEntrySet(entries, node.name, node.isDirectory, node.isDeleted,
+                node.runs.size() == 1, static_cast<uint32_t>(node.runs.front().first), size);
+        }
+        std::memcpy(image.data() + heapByte + (directory.runs.front().first - 2) * BYTES_PER_CLUSTER, entries.data(), entries.size());
+        scanRecords += entries.size() / sizeof(DirectoryEntryCommon);
+    }
+
+    writeFileData(image, heapByte, 2);
+    return finish(std::move(image), scanRecords);
+}
+
+/* NTFS */
+// $MFT, the root folder and $Bitmap, then one record per folder and file. Folders carry no index,
+// the engine finds files through the MFT and their parents through $FILE_NAME.
+SyntheticVolume SyntheticVolumeBuilder::buildNTFS() {
+    constexpr uint64_t MFT_CLUSTER = 4;
+    auto recordFor = [](uint32_t nodeIndex) {
+        return nodeIndex == ROOT_NODE ? NTFS_ROOT_RECORD : FIRST_NTFS_USER_RECORD + nodeIndex - 1;
+    };
+
+    uint64_t recordCount = FIRST_NTFS_USER_RECORD + nodes.size() - 1;
+    uint64_t mftClusters = clustersFor(recordCount * MFT_RECORD_BYTES);
+    nextCluster = MFT_CLUSTER + mftClusters;
+
+    std::bernoulli_distribution fragmentedDistribution(spec.fragmentedRatio);
+    for (Node& node : nodes) {
+        if (!node.isDirectory && node.size > NTFS_RESIDENT_LIMIT) {
+            allocate(node, clustersFor(node.size), fragmentedDistribution(random));
+        }
+    }
+
+    uint64_t bitmapClusters = 1;
+    while (clustersFor((nextCluster + bitmapClusters + SPARE_CLUSTERS + 7) / 8) > bitmapClusters) bitmapClusters++;
+    uint64_t bitmapCluster = nextCluster;
+    uint64_t totalClusters = nextCluster + bitmapClusters + SPARE_CLUSTERS;
+    uint64_t bitmapBytes = (totalClusters + 7) / 8;
+    std::vector<uint8_t> image(totalClusters * BYTES_PER_CLUSTER);
+
+    NTFSBootSector boot = {};
+    std::memcpy(boot.jump, "\xEB\x52\x90", 3);
+    std::memcpy(boot.oemID, "NTFS    ", 8);
+    boot.bytesPerSector = BYTES_PER_SECTOR;
+    boot.sectorsPerCluster = SECTORS_PER_CLUSTER;
+    boot.mediaDescriptor = 0xF8;
+    boot.sectorsPerTrack = 63;
+    boot.numberOfHeads = 255;
+    boot.totalSectors = totalClusters * SECTORS_PER_CLUSTER;
+    boot.mftCluster = MFT_CLUSTER;
+    boot.mirrorMftCluster = MFT_CLUSTER;
+    boot.clustersPerMftRecord = -10; // 2^10 bytes
+    boot.clustersPerIndexBlock = 1;
+    boot.volumeSerialNumber = spec.seed;
+    put(image, 0, boot);
+    put(image, 510, uint16_t{ 0xAA55 });
+
+    std::vector<uint8_t> bitmap(bitmapBytes);
+    for (uint64_t c = 0; c < MFT_CLUSTER + mftClusters; c++) setClusterBit(bitmap, c);
+    for (uint64_t c = bitmapCluster; c < bitmapCluster + bitmapClusters; c++) setClusterBit(bitmap, c);
+    for (const Node& node : nodes) {
+        if (node.isDeleted) continue;
+        for (const auto& [cluster, length] : node.runs) {
+            for (uint64_t c = cluster; c < cluster + length; c++) setClusterBit(bitmap, c);
+        }
+    }
+    std::memcpy(image.data() + bitmapCluster * BYTES_PER_CLUSTER, bitmap.data(), bitmap.size());
+
+    uint8_t* mft = image.data() + MFT_CLUSTER * BYTES_PER_CLUSTER;
+    auto recordAt = [&](uint64_t recordNumber) { return mft + recordNumber * MFT_RECORD_BYTES; };
+
+    MftRecordWriter mftRecord(recordAt(0), MFT_RECORD_BYTES, 0, 0x0001);
+    mftRecord.addFileName(L"$MFT", NTFS_ROOT_RECORD, recordCount * MFT_RECORD_BYTES, false);
+    mftRecord.addNonResidentData({ { MFT_CLUSTER, mftClusters } }, recordCount * MFT_RECORD_BYTES, BYTES_PER_CLUSTER);
+    mftRecord.finish();
+
+    MftRecordWriter rootRecord(recordAt(NTFS_ROOT_RECORD), MFT_RECORD_BYTES, NTFS_ROOT_RECORD, 0x0003);
+    rootRecord.addFileName(L".", NTFS_ROOT_RECORD, 0, true);
+    rootRecord.finish();
+
+    MftRecordWriter bitmapRecord(recordAt(NTFS_BITMAP_RECORD), MFT_RECORD_BYTES, NTFS_BITMAP_RECORD, 0x0001);
+    bitmapRecord.addFileName(L"$Bitmap", NTFS_ROOT_RECORD, bitmapBytes, false);
+    bitmapRecord.addNonResidentData({ { bitmapCluster, bitmapClusters } }, bitmapBytes, BYTES_PER_CLUSTER);
+    bitmapRecord.finish();
+
+    for (uint32_t i = 1; i < nodes.size(); i++) {
+        const Node& node = nodes[i];
+        uint16_t flags = (node.isDeleted ? 0x0000 : 0x0001) | (node.isDirectory ? 0x0002 : 0x0000);
+        MftRecordWriter record(recordAt(recordFor(i)), MFT_RECORD_BYTES, recordFor(i), flags);
+        record.addFileName(node.name, recordFor(node.parent), node.size, node.isDirectory);
+        if (!node.isDirectory) {
+            if (node.runs.empty()) record.addResidentData(fillByte(i), static_cast<uint32_t>(node.size));
+            else record.addNonResidentData(node.runs, node.size, BYTES_PER_CLUSTER);
+        }
+        record.finish();
+    }
+
+    writeFileData(image, 0, 0);
+    return finish(std::move(image), recordCount);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Enums.h"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Shape of a generated volume
+struct VolumeSpec {
+    FilesystemType type = FilesystemType::FAT32_TYPE;
+    uint32_t fileCount = 10000;
+    uint32_t directoryCount = 20;        // Folders below the root, the files are spread over them
+    double deletedRatio = 0.5;           // Share of files that are deleted
+    double fragmentedRatio = 0.2;        // Share of files split over several runs of clusters
+    uint32_t averageFileBytes = 32 * 1024;
+    uint32_t seed = 1;
+};
+
+// Generated image and what the engines are expected to find in it
+struct SyntheticVolume {
+    std::shared_ptr<std::vector<uint8_t>> image;
+    uint64_t scanRecords = 0;  // Directory entries or MFT records the scan has to parse
+    uint32_t deletedFiles = 0;
+    uint64_t deletedBytes = 0;
+};
+
+// Builds FAT32, exFAT and NTFS volumes in memory, laid out the way the engines read them.
+// The volumes carry only what the engines parse: boot sector, FAT or MFT, directories and file data.
+class SyntheticVolumeBuilder {
+private:
+    static constexpr uint32_t BYTES_PER_SECTOR = 512;
+    static constexpr uint32_t SECTORS_PER_CLUSTER = 8;
+    static constexpr uint32_t BYTES_PER_CLUSTER = BYTES_PER_SECTOR * SECTORS_PER_CLUSTER;
+    static constexpr uint32_t MFT_RECORD_BYTES = 1024;
+    static constexpr uint32_t NTFS_RESIDENT_LIMIT = 512;   // Smaller files are stored in their MFT record
+    static constexpr uint32_t FIRST_NTFS_USER_RECORD = 16; // Records below are reserved for metadata files
+    static constexpr uint32_t MAX_FRAGMENTS = 4;
+    static constexpr uint32_t MAX_FRAGMENT_GAP = 8;        // Free clusters left between the runs of a fragmented file
+    static constexpr uint64_t SPARE_CLUSTERS = 16;         // Free clusters at the end of every volume
+
+    // A file or folder and the clusters given to it
+    struct Node {
+        std::wstring name;
+        uint32_t parent = 0;       // Index of the parent folder, node 0 is the root
+        bool isDirectory = false;
+        bool isDeleted = false;
+        uint64_t size = 0;
+        std::vector<std::pair<uint64_t, uint64_t>> runs; // First cluster and length
+        std::vector<uint32_t> children;                  // Folders only
+    };
+    static constexpr uint32_t ROOT_NODE = 0;
+
+    VolumeSpec spec;
+    std::mt19937 random;
+    std::vector<Node> nodes; // Root, the folders below it, then the files
+    uint64_t nextCluster = 0; // Allocation cursor
+
+    static uint64_t clustersFor(uint64_t bytes);
+    static uint8_t fillByte(uint32_t nodeIndex);
+    void createNodes();
+    // Hand out clusters, fragmented files get gaps between their runs
+    void allocate(Node& node, uint64_t clusters, bool fragmented);
+    // Fill the clusters of every file with a pattern that depends on the file
+    void writeFileData(std::vector<uint8_t>& image, uint64_t firstClusterByte, uint64_t firstClusterNumber) const;
+    SyntheticVolume finish(std::vector<uint8_t>&& image, uint64_t scanRecords) const;
+
+    SyntheticVolume buildFAT32();
+    SyntheticVolume buildExFAT();
+    SyntheticVolume buildNTFS();
+
+public:
+    explicit SyntheticVolumeBuilder(const VolumeSpec& spec);
+
+    SyntheticVolume build();
+};
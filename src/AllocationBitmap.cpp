@@ -0,0 +1,93 @@
+#include "AllocationBitmap.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+
+AllocationBitmap::AllocationBitmap(uint64_t firstCluster, uint64_t clusterCount)
+    : words((clusterCount + 63) / 64, 0)
+    , firstCluster(firstCluster)
+    , clusterCount(clusterCount) {
+}
+
+void AllocationBitmap::loadFromBytes(const uint8_t* bytes, uint64_t length) {
+    uint64_t copyBytes = (std::min)(length, (clusterCount + 7) / 8);
+    std::fill(words.begin(), words.end(), 0);
+    // Little endian words keep bit n of the byte stream at bit n % 64 of word n / 64
+    std::memcpy(words.data(), bytes, copyBytes);
+
+    // Bits past the last cluster are padding
+    if (clusterCount % 64 != 0 && !words.empty()) {
+        words.back() &= (1ULL << (clusterCount % 64)) - 1;
+    }
+}
+
+void AllocationBitmap::markAllocated(uint64_t cluster) {
+    if (cluster < firstCluster || cluster - firstCluster >= clusterCount) return;
+    uint64_t bit = cluster - firstCluster;
+    words[bit / 64] |= 1ULL << (bit % 64);
+}
+
+bool AllocationBitmap::isAllocated(uint64_t cluster) const {
+    if (cluster < firstCluster || cluster - firstCluster >= clusterCount) return false;
+    uint64_t bit = cluster - firstCluster;
+    return (words[bit / 64] >> (bit % 64)) & 1;
+}
+
+uint64_t AllocationBitmap::countAllocated(uint64_t cluster, uint64_t count) const {
+    // Clip the range to the map
+    uint64_t mapEnd = firstCluster + clusterCount;
+    if (count == 0 || cluster >= mapEnd) return 0;
+    uint64_t begin = (std::max)(cluster, firstCluster);
+    uint64_t end = (count >= mapEnd - cluster) ? mapEnd : cluster + count;
+    if (begin >= end) return 0;
+
+    uint64_t firstBit = begin - firstCluster;
+    uint64_t lastBit = end - firstCluster; // Exclusive
+    uint64_t firstWord = firstBit / 64;
+    uint64_t lastWord = (lastBit - 1) / 64;
+
+    uint64_t headMask = ~0ULL << (firstBit % 64);
+    uint64_t tailMask = (lastBit % 64 == 0) ? ~0ULL : ((1ULL << (lastBit % 64)) - 1);
+
+    if (firstWord == lastWord) {
+        return std::popcount(words[firstWord] & headMask & tailMask);
+    }
+
+    uint64_t total = std::popcount(words[firstWord] & headMask);
+    for (uint64_t i = firstWord + 1; i < lastWord; i++) {
+        total += std::popcount(words[i]);
+    }
+    total += std::popcount(words[lastWord] & tailMask);
+    return total;
+}
+
+bool AllocationBitmap::findFreeRun(uint64_t& cluster, uint64_t& length) const {
+    uint64_t bit = (cluster > firstCluster) ? cluster - firstCluster : 0;
+
+    // Skip allocated clusters, a full word at a time
+    while (bit < clusterCount) {
+        uint64_t freeBits = ~words[bit / 64] >> (bit % 64);
+        if (freeBits != 0) {
+            bit += std::countr_zero(freeBits);
+            break;
+        }
+        bit = (bit / 64 + 1) * 64;
+    }
+    if (bit >= clusterCount) return false;
+
+    // The run ends at the next allocated cluster or at the end of the map
+    uint64_t end = bit;
+    while (end < clusterCount) {
+        uint64_t allocatedBits = words[end / 64] >> (end % 64);
+        if (allocatedBits != 0) {
+            end += std::countr_zero(allocatedBits);
+            break;
+        }
+        end = (end / 64 + 1) * 64;
+    }
+
+    cluster = firstCluster + bit;
+    length = (std::min)(end, clusterCount) - bit;
+    return true;
+}
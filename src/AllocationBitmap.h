@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Packed cluster allocation map, one bit per cluster.
+// Loaded once per volume from the filesystem's own bitmap (exFAT, NTFS) or derived from the FAT (FAT32).
+class AllocationBitmap {
+private:
+    std::vector<uint64_t> words;
+    uint64_t firstCluster;  // Cluster described by bit 0
+    uint64_t clusterCount;
+
+public:
+    AllocationBitmap(uint64_t firstCluster, uint64_t clusterCount);
+
+    // Load the on-disk bitmap layout (bit 0 of byte 0 is firstCluster), missing bytes stay free
+    void loadFromBytes(const uint8_t* bytes, uint64_t length);
+    void markAllocated(uint64_t cluster);
+
+    // Clusters outside the map are reported as free
+    bool isAllocated(uint64_t cluster) const;
+    // Number of allocated clusters in [cluster, cluster + count)
+    uint64_t countAllocated(uint64_t cluster, uint64_t count) const;
+    uint64_t countAllocated() const { return countAllocated(firstCluster, clusterCount); }
+    // Find the first run of free clusters at or after cluster, false if there is none
+    bool findFreeRun(uint64_t& cluster, uint64_t& length) const;
+
+    uint64_t getFirstCluster() const { return firstCluster; }
+    uint64_t getClusterCount() const { return clusterCount; }
+    // Packed bits, bit n % 64 of word n / 64 is cluster firstCluster + n
+    const std::vector<uint64_t>& getWords() const { return words; }
+};
@@ -0,0 +1,194 @@
+#include "CachingSectorReader.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+
+CachingSectorReader::CachingSectorReader(std::unique_ptr<SectorReader> reader, uint64_t memoryLimit, uint32_t blockSize)
+    : inner(std::move(reader)) {
+    if (!inner) {
+        throw std::runtime_error("Invalid sector reader");
+    }
+    bytesPerSector = inner->getBytesPerSector();
+    if (bytesPerSector == 0 || bytesPerSector > MIN_BLOCK_BYTES) {
+        throw std::runtime_error("Invalid bytes per sector for the block cache");
+    }
+
+    blockBytes = std::bit_floor((std::clamp)(blockSize, MIN_BLOCK_BYTES, MAX_BLOCK_BYTES));
+    blockBytes -= blockBytes % bytesPerSector;
+    sectorsPerBlock = blockBytes / bytesPerSector;
+    totalSectors = inner->getTotalSectors();
+    blocksPerShard = static_cast<size_t>((std::max)(static_cast<uint64_t>(1), memoryLimit / blockBytes / SHARD_COUNT));
+}
+
+bool CachingSectorReader::copyFromBlock(uint64_t blockIndex, uint32_t offset, uint32_t size, uint8_t* output) {
+    Shard& shard = getShard(blockIndex);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.lookup.find(blockIndex);
+    if (it == shard.lookup.end() || offset + size > it->second->validBytes) {
+        return false;
+    }
+
+    shard.blocks.splice(shard.blocks.begin(), shard.blocks, it->second);
+    std::memcpy(output, it->second->data.get() + offset, size);
+    return true;
+}
+
+uint32_t CachingSectorReader::getReadAhead(uint64_t blockIndex) {
+    Shard& shard = getShard(blockIndex);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.lookup.find(blockIndex);
+    return it != shard.lookup.end() ? it->second->readAhead : 0;
+}
+
+bool CachingSectorReader::isCached(uint64_t blockIndex) {
+    Shard& shard = getShard(blockIndex);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.lookup.contains(blockIndex);
+}
+
+bool CachingSectorReader::isUnreadable(uint64_t blockIndex) {
+    Shard& shard = getShard(blockIndex);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.unreadable.contains(blockIndex);
+}
+
+void CachingSectorReader::insertBlock(uint64_t blockIndex, const uint8_t* data, uint32_t validBytes, uint32_t readAhead) {
+    Shard& shard = getShard(blockIndex);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Another thread missed on the same block and loaded it first
+    if (shard.lookup.contains(blockIndex)) return;
+
+    std::unique_ptr<uint8_t[]> memory;
+    if (shard.blocks.size() >= blocksPerShard) {
+        // Reuse the memory of the least recently used block
+        memory = std::move(shard.blocks.back().data);
+        shard.lookup.erase(shard.blocks.back().index);
+        shard.blocks.pop_back();
+    }
+    else {
+        memory = std::make_unique<uint8_t[]>(blockBytes);
+    }
+    std::memcpy(memory.get(), data, validBytes);
+
+    shard.blocks.push_front({ blockIndex, std::move(memory), validBytes, readAhead });
+    shard.lookup[blockIndex] = shard.blocks.begin();
+}
+
+bool CachingSectorReader::loadBlocks(uint64_t blockIndex) {
+    // Sequential misses grow the window, a random one starts over with a single block
+    uint32_t previousWindow = blockIndex > 0 ? getReadAhead(blockIndex - 1) : 0;
+    uint32_t window = previousWindow > 0 ? (std::min)(previousWindow * 2, MAX_READ_AHEAD_BLOCKS) : 1;
+
+    uint64_t firstSector = blockIndex * sectorsPerBlock;
+    if (totalSectors > 0 && firstSector >= totalSectors) return false;
+
+    // The window stops at the first block that is already cached or the end of the device
+    uint32_t blocks = 1;
+    while (blocks < window && !isCached(blockIndex + blocks)
+        && (totalSectors == 0 || firstSector + static_cast<uint64_t>(blocks) * sectorsPerBlock < totalSectors)) {
+        blocks++;
+    }
+
+    thread_local std::vector<uint8_t> loadBuffer;
+    while (true) {
+        uint64_t sectors = static_cast<uint64_t>(blocks) * sectorsPerBlock;
+        if (totalSectors > 0) sectors = (std::min)(sectors, totalSectors - firstSector);
+        loadBuffer.resize(static_cast<size_t>(sectors * bytesPerSector));
+
+        if (inner->readSectors(firstSector, static_cast<uint32_t>(sectors), loadBuffer.data())) {
+            Metrics::getInstance().add(MetricCounter::BLOCKS_READ_AHEAD, blocks - 1);
+            for (uint32_t i = 0; i < blocks; i++) {
+                uint64_t blockOffset = static_cast<uint64_t>(i) * blockBytes;
+                uint32_t validBytes = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(blockBytes), loadBuffer.size() - blockOffset));
+                insertBlock(blockIndex + i, loadBuffer.data() + blockOffset, validBytes, window);
+            }
+            return true;
+        }
+        if (blocks == 1) break;
+        // A bad sector in the window shouldn't keep the missed block out of the cache
+        blocks = 1;
+    }
+
+    Shard& shard = getShard(blockIndex);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.unreadable.insert(blockIndex);
+    return false;
+}
+
+bool CachingSectorReader::readCached(uint64_t byteOffset, uint64_t length, uint8_t* output) {
+    Metrics& metrics = Metrics::getInstance();
+    while (length > 0) {
+        uint64_t blockIndex = byteOffset / blockBytes;
+        uint32_t offset = static_cast<uint32_t>(byteOffset % blockBytes);
+        uint32_t size = static_cast<uint32_t>((std::min)(length, static_cast<uint64_t>(blockBytes - offset)));
+
+        metrics.add(MetricCounter::BLOCK_CACHE_LOOKUPS);
+        if (!copyFromBlock(blockIndex, offset, size, output)) {
+            metrics.add(MetricCounter::BLOCK_CACHE_MISSES);
+            // Unreadable blocks and blocks evicted right after loading are read directly, with the backend's result
+            if (isUnreadable(blockIndex) || !loadBlocks(blockIndex) || !copyFromBlock(blockIndex, offset, size, output)) {
+                return inner->readRange(byteOffset, length, output);
+            }
+        }
+        byteOffset += size;
+        length -= size;
+        output += size;
+    }
+    return true;
+}
+
+bool CachingSectorReader::readThrough(uint64_t startSector, uint32_t count, uint8_t* output) {
+    uint64_t endSector = startSector + count;
+    uint64_t sector = startSector;
+    uint64_t runStart = startSector; // First sector of the uncached run being collected
+    bool success = true;
+
+    auto readRun = [&](uint64_t runEnd) {
+        if (runEnd > runStart) {
+            success = inner->readSectors(runStart, static_cast<uint32_t>(runEnd - runStart), output + (runStart - startSector) * bytesPerSector) && success;
+        }
+    };
+
+    while (sector < endSector) {
+        uint64_t blockIndex = sector / sectorsPerBlock;
+        uint64_t spanSectors = (std::min)(endSector, (blockIndex + 1) * sectorsPerBlock) - sector;
+        uint32_t offset = static_cast<uint32_t>((sector % sectorsPerBlock) * bytesPerSector);
+
+        if (copyFromBlock(blockIndex, offset, static_cast<uint32_t>(spanSectors * bytesPerSector), output + (sector - startSector) * bytesPerSector)) {
+            readRun(sector);
+            runStart = sector + spanSectors;
+        }
+        sector += spanSectors;
+    }
+    readRun(endSector);
+    return success;
+}
+
+bool CachingSectorReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    // Backends read size bytes at the sector, anything but a whole sector keeps their semantics
+    if (size != bytesPerSector) {
+        return inner->readSector(sector, buffer, size);
+    }
+    return readCached(sector * bytesPerSector, size, static_cast<uint8_t*>(buffer));
+}
+
+bool CachingSectorReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    uint64_t bytes = static_cast<uint64_t>(count) * bytesPerSector;
+    if (bytes > blockBytes) {
+        return readThrough(startSector, count, static_cast<uint8_t*>(buffer));
+    }
+    return readCached(startSector * bytesPerSector, bytes, static_cast<uint8_t*>(buffer));
+}
+
+void CachingSectorReader::close() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.blocks.clear();
+        shard.lookup.clear();
+        shard.unreadable.clear();
+    }
+    inner->close();
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "SectorReader.h"
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Keeps recently read blocks of another reader in memory, so the scattered small reads of the
+// directory scans and the extension prediction don't go to the device twice. The cache lives as long
+// as the engine's reader, the scan and the recovery of a volume share it.
+// A miss right after the previous block doubles the block's read-ahead window, up to MAX_READ_AHEAD_BLOCKS,
+// and the whole window is fetched with one read. Large reads copy the blocks that are cached and read
+// the rest straight into the caller's buffer, so streaming a file doesn't evict the metadata.
+class CachingSectorReader : public SectorReader {
+private:
+    static constexpr uint32_t MIN_BLOCK_BYTES = 64 * 1024;
+    static constexpr uint32_t MAX_BLOCK_BYTES = 1024 * 1024;
+    static constexpr uint32_t MAX_READ_AHEAD_BLOCKS = 16;
+    static constexpr uint32_t SHARD_COUNT = 16; // Blocks are spread by index, the scan workers rarely wait on each other
+
+    struct Block {
+        uint64_t index;
+        std::unique_ptr<uint8_t[]> data;
+        uint32_t validBytes;     // Less than the block size only at the end of the device
+        uint32_t readAhead;      // Window used when the block was loaded
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Block> blocks; // Most recently used first
+        std::unordered_map<uint64_t, std::list<Block>::iterator> lookup;
+        std::unordered_set<uint64_t> unreadable; // Blocks that failed to load, read around the cache from then on
+    };
+
+    std::unique_ptr<SectorReader> inner;
+    uint32_t bytesPerSector;
+    uint32_t blockBytes;
+    uint32_t sectorsPerBlock;
+    uint64_t totalSectors;       // 0 if the backend doesn't know, blocks are then always read whole
+    size_t blocksPerShard;
+    std::array<Shard, SHARD_COUNT> shards;
+
+    Shard& getShard(uint64_t blockIndex) { return shards[blockIndex % SHARD_COUNT]; }
+    // Copy bytes of a cached block to output, false on a miss
+    bool copyFromBlock(uint64_t blockIndex, uint32_t offset, uint32_t size, uint8_t* output);
+    // Read-ahead window of a block, 0 if it isn't cached
+    uint32_t getReadAhead(uint64_t blockIndex);
+    bool isCached(uint64_t blockIndex);
+    bool isUnreadable(uint64_t blockIndex);
+    void insertBlock(uint64_t blockIndex, const uint8_t* data, uint32_t validBytes, uint32_t readAhead);
+    // Load a missing block and the read-ahead window behind it, false if the device read failed
+    bool loadBlocks(uint64_t blockIndex);
+    // Read through the cache, bytes of every block get loaded
+    bool readCached(uint64_t byteOffset, uint64_t length, uint8_t* output);
+    // Copy the cached blocks of a large read, everything else is read without filling the cache
+    bool readThrough(uint64_t startSector, uint32_t count, uint8_t* output);
+
+public:
+    // blockSize is rounded to a power of two between 64 KiB and 1 MiB and to whole sectors
+    CachingSectorReader(std::unique_ptr<SectorReader> inner, uint64_t memoryLimit, uint32_t blockSize);
+
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    // Forwarded as a whole, batches are recovery streams that an overlapped backend keeps in flight
+    bool readBatch(std::vector<ReadRequest>& requests) override { return inner->readBatch(requests); }
+    // Salvaging follows failed reads, the failed blocks aren't cached anyway
+    bool salvageSectors(uint64_t startSector, uint32_t count, void* buffer, std::vector<uint64_t>& unreadableSectors) override {
+        return inner->salvageSectors(startSector, count, buffer, unreadableSectors);
+    }
+    SectorSpan mapSectors(uint64_t startSector, uint32_t count) override { return inner->mapSectors(startSector, count); }
+    uint64_t getTotalSectors() override { return totalSectors; }
+    uint32_t getBytesPerSector() override { return bytesPerSector; }
+    std::wstring getFilesystemType() override { return inner->getFilesystemType(); }
+    uint64_t getTotalMftRecords() override { return inner->getTotalMftRecords(); }
+    bool isOpen() const override { return inner->isOpen(); }
+    bool reopen() override { return inner->reopen(); }
+    // Closing releases the cached blocks as well
+    void close() override;
+};
@@ -1,27 +1,51 @@
 #include "ClusterHistory.h"
+#include <algorithm>
 
 
-void ClusterHistory::recordClusterUsage(uint32_t cluster, uint32_t fileId, uint64_t writeOffset) {
-    ClusterUsage usage; 
-    usage.timestamp = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
-    usage.fileId = fileId;
-    usage.isDeleted = true;
-    usage.writeOffset = writeOffset;
-    
-    clusterUsageHistory[cluster].push_back(usage);
+void ClusterHistory::clear() {
+    extents.clear();
+    maxEnd.clear();
+    finalized = false;
 }
 
-std::vector<std::pair<ClusterUsage, ClusterUsage>> ClusterHistory::findOverlappingUsage(uint32_t cluster) {
-    std::vector<std::pair<ClusterUsage, ClusterUsage>> overlaps;
-    auto& history = clusterUsageHistory[cluster];
+void ClusterHistory::addExtent(uint32_t fileId, uint64_t startCluster, uint64_t length) {
+    if (length == 0) return;
+    extents.push_back({ startCluster, startCluster + length, fileId });
+    finalized = false;
+}
+
+void ClusterHistory::finalize() {
+    std::sort(extents.begin(), extents.end(), [](const Extent& a, const Extent& b) {
+        return a.startCluster < b.startCluster;
+    });
+
+    maxEnd.resize(extents.size());
+    uint64_t runningMax = 0;
+    for (size_t i = 0; i < extents.size(); i++) {
+        runningMax = (std::max)(runningMax, extents[i].endCluster);
+        maxEnd[i] = runningMax;
+    }
+    finalized = true;
+}
+
+void ClusterHistory::findOverlaps(uint32_t fileId, uint64_t startCluster, uint64_t length, std::vector<ClusterOverlap>& overlaps) const {
+    if (!finalized || length == 0) return;
+    uint64_t endCluster = startCluster + length;
+
+    // Extents starting at or after the end of the query can't overlap it
+    auto first = std::lower_bound(extents.begin(), extents.end(), endCluster, [](const Extent& extent, uint64_t cluster) {
+        return extent.startCluster < cluster;
+    });
+
+    for (size_t i = static_cast<size_t>(first - extents.begin()); i-- > 0; ) {
+        // No earlier extent reaches the query
+        if (maxEnd[i] <= startCluster) break;
 
-    for (size_t i = 0; i < history.size(); i++) {
-        for (size_t j = i + 1; j < history.size(); j++) {
-            if (history[i].fileId != history[j].fileId &&
-                history[i].isDeleted && history[j].isDeleted) {
-                overlaps.push_back({ history[i], history[j] });
-            }
+        const Extent& extent = extents[i];
+        if (extent.endCluster > startCluster && extent.fileId != fileId) {
+            uint64_t overlapStart = (std::max)(extent.startCluster, startCluster);
+            uint64_t overlapEnd = (std::min)(extent.endCluster, endCluster);
+            overlaps.push_back({ overlapStart, overlapEnd - overlapStart, extent.fileId });
         }
     }
-    return overlaps;
 }
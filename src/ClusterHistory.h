@@ -1,17 +1,29 @@
 #pragma once
 #include "Structures.h"
 #include <cstdint>
-#include <map>
 #include <vector>
-#include <chrono>
 
+// Sorted table of the cluster extents claimed by deleted files, used to find files sharing clusters.
+// Extents are added first, finalize() sorts them, after that overlaps are answered with a binary search
+// and a backward walk bounded by the running maximum of the extent ends.
 class ClusterHistory {
-public:
-
+private:
+    struct Extent {
+        uint64_t startCluster;
+        uint64_t endCluster; // Exclusive
+        uint32_t fileId;
+    };
 
-    std::map<uint32_t, std::vector<ClusterUsage>> clusterUsageHistory;
+    std::vector<Extent> extents;
+    std::vector<uint64_t> maxEnd; // Largest endCluster of extents[0..i]
+    bool finalized = false;
 
-    void recordClusterUsage(uint32_t cluster, uint32_t fileId, uint64_t writeOffset);
+public:
+    void clear();
+    void addExtent(uint32_t fileId, uint64_t startCluster, uint64_t length);
+    void finalize();
+    bool isFinalized() const { return finalized; }
 
-    std::vector<std::pair<ClusterUsage, ClusterUsage>> findOverlappingUsage(uint32_t cluster);
-};
\ No newline at end of file
+    // Append the parts of [startCluster, startCluster + length) claimed by files other than fileId
+    void findOverlaps(uint32_t fileId, uint64_t startCluster, uint64_t length, std::vector<ClusterOverlap>& overlaps) const;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include "Enums.h"
 #include <string>
 #include <cstdint>
 
@@ -16,15 +17,40 @@ public:
     }
 
     std::wstring drivePath = L"";
-    std::wstring inputFolder = L""; // not implemented yed
+    std::wstring inputFolder = L""; // Only files below this folder, relative to the volume root
+    std::wstring pathPattern = L""; // Wildcard pattern (* and ?) the path of a file has to match
+    std::wstring extensionFilter = L""; // Comma separated extensions to keep
+    std::string fileIdFilter = ""; // IDs and ranges to keep, e.g. "1,5,10-20"
     std::wstring outputFolder = L"Recovered";
     std::wstring logFolder = L"Log";
-    std::wstring logFile = L"FileDataLog.txt";
-    uint32_t targetCluster = 0; // not implemented yed
-    uint32_t targetFileSize = 0; // not implemented yed
+    std::wstring logFile = L"FileDataLog.csv"; // The extension follows logFormat
+    std::wstring recoveryLogFile = L"RecoveredFiles.csv"; // Digests of recovered files, written when hashing is enabled
+    std::wstring contentScoreFile = L"ContentScores.csv"; // Scored files, best first, written when scoring is enabled
+    LogFormat logFormat = LogFormat::CSV_FORMAT;
+    std::wstring metricsFile = L""; // JSON file the run's metrics are written to at exit (empty = none)
+    uint64_t targetCluster = 0; // First cluster a file has to start at (0 = any)
+    uint64_t targetFileSize = 0; // Exact size a file has to have (0 = any)
+    uint64_t minFileSize = 0;
+    uint64_t maxFileSize = UINT64_MAX;
     bool createFileDataLog = true;
+    bool quiet = false; // No console line per found or recovered file
     bool recover = false;
     bool analyze = false;
+    bool scoreContent = false; // Sample the clusters of the selected files and rank them by confidence before recovery
+    uint32_t minConfidence = 0; // Files scored below it are not recovered (0 = keep all)
+    bool recoverAll = false; // Process every file found without asking
+    bool carve = false; // Carve file signatures from unallocated clusters
+    bool useIndex = false; // Load the scan result of an earlier run if the volume is unchanged
+    bool resume = false; // Continue an interrupted scan from its checkpoint if the volume is unchanged
+    bool hashSha256 = false; // SHA-256 of every recovered file, computed while it's written
+    bool hashXxh3 = false; // XXH3 64 bit hash of every recovered file
+    bool degradedMedia = false; // Bisect failed reads and skip past bad areas instead of retrying every sector
+    std::wstring badSectorMapFile = L"BadSectors.txt"; // Bad sectors found in degraded mode, kept in the log folder for later runs
+    uint64_t fatCacheLimit = 512ull * 1024 * 1024; // Memory limit for the in-memory FAT (bytes)
+    uint64_t readCacheLimit = 256ull * 1024 * 1024; // Memory limit for cached device blocks (bytes, 0 = no cache)
+    uint32_t readCacheBlockSize = 256 * 1024; // Bytes per cached block, a power of two from 64 KiB to 1 MiB
+    uint32_t ioQueueDepth = 1; // Reads kept in flight during recovery (1 = synchronous reader)
+    uint32_t threadCount = 0; // Worker threads used while scanning and, up to 4, recovering (0 = hardware threads)
 
 
 };
@@ -0,0 +1,530 @@
+#include "ContentAnalyzer.h"
+#include "Metrics.h"
+#include "SignatureDB.h"
+#include "SparseFileWriter.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cwctype>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONTENT_ANALYZER_USE_SSE2
+#endif
+
+
+namespace {
+    constexpr uint32_t MAX_SAMPLE_BYTES = 8192;      // A sample grows by the sector alignment of its start
+    constexpr uint32_t MIN_PROFILE_BYTES = 512;      // Shorter samples say too little about their entropy
+    constexpr double MIN_COMPRESSED_ENTROPY = 7.0;   // Bits per byte, compressed data stays close to 8
+    constexpr double MIN_TEXT_RATIO = 0.9;           // Share of text bytes, UTF-8 sequences included
+    constexpr size_t MAX_FOREIGN_JPEG_MARKERS = 4;   // Per sample of scan data, random data has about 15
+    constexpr size_t FOOTER_WINDOW = 1024;           // The footer is searched this far from the end of the file
+
+    // Confidence factors
+    constexpr double FOREIGN_HEADER_FACTOR = 0.2;    // The file starts with another type's signature
+    constexpr double MISSING_HEADER_FACTOR = 0.4;    // The type always has a signature but there is none
+    constexpr double UNKNOWN_TYPE_FACTOR = 0.75;     // Nothing to compare the content with
+    constexpr double DAMAGED_FORMAT_FACTOR = 0.5;
+
+    enum class ContentClass {
+        MIXED,      // Nothing expected of the entropy
+        COMPRESSED,
+        TEXT
+    };
+
+    // What the content of a file type looks like
+    struct TypeProfile {
+        std::wstring_view extension;
+        std::wstring_view signature;   // Extension SignatureDB reports for the type, empty if it has none
+        bool signatureRequired;        // Every file of the type starts with it
+        ContentClass contentClass;
+    };
+
+    constexpr TypeProfile PROFILES[] = {
+        { L"jpg",  L"jpg",    true,  ContentClass::COMPRESSED },
+        { L"jpeg", L"jpg",    true,  ContentClass::COMPRESSED },
+        { L"jpe",  L"jpg",    true,  ContentClass::COMPRESSED },
+        { L"png",  L"png",    true,  ContentClass::COMPRESSED },
+        { L"gif",  L"gif",    true,  ContentClass::MIXED },
+        { L"webp", L"webp",   true,  ContentClass::COMPRESSED },
+        { L"tif",  L"tif",    true,  ContentClass::MIXED },
+        { L"tiff", L"tif",    true,  ContentClass::MIXED },
+        { L"bmp",  L"bmp",    true,  ContentClass::MIXED },
+        { L"psd",  L"psd",    true,  ContentClass::MIXED },
+        { L"pdf",  L"pdf",    true,  ContentClass::MIXED },
+        { L"zip",  L"zip",    true,  ContentClass::COMPRESSED },
+        { L"docx", L"zip",    true,  ContentClass::COMPRESSED },
+        { L"xlsx", L"zip",    true,  ContentClass::COMPRESSED },
+        { L"pptx", L"zip",    true,  ContentClass::COMPRESSED },
+        { L"odt",  L"zip",    true,  ContentClass::COMPRESSED },
+        { L"ods",  L"zip",    true,  ContentClass::COMPRESSED },
+        { L"odp",  L"zip",    true,  ContentClass::COMPRESSED },
+        { L"jar",  L"zip",    true,  ContentClass::COMPRESSED },
+        { L"apk",  L"zip",    true,  ContentClass::COMPRESSED },
+        { L"epub", L"zip",    true,  ContentClass::COMPRESSED },
+        { L"doc",  L"doc",    true,  ContentClass::MIXED },
+        { L"xls",  L"doc",    true,  ContentClass::MIXED },
+        { L"ppt",  L"doc",    true,  ContentClass::MIXED },
+        { L"msg",  L"doc",    true,  ContentClass::MIXED },
+        { L"rtf",  L"rtf",    true,  ContentClass::TEXT },
+        { L"wav",  L"wav",    true,  ContentClass::MIXED },
+        { L"avi",  L"avi",    true,  ContentClass::MIXED },
+        { L"mov",  L"mov",    false, ContentClass::COMPRESSED }, // Brands other than qt match mp4
+        { L"mp4",  L"mp4",    true,  ContentClass::COMPRESSED },
+        { L"m4a",  L"mp4",    true,  ContentClass::COMPRESSED },
+        { L"m4v",  L"mp4",    true,  ContentClass::COMPRESSED },
+        { L"3gp",  L"mp4",    true,  ContentClass::COMPRESSED },
+        { L"mkv",  L"mkv",    true,  ContentClass::COMPRESSED },
+        { L"webm", L"mkv",    true,  ContentClass::COMPRESSED },
+        { L"mp3",  L"mp3",    false, ContentClass::COMPRESSED }, // Files without an ID3 tag start with a frame
+        { L"flac", L"flac",   true,  ContentClass::COMPRESSED },
+        { L"ogg",  L"ogg",    true,  ContentClass::COMPRESSED },
+        { L"oga",  L"ogg",    true,  ContentClass::COMPRESSED },
+        { L"opus", L"ogg",    true,  ContentClass::COMPRESSED },
+        { L"exe",  L"exe",    true,  ContentClass::MIXED },
+        { L"dll",  L"exe",    true,  ContentClass::MIXED },
+        { L"sys",  L"exe",    true,  ContentClass::MIXED },
+        { L"rar",  L"rar",    true,  ContentClass::COMPRESSED },
+        { L"gz",   L"gz",     true,  ContentClass::COMPRESSED },
+        { L"tgz",  L"gz",     true,  ContentClass::COMPRESSED },
+        { L"bz2",  L"bz2",    true,  ContentClass::COMPRESSED },
+        { L"7z",   L"7z",     true,  ContentClass::COMPRESSED },
+        { L"sqlite", L"sqlite", true, ContentClass::MIXED },
+        { L"otf",  L"otf",    true,  ContentClass::MIXED },
+        { L"ttf",  L"ttf",    true,  ContentClass::MIXED },
+        { L"xml",  L"xml",    false, ContentClass::TEXT },
+        { L"html", L"html",   false, ContentClass::TEXT },
+        { L"htm",  L"html",   false, ContentClass::TEXT },
+        { L"json", L"json",   false, ContentClass::TEXT },
+        { L"txt",  L"",       false, ContentClass::TEXT },
+        { L"csv",  L"",       false, ContentClass::TEXT },
+        { L"log",  L"",       false, ContentClass::TEXT },
+        { L"md",   L"",       false, ContentClass::TEXT },
+        { L"ini",  L"",       false, ContentClass::TEXT },
+        { L"cfg",  L"",       false, ContentClass::TEXT },
+        { L"c",    L"",       false, ContentClass::TEXT },
+        { L"cpp",  L"",       false, ContentClass::TEXT },
+        { L"h",    L"",       false, ContentClass::TEXT },
+        { L"hpp",  L"",       false, ContentClass::TEXT },
+        { L"cs",   L"",       false, ContentClass::TEXT },
+        { L"java", L"",       false, ContentClass::TEXT },
+        { L"py",   L"",       false, ContentClass::TEXT },
+        { L"js",   L"",       false, ContentClass::TEXT },
+        { L"css",  L"",       false, ContentClass::TEXT },
+        { L"sql",  L"",       false, ContentClass::TEXT },
+        { L"yml",  L"",       false, ContentClass::TEXT },
+        { L"yaml", L"",       false, ContentClass::TEXT },
+        { L"sh",   L"",       false, ContentClass::TEXT },
+        { L"bat",  L"",       false, ContentClass::TEXT },
+        { L"ps1",  L"",       false, ContentClass::TEXT },
+    };
+
+    // Profile of the extension at the end of the path, compared case insensitively
+    const TypeProfile* findProfile(std::wstring_view path) {
+        size_t dotPos = path.find_last_of(L".\\");
+        if (dotPos == std::wstring_view::npos || path[dotPos] != L'.') return nullptr;
+
+        std::wstring extension(path.substr(dotPos + 1));
+        for (wchar_t& c : extension) c = static_cast<wchar_t>(std::towlower(c));
+        for (const TypeProfile& profile : PROFILES) {
+            if (profile.extension == extension) return &profile;
+        }
+        return nullptr;
+    }
+
+    // Text files may start with any of the text signatures
+    bool isTextSignature(std::wstring_view extension) {
+        return extension == L"xml" || extension == L"html" || extension == L"json" || extension == L"rtf";
+    }
+
+    bool belongsToProfile(const FileSignature& signature, const TypeProfile& profile) {
+        std::wstring_view detected = signature.extension;
+        if (detected == profile.signature) return true;
+        if (profile.signature == L"mov" && detected == L"mp4") return true;
+        return profile.contentClass == ContentClass::TEXT && isTextSignature(detected);
+    }
+
+    // c * log2(c) for every count a sample can reach, so the entropy takes no logarithm per byte value
+    const std::vector<double>& getCountLogTable() {
+        static const std::vector<double> table = [] {
+            std::vector<double> values(MAX_SAMPLE_BYTES + 1, 0.0);
+            for (uint32_t count = 1; count <= MAX_SAMPLE_BYTES; count++) {
+                values[count] = count * std::log2(static_cast<double>(count));
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    struct SampleProfile {
+        double entropy;    // Bits per byte
+        double textRatio;  // Share of tabs, line breaks, printable ASCII and UTF-8 bytes
+    };
+
+    SampleProfile profileSample(const uint8_t* data, size_t size) {
+        // Four interleaved histograms, consecutive bytes of equal value don't wait for each other's increment
+        alignas(16) uint32_t counts[4][256] = {};
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            counts[0][data[i]]++;
+            counts[1][data[i + 1]]++;
+            counts[2][data[i + 2]]++;
+            counts[3][data[i + 3]]++;
+        }
+        for (; i < size; i++) {
+            counts[0][data[i]]++;
+        }
+
+#ifdef CONTENT_ANALYZER_USE_SSE2
+        for (size_t value = 0; value < 256; value += 4) {
+            __m128i sum = _mm_add_epi32(
+                _mm_add_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(&counts[0][value])), _mm_load_si128(reinterpret_cast<const __m128i*>(&counts[1][value]))),
+                _mm_add_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(&counts[2][value])), _mm_load_si128(reinterpret_cast<const __m128i*>(&counts[3][value]))));
+            _mm_store_si128(reinterpret_cast<__m128i*>(&counts[0][value]), sum);
+        }
+#else
+        for (size_t value = 0; value < 256; value++) {
+            counts[0][value] += counts[1][value] + counts[2][value] + counts[3][value];
+        }
+#endif
+
+        const std::vector<double>& countLog = getCountLogTable();
+        double countLogSum = 0.0;
+        uint64_t textBytes = counts[0]['\t'] + counts[0]['\n'] + counts[0]['\r'];
+        for (size_t value = 0; value < 256; value++) {
+            countLogSum += countLog[counts[0][value]];
+            if ((value >= 0x20 && value < 0x7F) || value >= 0x80) textBytes += counts[0][value];
+        }
+
+        // A sample of one byte value gives 0 up to rounding, which must not print as -0.000
+        double bytes = static_cast<double>(size);
+        return { (std::max)(0.0, std::log2(bytes) - countLogSum / bytes), textBytes / bytes };
+    }
+
+    uint16_t readBigEndian16(const uint8_t* data) {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+
+    uint32_t readBigEndian32(const uint8_t* data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    // Walk the segments after SOI, false if a marker or a length is broken.
+    // scanStart is where the entropy coded data begins, 0 if the segments run past the sample.
+    bool checkJpegSegments(const uint8_t* data, size_t size, uint64_t& scanStart) {
+        scanStart = 0;
+        size_t position = 2;
+        while (position + 4 <= size) {
+            if (data[position] != 0xFF) return false;
+            uint8_t marker = data[position + 1];
+            if (marker == 0xFF) {
+                position++; // Fill byte
+                continue;
+            }
+            if (marker == 0x00 || marker == 0xD8 || marker == 0xD9) return false;
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+                position += 2; // No length
+                continue;
+            }
+
+            uint16_t length = readBigEndian16(data + position + 2);
+            if (length < 2) return false;
+            position += 2 + static_cast<size_t>(length);
+            if (marker == 0xDA) {
+                scanStart = position;
+                return true;
+            }
+        }
+        return true;
+    }
+
+    // Inside scan data a 0xFF is stuffed or starts a restart marker, other markers only sit between scans
+    size_t countForeignJpegMarkers(const uint8_t* data, size_t size) {
+        size_t markers = 0;
+        for (size_t i = 0; i + 1 < size; i++) {
+            if (data[i] != 0xFF) continue;
+            uint8_t next = data[i + 1];
+            if (next != 0x00 && next != 0xFF && next != 0xD9 && !(next >= 0xD0 && next <= 0xD7)) markers++;
+        }
+        return markers;
+    }
+
+    // IHDR has to come first, every chunk that follows in the sample needs a type made of letters
+    bool checkPngChunks(const uint8_t* data, size_t size) {
+        static constexpr size_t SIGNATURE_BYTES = 8;
+        if (size < SIGNATURE_BYTES + 8) return true;
+        if (readBigEndian32(data + SIGNATURE_BYTES) != 13 || std::memcmp(data + SIGNATURE_BYTES + 4, "IHDR", 4) != 0) return false;
+
+        size_t position = SIGNATURE_BYTES;
+        while (position + 8 <= size) {
+            uint32_t length = readBigEndian32(data + position);
+            if (length > 0x7FFFFFFF) return false;
+            for (size_t i = 4; i < 8; i++) {
+                uint8_t c = data[position + i];
+                if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))) return false;
+            }
+            position += 12 + static_cast<size_t>(length);
+        }
+        return true;
+    }
+
+    bool containsFooter(const uint8_t* data, size_t size, std::string_view footer) {
+        size_t windowBytes = (std::min)(size, FOOTER_WINDOW);
+        std::string_view window(reinterpret_cast<const char*>(data + size - windowBytes), windowBytes);
+        return window.find(footer) != std::string_view::npos;
+    }
+}
+
+ContentAnalyzer::ContentAnalyzer(SectorReader& reader, const RecoveryGeometry& geometry, Utils& utils)
+    : sectorReader(reader)
+    , geometry(geometry)
+    , utils(utils)
+    , bytesPerCluster(static_cast<uint64_t>(geometry.sectorsPerCluster) * geometry.bytesPerSector) {
+    if (bytesPerCluster == 0) {
+        throw std::runtime_error("Invalid cluster size for content analysis");
+    }
+}
+
+uint64_t ContentAnalyzer::clusterToSector(uint64_t cluster) const {
+    return geometry.firstClusterSector + (cluster - geometry.firstCluster) * geometry.sectorsPerCluster;
+}
+
+uint64_t ContentAnalyzer::getFirstSector(const ContentCandidate& candidate) const {
+    if (!candidate.residentData.empty()) return 0;
+    for (const FileExtent& extent : candidate.extents) {
+        if (!extent.sparse) return clusterToSector(extent.startCluster);
+    }
+    return 0;
+}
+
+void ContentAnalyzer::planSamples(const ContentCandidate& candidate, std::vector<Sample>& samples, std::vector<ReadRequest>& requests, uint8_t* slots, uint32_t slotBytes) const {
+    if (!candidate.residentData.empty()) {
+        uint32_t size = static_cast<uint32_t>((std::min)(candidate.residentData.size(), static_cast<size_t>(MAX_SAMPLE_BYTES)));
+        samples.push_back({ 0, size, candidate.residentData.data(), true, 0 });
+        return;
+    }
+    if (candidate.fileSize == 0) return;
+
+    uint32_t bytesPerSector = geometry.bytesPerSector;
+    uint64_t fileSize = candidate.fileSize;
+    uint32_t sampleCount = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(MAX_SAMPLES), (fileSize + SAMPLE_BYTES - 1) / SAMPLE_BYTES));
+    for (uint32_t i = 0; i < sampleCount; i++) {
+        // Evenly spread, the last sample ends with the file. Starting at a sector boundary adds the bytes before it.
+        uint64_t targetOffset = sampleCount == 1 ? 0 : (fileSize - SAMPLE_BYTES) * i / (sampleCount - 1);
+        uint64_t fileOffset = targetOffset - targetOffset % bytesPerSector;
+        uint64_t size = (std::min)({ fileSize - fileOffset, targetOffset - fileOffset + SAMPLE_BYTES, static_cast<uint64_t>(MAX_SAMPLE_BYTES) });
+
+        uint64_t extentStart = 0;
+        const FileExtent* sampledExtent = nullptr;
+        for (const FileExtent& extent : candidate.extents) {
+            uint64_t extentBytes = extent.length * bytesPerCluster;
+            if (fileOffset < extentStart + extentBytes) {
+                sampledExtent = &extent;
+                break;
+            }
+            extentStart += extentBytes;
+        }
+
+        // The chain ended before the file did, those bytes can't be recovered either
+        if (!sampledExtent) {
+            samples.push_back({ fileOffset, static_cast<uint32_t>(size), nullptr, false, 0 });
+            continue;
+        }
+        // Sparse ranges are zeros by design
+        if (sampledExtent->sparse) continue;
+
+        uint64_t extentOffset = fileOffset - extentStart;
+        size = (std::min)(size, sampledExtent->length * bytesPerCluster - extentOffset);
+        uint8_t* buffer = slots + requests.size() * slotBytes;
+        samples.push_back({ fileOffset, static_cast<uint32_t>(size), buffer, false, requests.size() });
+        requests.push_back({ clusterToSector(sampledExtent->startCluster) + extentOffset / bytesPerSector,
+            static_cast<uint32_t>((size + bytesPerSector - 1) / bytesPerSector), buffer, false });
+    }
+}
+
+void ContentAnalyzer::scoreBatch(const std::vector<ContentCandidate>& candidates, const std::vector<size_t>& order, size_t first, size_t last, std::vector<ContentScore>& scores) {
+    uint32_t bytesPerSector = geometry.bytesPerSector;
+    uint32_t slotBytes = (MAX_SAMPLE_BYTES + bytesPerSector - 1) / bytesPerSector * bytesPerSector;
+    size_t slotCount = (last - first) * MAX_SAMPLES;
+    std::unique_ptr<uint8_t, AlignedDeleter> slotMemory(static_cast<uint8_t*>(::operator new(slotCount * slotBytes, std::align_val_t(BUFFER_ALIGNMENT))));
+
+    std::vector<std::vector<Sample>> fileSamples(last - first);
+    std::vector<ReadRequest> requests;
+    requests.reserve(slotCount);
+    for (size_t i = first; i < last; i++) {
+        planSamples(candidates[order[i]], fileSamples[i - first], requests, slotMemory.get(), slotBytes);
+    }
+
+    // Failed requests only mark their samples unreadable, the rest of the batch is still scored
+    if (!requests.empty()) sectorReader.readBatch(requests);
+    for (size_t i = first; i < last; i++) {
+        const ContentCandidate& candidate = candidates[order[i]];
+        for (Sample& sample : fileSamples[i - first]) {
+            if (sample.data && candidate.residentData.empty()) sample.readable = requests[sample.request].success;
+        }
+        scores[order[i]] = scoreFile(candidate, fileSamples[i - first]);
+    }
+    Metrics::getInstance().add(MetricCounter::FILES_SCORED, last - first);
+}
+
+ContentScore ContentAnalyzer::scoreFile(const ContentCandidate& candidate, const std::vector<Sample>& samples) const {
+    ContentScore score;
+    score.samples = static_cast<uint32_t>(samples.size());
+    // Nothing on disk, the file is either empty or entirely sparse
+    if (samples.empty()) return score;
+
+    const TypeProfile* profile = findProfile(candidate.path);
+    const Sample* header = samples.front().fileOffset == 0 && samples.front().readable ? &samples.front() : nullptr;
+    const FileSignature* signature = header ? SignatureDB::match(header->data, header->size) : nullptr;
+    if (signature) score.detectedType = signature->extension;
+    std::wstring_view format = signature ? std::wstring_view(signature->extension) : std::wstring_view();
+
+    uint64_t scanStart = 0;
+    bool formatChecked = false;
+    bool formatDamaged = false;
+    auto recordCheck = [&](bool passed) {
+        formatChecked = true;
+        formatDamaged = formatDamaged || !passed;
+    };
+    if (header && format == L"jpg") recordCheck(checkJpegSegments(header->data, header->size, scanStart));
+    if (header && format == L"png") recordCheck(checkPngChunks(header->data, header->size));
+
+    uint32_t readableSamples = 0;
+    uint32_t profiledSamples = 0;
+    uint32_t mismatchedSamples = 0;
+    double entropySum = 0.0;
+    for (const Sample& sample : samples) {
+        if (!sample.readable) {
+            score.unreadableSamples++;
+            continue;
+        }
+        readableSamples++;
+        if (SparseFileWriter::isZeroBlock(sample.data, sample.size)) {
+            score.zeroSamples++;
+            continue;
+        }
+
+        SampleProfile sampleProfile = profileSample(sample.data, sample.size);
+        entropySum += sampleProfile.entropy;
+
+        // Headers of compressed types hold tables and metadata, only the data after them is compressed
+        bool isHeader = &sample == header;
+        if (profile && sample.size >= MIN_PROFILE_BYTES && !(isHeader && profile->contentClass == ContentClass::COMPRESSED)) {
+            if (profile->contentClass == ContentClass::COMPRESSED) {
+                profiledSamples++;
+                if (sampleProfile.entropy < MIN_COMPRESSED_ENTROPY) mismatchedSamples++;
+            }
+            else if (profile->contentClass == ContentClass::TEXT) {
+                profiledSamples++;
+                if (sampleProfile.textRatio < MIN_TEXT_RATIO) mismatchedSamples++;
+            }
+        }
+
+        if (format == L"jpg" && scanStart > 0 && sample.fileOffset >= scanStart) {
+            recordCheck(countForeignJpegMarkers(sample.data, sample.size) <= MAX_FOREIGN_JPEG_MARKERS);
+        }
+        bool isTail = sample.fileOffset + sample.size == candidate.fileSize;
+        if (signature && isTail && !signature->carve.footer.empty()) {
+            recordCheck(containsFooter(sample.data, sample.size, signature->carve.footer));
+        }
+    }
+    uint32_t dataSamples = readableSamples - score.zeroSamples;
+    if (dataSamples > 0) score.entropy = entropySum / dataSamples;
+    if (formatChecked) score.format = formatDamaged ? FormatVerdict::DAMAGED_VERDICT : FormatVerdict::VALID_VERDICT;
+
+    // Every piece of evidence scales what the previous ones left
+    double confidence = 1.0 - static_cast<double>(score.unreadableSamples) / samples.size();
+    if (readableSamples > 0) {
+        confidence *= 1.0 - (profile ? 0.9 : 0.5) * score.zeroSamples / readableSamples;
+    }
+    if (!profile) {
+        confidence *= UNKNOWN_TYPE_FACTOR;
+    }
+    else if (signature && !belongsToProfile(*signature, *profile)) {
+        confidence *= FOREIGN_HEADER_FACTOR;
+    }
+    else if (!signature && profile->signatureRequired) {
+        confidence *= MISSING_HEADER_FACTOR;
+    }
+    if (profiledSamples > 0) {
+        confidence *= 1.0 - 0.8 * mismatchedSamples / profiledSamples;
+    }
+    if (formatDamaged) {
+        confidence *= DAMAGED_FORMAT_FACTOR;
+    }
+    score.confidence = static_cast<uint32_t>(std::lround((std::max)(0.0, confidence) * 100));
+    return score;
+}
+
+std::vector<ContentScore> ContentAnalyzer::scoreFiles(const std::vector<ContentCandidate>& candidates) {
+    ScopedTimer timer(MetricPhase::CONTENT_SCORING);
+    std::vector<ContentScore> scores(candidates.size());
+
+    // Batches follow the disk like recovery does, so the drive keeps reading forward
+    std::vector<size_t> order(candidates.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint64_t> firstSectors(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+        firstSectors[i] = getFirstSector(candidates[i]);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return firstSectors[a] < firstSectors[b]; });
+
+    std::atomic<uint64_t> scoredFiles{ 0 };
+    ThreadPool pool(ThreadPool::resolveThreadCount(config.threadCount));
+    for (size_t first = 0; first < order.size(); first += FILES_PER_BATCH) {
+        size_t last = (std::min)(first + FILES_PER_BATCH, order.size());
+        pool.submit([this, &candidates, &order, &scores, &scoredFiles, first, last] {
+            scoreBatch(candidates, order, first, last, scores);
+            utils.showProgress(scoredFiles += last - first, order.size());
+        });
+    }
+    pool.wait();
+    return scores;
+}
+
+std::vector<ContentScore> ContentAnalyzer::rankFiles(const std::vector<ContentCandidate>& candidates) {
+    std::cout << "[*] Scoring the content of " << candidates.size() << " files..." << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ContentScore> scores = scoreFiles(candidates);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::endl;
+
+    // Best first, files of the same confidence keep their order
+    std::vector<size_t> ranking(candidates.size());
+    std::iota(ranking.begin(), ranking.end(), 0);
+    std::stable_sort(ranking.begin(), ranking.end(), [&](size_t a, size_t b) { return scores[a].confidence > scores[b].confidence; });
+
+    std::vector<LoggedFile> files;
+    files.reserve(ranking.size());
+    size_t likelyIntact = 0;
+    size_t likelyOverwritten = 0;
+    for (size_t index : ranking) {
+        const ContentCandidate& candidate = candidates[index];
+        LoggedFile file;
+        file.fileId = candidate.fileId;
+        file.path = candidate.path;
+        file.fileSize = candidate.fileSize;
+        file.score = scores[index];
+        files.push_back(std::move(file));
+
+        if (scores[index].confidence >= HIGH_CONFIDENCE) likelyIntact++;
+        else if (scores[index].confidence < LOW_CONFIDENCE) likelyOverwritten++;
+    }
+    if (!utils.writeContentScoreLog(std::move(files))) {
+        std::cerr << "[!] Couldn't open the content score log, the ranking is not saved" << std::endl;
+    }
+
+    std::cout << "[+] Scored " << candidates.size() << " files in " << std::fixed << std::setprecision(2) << seconds << " s: "
+        << likelyIntact << " likely intact, " << candidates.size() - likelyIntact - likelyOverwritten << " doubtful, "
+        << likelyOverwritten << " likely overwritten" << std::endl;
+    return scores;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "IConfigurable.h"
+#include "RecoveryPipeline.h"
+#include "SectorReader.h"
+#include "Structures.h"
+#include "Utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <vector>
+
+// A file to score, its bytes are found through the extents the way recovery finds them
+struct ContentCandidate {
+    uint32_t fileId;
+    std::wstring path;                      // For the content score log, its extension is the type the file claims
+    uint64_t fileSize;
+    std::vector<FileExtent> extents;        // In file order
+    std::span<const uint8_t> residentData;  // NTFS data stored in the MFT record, scored instead of the extents
+};
+
+// Scores how likely the clusters of deleted files still hold their content, without recovering them.
+// Every file is sampled at up to MAX_SAMPLES places spread over its length, the start and the end included,
+// and the samples of FILES_PER_BATCH files go to the reader as one batch. Batches are scored on the worker
+// threads: the byte entropy of every sample is compared with what the claimed type contains, the header
+// with its signature, JPEG and PNG structure as far as the samples show it and the footer of types that have one.
+class ContentAnalyzer : public IConfigurable {
+private:
+    static constexpr uint32_t SAMPLE_BYTES = 4096;
+    static constexpr uint32_t MAX_SAMPLES = 8;
+    static constexpr size_t FILES_PER_BATCH = 64;
+    static constexpr size_t BUFFER_ALIGNMENT = 4096;   // Lets unbuffered readers fill the samples in place
+    static constexpr uint32_t HIGH_CONFIDENCE = 80;    // Summary bands
+    static constexpr uint32_t LOW_CONFIDENCE = 40;
+
+    struct AlignedDeleter {
+        void operator()(uint8_t* memory) const { ::operator delete(memory, std::align_val_t(BUFFER_ALIGNMENT)); }
+    };
+
+    // Bytes of a file taken at fileOffset
+    struct Sample {
+        uint64_t fileOffset;
+        uint32_t size;
+        const uint8_t* data;
+        bool readable;
+        size_t request;    // Read that fills it, ignored for resident data
+    };
+
+    SectorReader& sectorReader;
+    RecoveryGeometry geometry;
+    Utils& utils;
+    uint64_t bytesPerCluster;
+
+    uint64_t clusterToSector(uint64_t cluster) const;
+    // Sector the recovery of the file starts at, 0 for resident data
+    uint64_t getFirstSector(const ContentCandidate& candidate) const;
+    // Place the samples of a file over its extents, one read request per sample on disk
+    void planSamples(const ContentCandidate& candidate, std::vector<Sample>& samples, std::vector<ReadRequest>& requests, uint8_t* slots, uint32_t slotBytes) const;
+    // Read and score order[first, last)
+    void scoreBatch(const std::vector<ContentCandidate>& candidates, const std::vector<size_t>& order, size_t first, size_t last, std::vector<ContentScore>& scores);
+    ContentScore scoreFile(const ContentCandidate& candidate, const std::vector<Sample>& samples) const;
+
+public:
+    ContentAnalyzer(SectorReader& reader, const RecoveryGeometry& geometry, Utils& utils);
+
+    // Prevent copying, the analyzer refers to the engine's reader
+    ContentAnalyzer(const ContentAnalyzer&) = delete;
+    ContentAnalyzer& operator=(const ContentAnalyzer&) = delete;
+
+    // Score every candidate, the scores are in the order of the candidates
+    std::vector<ContentScore> scoreFiles(const std::vector<ContentCandidate>& candidates);
+    // Score the candidates, write them best first to the content score log and print a summary
+    std::vector<ContentScore> rankFiles(const std::vector<ContentCandidate>& candidates);
+};
@@ -0,0 +1,91 @@
+#include "DirectoryScan.h"
+
+
+VisitedClusterSet::VisitedClusterSet(uint64_t clusterCount)
+    : words(new std::atomic<uint64_t>[(clusterCount + 63) / 64])
+    , clusterCount(clusterCount) {
+    for (uint64_t i = 0; i < (clusterCount + 63) / 64; i++) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool VisitedClusterSet::tryVisit(uint32_t cluster) {
+    if (cluster >= clusterCount) return false;
+
+    uint64_t bit = 1ULL << (cluster % 64);
+    uint64_t previous = words[cluster / 64].fetch_or(bit, std::memory_order_relaxed);
+    return (previous & bit) == 0;
+}
+
+void ScanFrontier::add(DirectoryTask& task) {
+    task.frontierId = nextId++;
+    pending.emplace(task.frontierId, task);
+}
+
+void ScanFrontier::finish(const DirectoryTask& task, const std::vector<uint32_t>& clusters) {
+    pending.erase(task.frontierId);
+    finishedClusters.insert(finishedClusters.end(), clusters.begin(), clusters.end());
+}
+
+void ScanFrontier::write(IndexWriter& writer) const {
+    writer.write(nextId);
+    writer.write(static_cast<uint64_t>(pending.size()));
+    for (const auto& [id, task] : pending) {
+        writer.write(id);
+        writer.write(task.cluster);
+        writer.write(task.depth);
+        writeOrderKey(writer, task.orderKey);
+        writer.writeString(task.path);
+        writer.write(task.contiguousClusters);
+    }
+    writer.write(static_cast<uint64_t>(finishedClusters.size()));
+    for (uint32_t cluster : finishedClusters) {
+        writer.write(cluster);
+    }
+}
+
+bool ScanFrontier::read(IndexReader& reader) {
+    // A damaged count fails the reader before the loops get long
+    std::map<uint64_t, DirectoryTask> storedPending;
+    uint64_t storedNextId = reader.read<uint64_t>();
+    uint64_t pendingCount = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < pendingCount && reader.isValid(); i++) {
+        DirectoryTask task = {};
+        task.frontierId = reader.read<uint64_t>();
+        task.cluster = reader.read<uint32_t>();
+        task.depth = reader.read<uint32_t>();
+        task.orderKey = readOrderKey(reader);
+        task.path = reader.readString();
+        task.contiguousClusters = reader.read<uint32_t>();
+        if (task.frontierId >= storedNextId) return false;
+        storedPending.emplace(task.frontierId, std::move(task));
+    }
+
+    std::vector<uint32_t> storedClusters;
+    uint64_t clusterCount = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < clusterCount && reader.isValid(); i++) {
+        storedClusters.push_back(reader.read<uint32_t>());
+    }
+    if (!reader.isValid()) return false;
+
+    pending = std::move(storedPending);
+    finishedClusters = std::move(storedClusters);
+    nextId = storedNextId;
+    return true;
+}
+
+void ScanFrontier::writeOrderKey(IndexWriter& writer, const ScanOrderKey& orderKey) {
+    writer.write(static_cast<uint32_t>(orderKey.size()));
+    for (uint32_t sequence : orderKey) {
+        writer.write(sequence);
+    }
+}
+
+ScanOrderKey ScanFrontier::readOrderKey(IndexReader& reader) {
+    ScanOrderKey orderKey;
+    uint32_t length = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < length && reader.isValid(); i++) {
+        orderKey.push_back(reader.read<uint32_t>());
+    }
+    return orderKey;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "ScanIndex.h"
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+// Position of an entry in the depth-first order of a serial directory walk.
+// Every directory level adds the entry's sequence number within that directory.
+using ScanOrderKey = std::vector<uint32_t>;
+
+// Directory waiting to be scanned by the parallel directory walk
+struct DirectoryTask {
+    uint32_t cluster;       // First cluster of the directory
+    uint32_t depth;         // Nesting level below the root
+    ScanOrderKey orderKey;  // Key of the directory entry that pointed here
+    std::wstring path;      // Relative to the root, only tracked for a filter or the file data log
+    uint32_t contiguousClusters = 0; // Length of an exFAT NoFatChain directory, 0 follows the FAT
+    uint64_t frontierId = 0;         // Entry of the directory in the scan frontier
+};
+
+// Entries collected while scanning a single directory
+template <typename Entry>
+struct DirectoryScanState {
+    const DirectoryTask& task;
+    uint32_t nextSequence = 0;
+    std::vector<Entry> found;
+    std::vector<DirectoryTask> subdirectories; // Scheduled once the directory is done
+    std::vector<uint32_t> clusters;            // Clusters of the directory this task visited
+
+    explicit DirectoryScanState(const DirectoryTask& task) : task(task) {}
+
+    // Key of the next entry in this directory
+    ScanOrderKey nextKey() {
+        ScanOrderKey key = task.orderKey;
+        key.push_back(nextSequence++);
+        return key;
+    }
+};
+
+// Lock-free set of visited clusters shared by the directory workers, breaks loops in corrupted trees
+class VisitedClusterSet {
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    uint64_t clusterCount;
+
+public:
+    explicit VisitedClusterSet(uint64_t clusterCount);
+
+    // Mark the cluster as visited, false if it already was or it is out of range
+    bool tryVisit(uint32_t cluster);
+};
+
+// Directories of a parallel walk that were scheduled and haven't finished, and the clusters of the finished ones.
+// With the entries found so far it is a point the walk can resume from: the clusters of finished directories are
+// marked visited again and the pending directories are scanned from scratch. The caller serializes access.
+class ScanFrontier {
+private:
+    std::map<uint64_t, DirectoryTask> pending; // By frontier id
+    std::vector<uint32_t> finishedClusters;
+    uint64_t nextId = 1;
+
+public:
+    // Register a scheduled directory and give it its frontier id
+    void add(DirectoryTask& task);
+    // The directory is done, every entry it found was taken by the caller
+    void finish(const DirectoryTask& task, const std::vector<uint32_t>& clusters);
+
+    void write(IndexWriter& writer) const;
+    // Replace the frontier with a stored one, false if it is damaged
+    bool read(IndexReader& reader);
+    const std::map<uint64_t, DirectoryTask>& getPending() const { return pending; }
+    const std::vector<uint32_t>& getFinishedClusters() const { return finishedClusters; }
+
+    static void writeOrderKey(IndexWriter& writer, const ScanOrderKey& orderKey);
+    static ScanOrderKey readOrderKey(IndexReader& reader);
+};
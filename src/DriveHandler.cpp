@@ -3,9 +3,19 @@
 #include "exFATRecovery.h"
 #include "NTFSRecovery.h"
 
+#ifdef _WIN32
 #include "LogicalDriveReader.h"
+#include "OverlappedDriveReader.h"
+#include "PhysicalDriveReader.h"
+#include "ImageFileReader.h"
+#else
+#include "PosixDriveReader.h"
+#endif
+#include "CachingSectorReader.h"
+#include "ResilientSectorReader.h"
 #include <cwctype>
 #include <iostream>
+#include <iterator>
 #include <algorithm>
 
 
@@ -17,15 +27,17 @@ DriveHandler::DriveHandler() : IConfigurable(){
             throw std::runtime_error("Unknown drive type");
         }
 
-        if (driveType == DriveType::PHYSICAL_TYPE) {
-            throw std::runtime_error("Physical drive recovery not implemented");
-        }
-
         initializeSectorReader();
         getBytesPerSector();
 
-        fsType = getFilesystemType();
-        //partitionType = getPartitionType();
+        // An image may hold a whole disk or a single volume, both are handled like a physical drive
+        if (driveType == DriveType::PHYSICAL_TYPE || driveType == DriveType::IMAGE_TYPE) {
+            partitionType = getPartitionType();
+            readPartitionTable();
+        }
+        else {
+            fsType = getFilesystemType();
+        }
     }
     catch (const std::exception& e) {
         std::cerr << "DriveHandler Constructor exception: " << e.what() << std::endl;
@@ -38,25 +50,39 @@ DriveHandler::~DriveHandler() {
     closeDrive();
 }
 
-// Determine if drive is logical or physical
+// Determine if drive is logical, physical or an image file
 DriveType DriveHandler::determineDriveType(const std::wstring& drivePath) {
+#ifndef _WIN32
+    // Disks and partitions are block devices (/dev/sdb, /dev/sdb1), both are read like a physical drive
+    std::error_code error;
+    if (fs::is_block_file(drivePath, error)) {
+        return DriveType::PHYSICAL_TYPE;
+    }
+    if (fs::is_regular_file(drivePath, error)) {
+        return DriveType::IMAGE_TYPE;
+    }
+    return DriveType::UNKNOWN_TYPE;
+#else
     std::wstring upperPath = drivePath;
     std::wstring path = L"\\\\.\\";
 
     std::transform(upperPath.begin(), upperPath.end(),
         upperPath.begin(), std::towupper);
 
-    // Single digit drive number
-    if (drivePath.size() == 1 && std::isdigit(drivePath[0])) {
-        //config.drivePath = path + L"PhysicalDrive" + drivePath;
+    // Drive number
+    if (!drivePath.empty() && std::all_of(drivePath.begin(), drivePath.end(), ::iswdigit)) {
+        config.drivePath = path + L"PhysicalDrive" + drivePath;
         return DriveType::PHYSICAL_TYPE;
     }
 
     // Physical drive with explicit prefix
-    if (upperPath.find(L"PHYSICALDRIVE") != std::wstring::npos &&
-        std::isdigit(upperPath.back())) {
-        //config.drivePath = path + L"PhysicalDrive" + upperPath[upperPath.size() - 1];
-        return DriveType::PHYSICAL_TYPE;
+    size_t prefixPos = upperPath.find(L"PHYSICALDRIVE");
+    if (prefixPos != std::wstring::npos) {
+        std::wstring driveNumber = upperPath.substr(prefixPos + std::wstring(L"PHYSICALDRIVE").size());
+        if (!driveNumber.empty() && std::all_of(driveNumber.begin(), driveNumber.end(), ::iswdigit)) {
+            config.drivePath = path + L"PhysicalDrive" + driveNumber;
+            return DriveType::PHYSICAL_TYPE;
+        }
     }
 
     // Logical drive letter
@@ -67,7 +93,14 @@ DriveType DriveHandler::determineDriveType(const std::wstring& drivePath) {
         return DriveType::LOGICAL_TYPE;
     }
 
+    // Raw image of a disk or volume (.dd, .img, ...)
+    std::error_code error;
+    if (fs::is_regular_file(drivePath, error)) {
+        return DriveType::IMAGE_TYPE;
+    }
+
     return DriveType::UNKNOWN_TYPE;
+#endif
 }
 // FAT32, NTFS, ...
 FilesystemType DriveHandler::getFilesystemType() {
@@ -76,35 +109,95 @@ FilesystemType DriveHandler::getFilesystemType() {
         ? filesystemMap.at(fsType)
         : FilesystemType::UNKNOWN_TYPE;
 }
-// MBR, GPT - for physical drive, not implemented
+// MBR, GPT - for physical drive
 PartitionType DriveHandler::getPartitionType() {
     std::vector<uint8_t> buffer(bytesPerSector);
 
     if (!readSector(0, buffer.data(), bytesPerSector)) {
         throw std::runtime_error("Failed to read partition table");
     }
+    bool hasMbr = isMbr(buffer.data());
 
-    if (isMbr(buffer.data())) {
-        if (!readSector(1, buffer.data(), bytesPerSector)) {
-            throw std::runtime_error("Failed to read potential GPT header");
-        }
-        return isGpt(buffer.data()) ? PartitionType::GPT_TYPE
-            : PartitionType::MBR_TYPE;
+    // A GPT header is trusted even if a damaged protective MBR lost its signature
+    if (readSector(1, buffer.data(), bytesPerSector) && isGpt(buffer.data())) {
+        return PartitionType::GPT_TYPE;
     }
-    return PartitionType::UNKNOWN_TYPE;
+    return hasMbr ? PartitionType::MBR_TYPE : PartitionType::UNKNOWN_TYPE;
 }
 
 // Initialize sector reader based on drive type
 void DriveHandler::initializeSectorReader() {
+#ifndef _WIN32
+    // Devices and images share one reader, io_uring keeps the queue depth in flight
+    if (driveType == DriveType::PHYSICAL_TYPE || driveType == DriveType::IMAGE_TYPE) {
+        setSectorReader(std::make_unique<PosixDriveReader>(config.drivePath, 0, 0, config.ioQueueDepth));
+        if (driveType == DriveType::IMAGE_TYPE) {
+            if (uint32_t imageSectorBytes = detectImageSectorSize(); imageSectorBytes != sectorReader->getBytesPerSector()) {
+                setSectorReader(std::make_unique<PosixDriveReader>(config.drivePath, 0, 0, config.ioQueueDepth, imageSectorBytes));
+            }
+        }
+        return;
+    }
+    throw std::runtime_error("Invalid drive type");
+#else
     switch (driveType) {
     case DriveType::LOGICAL_TYPE:
-        setSectorReader(std::make_unique<LogicalDriveReader>(config.drivePath));
+        if (config.ioQueueDepth > 1) {
+            setSectorReader(std::make_unique<OverlappedDriveReader>(config.drivePath, config.ioQueueDepth));
+        }
+        else {
+            setSectorReader(std::make_unique<LogicalDriveReader>(config.drivePath));
+        }
         break;
     case DriveType::PHYSICAL_TYPE:
-        throw std::runtime_error("Physical drive recovery not implemented");
+        // The whole disk, partitions get their own reader when they are recovered
+        setSectorReader(std::make_unique<PhysicalDriveReader>(config.drivePath));
+        break;
+    case DriveType::IMAGE_TYPE:
+        setSectorReader(std::make_unique<ImageFileReader>(config.drivePath));
+        if (uint32_t imageSectorBytes = detectImageSectorSize(); imageSectorBytes != sectorReader->getBytesPerSector()) {
+            setSectorReader(std::make_unique<ImageFileReader>(config.drivePath, 0, 0, imageSectorBytes));
+        }
+        break;
     default:
         throw std::runtime_error("Invalid drive type");
     }
+#endif
+}
+// A 4Kn disk keeps its tables in 4096 byte sectors, reading its image in 512 byte sectors would miss every structure
+uint32_t DriveHandler::detectImageSectorSize() {
+    constexpr uint32_t DEFAULT_SECTOR_BYTES = IMAGE_SECTOR_SIZES[0];
+    constexpr uint32_t MAX_SECTOR_BYTES = IMAGE_SECTOR_SIZES[std::size(IMAGE_SECTOR_SIZES) - 1];
+    std::vector<uint8_t> buffer(2 * MAX_SECTOR_BYTES);
+    if (!sectorReader->readRange(0, buffer.size(), buffer.data())) {
+        return DEFAULT_SECTOR_BYTES;
+    }
+
+    // The GPT header is in the second sector
+    for (uint32_t sectorBytes : IMAGE_SECTOR_SIZES) {
+        if (isGpt(buffer.data() + sectorBytes)) return sectorBytes;
+    }
+
+    // A volume without a partition table says itself
+    uint32_t declaredBytes = SectorReader::getDeclaredSectorSize(buffer.data());
+    if (declaredBytes != 0) {
+        return std::find(std::begin(IMAGE_SECTOR_SIZES), std::end(IMAGE_SECTOR_SIZES), declaredBytes) != std::end(IMAGE_SECTOR_SIZES) ? declaredBytes : DEFAULT_SECTOR_BYTES;
+    }
+
+    // MBR start sectors count in the disk's sectors, the right size finds a boot sector formatted with it
+    if (!isMbr(buffer.data())) return DEFAULT_SECTOR_BYTES;
+    const MBRHeader mbr = *reinterpret_cast<const MBRHeader*>(buffer.data());
+    std::vector<uint8_t> bootSector(MAX_SECTOR_BYTES);
+    for (const MBRPartitionEntry& entry : mbr.PartitionTable) {
+        if (entry.Type == 0 || entry.StartLBA == 0) continue;
+        for (uint32_t sectorBytes : IMAGE_SECTOR_SIZES) {
+            if (sectorReader->readRange(static_cast<uint64_t>(entry.StartLBA) * sectorBytes, sectorBytes, bootSector.data()) &&
+                SectorReader::getDeclaredSectorSize(bootSector.data()) == sectorBytes) {
+                return sectorBytes;
+            }
+        }
+    }
+    return DEFAULT_SECTOR_BYTES;
 }
 // Read data from specified sector
 bool DriveHandler::readSector(uint64_t sector, void* buffer, uint32_t size) {
@@ -131,10 +224,11 @@ void DriveHandler::getBytesPerSector() {
 
 
 bool DriveHandler::isGpt(const uint8_t* buffer) {
+    // The signature is 8 ASCII bytes
     return std::equal(
         GPT_SIGNATURE.begin(),
         GPT_SIGNATURE.end(),
-        reinterpret_cast<const wchar_t*>(buffer + GPT_SIGNATURE_OFFSET)
+        reinterpret_cast<const char*>(buffer + GPT_SIGNATURE_OFFSET)
     );
 }
 bool DriveHandler::isMbr(const uint8_t* buffer) {
@@ -151,26 +245,195 @@ void DriveHandler::closeDrive() {
         sectorReader.reset();
     }
 }
-/*=============== Public Interface ===============*/
+/*=============== Partition table ===============*/
+void DriveHandler::readPartitionTable() {
+    partitions.clear();
+    std::vector<uint8_t> buffer(bytesPerSector);
 
-// Main recovery entry point
-void DriveHandler::recoverDrive() {
-    if (!sectorReader) {
-        throw std::runtime_error("Drive not initialized");
+    switch (partitionType) {
+    case PartitionType::GPT_TYPE:
+        readAnyGptPartitions();
+        break;
+    case PartitionType::MBR_TYPE:
+        // A volume boot sector at sector 0 also ends with 0x55AA, the disk has no partitions then
+        if (detectPartitionFilesystem(0) != FilesystemType::UNKNOWN_TYPE) {
+            addPartition(0, sectorReader->getTotalSectors(), PartitionType::UNKNOWN_TYPE);
+            break;
+        }
+        if (!readSector(0, buffer.data(), bytesPerSector)) {
+            throw std::runtime_error("Failed to read partition table");
+        }
+        readMbrPartitions(*reinterpret_cast<const MBRHeader*>(buffer.data()));
+        break;
+    default:
+        // No table at all, try the backup GPT, then a volume spanning the whole disk
+        if (!readAnyGptPartitions() && detectPartitionFilesystem(0) != FilesystemType::UNKNOWN_TYPE) {
+            addPartition(0, sectorReader->getTotalSectors(), PartitionType::UNKNOWN_TYPE);
+        }
+        break;
+    }
+
+    printPartitions();
+}
+
+void DriveHandler::readMbrPartitions(const MBRHeader& mbr) {
+    for (const MBRPartitionEntry& entry : mbr.PartitionTable) {
+        if (entry.Type == 0 || entry.TotalSectors == 0) continue;
+
+        switch (entry.Type) {
+        case 0x05: // Extended CHS
+        case 0x0F: // Extended LBA
+        case 0x85: // Linux extended
+            readExtendedPartitions(entry.StartLBA);
+            break;
+        case MBR_TYPE_GPT_PROTECTIVE:
+            // Primary GPT header is damaged, otherwise the drive was detected as GPT
+            readAnyGptPartitions();
+            break;
+        default:
+            addPartition(entry.StartLBA, entry.TotalSectors, PartitionType::MBR_TYPE);
+            break;
+        }
+    }
+}
+
+void DriveHandler::readExtendedPartitions(uint64_t extendedStart) {
+    std::vector<uint8_t> buffer(bytesPerSector);
+    uint64_t ebrSector = extendedStart;
+
+    for (uint32_t i = 0; i < MAX_LOGICAL_PARTITIONS; i++) {
+        if (!readSector(ebrSector, buffer.data(), bytesPerSector) || !isMbr(buffer.data())) {
+            std::cerr << "[-] Broken EBR chain at sector " << ebrSector << std::endl;
+            return;
+        }
+        const MBRHeader* ebr = reinterpret_cast<const MBRHeader*>(buffer.data());
+
+        // First entry is the logical partition, relative to this EBR
+        const MBRPartitionEntry& logical = ebr->PartitionTable[0];
+        if (logical.Type != 0 && logical.TotalSectors != 0) {
+            addPartition(ebrSector + logical.StartLBA, logical.TotalSectors, PartitionType::MBR_TYPE);
+        }
+
+        // Second entry links the next EBR, relative to the extended partition
+        const MBRPartitionEntry& next = ebr->PartitionTable[1];
+        if (next.Type == 0 || next.StartLBA == 0) return;
+        uint64_t nextSector = extendedStart + next.StartLBA;
+        if (nextSector <= ebrSector) return; // Chain has to move forward
+        ebrSector = nextSector;
+    }
+}
+
+bool DriveHandler::readGptPartitions(uint64_t headerSector) {
+    std::vector<uint8_t> buffer(bytesPerSector);
+    if (!readSector(headerSector, buffer.data(), bytesPerSector) || !isGpt(buffer.data())) {
+        return false;
+    }
+
+    // CRCs are not checked, a damaged table is still worth scanning
+    const GPTHeader header = *reinterpret_cast<const GPTHeader*>(buffer.data());
+    if (header.SizeOfEntry < sizeof(GPTPartitionEntry) || header.SizeOfEntry % 8 != 0 ||
+        header.NumberOfEntries == 0 || header.NumberOfEntries > MAX_GPT_ENTRIES) {
+        return false;
+    }
+
+    uint64_t tableBytes = static_cast<uint64_t>(header.NumberOfEntries) * header.SizeOfEntry;
+    uint32_t tableSectors = static_cast<uint32_t>((tableBytes + bytesPerSector - 1) / bytesPerSector);
+    std::vector<uint8_t> table(static_cast<uint64_t>(tableSectors) * bytesPerSector);
+    if (!sectorReader->readSectors(header.PartitionEntryLBA, tableSectors, table.data())) {
+        return false;
+    }
+
+    static constexpr uint8_t UNUSED_TYPE[16] = {};
+    for (uint32_t i = 0; i < header.NumberOfEntries; i++) {
+        const GPTPartitionEntry* entry = reinterpret_cast<const GPTPartitionEntry*>(table.data() + static_cast<uint64_t>(i) * header.SizeOfEntry);
+        if (std::equal(std::begin(UNUSED_TYPE), std::end(UNUSED_TYPE), entry->PartitionTypeGUID)) continue;
+        if (entry->EndingLBA < entry->StartingLBA) continue;
+
+        addPartition(entry->StartingLBA, entry->EndingLBA - entry->StartingLBA + 1, PartitionType::GPT_TYPE);
+    }
+    return true;
+}
+
+bool DriveHandler::readAnyGptPartitions() {
+    if (readGptPartitions(1)) return true;
+
+    uint64_t diskSectors = sectorReader->getTotalSectors();
+    if (diskSectors > 1 && readGptPartitions(diskSectors - 1)) {
+        std::cout << "[!] Primary GPT header is damaged, using the backup header" << std::endl;
+        return true;
+    }
+    return false;
+}
+
+void DriveHandler::addPartition(uint64_t startSector, uint64_t sectorCount, PartitionType tableType) {
+    PartitionInfo partition = {
+        .index = static_cast<uint32_t>(partitions.size() + 1),
+        .startSector = startSector,
+        .sectorCount = sectorCount,
+        .tableType = tableType,
+        .fsType = detectPartitionFilesystem(startSector)
+    };
+    partitions.push_back(partition);
+}
+
+FilesystemType DriveHandler::detectPartitionFilesystem(uint64_t startSector) {
+    std::vector<uint8_t> buffer((std::max)(bytesPerSector, 512u));
+    if (!readSector(startSector, buffer.data(), bytesPerSector)) {
+        return FilesystemType::UNKNOWN_TYPE;
+    }
+    std::wstring name = SectorReader::detectFilesystem(buffer.data());
+    return filesystemMap.find(name) != filesystemMap.end()
+        ? filesystemMap.at(name)
+        : FilesystemType::UNKNOWN_TYPE;
+}
+
+void DriveHandler::printPartitions() const {
+    static const std::unordered_map<FilesystemType, const char*> fsNames = {
+        {FilesystemType::EXFAT_TYPE, "exFAT"},
+        {FilesystemType::FAT32_TYPE, "FAT32"},
+        {FilesystemType::NTFS_TYPE, "NTFS"}
+    };
+
+    std::cout << std::string(60, '_') << "\n\n";
+    std::cout << "Partitions (" << (partitionType == PartitionType::GPT_TYPE ? "GPT" : partitionType == PartitionType::MBR_TYPE ? "MBR" : "no partition table") << "):" << std::endl;
+    std::cout << std::string(60, '_') << "\n\n";
+    if (partitions.empty()) {
+        std::cout << "  No partitions found" << std::endl;
+    }
+    for (const PartitionInfo& partition : partitions) {
+        auto name = fsNames.find(partition.fsType);
+        std::cout << "  #" << partition.index
+            << " | start sector " << partition.startSector
+            << " | " << partition.sectorCount << " sectors"
+            << " | " << (name != fsNames.end() ? name->second : "Unsupported") << std::endl;
+    }
+    std::cout << std::string(60, '_') << "\n\n";
+}
+
+void DriveHandler::recoverVolume(FilesystemType volumeType, std::unique_ptr<SectorReader> reader) {
+    // Below the cache, so the blocks it loads skip known bad sectors too. The output folder is per partition,
+    // every volume keeps its own map.
+    if (config.degradedMedia) {
+        fs::path mapPath = fs::path(config.outputFolder) / config.logFolder / config.badSectorMapFile;
+        reader = std::make_unique<ResilientSectorReader>(std::move(reader), mapPath, config.drivePath);
+    }
+    // Memory mapped images are kept by the system's file cache already
+    if (config.readCacheLimit > 0 && !reader->mapSectors(0, 1)) {
+        reader = std::make_unique<CachingSectorReader>(std::move(reader), config.readCacheLimit, config.readCacheBlockSize);
     }
 
     // Create appropriate recovery handler based on filesystem type
-    switch (fsType) {
+    switch (volumeType) {
     case FilesystemType::FAT32_TYPE:
-        FAT32Recovery(driveType, releaseSectorReader())
+        FAT32Recovery(driveType, std::move(reader))
             .startRecovery();
         break;
     case FilesystemType::EXFAT_TYPE:
-        exFATRecovery(driveType, releaseSectorReader())
+        exFATRecovery(driveType, std::move(reader))
             .startRecovery();
         break;
     case FilesystemType::NTFS_TYPE:
-        NTFSRecovery(driveType, releaseSectorReader())
+        NTFSRecovery(driveType, std::move(reader))
             .startRecovery();
         break;
     default:
@@ -178,4 +441,68 @@ void DriveHandler::recoverDrive() {
     }
 }
 
+std::unique_ptr<SectorReader> DriveHandler::createPartitionReader(const PartitionInfo& partition) const {
+#ifndef _WIN32
+    return std::make_unique<PosixDriveReader>(config.drivePath, partition.startSector, partition.sectorCount, config.ioQueueDepth, bytesPerSector);
+#else
+    if (driveType == DriveType::IMAGE_TYPE) {
+        return std::make_unique<ImageFileReader>(config.drivePath, partition.startSector, partition.sectorCount, bytesPerSector);
+    }
+    return std::make_unique<PhysicalDriveReader>(config.drivePath, partition.startSector, partition.sectorCount);
+#endif
+}
+
+void DriveHandler::recoverPhysicalDrive() {
+    bool hasSupportedPartition = std::any_of(partitions.begin(), partitions.end(), [](const PartitionInfo& partition) {
+        return partition.fsType != FilesystemType::UNKNOWN_TYPE;
+    });
+    if (!hasSupportedPartition) {
+        throw std::runtime_error("No FAT32, exFAT or NTFS partition found");
+    }
+
+    // Every partition of one --drive is on the same device, so they are processed one after another.
+    // Concurrent scans would only make a disk seek between them, and the engines share the output
+    // folder of the configuration, the console prompt and the metrics.
+    closeDrive();
+    std::wstring baseOutputFolder = config.outputFolder;
+    for (const PartitionInfo& partition : partitions) {
+        if (partition.fsType == FilesystemType::UNKNOWN_TYPE) continue;
+
+        std::cout << "[*] Partition #" << partition.index << " at sector " << partition.startSector << std::endl;
+        config.outputFolder = (fs::path(baseOutputFolder) / (L"Partition" + std::to_wstring(partition.index))).wstring();
+        try {
+            std::unique_ptr<SectorReader> reader = createPartitionReader(partition);
+            // The engines address the volume in the sectors of its boot sector, the reader in those of the disk
+            std::vector<uint8_t> bootSector(reader->getBytesPerSector());
+            uint32_t declaredBytes = reader->readSector(0, bootSector.data(), reader->getBytesPerSector()) ? SectorReader::getDeclaredSectorSize(bootSector.data()) : 0;
+            if (declaredBytes != reader->getBytesPerSector()) {
+                std::cerr << "[-] Partition #" << partition.index << " was formatted with " << declaredBytes << " byte sectors, the "
+                    << (driveType == DriveType::IMAGE_TYPE ? "image" : "disk") << " has " << reader->getBytesPerSector() << " byte sectors. Skipping it" << std::endl;
+                continue;
+            }
+            recoverVolume(partition.fsType, std::move(reader));
+        }
+        catch (const std::exception& e) {
+            // A damaged partition shouldn't stop the others
+            std::cerr << "[-] Partition #" << partition.index << " failed: " << e.what() << std::endl;
+        }
+    }
+    config.outputFolder = baseOutputFolder;
+}
+
+/*=============== Public Interface ===============*/
+
+// Main recovery entry point
+void DriveHandler::recoverDrive() {
+    if (!sectorReader) {
+        throw std::runtime_error("Drive not initialized");
+    }
+
+    if (driveType == DriveType::PHYSICAL_TYPE || driveType == DriveType::IMAGE_TYPE) {
+        recoverPhysicalDrive();
+        return;
+    }
+    recoverVolume(fsType, releaseSectorReader());
+}
+
 
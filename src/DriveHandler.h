@@ -3,6 +3,7 @@
 #include "IConfigurable.h"
 #include "SectorReader.h"
 #include "Enums.h"
+#include "PartitionStructs.h"
 #include <memory>
 #include <cstdint>
 #include <vector>
@@ -18,7 +19,11 @@ private:
     // Constants
     static constexpr int MBR_SIGNATURE_OFFSET = 0x1FE;
     static constexpr int GPT_SIGNATURE_OFFSET = 0x00;
-    static constexpr std::wstring_view GPT_SIGNATURE = L"EFI PART";
+    static constexpr std::string_view GPT_SIGNATURE = "EFI PART";
+    static constexpr uint32_t MAX_LOGICAL_PARTITIONS = 128;   // Bounds a corrupted EBR chain
+    static constexpr uint32_t MAX_GPT_ENTRIES = 1024;         // Sanity limit for a damaged GPT header
+    static constexpr uint8_t MBR_TYPE_GPT_PROTECTIVE = 0xEE;
+    static constexpr uint32_t IMAGE_SECTOR_SIZES[] = { 512, 4096 }; // Candidates for an image, which carries no geometry
 
     // Configuration and state
     
@@ -27,6 +32,7 @@ private:
     PartitionType partitionType;
     uint32_t bytesPerSector{ 0 };
     std::unique_ptr<SectorReader> sectorReader;
+    std::vector<PartitionInfo> partitions; // Physical drive and image only
 
     // Filesystem type mapping
     const std::unordered_map<std::wstring, FilesystemType> filesystemMap = {
@@ -44,6 +50,8 @@ private:
 
     // Initialize sector reader based on drive type
     void initializeSectorReader();
+    // Sector size of an image from its GPT header or the boot sectors its table points to, 512 if nothing tells
+    uint32_t detectImageSectorSize();
     // Read data from specified sector
     bool readSector(uint64_t sector, void* buffer, uint32_t size);
     // Set the sector reader implementation 
@@ -56,6 +64,27 @@ private:
     bool isGpt(const uint8_t* buffer);
     bool isMbr(const uint8_t* buffer);
 
+    /*=============== Partition table ===============*/
+    // Enumerate every partition of the physical drive or image from the MBR, its EBR chain or the GPT
+    void readPartitionTable();
+    void readMbrPartitions(const MBRHeader& mbr);
+    // Follow the EBR chain of an extended partition
+    void readExtendedPartitions(uint64_t extendedStart);
+    // Read the partition entries of the GPT header at headerSector, false if the header is invalid
+    bool readGptPartitions(uint64_t headerSector);
+    // Primary GPT header first, the backup at the last sector of the disk if it's damaged
+    bool readAnyGptPartitions();
+    void addPartition(uint64_t startSector, uint64_t sectorCount, PartitionType tableType);
+    FilesystemType detectPartitionFilesystem(uint64_t startSector);
+    void printPartitions() const;
+
+    // Run the recovery engine matching the filesystem
+    void recoverVolume(FilesystemType volumeType, std::unique_ptr<SectorReader> reader);
+    // Reader limited to one partition of the physical drive or image
+    std::unique_ptr<SectorReader> createPartitionReader(const PartitionInfo& partition) const;
+    // Recover every supported partition of the physical drive or image, each into its own output folder
+    void recoverPhysicalDrive();
+
     std::unique_ptr<SectorReader> releaseSectorReader();
 public:
     /*=============== Public Interface ===============*/
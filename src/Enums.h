@@ -2,7 +2,8 @@
 enum class DriveType {
     UNKNOWN_TYPE,
     LOGICAL_TYPE,
-    PHYSICAL_TYPE
+    PHYSICAL_TYPE,
+    IMAGE_TYPE
 };
 
 enum class PartitionType {
@@ -17,4 +18,22 @@ enum class FilesystemType {
     NTFS_TYPE,
     EXFAT_TYPE,
     EXT4_TYPE
+};
+
+enum class LogFormat {
+    CSV_FORMAT,
+    JSONL_FORMAT
+};
+
+enum class ResultLogType {
+    FOUND_FILES_TYPE,
+    RECOVERED_FILES_TYPE,
+    CONTENT_SCORES_TYPE
+};
+
+// Outcome of the structure checks of a scored file
+enum class FormatVerdict {
+    UNCHECKED_VERDICT, // Nothing in the samples could be checked
+    VALID_VERDICT,
+    DAMAGED_VERDICT
 };
\ No newline at end of file
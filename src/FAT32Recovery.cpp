@@ -1,11 +1,12 @@
 
 #include "FAT32Recovery.h"
-#include "LogicalDriveReader.h"
+#include "Metrics.h"
 #include <set>
 #include <vector>
 #include <cwctype>
 #include <codecvt>
 #include <iostream>
+#include <iterator>
 
 
 // Constructor
@@ -17,6 +18,7 @@ FAT32Recovery::FAT32Recovery(const DriveType& driveType, std::unique_ptr<SectorR
     utils.ensureOutputDirectory();
     setSectorReader(std::move(reader));
     readBootSector(0);
+    initializeFATCache();
 }
 // Destructor
 FAT32Recovery::~FAT32Recovery() {
@@ -71,6 +73,10 @@ void FAT32Recovery::readBootSector(uint32_t sector) {
     uint32_t dataSectors = totalSectors - (driveInfo.bootSector.ReservedSectorCount + (driveInfo.bootSector.NumFATs * driveInfo.bootSector.FATSize32) + rootDirSectors);
     driveInfo.maxClusterCount = dataSectors / driveInfo.bootSector.SectorsPerCluster;
 }
+void FAT32Recovery::initializeFATCache() {
+    fatCache = std::make_unique<FATCache>(*sectorReader, driveInfo.fatStartSector, driveInfo.bootSector.FATSize32,
+        driveInfo.bootSector.BytesPerSector, driveInfo.maxClusterCount, config.fatCacheLimit);
+}
 uint32_t FAT32Recovery::getBytesPerSector() {
     if (!sectorReader) {
         throw std::runtime_error("Sector reader not initialized");
@@ -85,6 +91,12 @@ uint32_t FAT32Recovery::getBytesPerSector() {
 bool FAT32Recovery::readSector(uint64_t sector, void* buffer, uint32_t size) {
     return sectorReader && sectorReader->readSector(sector, buffer, size);
 }
+bool FAT32Recovery::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    return sectorReader && sectorReader->readSectors(startSector, count, buffer);
+}
+bool FAT32Recovery::readBatch(std::vector<ReadRequest>& requests) {
+    return sectorReader && sectorReader->readBatch(requests);
+}
 
 
 bool FAT32Recovery::isValidCluster(uint32_t cluster) const {
@@ -123,17 +135,11 @@ uint32_t FAT32Recovery::clusterToSector(uint32_t cluster) const {
     return driveInfo.dataStartSector + (cluster - 2) * driveInfo.bootSector.SectorsPerCluster;
 }
 uint32_t FAT32Recovery::getNextCluster(uint32_t cluster) {
-    uint32_t fatOffset = cluster * 4;
-    uint32_t fatSector = driveInfo.fatStartSector + (fatOffset / driveInfo.bootSector.BytesPerSector);
-    uint32_t entryOffset = fatOffset % driveInfo.bootSector.BytesPerSector;
-
-    std::vector<uint8_t> sectorBuffer(driveInfo.bootSector.BytesPerSector);
-    if (!readSector(fatSector, sectorBuffer.data(), driveInfo.bootSector.BytesPerSector)) {
-        std::cerr << "Error: Failed to read FAT sector " << fatSector << std::endl;
+    uint32_t fatEntry;
+    if (!fatCache->getEntry(cluster, fatEntry)) {
         return 0xFFFFFFFF;
     }
 
-    uint32_t fatEntry = *reinterpret_cast<uint32_t*>(sectorBuffer.data() + entryOffset);
     uint32_t nextCluster = fatEntry & 0x0FFFFFFF;  // Mask the lower 28 bits
 
     if (nextCluster >= 0x0FFFFFF8) {
@@ -156,66 +162,185 @@ void FAT32Recovery::scanForDeletedFiles(uint32_t startSector) {
         std::cout << "Exitting..." << std::endl;
         exit(1);
     }
+    ScopedTimer timer(MetricPhase::SCAN);
 
-    scanDirectory(driveInfo.rootDirCluster);
+    visitedClusters = std::make_unique<VisitedClusterSet>(static_cast<uint64_t>(driveInfo.maxClusterCount) + 1);
+    // Unfiltered walks are checkpointed, filtered ones skip directories and aren't a prefix of the full scan
+    if (!scanFilter.isActive()) {
+        checkpoint = std::make_unique<ScanCheckpoint>(getVolumeKey());
+    }
+    {
+        ThreadPool pool(config.threadCount);
+        scanPool = &pool;
+        std::vector<DirectoryTask> tasks;
+        if (!checkpoint || !config.resume || !resumeDirectoryScan(tasks)) {
+            tasks = { { driveInfo.rootDirCluster, 0, {}, L"" } };
+            if (checkpoint) scanFrontier.add(tasks.front());
+        }
+        for (DirectoryTask& task : tasks) {
+            scheduleDirectory(std::move(task));
+        }
+        pool.wait();
+        scanPool = nullptr;
+    }
+    visitedClusters.reset();
+    if (checkpoint) {
+        checkpoint->remove();
+        checkpoint.reset();
+        scanFrontier = {};
+        checkpointResults = {};
+    }
+    mergeScanResults();
 
     utils.closeLogFile();
     utils.printFooter();
 }
 
-void FAT32Recovery::scanDirectory(uint32_t cluster, bool isTargetFolder) {
+void FAT32Recovery::scheduleDirectory(DirectoryTask task) {
+    scanPool->submit([this, task = std::move(task)] {
+        DirectoryScanState<FAT32ScanEntry> state(task);
+        scanDirectory(state);
+        finishDirectory(state);
+    });
+}
+
+void FAT32Recovery::scanDirectory(DirectoryScanState<FAT32ScanEntry>& state) {
+    const DirectoryTask& task = state.task;
+    uint32_t bytesPerCluster = driveInfo.bootSector.SectorsPerCluster * driveInfo.bootSector.BytesPerSector;
+    uint32_t entriesPerCluster = bytesPerCluster / sizeof(DirectoryEntry);
+    std::vector<uint8_t> clusterBuffer(bytesPerCluster);
+    Metrics::getInstance().add(MetricCounter::DIRECTORIES_SCANNED);
+
+    // Follow the directory's chain, a cluster seen before means the tree loops
+    uint32_t cluster = task.cluster;
     if (!isValidCluster(cluster)) {
         std::cerr << "Warning: Invalid cluster detected: 0x"
             << std::hex << cluster << std::dec << std::endl;
         return;
     }
+    while (isValidCluster(cluster) && visitedClusters->tryVisit(cluster)) {
+        state.clusters.push_back(cluster);
+        uint32_t sector = clusterToSector(cluster);
 
-    uint32_t sector = clusterToSector(cluster);
-    uint32_t entriesPerSector = driveInfo.bootSector.BytesPerSector / sizeof(DirectoryEntry);
-    std::vector<uint8_t> sectorBuffer(driveInfo.bootSector.BytesPerSector);
-    for (uint64_t i = 0; i < driveInfo.bootSector.SectorsPerCluster; i++) {
-        //sectorBuffer.resize(driveInfo.bootSector.BytesPerSector);
-        
-        if (readSector(static_cast<uint64_t>(sector) + i, sectorBuffer.data(), driveInfo.bootSector.BytesPerSector)) {
-            processEntriesInSector(entriesPerSector, isTargetFolder, sectorBuffer);
+        // Read the whole directory cluster at once
+        if (readSectors(sector, driveInfo.bootSector.SectorsPerCluster, clusterBuffer.data())) {
+            processEntriesInCluster(entriesPerCluster, clusterBuffer, state);
+            Metrics::getInstance().add(MetricCounter::DIRECTORY_ENTRIES, entriesPerCluster);
         }
         else {
-            std::cerr << "Warning: Failed to read sector " << (sector + i) << std::endl;
+            std::cerr << "Warning: Failed to read cluster " << cluster << " (sector " << sector << ")" << std::endl;
         }
+
+        cluster = getNextCluster(cluster);
     }
+}
 
-    uint32_t nextCluster = getNextCluster(cluster);
-    if (isValidCluster(nextCluster)) {
-        scanDirectory(nextCluster, isTargetFolder);
+void FAT32Recovery::finishDirectory(DirectoryScanState<FAT32ScanEntry>& state) {
+    // Results, frontier and checkpoint change together, so a checkpoint never holds half a directory
+    std::lock_guard<std::mutex> lock(scanResultsMutex);
+    if (checkpoint) {
+        for (const FAT32ScanEntry& found : state.found) {
+            writeScanEntry(checkpointResults, found);
+        }
+        scanFrontier.finish(state.task, state.clusters);
     }
+    std::move(state.found.begin(), state.found.end(), std::back_inserter(scanResults));
+
+    for (DirectoryTask& subdirectory : state.subdirectories) {
+        if (checkpoint) scanFrontier.add(subdirectory);
+        scheduleDirectory(std::move(subdirectory));
+    }
+
+    if (checkpoint && checkpoint->isDue()) {
+        IndexWriter frontier;
+        frontier.write(static_cast<uint64_t>(scanResults.size()));
+        scanFrontier.write(frontier);
+        checkpoint->save(fileId, frontier, checkpointResults);
+    }
+}
+
+bool FAT32Recovery::resumeDirectoryScan(std::vector<DirectoryTask>& pendingTasks) {
+    uint32_t nextFileId = 0;
+    std::vector<uint8_t> frontier;
+    std::vector<uint8_t> results;
+    if (!checkpoint->load(nextFileId, frontier, results)) {
+        std::cout << "[*] No usable scan checkpoint, scanning from the root directory" << std::endl;
+        return false;
+    }
+
+    // Only kept if the whole checkpoint reads back
+    IndexReader frontierReader(frontier.data(), frontier.size());
+    uint64_t entryCount = frontierReader.read<uint64_t>();
+    ScanFrontier storedFrontier;
+    bool isValid = storedFrontier.read(frontierReader) && frontierReader.isAtEnd() && entryCount <= results.size();
+    std::vector<FAT32ScanEntry> entries(isValid ? entryCount : 0);
+    IndexReader reader(results.data(), results.size());
+    for (FAT32ScanEntry& entry : entries) {
+        readScanEntry(reader, entry);
+    }
+    if (!isValid || !reader.isValid() || !reader.isAtEnd()) {
+        std::cerr << "[!] The scan checkpoint is damaged, scanning from the root directory" << std::endl;
+        return false;
+    }
+
+    std::cout << "[*] Resuming the scan with " << storedFrontier.getPending().size() << " directories left, "
+        << entries.size() << " files were found before" << std::endl;
+    for (uint32_t cluster : storedFrontier.getFinishedClusters()) {
+        visitedClusters->tryVisit(cluster);
+    }
+    for (const auto& [id, task] : storedFrontier.getPending()) {
+        pendingTasks.push_back(task);
+    }
+    std::lock_guard<std::mutex> lock(scanResultsMutex);
+    scanResults = std::move(entries);
+    scanFrontier = std::move(storedFrontier);
+    checkpointResults.writeRaw(results);
+    fileId = nextFileId;
+    return true;
+}
+
+void FAT32Recovery::writeScanEntry(IndexWriter& writer, const FAT32ScanEntry& entry) {
+    ScanFrontier::writeOrderKey(writer, entry.orderKey);
+    writer.writeString(entry.folder);
+    writer.writeString(entry.fullName);
+    writer.write(entry.cluster);
+    writer.write(entry.fileSize);
 }
 
-void FAT32Recovery::processEntriesInSector(uint32_t entriesPerSector, bool isTargetFolder, std::vector<uint8_t>& sectorBuffer) {
-    std::wstring longFilename;
-    for (uint32_t j = 0; j < entriesPerSector; j++) {
-        DirectoryEntry* entry = reinterpret_cast<DirectoryEntry*>(sectorBuffer.data() + j * sizeof(DirectoryEntry));
+void FAT32Recovery::readScanEntry(IndexReader& reader, FAT32ScanEntry& entry) {
+    entry.orderKey = ScanFrontier::readOrderKey(reader);
+    entry.folder = reader.readString();
+    entry.fullName = reader.readString();
+    entry.cluster = reader.read<uint32_t>();
+    entry.fileSize = reader.read<uint32_t>();
+}
+
+void FAT32Recovery::processEntriesInCluster(uint32_t entriesPerCluster, std::vector<uint8_t>& clusterBuffer, DirectoryScanState<FAT32ScanEntry>& state) {
+    std::wstring reversedLongFilename;
+    std::wstring filename;
+    for (uint32_t j = 0; j < entriesPerCluster; j++) {
+        DirectoryEntry* entry = reinterpret_cast<DirectoryEntry*>(clusterBuffer.data() + j * sizeof(DirectoryEntry));
         if (entry->Name[0] == 0x00) return; // End of directory
 
         bool isDeleted = entry->Name[0] == 0xE5;
         if (entry->Attr == 0x0F) { // Long filename
-            longFilename = getLongFilename(entry) + longFilename;
+            appendLongFilenameReversed(entry, reversedLongFilename);
             continue;
         }
 
-        std::wstring filename;
-        if (!longFilename.empty()) { // LFN
-            filename = longFilename;
-            longFilename.clear();
+        if (!reversedLongFilename.empty()) { // LFN
+            filename.assign(reversedLongFilename.rbegin(), reversedLongFilename.rend());
+            reversedLongFilename.clear();
         }
         else { // SFN
             filename = getShortFilename(entry, isDeleted);
         }
 
-        processDirectoryEntry(entry,  filename, isTargetFolder);
+        processDirectoryEntry(entry, filename, state);
     }
 }
 
-void FAT32Recovery::processDirectoryEntry(const DirectoryEntry* entry, const std::wstring& filename, bool isTargetFolder) {
+void FAT32Recovery::processDirectoryEntry(const DirectoryEntry* entry, const std::wstring& filename, DirectoryScanState<FAT32ScanEntry>& state) {
     if (!entry) return;
 
     bool isDeleted = entry->Name[0] == 0xE5;
@@ -225,41 +350,71 @@ void FAT32Recovery::processDirectoryEntry(const DirectoryEntry* entry, const std
     subDirCluster = sanitizeCluster(subDirCluster);
     if (subDirCluster == 0) return;
 
+    // Paths are only built when a filter or the file data log asks for them
+    std::wstring path = scanFilter.tracksPaths() ? ScanFilter::joinPath(state.task.path, filename) : std::wstring();
     if (isDirectory) {
-        scanDirectory(subDirCluster, false);
+        if (scanFilter.matchesDirectory(path)) {
+            state.subdirectories.push_back({ subDirCluster, state.task.depth + 1, state.nextKey(), std::move(path) });
+        }
     }
-    else if (isDeleted) {
-        uint32_t fileSize = entry->FileSize;
-        FAT32FileInfo fileInfo = parseFileInfo(filename, subDirCluster, fileSize);
+    else if (isDeleted && scanFilter.matchesPath(path) && scanFilter.matchesAttributes(entry->FileSize, subDirCluster)) {
+        state.found.push_back({ state.nextKey(), state.task.path, filename, subDirCluster, entry->FileSize });
+    }
+}
 
+void FAT32Recovery::mergeScanResults() {
+    // Sorting by the order key gives the same ids as a serial depth-first walk
+    std::sort(scanResults.begin(), scanResults.end(), [](const FAT32ScanEntry& a, const FAT32ScanEntry& b) {
+        return a.orderKey < b.orderKey;
+    });
+
+    for (const FAT32ScanEntry& found : scanResults) {
+        FAT32FileInfo fileInfo = parseFileInfo(found.fullName, found.cluster, found.fileSize);
+        // The extension may have been predicted, so it is checked on the parsed name
+        if (!scanFilter.matchesExtension(fileInfo.fullName)) continue;
+        fileInfo.fileId = fileId++;
+        if (!scanFilter.matchesId(fileInfo.fileId)) continue;
+
+        fileInfo.folder = arena.internName(found.folder);
         addToRecoveryList(fileInfo);
-        utils.logFileInfo(fileInfo.fileId, fileInfo.fileName, fileInfo.fileSize);
+        logFoundFile(fileInfo);
     }
+    std::vector<FAT32ScanEntry>().swap(scanResults);
+    arena.releaseInternTable();
 }
 
 void FAT32Recovery::addToRecoveryList(const FAT32FileInfo& fileInfo) {
-    if (config.recover || config.analyze) {
-        recoveryList.push_back(fileInfo);
-    }
+    // Kept without --recover too, the scan index stores every file found
+    recoveryList.push_back(fileInfo);
 }
-// Extract long filename from LFN entry
-std::wstring FAT32Recovery::getLongFilename(DirectoryEntry* entry) const {
-    LFNEntry* lfn = reinterpret_cast<LFNEntry*>(entry);
-    std::wstring lfnPart;
-    lfnPart.reserve(13);
-    for (int k = 0; k < 5; k++) lfnPart += lfn->Name1[k];
-    for (int k = 0; k < 6; k++) lfnPart += lfn->Name2[k];
-    for (int k = 0; k < 2; k++) lfnPart += lfn->Name3[k];
 
-    lfnPart.erase(
-        std::remove_if(lfnPart.begin(), lfnPart.end(),
-            [](wchar_t c) {
-                return c == 0 || c == 0xFFFF || c < 32;
-            }),
-        lfnPart.end()
-                );
+void FAT32Recovery::logFoundFile(const FAT32FileInfo& fileInfo) {
+    LoggedFile file;
+    file.fileId = fileInfo.fileId;
+    file.path = ScanFilter::joinPath(fileInfo.folder, fileInfo.fullName);
+    file.fileSize = fileInfo.fileSize;
+    file.firstCluster = fileInfo.cluster;
+    file.isExtensionPredicted = fileInfo.isExtensionPredicted;
 
-    return lfnPart;
+    // Deleting a file frees its chain, recovery then reads the clusters that follow the first one
+    uint32_t bytesPerCluster = driveInfo.bootSector.SectorsPerCluster * driveInfo.bootSector.BytesPerSector;
+    uint64_t clusterCount = (fileInfo.fileSize + bytesPerCluster - 1) / bytesPerCluster;
+    if (clusterCount > 0) file.extents.push_back({ fileInfo.cluster, clusterCount, false });
+    utils.logFileInfo(std::move(file));
+}
+// Append the characters of an LFN entry in reverse
+void FAT32Recovery::appendLongFilenameReversed(const DirectoryEntry* entry, std::wstring& reversedName) const {
+    const LFNEntry* lfn = reinterpret_cast<const LFNEntry*>(entry);
+    wchar_t lfnPart[13];
+    for (int k = 0; k < 5; k++) lfnPart[k] = lfn->Name1[k];
+    for (int k = 0; k < 6; k++) lfnPart[5 + k] = lfn->Name2[k];
+    for (int k = 0; k < 2; k++) lfnPart[11 + k] = lfn->Name3[k];
+
+    // Padding and control characters are dropped
+    for (int k = 12; k >= 0; k--) {
+        wchar_t c = lfnPart[k];
+        if (c != 0 && c != 0xFFFF && c >= 32) reversedName += c;
+    }
 }
 // Extract short filename from Directory Entry
 std::wstring FAT32Recovery::getShortFilename(const DirectoryEntry* entry, bool isDeleted) const {
@@ -297,43 +452,37 @@ std::wstring FAT32Recovery::getShortFilename(const DirectoryEntry* entry, bool i
     return filename;
 }
 // Clean filename and combine it with its extension
-FAT32FileInfo FAT32Recovery::parseFileInfo(const std::wstring& fullName, uint32_t startCluster, uint32_t expectedSize) {
+FAT32FileInfo FAT32Recovery::parseFileInfo(const std::wstring& rawName, uint32_t startCluster, uint32_t expectedSize) {
     FAT32FileInfo fileInfo = {};
-    fileInfo.fileId = fileId;
-    fileInfo.fullName = fullName;
-    fileInfo.fileName = L"";
-    fileInfo.extension = L"";
     fileInfo.fileSize = expectedSize;
     fileInfo.cluster = startCluster;
     fileInfo.isExtensionPredicted = false;
-    
 
-    std::wstring cleanName = fullName;
-    cleanName.erase(std::remove(cleanName.begin(), cleanName.end(), L'\0'), cleanName.end());
-
-    fileInfo.fullName = cleanName;
+    std::wstring fullName = rawName;
+    fullName.erase(std::remove(fullName.begin(), fullName.end(), L'\0'), fullName.end());
 
     size_t dotPos = fullName.find_last_of(L".");
     if (dotPos != std::wstring::npos && dotPos != 0) {
-        fileInfo.fileName = fullName.substr(0, dotPos);
-        fileInfo.extension = fullName.substr(dotPos + 1);
+        std::wstring_view extension = std::wstring_view(fullName).substr(dotPos + 1);
 
-        bool isValid = std::all_of(fileInfo.extension.begin(), fileInfo.extension.end(), ::iswalnum);
+        bool isValid = std::all_of(extension.begin(), extension.end(), ::iswalnum);
         if (!isValid) {
-            std::wcerr << "  [-] Extension is invalid (" << fileInfo.extension << ") file may be corrupted" << std::endl;
-            fileInfo.extension = predictExtension(startCluster, expectedSize);
+            std::wcerr << "  [-] Extension is invalid (" << extension << ") file may be corrupted" << std::endl;
+            fullName = fullName.substr(0, dotPos + 1) + predictExtension(startCluster, expectedSize);
             fileInfo.isExtensionPredicted = true;
-            fileInfo.fullName = fileInfo.fileName + L"." + fileInfo.extension;
         }
     }
     else {
         std::wcerr << "  [-] Extension is missing, file may be corrupted" << std::endl;
-        fileInfo.extension = predictExtension(startCluster, expectedSize);
+        dotPos = fullName.size();
+        fullName += L"." + predictExtension(startCluster, expectedSize);
         fileInfo.isExtensionPredicted = true;
-        fileInfo.fileName = fullName;
-        fileInfo.fullName = fullName + L"." + fileInfo.extension;
     }
-    ++fileId;
+
+    // The name and the extension are views into the stored full name
+    fileInfo.fullName = arena.internName(fullName);
+    fileInfo.fileName = fileInfo.fullName.substr(0, dotPos);
+    fileInfo.extension = fileInfo.fullName.substr(dotPos + 1);
     return fileInfo;
 }
 // Compare two filenames (case-insensitive)
@@ -360,21 +509,20 @@ bool FAT32Recovery::compareFolderNames(const std::wstring& filename1, const std:
 }
 // Predict file extension based on content
 std::wstring FAT32Recovery::predictExtension(const uint32_t cluster, const uint32_t expectedSize) {
-    uint32_t bytesPerCluster = driveInfo.bootSector.SectorsPerCluster * driveInfo.bootSector.BytesPerSector;
     uint32_t firstSector = clusterToSector(cluster);
 
-
     std::vector<uint8_t> buffer;
     buffer.resize(driveInfo.bootSector.BytesPerSector);
 
-    std::wcout << "  [*] Prediting extension..." << std::endl;
+    if (!config.quiet) std::wcout << "  [*] Prediting extension..." << std::endl;
 
     // Read only the first sector to capture file signature
-    bool succ = readSector(firstSector, buffer.data(), driveInfo.bootSector.BytesPerSector);
-
-    std::vector<uint8_t> firstBytes(buffer.begin(), buffer.begin() + 8);
+    std::wstring extension = L"bin";
+    if (readSector(firstSector, buffer.data(), driveInfo.bootSector.BytesPerSector)) {
+        extension = SignatureDB::guessExtension(buffer.data(), (std::min)(buffer.size(), static_cast<size_t>(expectedSize)));
+    }
 
-    std::wstring extension = guessFileExtension(getFileSignature(firstBytes));
+    if (config.quiet) return extension;
 
     // Default to .bin if extension could not be determined
     if (extension == L"bin") {
@@ -386,73 +534,28 @@ std::wstring FAT32Recovery::predictExtension(const uint32_t cluster, const uint3
 
     return extension;
 }
-// Get file signature from first bytes
-std::string FAT32Recovery::getFileSignature(const std::vector<uint8_t>& data) const {
-    std::stringstream ss;
-    for (int i = 0; i < (std::min)(4, static_cast<int>(data.size())); ++i) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(data[i]);
-    }
-    return ss.str();
-}
-// Convert file signature to extension
-std::wstring FAT32Recovery::guessFileExtension(const std::string& signature) const {
-    // Images
-    if (signature.substr(0, 6) == "ffd8ff") return L"jpg";          // JPEG/JPG
-    if (signature.substr(0, 8) == "89504e47") return L"png";        // PNG
-    if ((signature.substr(0, 8) == "47494638") ||
-        (signature.substr(0, 3) == "383761")) return L"gif";        // GIF87a/GIF89a
-    if (signature.substr(0, 4) == "424d") return L"bmp";            // BMP
-    if (signature.substr(0, 8) == "49492a00") return L"tif";        // TIFF
-    if (signature.substr(0, 8) == "4d4d002a") return L"tif";        // TIFF
-    if (signature.substr(0, 8) == "52494646") return L"webp";       // WebP
-
-    // Documents
-    if (signature.substr(0, 8) == "25504446") return L"pdf";        // PDF
-    if (signature.substr(0, 8) == "504b0304") return L"zip";        // ZIP/DOCX/XLSX/PPTX
-    if (signature.substr(0, 8) == "d0cf11e0") return L"doc";        // DOC/XLS/PPT (Legacy Office)
-    if (signature.substr(0, 8) == "7b5c7274") return L"rtf";        // RTF
-
-    // Audio/Video
-    if (signature.substr(0, 8) == "52494646") return L"wav";        // WAV
-    if (signature.substr(0, 8) == "494433") return L"mp3";          // MP3
-    if (signature.substr(0, 8) == "66747970") return L"mp4";        // MP4
-    if (signature.substr(0, 8) == "52494646") return L"avi";        // AVI
-    if (signature.substr(0, 4) == "4f676753") return L"ogg";        // OGG
-
-    // Executables and Libraries
-    if (signature.substr(0, 4) == "4d5a") return L"exe";            // EXE/DLL
-    if (signature.substr(0, 8) == "7f454c46") return L"elf";        // ELF (Linux executables)
-
-    // Archives
-    if (signature.substr(0, 8) == "504b0304") return L"zip";        // ZIP
-    if (signature.substr(0, 6) == "526172") return L"rar";          // RAR
-    if (signature.substr(0, 8) == "1f8b0808") return L"gz";         // GZIP
-    if (signature.substr(0, 6) == "425a68") return L"bz2";          // BZIP2
-    if (signature.substr(0, 8) == "377abcaf") return L"7z";         // 7Z
-
-    // Database
-    if (signature.substr(0, 8) == "53514c69") return L"sqlite";     // SQLite
-
-    // Programming
-    if (signature.substr(0, 8) == "3c3f786d") return L"xml";        // XML
-    if (signature.substr(0, 8) == "7b0d0a20") return L"json";       // JSON
-    if (signature.substr(0, 8) == "3c21444f") return L"html";       // HTML
-
-    // Font files
-    if (signature.substr(0, 8) == "4f54544f") return L"otf";        // OTF
-    if (signature.substr(0, 8) == "00010000") return L"ttf";        // TTF
-
-    // If no match is found
-    return L"bin";
-}
 
 
 
 /*=============== Corruption analysis ===============*/
 // Check if cluster is marked as in use in the FAT
+void FAT32Recovery::loadAllocationBitmap() {
+    allocationBitmap = std::make_unique<AllocationBitmap>(MIN_DATA_CLUSTER, driveInfo.maxClusterCount);
+
+    uint64_t lastCluster = static_cast<uint64_t>(MIN_DATA_CLUSTER) + driveInfo.maxClusterCount;
+    for (uint64_t cluster = MIN_DATA_CLUSTER; cluster < lastCluster; cluster++) {
+        uint32_t fatEntry;
+        if (fatCache->getEntry(static_cast<uint32_t>(cluster), fatEntry) && (fatEntry & 0x0FFFFFFF) != 0) {
+            allocationBitmap->markAllocated(cluster);
+        }
+    }
+    std::cout << "[*] Allocation bitmap built, " << allocationBitmap->countAllocated() << " of "
+        << driveInfo.maxClusterCount << " clusters in use" << std::endl;
+}
+
 bool FAT32Recovery::isClusterInUse(uint32_t cluster) {
-    uint32_t fatValue = getNextCluster(cluster);
-    return (fatValue != 0 && fatValue != 0xF8FFFFFF);
+    if (!allocationBitmap) loadAllocationBitmap();
+    return allocationBitmap->isAllocated(cluster);
 }
 // Analyzes clusters for repetition, gaps, backward jumps and calculates the fragmentation score
 void FAT32Recovery::analyzeClusterPattern(const std::vector<uint32_t>& clusters, FAT32RecoveryStatus& status) const {
@@ -536,43 +639,64 @@ bool FAT32Recovery::isFileNameCorrupted(const std::wstring& filename) const {
     // flag as corrupted if half of the filename contains suspicious characters
     return (controlCharCount > 0 || unusualCharCount > static_cast<int>(filename.length() / 2));
 }
-// Calculate the percentage of deleted file being overwritten by another deleted file
-OverwriteAnalysis FAT32Recovery::analyzeClusterOverwrites(uint32_t startCluster, uint32_t expectedSize) {
-    OverwriteAnalysis analysis = {
-        .hasOverwrite = false,
-        .overwritePercentage = 0.0
-    };
-
-    uint32_t bytesPerCluster = driveInfo.bootSector.SectorsPerCluster * driveInfo.bootSector.BytesPerSector;
-    uint32_t expectedClusters = (expectedSize + bytesPerCluster - 1) / bytesPerCluster;
-
+// Follow the cluster chain for expectedClusters clusters, assumes the next cluster when the chain is broken
+std::vector<uint32_t> FAT32Recovery::walkClusterChain(uint32_t startCluster, uint64_t expectedClusters) {
+    std::vector<uint32_t> clusterChain;
     uint32_t currentCluster = startCluster;
-    uint64_t currentOffset = 0;
 
-    while (currentOffset < expectedSize && currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
-        auto overlaps = clusterHistory.findOverlappingUsage(currentCluster);
-
-        if (!overlaps.empty()) {
-            analysis.hasOverwrite = true;
-            analysis.overwrittenClusters.push_back(currentCluster);
+    while (clusterChain.size() < expectedClusters && currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
+        clusterChain.push_back(currentCluster);
 
-            for (const auto& overlap : overlaps) {
-                analysis.overwrittenBy[currentCluster].push_back(overlap.second.fileId);
+        uint32_t nextCluster = getNextCluster(currentCluster);
+        if (nextCluster == currentCluster || nextCluster < 2 || nextCluster >= 0x0FFFFFF8) {
+            nextCluster = currentCluster + 1;
+        }
+        currentCluster = nextCluster;
+    }
+    return clusterChain;
+}
+// Register the clusters claimed by every deleted file so overlaps can be looked up per extent
+void FAT32Recovery::buildClusterHistory() {
+    clusterHistory.clear();
+    uint64_t bytesPerCluster = static_cast<uint64_t>(driveInfo.bootSector.SectorsPerCluster * driveInfo.bootSector.BytesPerSector);
+
+    for (const auto& file : recoveryList) {
+        uint64_t expectedClusters = (file.fileSize + bytesPerCluster - 1) / bytesPerCluster;
+        for (const ClusterRun& run : utils.coalesceClusterChain(walkClusterChain(file.cluster, expectedClusters))) {
+            clusterHistory.addExtent(file.fileId, run.startCluster, run.length);
+        }
+    }
+    clusterHistory.finalize();
+}
+// Calculate the percentage of deleted file being overwritten by another deleted file
+OverwriteAnalysis FAT32Recovery::analyzeClusterOverwrites(uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, uint64_t expectedClusters) {
+    OverwriteAnalysis analysis = {};
+
+    for (const ClusterRun& run : clusterRuns) {
+        size_t firstOverlap = analysis.overlaps.size();
+        clusterHistory.findOverlaps(fileId, run.startCluster, run.length, analysis.overlaps);
+        if (analysis.overlaps.size() == firstOverlap) continue;
+
+        // Several files may claim the same clusters, count each cluster once
+        std::sort(analysis.overlaps.begin() + firstOverlap, analysis.overlaps.end(), [](const ClusterOverlap& a, const ClusterOverlap& b) {
+            return a.startCluster < b.startCluster;
+        });
+        uint64_t coveredEnd = 0;
+        for (size_t i = firstOverlap; i < analysis.overlaps.size(); i++) {
+            const ClusterOverlap& overlap = analysis.overlaps[i];
+            uint64_t overlapStart = (std::max)(overlap.startCluster, coveredEnd);
+            uint64_t overlapEnd = overlap.startCluster + overlap.length;
+            if (overlapEnd > overlapStart) {
+                analysis.overwrittenClusters += overlapEnd - overlapStart;
+                coveredEnd = overlapEnd;
             }
         }
-
-        clusterHistory.recordClusterUsage(currentCluster, nextFileId, currentOffset);
-
-        currentOffset += bytesPerCluster;
-        currentCluster = getNextCluster(currentCluster);
     }
 
-    if (!analysis.overwrittenClusters.empty()) {
-        analysis.overwritePercentage =
-            static_cast<double>(analysis.overwrittenClusters.size()) / expectedClusters * 100.0;
+    analysis.hasOverwrite = analysis.overwrittenClusters > 0;
+    if (analysis.hasOverwrite && expectedClusters > 0) {
+        analysis.overwritePercentage = static_cast<double>(analysis.overwrittenClusters) / expectedClusters * 100.0;
     }
-
-    nextFileId++;
     return analysis;
 }
 
@@ -595,27 +719,23 @@ std::vector<FAT32FileInfo> FAT32Recovery::selectFilesToRecover(const std::vector
         else if (userResponse == '1') return recoveryList;
         else if (userResponse == '2') {
             std::string fileIds;
-            std::cout << "\nEnter file IDs to recover (e.g., 1,2,3): ";
+            std::cout << "\nEnter file IDs to recover (e.g., 1,2,3 or 10-20): ";
             std::cin >> fileIds;
 
-            std::vector<int> fileIdVector;
-            std::stringstream ss(fileIds);
-            std::string id;
-            while (std::getline(ss, id, ',')) {
-                try {
-                    fileIdVector.push_back(std::stoi(id));
-                }
-                catch (const std::invalid_argument&) {
-                    std::cerr << "\nInvalid input. Please enter numeric IDs.\n";
-                    return recoveryList;
-                }
+            IdSelection selection;
+            try {
+                selection = IdSelection::parse(fileIds);
+            }
+            catch (const std::logic_error&) {
+                std::cerr << "\nInvalid input. Please enter numeric IDs.\n";
+                return recoveryList;
             }
             // Create a new vector to store the selected files
             std::vector<FAT32FileInfo> selectedFiles;
 
             // Iterate through the original recoveryList vector and add the selected files to the new vector
             for (const auto& file : recoveryList) {
-                if (std::find(fileIdVector.begin(), fileIdVector.end(), file.fileId) != fileIdVector.end()) {
+                if (selection.contains(file.fileId)) {
                     selectedFiles.push_back(file);
                 }
             }
@@ -626,17 +746,51 @@ std::vector<FAT32FileInfo> FAT32Recovery::selectFilesToRecover(const std::vector
     }
     return recoveryList;
 }
+// Sample the clusters recovery would read, the ranking goes to the content score log
+void FAT32Recovery::rankSelectedFiles(std::vector<FAT32FileInfo>& files) {
+    uint64_t bytesPerCluster = static_cast<uint64_t>(driveInfo.bootSector.SectorsPerCluster) * driveInfo.bootSector.BytesPerSector;
+    std::vector<ContentCandidate> candidates;
+    candidates.reserve(files.size());
+    for (const FAT32FileInfo& file : files) {
+        ContentCandidate candidate = { file.fileId, ScanFilter::joinPath(file.folder, file.fullName), file.fileSize, {}, {} };
+        uint64_t expectedClusters = (file.fileSize + bytesPerCluster - 1) / bytesPerCluster;
+        for (const ClusterRun& run : utils.coalesceClusterChain(walkClusterChain(file.cluster, expectedClusters))) {
+            candidate.extents.push_back({ run.startCluster, run.length, false });
+        }
+        candidates.push_back(std::move(candidate));
+    }
+
+    RecoveryGeometry geometry = {
+        .firstCluster = 2,
+        .firstClusterSector = driveInfo.dataStartSector,
+        .sectorsPerCluster = driveInfo.bootSector.SectorsPerCluster,
+        .bytesPerSector = driveInfo.bootSector.BytesPerSector
+    };
+    ContentAnalyzer analyzer(*sectorReader, geometry, utils);
+    std::vector<ContentScore> scores = analyzer.rankFiles(candidates);
+    if (config.minConfidence == 0) return;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (scores[i].confidence >= config.minConfidence) files[kept++] = files[i];
+    }
+    std::cout << "[*] " << files.size() - kept << " files below " << config.minConfidence << "% confidence are not recovered" << std::endl;
+    files.resize(kept);
+}
 // Recover all found deleted files or a specific file if target cluster and target filesize is specified
 void FAT32Recovery::recoverPartition() {
     utils.printHeader("File Recovery and Analysis:");
+    if (!config.recover && !config.analyze && !config.scoreContent) {
+        std::cout << "[!] Recovery or analysis is disabled. Use --recover, --analyze and/or --score to proceed." << std::endl;
+        return;
+    }
     if (recoveryList.empty()) {
-        if (config.recover || config.analyze)  std::cerr << "[-] No deleted files found" << std::endl;
-        else std::cout << "[!] Recovery or analysis is disabled. Use --recover and/or --analyze to proceed." << std::endl;
-
+        std::cerr << (scanFilter.isActive() ? "[-] No deleted files match the filters" : "[-] No deleted files found") << std::endl;
         return;
     }
     std::vector<FAT32FileInfo> selectedDeletedFiles;
-    if (!config.targetCluster && !config.targetFileSize) {
+    // Filtered and --all runs are scripted, nobody is there to answer
+    if (!config.recoverAll && !scanFilter.isActive()) {
         selectedDeletedFiles = selectFilesToRecover(recoveryList);
         utils.printItemDivider();
     }
@@ -644,15 +798,35 @@ void FAT32Recovery::recoverPartition() {
         selectedDeletedFiles = recoveryList;
     }
 
-    for (const auto& file : selectedDeletedFiles) {
-        processFileForRecovery(file);
+    if (config.scoreContent) {
+        rankSelectedFiles(selectedDeletedFiles);
+        if (!config.recover && !config.analyze) return;
+    }
+
+    // Overlaps are checked against every deleted file, not only the selected ones
+    if (config.analyze) {
+        buildClusterHistory();
+    }
+
+    // Files are recovered in on-disk order, several at a time when there is nothing to analyze
+    RecoveryScheduler scheduler;
+    for (size_t i = 0; i < selectedDeletedFiles.size(); i++) {
+        uint32_t cluster = selectedDeletedFiles[i].cluster;
+        scheduler.addFile(i, isValidCluster(cluster) ? clusterToSector(cluster) : 0);
     }
+    concurrentRecovery = scheduler.getWorkerCount() > 1;
+    if (concurrentRecovery) {
+        std::cout << "[*] Recovering " << selectedDeletedFiles.size() << " files with " << scheduler.getWorkerCount() << " workers" << std::endl;
+    }
+    ScopedTimer timer(MetricPhase::RECOVERY); // Starts after the prompt, so files/s only covers the recovery
+    scheduler.run([&](size_t index) { processFileForRecovery(selectedDeletedFiles[index]); });
+    concurrentRecovery = false;
 }
 void FAT32Recovery::processFileForRecovery(const FAT32FileInfo& fileInfo) {
-    bool isExtensionPredicted = false;
+    bool isExtensionPredicted = fileInfo.isExtensionPredicted;
 
-    // Skip files that don't match the target cluster and size (if specified)
-    if (fileInfo.fileSize <= 0 || (config.targetCluster && config.targetFileSize && (fileInfo.cluster != config.targetCluster || fileInfo.fileSize != config.targetFileSize))) {
+    // The target cluster and size were already applied by the scan filter
+    if (fileInfo.fileSize <= 0) {
         return;  
     }
     
@@ -669,18 +843,18 @@ void FAT32Recovery::processFileForRecovery(const FAT32FileInfo& fileInfo) {
     uint32_t bytesPerCluster = driveInfo.bootSector.SectorsPerCluster * driveInfo.bootSector.BytesPerSector;
     status.expectedClusters = (expectedSize + bytesPerCluster - 1) / bytesPerCluster;
 
-    std::wcout << "[*] Current file: " << outputPath.filename() << " cluster " << fileInfo.cluster << " (" << expectedSize << " bytes)" << std::endl;
+    if (reportsFileDetails() || config.analyze) std::wcout << "[*] Current file: " << outputPath.filename() << " cluster " << fileInfo.cluster << " (" << expectedSize << " bytes)" << std::endl;
     std::vector<uint32_t> clusterChain;
 
-    validateClusterChain(status, fileInfo.cluster, clusterChain, expectedSize, outputPath, isExtensionPredicted);
+    validateClusterChain(status, fileInfo.fileId, fileInfo.cluster, clusterChain, outputPath, isExtensionPredicted);
 
     if (config.recover) {
-        recoverFile(clusterChain, status, outputPath, expectedSize);  
+        recoverFile(fileInfo.fileId, utils.coalesceClusterChain(clusterChain), status, outputPath, expectedSize);
     }
-    utils.printItemDivider();
+    if (reportsFileDetails() || config.analyze) utils.printItemDivider();
 }
 // Validates cluster chain and finds potential signs of corruption
-void FAT32Recovery::validateClusterChain(FAT32RecoveryStatus& status, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, uint32_t expectedSize, const fs::path& outputPath, bool isExtensionPredicted){
+void FAT32Recovery::validateClusterChain(FAT32RecoveryStatus& status, const uint32_t fileId, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, const fs::path& outputPath, bool isExtensionPredicted){
     if (config.analyze) std::cout << "[*] Analyzing file clusters..." << std::endl;
 
     uint32_t currentCluster = startCluster;
@@ -718,9 +892,13 @@ void FAT32Recovery::validateClusterChain(FAT32RecoveryStatus& status, const uint
         currentCluster = nextCluster;
     }
     if (config.analyze) {
-        auto overwriteAnalysis = analyzeClusterOverwrites(startCluster, expectedSize);
-        status.hasOverwrittenClusters = overwriteAnalysis.hasOverwrite;
-        if (status.hasOverwrittenClusters) status.isCorrupted = true;
+        auto overwriteAnalysis = analyzeClusterOverwrites(fileId, utils.coalesceClusterChain(clusterChain), status.expectedClusters);
+        if (overwriteAnalysis.hasOverwrite) {
+            status.hasOverwrittenClusters = true;
+            status.isCorrupted = true;
+            std::cout << "  [!] " << overwriteAnalysis.overwrittenClusters << " cluster(s) (" << std::fixed << std::setprecision(2)
+                << overwriteAnalysis.overwritePercentage << "%) also claimed by " << overwriteAnalysis.overlaps.size() << " extent(s) of other deleted files" << std::endl;
+        }
 
         status.hasInvalidFileName = isFileNameCorrupted(outputPath.filename().wstring());
         if (status.hasInvalidFileName) {
@@ -743,39 +921,31 @@ void FAT32Recovery::validateClusterChain(FAT32RecoveryStatus& status, const uint
     }
 }
 // Recovers specific file
-void FAT32Recovery::recoverFile(const std::vector<uint32_t>& clusterChain, FAT32RecoveryStatus& status, const fs::path& outputPath, const uint32_t expectedSize) {
-    std::cout << "[*] Recovering file..." << std::endl;
-    std::ofstream outputFile(outputPath, std::ios::binary);
-    if (!outputFile) {
-        throw std::runtime_error("[-] Failed to create output file.");
-    }
-    // Recovery
-    std::vector<uint8_t> sectorBuffer(driveInfo.bootSector.BytesPerSector);
-    for (uint32_t cluster : clusterChain) {
-        uint32_t sector = clusterToSector(cluster);
-
-        for (uint64_t i = 0; i < driveInfo.bootSector.SectorsPerCluster; ++i) {
-            if (!readSector(static_cast<uint64_t>(sector) + i, sectorBuffer.data(), driveInfo.bootSector.BytesPerSector)) {
-                continue;
-            }
-
-            uint64_t bytesToWrite = (std::min)(
-                static_cast<uint64_t>(driveInfo.bootSector.BytesPerSector),
-                expectedSize - status.recoveredBytes
-            );
-
-            outputFile.write(reinterpret_cast<char*>(sectorBuffer.data()), bytesToWrite);
-            status.recoveredBytes += bytesToWrite;
-            utils.showProgress(status.recoveredBytes, expectedSize);
-
-            if (status.recoveredBytes >= expectedSize) break;
-        }
-        status.recoveredClusters++;
-        if (status.recoveredBytes >= expectedSize) break;
+void FAT32Recovery::recoverFile(const uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, FAT32RecoveryStatus& status, const fs::path& outputPath, const uint32_t expectedSize) {
+    if (reportsFileDetails()) std::cout << "[*] Recovering file..." << std::endl;
+    std::vector<FileExtent> extents;
+    extents.reserve(clusterRuns.size());
+    for (const ClusterRun& run : clusterRuns) {
+        extents.push_back({ run.startCluster, run.length, false });
     }
-    outputFile.close();
 
-    showRecoveryResult(status, outputPath, expectedSize);
+    RecoveryGeometry geometry = {
+        .firstCluster = 2,
+        .firstClusterSector = driveInfo.dataStartSector,
+        .sectorsPerCluster = driveInfo.bootSector.SectorsPerCluster,
+        .bytesPerSector = driveInfo.bootSector.BytesPerSector
+    };
+    RecoveryPipeline pipeline(*sectorReader, geometry, utils);
+    pipeline.setReportProgress(!concurrentRecovery);
+    PipelineResult result = pipeline.recoverFile(extents, expectedSize, outputPath);
+    status.recoveredBytes += result.recoveredBytes;
+    status.recoveredClusters += result.recoveredClusters;
+    status.unreadableBytes += result.unreadableBytes;
+    status.problematicClusters.insert(status.problematicClusters.end(), result.problematicClusters.begin(), result.problematicClusters.end());
+    if (!result.writeFailed) utils.logFileDigests(fileId, outputPath, result.recoveredBytes, expectedSize, std::move(result.digests));
+
+    if (!reportsFileDetails()) utils.logRecoveredFile(outputPath, status.recoveredBytes, expectedSize, status.unreadableBytes);
+    else showRecoveryResult(status, outputPath, expectedSize);
 }
 
 /* Recovery and analysis results */
@@ -829,6 +999,9 @@ void FAT32Recovery::showRecoveryResult(const FAT32RecoveryStatus& status, const
         << " / " << status.expectedClusters << std::endl;
     std::cout << "  [*] Bytes recovered: " << status.recoveredBytes
         << " / " << expectedSize << std::endl;
+    if (status.unreadableBytes > 0) {
+        std::cout << "  [-] Unreadable bytes written as zeros: " << status.unreadableBytes << std::endl;
+    }
     if (fs::exists(fs::absolute(outputPath))) {
         std::wcout << "  [+] File saved to " << fs::absolute(outputPath) << L"\n";
     } 
@@ -838,16 +1011,109 @@ void FAT32Recovery::showRecoveryResult(const FAT32RecoveryStatus& status, const
 }
 
 
+/*=============== Scan index ===============*/
+VolumeKey FAT32Recovery::getVolumeKey() {
+    // Deleting a file frees its FAT entries, so the allocation state tells if the volume changed
+    if (!allocationBitmap) loadAllocationBitmap();
+    return ScanIndex::makeKey(FilesystemType::FAT32_TYPE, driveInfo.bootSector.VolumeID,
+        &driveInfo.bootSector, sizeof(driveInfo.bootSector), *allocationBitmap);
+}
+
+void FAT32Recovery::saveScanIndex() {
+    IndexWriter writer;
+    for (const FAT32FileInfo& fileInfo : recoveryList) {
+        writer.write(static_cast<uint32_t>(fileInfo.fileId));
+        writer.writeString(fileInfo.folder);
+        writer.writeString(fileInfo.fullName);
+        writer.writeString(fileInfo.fileName);
+        writer.writeString(fileInfo.extension);
+        writer.write(fileInfo.fileSize);
+        writer.write(fileInfo.cluster);
+        writer.write(static_cast<uint8_t>(fileInfo.isExtensionPredicted));
+    }
+
+    ScanIndex index(getVolumeKey());
+    if (index.save(static_cast<uint32_t>(recoveryList.size()), fileId, writer)) {
+        std::wcout << "[*] Scan index saved to " << index.getPath().wstring() << std::endl;
+    }
+}
+
+bool FAT32Recovery::loadScanIndex() {
+    ScopedTimer timer(MetricPhase::SCAN_INDEX);
+    ScanIndex index(getVolumeKey());
+    uint32_t recordCount = 0;
+    uint32_t nextFileId = 0;
+    std::vector<uint8_t> records;
+    if (!index.load(recordCount, nextFileId, records)) {
+        std::cout << "[*] No usable scan index, scanning the volume" << std::endl;
+        return false;
+    }
+
+    // Only kept if the whole index reads back
+    MetadataArena indexArena;
+    std::vector<FAT32FileInfo> indexedFiles(recordCount);
+    IndexReader reader(records.data(), records.size());
+    for (FAT32FileInfo& fileInfo : indexedFiles) {
+        fileInfo.fileId = reader.read<uint32_t>();
+        fileInfo.folder = indexArena.internName(reader.readString());
+        fileInfo.fullName = indexArena.internName(reader.readString());
+        fileInfo.fileName = indexArena.internName(reader.readString());
+        fileInfo.extension = indexArena.internName(reader.readString());
+        fileInfo.fileSize = reader.read<uint64_t>();
+        fileInfo.cluster = reader.read<uint32_t>();
+        fileInfo.isExtensionPredicted = reader.read<uint8_t>() != 0;
+    }
+    if (!reader.isValid() || !reader.isAtEnd()) {
+        std::cerr << "[!] The scan index is damaged, scanning the volume" << std::endl;
+        return false;
+    }
+
+    utils.printHeader("File Search (scan index):");
+    utils.openLogFile();
+    for (const FAT32FileInfo& fileInfo : indexedFiles) {
+        logFoundFile(fileInfo);
+    }
+    utils.closeLogFile();
+    recoveryList = std::move(indexedFiles);
+    arena.adopt(indexArena);
+    fileId = nextFileId;
+    utils.printFooter();
+    return true;
+}
+
 void FAT32Recovery::runLogicalDriveRecovery() {
-    scanForDeletedFiles(driveInfo.rootDirCluster);
+    // A matching index replaces the scan, every unfiltered scan refreshes it
+    if (scanFilter.isActive()) {
+        if (config.useIndex) std::cout << "[!] Filters are set, the scan index is not used" << std::endl;
+        if (config.resume) std::cout << "[!] Filters are set, the scan checkpoint is not used" << std::endl;
+        scanForDeletedFiles(driveInfo.rootDirCluster);
+    }
+    else if (!config.useIndex || !loadScanIndex()) {
+        scanForDeletedFiles(driveInfo.rootDirCluster);
+        saveScanIndex();
+    }
     recoverPartition();
+    if (config.carve) carveUnallocatedClusters();
+}
+// Carve files from the clusters the allocation bitmap reports as free
+void FAT32Recovery::carveUnallocatedClusters() {
+    if (!allocationBitmap) loadAllocationBitmap();
+
+    CarvingGeometry geometry = {
+        .firstClusterSector = clusterToSector(static_cast<uint32_t>(allocationBitmap->getFirstCluster())),
+        .sectorsPerCluster = driveInfo.bootSector.SectorsPerCluster,
+        .bytesPerSector = driveInfo.bootSector.BytesPerSector
+    };
+    FileCarver carver(*sectorReader, *allocationBitmap, geometry, utils, fileId);
+    carver.carveUnallocatedClusters();
 }
 
 /*=============== Public Interface ===============*/
 
 /* Recovery entry point */
 void FAT32Recovery::startRecovery() {
-    if (this->driveType == DriveType::LOGICAL_TYPE) runLogicalDriveRecovery();
+    // A partition of a physical drive or an image is read through a partition relative reader, like a volume
+    if (this->driveType == DriveType::LOGICAL_TYPE || this->driveType == DriveType::PHYSICAL_TYPE || this->driveType == DriveType::IMAGE_TYPE) runLogicalDriveRecovery();
     else {
         throw std::runtime_error("Unknown drive type.");
     }
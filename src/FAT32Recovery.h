@@ -4,16 +4,29 @@
 #include "Utils.h"
 #include "SectorReader.h"
 #include "ClusterHistory.h"
+#include "FATCache.h"
+#include "AllocationBitmap.h"
+#include "FileCarver.h"
+#include "RecoveryPipeline.h"
+#include "RecoveryScheduler.h"
+#include "ContentAnalyzer.h"
+#include "SignatureDB.h"
+#include "DirectoryScan.h"
+#include "ThreadPool.h"
+#include "ScanIndex.h"
+#include "ScanCheckpoint.h"
+#include "ScanFilter.h"
+#include "MetadataArena.h"
 #include "Enums.h"
 
 #include <cstdint>
 #include <string>
-#include <windows.h>
 #include <vector>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <mutex>
 
 
 
@@ -33,8 +46,7 @@ private:
     static constexpr double SUSPICIOUS_PATTERN_THRESHOLD = 0.1; // 10%
     static constexpr double SEVERE_PATTERN_THRESHOLD = 0.25;    // 25%
     static constexpr double FILENAME_CORRUTPION_THRESHOLD = 0.5; // 50% bad chars in name
-    ClusterHistory clusterHistory;// used with finding cluster overwrites
-    uint32_t nextFileId = 0; // used with finding cluster overwrites
+    ClusterHistory clusterHistory; // Extents of every deleted file, used with finding cluster overwrites
 
     Utils utils;
     //const Config& config;
@@ -46,17 +58,37 @@ private:
         uint32_t maxClusterCount;
     } driveInfo;
 
-    uint16_t fileId = 1;
+    uint32_t fileId = 1;
+    MetadataArena arena; // Names of recoveryList
     std::vector<FAT32FileInfo> recoveryList;
+    bool concurrentRecovery = false; // Several workers recover files, each reports a single line
+    // A single worker prints a report for every file, unless --quiet is set
+    bool reportsFileDetails() const { return !concurrentRecovery && !config.quiet; }
+    ScanFilter scanFilter;
     std::unique_ptr<SectorReader> sectorReader;
+    std::unique_ptr<FATCache> fatCache;
+    std::unique_ptr<AllocationBitmap> allocationBitmap; // Derived from the FAT on first use
+
+    // Parallel directory scan state
+    ThreadPool* scanPool = nullptr;                     // Pool running the directory tasks
+    std::unique_ptr<VisitedClusterSet> visitedClusters; // Directory clusters already scanned
+    std::mutex scanResultsMutex;                        // Guards the results, the frontier and the checkpoint
+    std::vector<FAT32ScanEntry> scanResults;
+    std::unique_ptr<ScanCheckpoint> checkpoint;         // Unfiltered scans only
+    ScanFrontier scanFrontier;
+    IndexWriter checkpointResults;                      // scanResults serialized as they are found
     DriveType driveType = DriveType::UNKNOWN_TYPE; // not implemented yet
 
     void printToolHeader() const;
 
     void setSectorReader(std::unique_ptr<SectorReader> reader);
     bool readSector(uint64_t sector, void* buffer, uint32_t size);
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer);
+    bool readBatch(std::vector<ReadRequest>& requests);
     void readBootSector(uint32_t sector);
     uint32_t getBytesPerSector();
+    // Load the first FAT into memory for chain walks
+    void initializeFATCache();
 
     bool isValidCluster(uint32_t cluster) const;
     uint32_t sanitizeCluster(uint32_t cluster) const;
@@ -66,54 +98,82 @@ private:
     /*=============== File scan ===============*/
     // Scan drive for deleted files
     void scanForDeletedFiles(uint32_t startSector);
-    void scanDirectory(uint32_t cluster, bool isTargetFolder = false);
-    void processEntriesInSector(uint32_t entriesPerSector, bool isTargetFolder, std::vector<uint8_t>& sectorBuffer);
-    void processDirectoryEntry(const DirectoryEntry* entry, const std::wstring& filename, bool isTargetFolder);
+    // Queue a directory for the scan workers
+    void scheduleDirectory(DirectoryTask task);
+    // Scan every cluster of a directory, subdirectories are collected in the state
+    void scanDirectory(DirectoryScanState<FAT32ScanEntry>& state);
+    // Take the entries of a scanned directory and schedule its subdirectories, saves a checkpoint when one is due
+    void finishDirectory(DirectoryScanState<FAT32ScanEntry>& state);
+    // Restore the entries and the pending directories of an interrupted scan, false starts from the root
+    bool resumeDirectoryScan(std::vector<DirectoryTask>& pendingTasks);
+    static void writeScanEntry(IndexWriter& writer, const FAT32ScanEntry& entry);
+    static void readScanEntry(IndexReader& reader, FAT32ScanEntry& entry);
+    void processEntriesInCluster(uint32_t entriesPerCluster, std::vector<uint8_t>& clusterBuffer, DirectoryScanState<FAT32ScanEntry>& state);
+    void processDirectoryEntry(const DirectoryEntry* entry, const std::wstring& filename, DirectoryScanState<FAT32ScanEntry>& state);
+    // Turn the sorted scan results into the recovery list
+    void mergeScanResults();
     void addToRecoveryList(const FAT32FileInfo& fileInfo);
-    // Extract long filename from LFN entry
-    std::wstring getLongFilename(DirectoryEntry* entry) const;
+    // Hand a found file to the result logger
+    void logFoundFile(const FAT32FileInfo& fileInfo);
+    // Append the characters of an LFN entry in reverse. The entries of a name are stored last part first,
+    // so the parts are collected reversed and the whole name is turned around once.
+    void appendLongFilenameReversed(const DirectoryEntry* entry, std::wstring& reversedName) const;
     // Extract short filename from Directory Entry
     std::wstring getShortFilename(const DirectoryEntry* entry, bool isDeleted = false)const;
-    // Parse filename into components
-    FAT32FileInfo parseFileInfo(const std::wstring& fullName, uint32_t startCluster, uint32_t expectedSize);
+    // Parse filename into components, the name is stored in the arena. The file id is assigned by the caller.
+    FAT32FileInfo parseFileInfo(const std::wstring& rawName, uint32_t startCluster, uint32_t expectedSize);
     // Compare two filenames (case-insensitive)
     bool compareFolderNames(const std::wstring& filename1, const std::wstring& filename2) const;
     // Predict file extension based on content
     std::wstring predictExtension(const uint32_t cluster, const uint32_t expectedSize);
-    // Get file signature from first bytes
-    std::string getFileSignature(const std::vector<BYTE>& data) const;
-    // Convert file signature to extension
-    std::wstring guessFileExtension(const std::string& signature) const;
   
 
     /*=============== Corruption analysis ===============*/
+    // Build the allocation bitmap from the FAT, a cluster with a non-zero entry is allocated
+    void loadAllocationBitmap();
     // Check if cluster is marked as in use in the FAT
     bool isClusterInUse(uint32_t cluster);
     // Analyzes clusters for repetition, gaps, backward jumps and calculates the fragmentation score
     void analyzeClusterPattern(const std::vector<uint32_t>& clusters, FAT32RecoveryStatus& status) const;
     // Checks if a filename is corrupted
     bool isFileNameCorrupted(const std::wstring& filename) const;
+    // Follow the FAT from startCluster, broken links continue with the next cluster
+    std::vector<uint32_t> walkClusterChain(uint32_t startCluster, uint64_t expectedClusters);
+    // Index the clusters of all deleted files
+    void buildClusterHistory();
     // Find deleted files overwritten by other deleted files
-    OverwriteAnalysis analyzeClusterOverwrites(uint32_t startCluster, uint32_t expectedSize);
+    OverwriteAnalysis analyzeClusterOverwrites(uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, uint64_t expectedClusters);
 
     /*=============== Recovery ===============*/
     // Asks user to either recover all files or only the selected IDs
     std::vector<FAT32FileInfo> selectFilesToRecover(const std::vector<FAT32FileInfo>& deletedFiles);
+    // Score the content of the selected files, files below the minimum confidence are dropped
+    void rankSelectedFiles(std::vector<FAT32FileInfo>& files);
     // Recover all found deleted files
     void recoverPartition();
     // Processes each file for recovery based on config options
     void processFileForRecovery(const FAT32FileInfo& fileInfo);
     // Validate cluster chain and find signs of corruption
-    void validateClusterChain(FAT32RecoveryStatus& status, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, uint32_t expectedSize, const fs::path& outputPath, bool isExtensionPredicted);
-    // Recover specific file
-    void recoverFile(const std::vector<uint32_t>& clusterChain, FAT32RecoveryStatus& status, const fs::path& outputPath, const uint32_t expectedSize);
+    void validateClusterChain(FAT32RecoveryStatus& status, const uint32_t fileId, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, const fs::path& outputPath, bool isExtensionPredicted);
+    // Recover specific file, each run of consecutive clusters is streamed with large reads
+    void recoverFile(const uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, FAT32RecoveryStatus& status, const fs::path& outputPath, const uint32_t expectedSize);
 
     /*=============== Recovery and analysis results ===============*/
     void showAnalysisResult(const FAT32RecoveryStatus& status) const;
     void showRecoveryResult(const FAT32RecoveryStatus& status, const fs::path& outputPath, const uint32_t expectedSize) const;
 
+    /*=============== Scan index ===============*/
+    // Identify the volume state, builds the allocation bitmap on first use
+    VolumeKey getVolumeKey();
+    // Persist the recovery list so a later run with --use-index can skip the scan
+    void saveScanIndex();
+    // Fill the recovery list from the index, false if it is missing or outdated
+    bool loadScanIndex();
+
     // Recovery entry point
     void runLogicalDriveRecovery();
+    // Carve signatures from free clusters, after the directory based recovery
+    void carveUnallocatedClusters();
 
 public:
     // Constructor
@@ -0,0 +1,134 @@
+#include "FATCache.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+
+FATCache::FATCache(SectorReader& reader, uint64_t fatStartSector, uint32_t fatSectorCount, uint32_t bytesPerSector, uint32_t clusterCount, uint64_t memoryLimit)
+    : sectorReader(reader)
+    , fatStartSector(fatStartSector)
+    , fatSectorCount(fatSectorCount)
+    , bytesPerSector(bytesPerSector)
+{
+    if (bytesPerSector == 0 || bytesPerSector % sizeof(uint32_t) != 0 || fatSectorCount == 0) {
+        throw std::runtime_error("Invalid FAT geometry");
+    }
+
+    sectorsPerPage = (std::max)(1u, PAGE_BYTES / bytesPerSector);
+    entriesPerPage = sectorsPerPage * (bytesPerSector / sizeof(uint32_t));
+    pageCount = (fatSectorCount + sectorsPerPage - 1) / sectorsPerPage;
+
+    // Entries past the last data cluster are unused
+    uint64_t tableEntries = static_cast<uint64_t>(fatSectorCount) * (bytesPerSector / sizeof(uint32_t));
+    entryCount = static_cast<uint32_t>((std::min)(tableEntries, static_cast<uint64_t>(clusterCount) + 2));
+
+    uint64_t tableBytes = static_cast<uint64_t>(pageCount) * entriesPerPage * sizeof(uint32_t);
+    uint64_t pageBytes = static_cast<uint64_t>(entriesPerPage) * sizeof(uint32_t);
+    maxResidentPages = static_cast<uint32_t>((std::max)(static_cast<uint64_t>(MIN_RESIDENT_PAGES), memoryLimit / pageBytes));
+
+    if (mapAll()) {
+        std::cout << "[*] FAT is mapped from the image" << std::endl;
+    }
+    else if (tableBytes <= memoryLimit) {
+        loadAll();
+    }
+    else {
+        std::cout << "[*] FAT exceeds the cache limit, using " << maxResidentPages
+            << " pages of " << (pageBytes / 1024) << " KiB" << std::endl;
+    }
+}
+
+bool FATCache::readBlock(uint64_t firstSector, uint32_t sectorCount, uint8_t* buffer) {
+    return sectorReader.readSectors(firstSector, sectorCount, buffer);
+}
+
+void FATCache::loadPage(uint32_t pageIndex, uint32_t* destination) {
+    uint64_t firstSector = static_cast<uint64_t>(pageIndex) * sectorsPerPage;
+    uint32_t sectorCount = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(sectorsPerPage), fatSectorCount - firstSector));
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(destination);
+
+    if (sectorCount < sectorsPerPage) {
+        std::memset(buffer + static_cast<uint64_t>(sectorCount) * bytesPerSector, 0xFF,
+            static_cast<uint64_t>(sectorsPerPage - sectorCount) * bytesPerSector);
+    }
+
+    if (readBlock(fatStartSector + firstSector, sectorCount, buffer)) {
+        return;
+    }
+
+    // Block read failed, salvage what is readable
+    std::vector<uint64_t> unreadableSectors;
+    sectorReader.salvageSectors(fatStartSector + firstSector, sectorCount, buffer, unreadableSectors);
+    for (uint64_t sector : unreadableSectors) {
+        std::cerr << "Error: Failed to read FAT sector " << sector << std::endl;
+        std::memset(buffer + (sector - fatStartSector - firstSector) * bytesPerSector, 0xFF, bytesPerSector);
+    }
+}
+
+void FATCache::loadAll() {
+    std::cout << "[*] Loading FAT into memory..." << std::endl;
+    entries.resize(static_cast<uint64_t>(pageCount) * entriesPerPage);
+    for (uint32_t page = 0; page < pageCount; page++) {
+        loadPage(page, entries.data() + static_cast<uint64_t>(page) * entriesPerPage);
+    }
+    residentEntries = entries.data();
+    fullyResident = true;
+}
+
+bool FATCache::mapAll() {
+    // Entries are read as aligned 32-bit values
+    mappedTable = sectorReader.mapSectors(fatStartSector, fatSectorCount);
+    if (!mappedTable || mappedTable.size < static_cast<uint64_t>(fatSectorCount) * bytesPerSector ||
+        reinterpret_cast<uintptr_t>(mappedTable.data) % alignof(uint32_t) != 0) {
+        mappedTable = {};
+        return false;
+    }
+    residentEntries = reinterpret_cast<const uint32_t*>(mappedTable.data);
+    fullyResident = true;
+    return true;
+}
+
+const uint32_t* FATCache::getPage(uint32_t pageIndex) {
+    auto it = pageLookup.find(pageIndex);
+    if (it != pageLookup.end()) {
+        // Move to the front of the LRU list
+        pages.splice(pages.begin(), pages, it->second);
+        return pages.front().entries.data();
+    }
+
+    if (pages.size() >= maxResidentPages) {
+        // Reuse the buffer of the least recently used page
+        pages.splice(pages.begin(), pages, std::prev(pages.end()));
+        pageLookup.erase(pages.front().index);
+    }
+    else {
+        pages.emplace_front();
+        pages.front().entries.resize(entriesPerPage);
+    }
+
+    Page& page = pages.front();
+    page.index = pageIndex;
+    Metrics::getInstance().add(MetricCounter::FAT_CACHE_MISSES);
+    loadPage(pageIndex, page.entries.data());
+    pageLookup[pageIndex] = pages.begin();
+    return page.entries.data();
+}
+
+bool FATCache::getEntry(uint32_t cluster, uint32_t& value) {
+    if (cluster >= entryCount) {
+        value = UNREADABLE_ENTRY;
+        return false;
+    }
+
+    Metrics::getInstance().add(MetricCounter::FAT_LOOKUPS);
+    if (fullyResident) {
+        value = residentEntries[cluster];
+    }
+    else {
+        std::lock_guard<std::mutex> lock(pageMutex);
+        value = getPage(cluster / entriesPerPage)[cluster % entriesPerPage];
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "SectorReader.h"
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+// In-memory copy of the File Allocation Table, shared by the FAT32 and exFAT engines.
+// Mapped readers expose the table in place, otherwise it is loaded fully when it fits the memory limit
+// and paged in with an LRU policy when it doesn't.
+class FATCache {
+private:
+    static constexpr uint32_t PAGE_BYTES = 1024 * 1024;      // FAT bytes loaded by a single block read
+    static constexpr uint32_t MIN_RESIDENT_PAGES = 4;        // Lower bound for the paged mode
+    static constexpr uint32_t UNREADABLE_ENTRY = 0xFFFFFFFF; // Unreadable FAT sectors are treated as end of chain
+
+    struct Page {
+        uint32_t index;
+        std::vector<uint32_t> entries;
+    };
+
+    SectorReader& sectorReader;
+    uint64_t fatStartSector;
+    uint32_t fatSectorCount;
+    uint32_t bytesPerSector;
+    uint32_t sectorsPerPage;
+    uint32_t entriesPerPage;
+    uint32_t pageCount;
+    uint32_t entryCount;
+    uint32_t maxResidentPages;
+    bool fullyResident = false;
+
+    std::vector<uint32_t> entries;      // Fully resident table
+    SectorSpan mappedTable;             // Table mapped by the reader, used instead of entries
+    const uint32_t* residentEntries = nullptr; // Either of the two above
+    std::list<Page> pages;              // Paged table, most recently used first
+    std::unordered_map<uint32_t, std::list<Page>::iterator> pageLookup;
+    std::mutex pageMutex;               // Guards the paged table, the resident table is read only
+
+    // Read consecutive FAT sectors into buffer
+    bool readBlock(uint64_t firstSector, uint32_t sectorCount, uint8_t* buffer);
+    // Load one page of FAT entries, unreadable sectors are filled with UNREADABLE_ENTRY
+    void loadPage(uint32_t pageIndex, uint32_t* destination);
+    // Get a page from the LRU list, loading it on a miss
+    const uint32_t* getPage(uint32_t pageIndex);
+    void loadAll();
+    // Use the reader's mapping of the table, false if it can't be mapped
+    bool mapAll();
+
+public:
+    FATCache(SectorReader& reader, uint64_t fatStartSector, uint32_t fatSectorCount, uint32_t bytesPerSector, uint32_t clusterCount, uint64_t memoryLimit);
+
+    // Prevent copying, the cache refers to the engine's sector reader
+    FATCache(const FATCache&) = delete;
+    FATCache& operator=(const FATCache&) = delete;
+
+    // Get the raw 32-bit FAT entry of a cluster, false if the cluster is outside the table.
+    // Safe to call from several threads.
+    bool getEntry(uint32_t cluster, uint32_t& value);
+    uint32_t getEntryCount() const { return entryCount; }
+    bool isFullyResident() const { return fullyResident; }
+};
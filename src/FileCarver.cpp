@@ -0,0 +1,262 @@
+#include "FileCarver.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+
+FileCarver::FileCarver(SectorReader& reader, const AllocationBitmap& allocationBitmap, const CarvingGeometry& geometry, Utils& utils, uint32_t firstFileId)
+    : sectorReader(reader)
+    , allocationBitmap(allocationBitmap)
+    , geometry(geometry)
+    , utils(utils)
+    , bytesPerCluster(geometry.sectorsPerCluster * geometry.bytesPerSector)
+    , carvedFolder(fs::path(config.outputFolder) / CARVED_FOLDER)
+    , nextFileId(firstFileId) {
+    if (bytesPerCluster == 0) {
+        throw std::runtime_error("Invalid cluster size for carving");
+    }
+}
+
+uint64_t FileCarver::clusterToSector(uint64_t cluster) const {
+    return geometry.firstClusterSector + (cluster - allocationBitmap.getFirstCluster()) * geometry.sectorsPerCluster;
+}
+
+uint32_t FileCarver::carveUnallocatedClusters() {
+    utils.printHeader("File Carving:");
+    ScopedTimer timer(MetricPhase::CARVING);
+
+    uint64_t allocatedClusters = allocationBitmap.countAllocated();
+    uint64_t totalFreeClusters = allocationBitmap.getClusterCount() - allocatedClusters;
+    if (allocatedClusters == 0) {
+        std::cout << "[!] No allocated clusters are known, the whole volume will be carved" << std::endl;
+    }
+
+    try {
+        fs::create_directories(carvedFolder);
+    }
+    catch (const fs::filesystem_error& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        throw std::runtime_error("Failed to create carving output directory");
+    }
+
+    uint32_t clustersPerChunk = (std::max)(1u, CARVE_CHUNK_BYTES / bytesPerCluster);
+    useMappedReads = static_cast<bool>(sectorReader.mapSectors(geometry.firstClusterSector, geometry.sectorsPerCluster));
+    uint32_t batchSize = useMappedReads ? 1u : (std::max)(1u, config.ioQueueDepth);
+    batchBuffer.resize(static_cast<uint64_t>(batchSize) * clustersPerChunk * bytesPerCluster);
+
+    std::cout << "[*] Carving " << totalFreeClusters << " free clusters..." << std::endl;
+
+    // The scan closed the found files log, carved files are appended to it
+    utils.openLogFile();
+
+    uint64_t scannedClusters = 0;
+    uint64_t cluster = allocationBitmap.getFirstCluster();
+    uint64_t length = 0;
+    while (allocationBitmap.findFreeRun(cluster, length)) {
+        carveFreeRun(cluster, length, scannedClusters, totalFreeClusters);
+        cluster += length;
+    }
+    std::cout << std::endl;
+    utils.closeFileDataLog();
+
+    batchBuffer.clear();
+    batchBuffer.shrink_to_fit();
+
+    std::wcout << "[+] Carved " << carvedFiles << " file(s) into \"" << carvedFolder.wstring() << "\"" << std::endl;
+    return carvedFiles;
+}
+
+void FileCarver::carveFreeRun(uint64_t startCluster, uint64_t length, uint64_t& scannedClusters, uint64_t totalFreeClusters) {
+    uint32_t clustersPerChunk = (std::max)(1u, CARVE_CHUNK_BYTES / bytesPerCluster);
+    uint64_t chunkBytes = static_cast<uint64_t>(clustersPerChunk) * bytesPerCluster;
+    uint32_t batchSize = static_cast<uint32_t>(batchBuffer.size() / chunkBytes);
+    std::vector<ReadRequest> batch;
+    std::vector<uint64_t> unreadableSectors;
+
+    uint64_t runOffset = 0;
+    while (runOffset < length) {
+        // Consecutive chunks of the run are submitted together
+        batch.clear();
+        for (uint32_t i = 0; i < batchSize && runOffset < length; i++) {
+            uint32_t chunkClusters = static_cast<uint32_t>((std::min)(static_cast<uint64_t>(clustersPerChunk), length - runOffset));
+            batch.push_back({ clusterToSector(startCluster + runOffset), chunkClusters * geometry.sectorsPerCluster, batchBuffer.data() + i * chunkBytes, false });
+            runOffset += chunkClusters;
+        }
+        if (!useMappedReads) {
+            sectorReader.readBatch(batch);
+        }
+
+        for (ReadRequest& request : batch) {
+            const uint8_t* chunkData = static_cast<const uint8_t*>(request.buffer);
+
+            // Mapped clusters are scanned in place
+            SectorSpan span;
+            if (useMappedReads) {
+                span = sectorReader.mapSectors(request.startSector, request.sectorCount);
+                request.success = static_cast<bool>(span);
+                if (span) chunkData = span.data;
+            }
+
+            // Salvage what is readable, unreadable sectors are zeroed
+            if (!request.success) {
+                unreadableSectors.clear();
+                sectorReader.salvageSectors(request.startSector, request.sectorCount, request.buffer, unreadableSectors);
+            }
+
+            uint64_t firstCluster = allocationBitmap.getFirstCluster() + (request.startSector - geometry.firstClusterSector) / geometry.sectorsPerCluster;
+            uint32_t clusterCount = request.sectorCount / geometry.sectorsPerCluster;
+            for (uint32_t j = 0; j < clusterCount; j++) {
+                processCluster(chunkData + static_cast<uint64_t>(j) * bytesPerCluster, firstCluster + j);
+            }
+            scannedClusters += clusterCount;
+        }
+        utils.showProgress(scannedClusters, totalFreeClusters);
+    }
+
+    // The next free cluster isn't adjacent, a file can't continue there
+    if (carve.signature) closeCarve(carve.pendingTrailingBytes > 0);
+}
+
+void FileCarver::processCluster(const uint8_t* clusterData, uint64_t cluster) {
+    if (const FileSignature* signature = matchHeader(clusterData)) {
+        // A new file starts here, so the previous one ended without its footer
+        if (carve.signature) closeCarve(carve.pendingTrailingBytes > 0);
+        openCarve(signature, cluster);
+    }
+    if (carve.signature) {
+        appendToCarve(clusterData, bytesPerCluster);
+    }
+}
+
+const FileSignature* FileCarver::matchHeader(const uint8_t* data) const {
+    const FileSignature* signature = SignatureDB::match(data, bytesPerCluster);
+    // Weak signatures would carve every cluster that happens to start with them
+    return (signature && signature->carve.maxSize > 0) ? signature : nullptr;
+}
+
+void FileCarver::openCarve(const FileSignature* signature, uint64_t cluster) {
+    std::wstring fileName = L"carved_" + std::to_wstring(cluster) + L"." + signature->extension;
+    fs::path outputPath = utils.getOutputPath(fileName, carvedFolder.wstring());
+
+    if (!carve.output.open(outputPath)) {
+        std::wcerr << "[-] Failed to create output file " << outputPath.filename() << std::endl;
+        return;
+    }
+    carve.signature = signature;
+    carve.outputPath = outputPath;
+    carve.startCluster = cluster;
+    carve.bytesWritten = 0;
+    carve.pendingTrailingBytes = 0;
+    carve.footerCarry.clear();
+    carve.hasher = std::make_unique<FileHasher>();
+}
+
+void FileCarver::appendToCarve(const uint8_t* data, uint64_t size) {
+    const CarveRule& rule = carve.signature->carve;
+    uint64_t limit = (std::min)(size, rule.maxSize - carve.bytesWritten);
+
+    // The footer was in the previous cluster, only its trailing bytes are left
+    if (carve.pendingTrailingBytes > 0) {
+        uint64_t trailingBytes = (std::min)(limit, static_cast<uint64_t>(carve.pendingTrailingBytes));
+        writeToCarve(data, trailingBytes);
+        carve.pendingTrailingBytes -= static_cast<uint32_t>(trailingBytes);
+        if (carve.pendingTrailingBytes == 0 || carve.bytesWritten >= rule.maxSize) closeCarve(true);
+        return;
+    }
+
+    uint64_t footerEnd = 0;
+    if (!rule.footer.empty() && findFooter(data, limit, footerEnd)) {
+        uint64_t fileEnd = footerEnd + rule.footerTrailingBytes;
+        uint64_t writeBytes = (std::min)(fileEnd, limit);
+        writeToCarve(data, writeBytes);
+        carve.pendingTrailingBytes = static_cast<uint32_t>(fileEnd - writeBytes);
+        if (carve.pendingTrailingBytes == 0 || carve.bytesWritten >= rule.maxSize) closeCarve(true);
+        return;
+    }
+
+    writeToCarve(data, limit);
+
+    // Keep the tail so a footer split between clusters is still found
+    size_t carryBytes = rule.footer.empty() ? 0 : rule.footer.size() - 1;
+    if (carryBytes > 0) {
+        if (limit >= carryBytes) {
+            carve.footerCarry.assign(reinterpret_cast<const char*>(data + limit - carryBytes), carryBytes);
+        }
+        else {
+            carve.footerCarry.append(reinterpret_cast<const char*>(data), limit);
+            if (carve.footerCarry.size() > carryBytes) carve.footerCarry.erase(0, carve.footerCarry.size() - carryBytes);
+        }
+    }
+
+    if (carve.bytesWritten >= rule.maxSize) closeCarve(false);
+}
+
+bool FileCarver::findFooter(const uint8_t* data, uint64_t size, uint64_t& footerEnd) const {
+    std::string_view footer = carve.signature->carve.footer;
+    std::string_view carry = carve.footerCarry;
+
+    // Footer starting in the carried bytes of the previous cluster
+    for (size_t carried = (std::min)(carry.size(), footer.size() - 1); carried > 0; carried--) {
+        size_t remaining = footer.size() - carried;
+        if (remaining <= size && carry.substr(carry.size() - carried) == footer.substr(0, carried)
+            && std::memcmp(data, footer.data() + carried, remaining) == 0) {
+            footerEnd = remaining;
+            return true;
+        }
+    }
+
+    if (size < footer.size()) return false;
+
+    // Jump between occurrences of the first footer byte
+    const uint8_t* position = data;
+    const uint8_t* lastStart = data + size - footer.size();
+    while (position <= lastStart) {
+        position = static_cast<const uint8_t*>(std::memchr(position, static_cast<uint8_t>(footer[0]), lastStart - position + 1));
+        if (!position) return false;
+        if (std::memcmp(position, footer.data(), footer.size()) == 0) {
+            footerEnd = (position - data) + footer.size();
+            return true;
+        }
+        position++;
+    }
+    return false;
+}
+
+void FileCarver::writeToCarve(const uint8_t* data, uint64_t size) {
+    carve.output.write(data, static_cast<size_t>(size));
+    if (carve.hasher->isEnabled()) carve.hasher->update(data, static_cast<size_t>(size));
+    carve.bytesWritten += size;
+}
+
+void FileCarver::closeCarve(bool isComplete) {
+    carve.output.close();
+
+    std::cout << "\n";
+    // Carved files are one run from the header on, their extension comes from the signature
+    LoggedFile file;
+    file.fileId = nextFileId++;
+    file.path = carve.outputPath.filename().wstring();
+    file.fileSize = carve.bytesWritten;
+    file.firstCluster = carve.startCluster;
+    file.extents.push_back({ carve.startCluster, (carve.bytesWritten + bytesPerCluster - 1) / bytesPerCluster, false });
+    file.isExtensionPredicted = true;
+    if (carve.hasher->isEnabled()) {
+        utils.logFileDigests(file.fileId, carve.outputPath, carve.bytesWritten, carve.bytesWritten, carve.hasher->finish());
+    }
+    utils.logFileInfo(std::move(file));
+    if (!isComplete) {
+        if (!carve.signature->carve.footer.empty()) {
+            std::cout << "  [!] No footer found, the file is probably truncated or fragmented" << std::endl;
+        }
+        else {
+            std::cout << "  [!] Format has no footer, the file is carved up to the next file or allocated cluster" << std::endl;
+        }
+    }
+    carvedFiles++;
+
+    carve.signature = nullptr;
+    carve.footerCarry.clear();
+    carve.pendingTrailingBytes = 0;
+}
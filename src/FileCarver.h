@@ -0,0 +1,78 @@
+#pragma once
+#include "FileHasher.h"
+#include "IConfigurable.h"
+#include "SectorReader.h"
+#include "AllocationBitmap.h"
+#include "Utils.h"
+#include "SignatureDB.h"
+#include "SparseFileWriter.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Where the clusters described by the allocation bitmap live on the volume
+struct CarvingGeometry {
+    uint64_t firstClusterSector;    // Sector of the bitmap's first cluster
+    uint32_t sectorsPerCluster;
+    uint32_t bytesPerSector;
+};
+
+// Streams the free clusters of a volume and carves files by their signatures.
+// Headers are matched against SignatureDB at every free cluster start, a carved file continues
+// through consecutive free clusters until its footer, its size limit or an allocated cluster.
+class FileCarver : public IConfigurable {
+private:
+    static constexpr uint32_t CARVE_CHUNK_BYTES = 4 * 1024 * 1024; // Largest single read while streaming free clusters
+    static constexpr const wchar_t* CARVED_FOLDER = L"Carved";
+
+    // File currently being written
+    struct OpenCarve {
+        const FileSignature* signature = nullptr;
+        SparseFileWriter output;
+        fs::path outputPath;
+        uint64_t startCluster = 0;
+        uint64_t bytesWritten = 0;
+        uint32_t pendingTrailingBytes = 0; // Footer was found, the trailing bytes continue in the next cluster
+        std::string footerCarry;           // Last bytes written, for footers split between clusters
+        std::unique_ptr<FileHasher> hasher;
+    };
+
+    SectorReader& sectorReader;
+    const AllocationBitmap& allocationBitmap;
+    CarvingGeometry geometry;
+    Utils& utils;
+
+    uint32_t bytesPerCluster;
+    fs::path carvedFolder;
+    OpenCarve carve;
+    std::vector<uint8_t> batchBuffer;
+    bool useMappedReads = false;  // The reader exposes clusters in place, batchBuffer is only used when mapping fails
+    uint32_t nextFileId;
+    uint32_t carvedFiles = 0;
+
+    uint64_t clusterToSector(uint64_t cluster) const;
+
+    // Stream one run of free clusters
+    void carveFreeRun(uint64_t startCluster, uint64_t length, uint64_t& scannedClusters, uint64_t totalFreeClusters);
+    void processCluster(const uint8_t* clusterData, uint64_t cluster);
+    const FileSignature* matchHeader(const uint8_t* data) const;
+
+    void openCarve(const FileSignature* signature, uint64_t cluster);
+    // Append a cluster to the open carve, the carve is closed when its footer or size limit is reached
+    void appendToCarve(const uint8_t* data, uint64_t size);
+    // Find the footer in data, including one that started in the previous cluster
+    bool findFooter(const uint8_t* data, uint64_t size, uint64_t& footerEnd) const;
+    void writeToCarve(const uint8_t* data, uint64_t size);
+    void closeCarve(bool isComplete);
+
+public:
+    FileCarver(SectorReader& reader, const AllocationBitmap& allocationBitmap, const CarvingGeometry& geometry, Utils& utils, uint32_t firstFileId);
+
+    // Carve every free cluster of the bitmap, returns the number of carved files
+    uint32_t carveUnallocatedClusters();
+};
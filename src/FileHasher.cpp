@@ -0,0 +1,470 @@
+#include "FileHasher.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+#include <immintrin.h>
+#define FILE_HASHER_USE_X64
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SHA_EXTENSIONS_TARGET
+#else
+#include <cpuid.h>
+#define SHA_EXTENSIONS_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+#endif
+
+
+namespace {
+    constexpr uint32_t SHA256_K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    // Default XXH3 secret
+    alignas(16) constexpr uint8_t XXH3_SECRET[192] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+    };
+
+    constexpr uint32_t PRIME32_1 = 0x9E3779B1U;
+    constexpr uint32_t PRIME32_2 = 0x85EBCA77U;
+    constexpr uint32_t PRIME32_3 = 0xC2B2AE3DU;
+    constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+    constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+    constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+    uint32_t readLE32(const uint8_t* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint64_t readLE64(const uint8_t* data) {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint32_t rotateRight32(uint32_t value, int bits) { return (value >> bits) | (value << (32 - bits)); }
+    uint64_t rotateLeft64(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+    uint64_t byteSwap64(uint64_t value) {
+        value = ((value & 0x00FF00FF00FF00FFULL) << 8) | ((value >> 8) & 0x00FF00FF00FF00FFULL);
+        value = ((value & 0x0000FFFF0000FFFFULL) << 16) | ((value >> 16) & 0x0000FFFF0000FFFFULL);
+        return (value << 32) | (value >> 32);
+    }
+
+    // Low and high halves of the 128 bit product folded together
+    uint64_t multiplyFold64(uint64_t a, uint64_t b) {
+#if defined(FILE_HASHER_USE_X64) && defined(_MSC_VER)
+        uint64_t high;
+        uint64_t low = _umul128(a, b, &high);
+        return low ^ high;
+#elif defined(__SIZEOF_INT128__)
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32, bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+        uint64_t lowLow = aLow * bLow, highLow = aHigh * bLow, lowHigh = aLow * bHigh, highHigh = aHigh * bHigh;
+        uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+        uint64_t upper = (highLow >> 32) + (cross >> 32) + highHigh;
+        uint64_t lower = (cross << 32) | (lowLow & 0xFFFFFFFF);
+        return lower ^ upper;
+#endif
+    }
+
+    std::string toHex(const uint8_t* data, size_t size) {
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(size * 2);
+        for (size_t i = 0; i < size; i++) {
+            hex += HEX_DIGITS[data[i] >> 4];
+            hex += HEX_DIGITS[data[i] & 0xF];
+        }
+        return hex;
+    }
+
+    /*=============== SHA-256 ===============*/
+    void compressSha256Portable(uint32_t* state, const uint8_t* data, size_t blocks) {
+        for (; blocks > 0; blocks--, data += 64) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; i++) {
+                w[i] = (static_cast<uint32_t>(data[i * 4]) << 24) | (static_cast<uint32_t>(data[i * 4 + 1]) << 16)
+                    | (static_cast<uint32_t>(data[i * 4 + 2]) << 8) | data[i * 4 + 3];
+            }
+            for (int i = 16; i < 64; i++) {
+                uint32_t s0 = rotateRight32(w[i - 15], 7) ^ rotateRight32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotateRight32(w[i - 2], 17) ^ rotateRight32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; i++) {
+                uint32_t s1 = rotateRight32(e, 6) ^ rotateRight32(e, 11) ^ rotateRight32(e, 25);
+                uint32_t choice = (e & f) ^ (~e & g);
+                uint32_t temp1 = h + s1 + choice + SHA256_K[i] + w[i];
+                uint32_t s0 = rotateRight32(a, 2) ^ rotateRight32(a, 13) ^ rotateRight32(a, 22);
+                uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+                uint32_t temp2 = s0 + majority;
+                h = g; g = f; f = e; e = d + temp1;
+                d = c; c = b; b = a; a = temp1 + temp2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+    }
+
+#ifdef FILE_HASHER_USE_X64
+    bool hasShaExtensions() {
+        // SSSE3 and SSE4.1 in leaf 1, SHA in leaf 7
+        unsigned int leaf1[4] = {}, leaf7[4] = {};
+#ifdef _MSC_VER
+        int registers[4];
+        __cpuid(registers, 0);
+        if (registers[0] < 7) return false;
+        __cpuid(registers, 1);
+        std::memcpy(leaf1, registers, sizeof(leaf1));
+        __cpuidex(registers, 7, 0);
+        std::memcpy(leaf7, registers, sizeof(leaf7));
+#else
+        if (__get_cpuid_max(0, nullptr) < 7) return false;
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+#endif
+        return (leaf1[2] & (1u << 9)) && (leaf1[2] & (1u << 19)) && (leaf7[1] & (1u << 29));
+    }
+
+    // Four rounds per step, the state is kept as ABEF and CDGH as the SHA instructions expect
+    SHA_EXTENSIONS_TARGET void compressSha256Extensions(uint32_t* state, const uint8_t* data, size_t blocks) {
+        const __m128i byteSwapMask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i temp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+        __m128i state0 = _mm_alignr_epi8(temp, state1, 8);
+        state1 = _mm_blend_epi16(state1, temp, 0xF0);
+
+        for (; blocks > 0; blocks--, data += 64) {
+            __m128i savedState0 = state0;
+            __m128i savedState1 = state1;
+            __m128i messages[4];
+
+            for (int i = 0; i < 16; i++) {
+                __m128i& words = messages[i & 3];
+                if (i < 4) {
+                    words = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byteSwapMask);
+                }
+                else {
+                    // Words t-16 to t-13 become the next four schedule words
+                    __m128i previous = messages[(i + 3) & 3];
+                    words = _mm_sha256msg1_epu32(words, messages[(i + 1) & 3]);
+                    words = _mm_add_epi32(words, _mm_alignr_epi8(previous, messages[(i + 2) & 3], 4));
+                    words = _mm_sha256msg2_epu32(words, previous);
+                }
+                __m128i roundInput = _mm_add_epi32(words, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_K[i * 4])));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, roundInput);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(roundInput, 0x0E));
+            }
+
+            state0 = _mm_add_epi32(state0, savedState0);
+            state1 = _mm_add_epi32(state1, savedState1);
+        }
+
+        temp = _mm_shuffle_epi32(state0, 0x1B);
+        state1 = _mm_shuffle_epi32(state1, 0xB1);
+        state0 = _mm_blend_epi16(temp, state1, 0xF0);
+        state1 = _mm_alignr_epi8(state1, temp, 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+    }
+#endif
+
+    void compressSha256(uint32_t* state, const uint8_t* data, size_t blocks) {
+#ifdef FILE_HASHER_USE_X64
+        static const bool useExtensions = hasShaExtensions();
+        if (useExtensions) {
+            compressSha256Extensions(state, data, blocks);
+            return;
+        }
+#endif
+        compressSha256Portable(state, data, blocks);
+    }
+
+    /*=============== XXH3 ===============*/
+    uint64_t xxh64Avalanche(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= PRIME64_2;
+        hash ^= hash >> 29;
+        hash *= PRIME64_3;
+        return hash ^ (hash >> 32);
+    }
+
+    uint64_t xxh3Avalanche(uint64_t hash) {
+        hash ^= hash >> 37;
+        hash *= PRIME_MX1;
+        return hash ^ (hash >> 32);
+    }
+
+    uint64_t mix16(const uint8_t* data, const uint8_t* secret) {
+        return multiplyFold64(readLE64(data) ^ readLE64(secret), readLE64(data + 8) ^ readLE64(secret + 8));
+    }
+
+    // Inputs of up to 240 bytes are hashed at once
+    uint64_t xxh3Short(const uint8_t* data, size_t size) {
+        const uint8_t* secret = XXH3_SECRET;
+        if (size == 0) {
+            return xxh64Avalanche(readLE64(secret + 56) ^ readLE64(secret + 64));
+        }
+        if (size <= 3) {
+            uint32_t combined = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[size >> 1]) << 24)
+                | data[size - 1] | (static_cast<uint32_t>(size) << 8);
+            uint64_t bitflip = readLE32(secret) ^ readLE32(secret + 4);
+            return xxh64Avalanche(combined ^ bitflip);
+        }
+        if (size <= 8) {
+            uint64_t input = readLE32(data + size - 4) + (static_cast<uint64_t>(readLE32(data)) << 32);
+            uint64_t hash = input ^ (readLE64(secret + 8) ^ readLE64(secret + 16));
+            hash ^= rotateLeft64(hash, 49) ^ rotateLeft64(hash, 24);
+            hash *= PRIME_MX2;
+            hash ^= (hash >> 35) + size;
+            hash *= PRIME_MX2;
+            return hash ^ (hash >> 28);
+        }
+        if (size <= 16) {
+            uint64_t low = readLE64(data) ^ (readLE64(secret + 24) ^ readLE64(secret + 32));
+            uint64_t high = readLE64(data + size - 8) ^ (readLE64(secret + 40) ^ readLE64(secret + 48));
+            return xxh3Avalanche(size + byteSwap64(low) + high + multiplyFold64(low, high));
+        }
+
+        uint64_t hash = size * PRIME64_1;
+        if (size <= 128) {
+            // Pairs of 16 byte lanes from both ends
+            size_t pairs = (size - 1) / 32 + 1;
+            for (size_t i = pairs; i-- > 0;) {
+                hash += mix16(data + i * 16, secret + i * 32);
+                hash += mix16(data + size - (i + 1) * 16, secret + i * 32 + 16);
+            }
+            return xxh3Avalanche(hash);
+        }
+
+        size_t rounds = size / 16;
+        for (size_t i = 0; i < 8; i++) {
+            hash += mix16(data + i * 16, secret + i * 16);
+        }
+        hash = xxh3Avalanche(hash);
+        for (size_t i = 8; i < rounds; i++) {
+            hash += mix16(data + i * 16, secret + (i - 8) * 16 + 3);
+        }
+        hash += mix16(data + size - 16, secret + 136 - 17);
+        return xxh3Avalanche(hash);
+    }
+
+    // One 64 byte stripe into the eight accumulators
+    void accumulateStripe(uint64_t* accumulators, const uint8_t* data, const uint8_t* secret) {
+#ifdef FILE_HASHER_USE_X64
+        __m128i* lanes = reinterpret_cast<__m128i*>(accumulators);
+        for (int i = 0; i < 4; i++) {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16));
+            __m128i keyed = _mm_xor_si128(input, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret + i * 16)));
+            __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m128i swapped = _mm_shuffle_epi32(input, _MM_SHUFFLE(1, 0, 3, 2));
+            lanes[i] = _mm_add_epi64(product, _mm_add_epi64(lanes[i], swapped));
+        }
+#else
+        for (int i = 0; i < 8; i++) {
+            uint64_t input = readLE64(data + i * 8);
+            uint64_t keyed = input ^ readLE64(secret + i * 8);
+            accumulators[i ^ 1] += input;
+            accumulators[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+        }
+#endif
+    }
+
+    void scrambleAccumulators(uint64_t* accumulators, const uint8_t* secret) {
+        for (int i = 0; i < 8; i++) {
+            uint64_t accumulator = accumulators[i];
+            accumulator ^= accumulator >> 47;
+            accumulator ^= readLE64(secret + i * 8);
+            accumulators[i] = accumulator * PRIME32_1;
+        }
+    }
+}
+
+
+Sha256::Sha256()
+    : state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 } {}
+
+void Sha256::update(const uint8_t* data, size_t size) {
+    totalBytes += size;
+    if (blockBytes > 0) {
+        size_t fill = (std::min)(size, BLOCK_BYTES - blockBytes);
+        std::memcpy(block.data() + blockBytes, data, fill);
+        blockBytes += fill;
+        data += fill;
+        size -= fill;
+        if (blockBytes < BLOCK_BYTES) return;
+        compressSha256(state.data(), block.data(), 1);
+        blockBytes = 0;
+    }
+
+    // Whole blocks straight from the caller's buffer
+    size_t blocks = size / BLOCK_BYTES;
+    if (blocks > 0) {
+        compressSha256(state.data(), data, blocks);
+        data += blocks * BLOCK_BYTES;
+        size -= blocks * BLOCK_BYTES;
+    }
+    std::memcpy(block.data(), data, size);
+    blockBytes = size;
+}
+
+std::array<uint8_t, 32> Sha256::finish() {
+    uint64_t totalBits = totalBytes * 8;
+    block[blockBytes++] = 0x80;
+    if (blockBytes > BLOCK_BYTES - 8) {
+        std::memset(block.data() + blockBytes, 0, BLOCK_BYTES - blockBytes);
+        compressSha256(state.data(), block.data(), 1);
+        blockBytes = 0;
+    }
+    std::memset(block.data() + blockBytes, 0, BLOCK_BYTES - 8 - blockBytes);
+    for (int i = 0; i < 8; i++) {
+        block[BLOCK_BYTES - 1 - i] = static_cast<uint8_t>(totalBits >> (i * 8));
+    }
+    compressSha256(state.data(), block.data(), 1);
+
+    std::array<uint8_t, 32> digest;
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+
+Xxh3::Xxh3()
+    : accumulators{ PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 } {}
+
+void Xxh3::consumeStripes(const uint8_t* data, size_t stripes) {
+    // The accumulators are scrambled after every block of STRIPES_PER_BLOCK stripes
+    while (stripes > 0) {
+        size_t count = (std::min)(stripes, STRIPES_PER_BLOCK - stripesInBlock);
+        for (size_t i = 0; i < count; i++) {
+            accumulateStripe(accumulators.data(), data + i * STRIPE_BYTES, XXH3_SECRET + (stripesInBlock + i) * 8);
+        }
+        data += count * STRIPE_BYTES;
+        stripes -= count;
+        stripesInBlock += count;
+        if (stripesInBlock == STRIPES_PER_BLOCK) {
+            scrambleAccumulators(accumulators.data(), XXH3_SECRET + SECRET_BYTES - STRIPE_BYTES);
+            stripesInBlock = 0;
+        }
+    }
+}
+
+void Xxh3::update(const uint8_t* data, size_t size) {
+    totalBytes += size;
+    if (size <= BUFFER_BYTES - bufferedBytes) {
+        std::memcpy(buffer.data() + bufferedBytes, data, size);
+        bufferedBytes += size;
+        return;
+    }
+
+    if (bufferedBytes > 0) {
+        size_t fill = BUFFER_BYTES - bufferedBytes;
+        std::memcpy(buffer.data() + bufferedBytes, data, fill);
+        data += fill;
+        size -= fill;
+        consumeStripes(buffer.data(), BUFFER_BYTES / STRIPE_BYTES);
+        bufferedBytes = 0;
+    }
+
+    // At least one byte is always kept back, the last stripe is hashed differently by finish
+    if (size > BUFFER_BYTES) {
+        size_t stripes = (size - 1) / STRIPE_BYTES;
+        consumeStripes(data, stripes);
+        data += stripes * STRIPE_BYTES;
+        size -= stripes * STRIPE_BYTES;
+        // finish may need the end of the last consumed stripe
+        std::memcpy(buffer.data() + BUFFER_BYTES - STRIPE_BYTES, data - STRIPE_BYTES, STRIPE_BYTES);
+    }
+    std::memcpy(buffer.data(), data, size);
+    bufferedBytes = size;
+}
+
+uint64_t Xxh3::finish() {
+    if (totalBytes <= 240) {
+        return xxh3Short(buffer.data(), static_cast<size_t>(totalBytes));
+    }
+
+    const uint8_t* lastStripe;
+    alignas(16) uint8_t joinedStripe[STRIPE_BYTES];
+    if (bufferedBytes >= STRIPE_BYTES) {
+        consumeStripes(buffer.data(), (bufferedBytes - 1) / STRIPE_BYTES);
+        lastStripe = buffer.data() + bufferedBytes - STRIPE_BYTES;
+    }
+    else {
+        // The last stripe starts in the previously consumed data
+        size_t carried = STRIPE_BYTES - bufferedBytes;
+        std::memcpy(joinedStripe, buffer.data() + BUFFER_BYTES - carried, carried);
+        std::memcpy(joinedStripe + carried, buffer.data(), bufferedBytes);
+        lastStripe = joinedStripe;
+    }
+    accumulateStripe(accumulators.data(), lastStripe, XXH3_SECRET + SECRET_BYTES - STRIPE_BYTES - 7);
+
+    uint64_t hash = totalBytes * PRIME64_1;
+    for (int i = 0; i < 4; i++) {
+        const uint8_t* secret = XXH3_SECRET + 11 + i * 16;
+        hash += multiplyFold64(accumulators[i * 2] ^ readLE64(secret), accumulators[i * 2 + 1] ^ readLE64(secret + 8));
+    }
+    return xxh3Avalanche(hash);
+}
+
+
+FileHasher::FileHasher()
+    : IConfigurable()
+    , useSha256(config.hashSha256)
+    , useXxh3(config.hashXxh3) {}
+
+void FileHasher::update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (useSha256) sha256.update(bytes, size);
+    if (useXxh3) xxh3.update(bytes, size);
+}
+
+FileDigests FileHasher::finish() {
+    FileDigests digests;
+    if (useSha256) {
+        std::array<uint8_t, 32> digest = sha256.finish();
+        digests.sha256 = toHex(digest.data(), digest.size());
+    }
+    if (useXxh3) {
+        // Written big endian like xxhsum does
+        uint64_t hash = xxh3.finish();
+        uint8_t digest[8];
+        for (int i = 0; i < 8; i++) digest[i] = static_cast<uint8_t>(hash >> (56 - i * 8));
+        digests.xxh3 = toHex(digest, sizeof(digest));
+    }
+    return digests;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "IConfigurable.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hex digests of a recovered file, empty for algorithms that weren't enabled
+struct FileDigests {
+    std::string sha256;
+    std::string xxh3;
+
+    bool empty() const { return sha256.empty() && xxh3.empty(); }
+};
+
+// Streaming SHA-256, uses the SHA extensions when the CPU has them
+class Sha256 {
+private:
+    static constexpr size_t BLOCK_BYTES = 64;
+
+    std::array<uint32_t, 8> state;
+    std::array<uint8_t, BLOCK_BYTES> block{};
+    size_t blockBytes = 0;
+    uint64_t totalBytes = 0;
+
+public:
+    Sha256();
+    void update(const uint8_t* data, size_t size);
+    std::array<uint8_t, 32> finish();
+};
+
+// Streaming XXH3 64 bit hash with the default secret and seed 0, same digest as xxhsum -H3
+class Xxh3 {
+private:
+    static constexpr size_t STRIPE_BYTES = 64;
+    static constexpr size_t BUFFER_BYTES = 256;  // Input kept back until more than this arrives
+    static constexpr size_t SECRET_BYTES = 192;
+    static constexpr size_t STRIPES_PER_BLOCK = (SECRET_BYTES - STRIPE_BYTES) / 8;
+
+    alignas(16) std::array<uint64_t, 8> accumulators;
+    alignas(16) std::array<uint8_t, BUFFER_BYTES> buffer{};
+    size_t bufferedBytes = 0;
+    size_t stripesInBlock = 0; // Stripes of the current block already accumulated
+    uint64_t totalBytes = 0;
+
+    void consumeStripes(const uint8_t* data, size_t stripes);
+
+public:
+    Xxh3();
+    void update(const uint8_t* data, size_t size);
+    uint64_t finish();
+};
+
+// Hashes a file with the algorithms enabled in the config while it's written.
+// Every enabled algorithm sees the same bytes, in the order they are written to the output file.
+class FileHasher : public IConfigurable {
+private:
+    bool useSha256;
+    bool useXxh3;
+    Sha256 sha256;
+    Xxh3 xxh3;
+
+public:
+    FileHasher();
+
+    // True if any algorithm is enabled
+    bool isEnabled() const { return useSha256 || useXxh3; }
+    void update(const void* data, size_t size);
+    // Digests of everything passed to update
+    FileDigests finish();
+};
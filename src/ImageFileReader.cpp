@@ -0,0 +1,278 @@
+#ifdef _WIN32
+#include "ImageFileReader.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+namespace {
+    // A failed page-in of the image raises an in-page exception instead of returning an error
+    bool copyFromView(void* destination, const void* source, size_t size) {
+#ifdef _MSC_VER
+        __try {
+            std::memcpy(destination, source, size);
+        }
+        __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+            return false;
+        }
+        return true;
+#else
+        std::memcpy(destination, source, size);
+        return true;
+#endif
+    }
+
+    // Images on network shares and removable media fail more often than local disks, their pages are only copied
+    bool isOnFixedVolume(const std::wstring& path) {
+        wchar_t volumePath[MAX_PATH + 1] = {};
+        if (!GetVolumePathNameW(path.c_str(), volumePath, MAX_PATH + 1)) {
+            return false;
+        }
+        return GetDriveTypeW(volumePath) == DRIVE_FIXED;
+    }
+}
+
+
+ImageFileReader::MappedView::~MappedView() {
+    if (base) {
+        UnmapViewOfFile(base);
+    }
+}
+
+ImageFileReader::ImageFileReader(const std::wstring& path, uint64_t partitionOffset, uint64_t partitionSectors, uint32_t bytesPerSector)
+    : hFile(INVALID_HANDLE_VALUE)
+    , hMapping(NULL)
+    , imagePath(path)
+    , partitionOffset(partitionOffset)
+    , partitionSectors(partitionSectors)
+    , bytesPerSector(bytesPerSector) {
+    SYSTEM_INFO systemInfo = {};
+    GetSystemInfo(&systemInfo);
+    allocationGranularity = (std::max)(static_cast<uint32_t>(systemInfo.dwAllocationGranularity), 1u);
+
+    if (!openImage()) {
+        throw std::runtime_error("Failed to open image file. Please make sure the path is correct and the file isn't empty.");
+    }
+}
+
+ImageFileReader::~ImageFileReader() {
+    close();
+}
+
+bool ImageFileReader::openImage() {
+    close(); // Ensure any existing handle is closed
+
+    hFile = CreateFileW(
+        imagePath.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart <= 0) {
+        close();
+        return false;
+    }
+    imageBytes = static_cast<uint64_t>(fileSize.QuadPart);
+
+    // Views keep the mapping alive, spans stay valid even after the reader is closed
+    hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL) {
+        close();
+        return false;
+    }
+    mapsSectors = isOnFixedVolume(imagePath);
+    return true;
+}
+
+bool ImageFileReader::reopen() {
+    return openImage();
+}
+
+void ImageFileReader::close() {
+    {
+        std::lock_guard<std::mutex> lock(viewMutex);
+        views.clear();
+    }
+    if (hMapping != NULL) {
+        CloseHandle(hMapping);
+        hMapping = NULL;
+    }
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+        hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool ImageFileReader::isInPartition(uint64_t sector, uint64_t count) {
+    uint64_t totalSectors = getTotalSectors();
+    return sector < totalSectors && count <= totalSectors - sector;
+}
+
+std::shared_ptr<ImageFileReader::MappedView> ImageFileReader::mapView(uint64_t offset, uint64_t length) const {
+    if (offset >= imageBytes) {
+        return nullptr;
+    }
+
+    // Views have to start on the allocation granularity
+    uint64_t alignedOffset = offset - (offset % allocationGranularity);
+    uint64_t viewBytes = (std::min)(offset + length, imageBytes) - alignedOffset;
+    if (viewBytes > SIZE_MAX) {
+        return nullptr;
+    }
+
+    const void* base = MapViewOfFile(hMapping, FILE_MAP_READ,
+        static_cast<DWORD>(alignedOffset >> 32), static_cast<DWORD>(alignedOffset & 0xFFFFFFFF), static_cast<SIZE_T>(viewBytes));
+    if (!base) {
+        return nullptr;
+    }
+
+    auto view = std::make_shared<MappedView>();
+    view->base = static_cast<const uint8_t*>(base);
+    view->offset = alignedOffset;
+    view->size = viewBytes;
+    return view;
+}
+
+std::shared_ptr<ImageFileReader::MappedView> ImageFileReader::getView(uint64_t offset, uint64_t length) {
+    std::lock_guard<std::mutex> lock(viewMutex);
+    if (hMapping == NULL) {
+        return nullptr;
+    }
+
+    // Windows overlap their successor, so a range never needs two of them
+    uint64_t windowIndex = offset / VIEW_BYTES;
+    uint64_t windowStart = windowIndex * VIEW_BYTES;
+    if (offset + length > windowStart + VIEW_BYTES + VIEW_OVERLAP_BYTES) {
+        return mapView(offset, length);
+    }
+
+    auto it = std::find_if(views.begin(), views.end(), [windowIndex](const auto& entry) {
+        return entry.first == windowIndex;
+    });
+    if (it != views.end()) {
+        // Move to the front of the LRU list
+        views.splice(views.begin(), views, it);
+        return views.front().second;
+    }
+
+    std::shared_ptr<MappedView> view = mapView(windowStart, VIEW_BYTES + VIEW_OVERLAP_BYTES);
+    if (!view) {
+        return nullptr;
+    }
+    // Evicted windows are unmapped once no span refers to them
+    if (views.size() >= MAX_CACHED_VIEWS) {
+        views.pop_back();
+    }
+    views.emplace_front(windowIndex, view);
+    return view;
+}
+
+bool ImageFileReader::readBytes(uint64_t byteOffset, uint64_t length, void* buffer) {
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    uint64_t imageOffset = partitionOffset * bytesPerSector + byteOffset;
+    uint64_t requestedBytes = length;
+
+    // Copies out of the mapping are timed like device reads
+    auto start = std::chrono::steady_clock::now();
+    auto finish = [&](bool success) {
+        Metrics::getInstance().recordRead(requestedBytes, start, success);
+        if (success) Metrics::getInstance().add(MetricCounter::SECTORS_READ, (requestedBytes + bytesPerSector - 1) / bytesPerSector);
+        return success;
+    };
+
+    while (length > 0) {
+        uint64_t piece = (std::min)(length, VIEW_OVERLAP_BYTES);
+        std::shared_ptr<MappedView> view = getView(imageOffset, piece);
+        if (!view || imageOffset + piece > view->offset + view->size) {
+            return finish(false);
+        }
+        if (!copyFromView(output, view->base + (imageOffset - view->offset), static_cast<size_t>(piece))) {
+            return finish(false);
+        }
+        output += piece;
+        imageOffset += piece;
+        length -= piece;
+    }
+    return finish(true);
+}
+
+bool ImageFileReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    if (!isOpen() && !reopen()) {
+        return false;
+    }
+    if (!isInPartition(sector, (static_cast<uint64_t>(size) + bytesPerSector - 1) / bytesPerSector)) {
+        return false;
+    }
+    return readBytes(sector * bytesPerSector, size, buffer);
+}
+
+bool ImageFileReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    if (!isOpen() && !reopen()) {
+        return false;
+    }
+    if (!isInPartition(startSector, count)) {
+        return false;
+    }
+    return readBytes(startSector * bytesPerSector, static_cast<uint64_t>(count) * bytesPerSector, buffer);
+}
+
+bool ImageFileReader::readRange(uint64_t byteOffset, uint64_t length, void* buffer) {
+    if (!isOpen() && !reopen()) {
+        return false;
+    }
+    // The mapping is byte addressable, no bounce buffer is needed
+    uint64_t firstSector = byteOffset / bytesPerSector;
+    uint64_t lastSector = (byteOffset + length + bytesPerSector - 1) / bytesPerSector;
+    if (!isInPartition(firstSector, lastSector - firstSector)) {
+        return false;
+    }
+    return readBytes(byteOffset, length, buffer);
+}
+
+SectorSpan ImageFileReader::mapSectors(uint64_t startSector, uint32_t count) {
+    if (!isOpen() || !mapsSectors || count == 0 || !isInPartition(startSector, count)) {
+        return {};
+    }
+
+    uint64_t imageOffset = (partitionOffset + startSector) * bytesPerSector;
+    uint64_t length = static_cast<uint64_t>(count) * bytesPerSector;
+    std::shared_ptr<MappedView> view = getView(imageOffset, length);
+    if (!view || imageOffset + length > view->offset + view->size) {
+        return {};
+    }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ, count);
+    Metrics::getInstance().add(MetricCounter::BYTES_MAPPED, length);
+    return { view->base + (imageOffset - view->offset), length, view };
+}
+
+uint64_t ImageFileReader::getTotalSectors() {
+    if (partitionSectors != 0) {
+        return partitionSectors;
+    }
+    uint64_t imageSectors = imageBytes / bytesPerSector;
+    return imageSectors > partitionOffset ? imageSectors - partitionOffset : 0;
+}
+
+std::wstring ImageFileReader::getFilesystemType() {
+    std::vector<uint8_t> bootSector(bytesPerSector);
+    if (!readSector(0, bootSector.data(), bytesPerSector)) {
+        return L"UNKNOWN_TYPE";
+    }
+    return detectFilesystem(bootSector.data());
+}
+
+uint64_t ImageFileReader::getTotalMftRecords() {
+    // There is no volume to query, the MFT layout is read from record 0 instead
+    return 0;
+}
+#endif // _WIN32
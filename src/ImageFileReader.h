@@ -0,0 +1,75 @@
+#pragma once
+#include "SectorReader.h"
+#include <cstdint>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <windows.h>
+
+// Reader for raw disk or volume images (.dd, .img), sectors are relative to partitionOffset.
+// The image is memory mapped through sliding views, it doesn't need administrator rights
+// and the engines can parse mapped sectors in place instead of copying them. Reads copy out of the
+// views and catch in-page errors, sectors are only mapped for callers when the image is on a fixed volume.
+class ImageFileReader : public SectorReader {
+private:
+    static constexpr uint32_t DEFAULT_SECTOR_BYTES = 512;                // Raw images carry no geometry
+    static constexpr uint64_t VIEW_BYTES = 64ull * 1024 * 1024;         // Stride of the cached views
+    static constexpr uint64_t VIEW_OVERLAP_BYTES = 16ull * 1024 * 1024; // Ranges up to this size never straddle two cached views
+    static constexpr size_t MAX_CACHED_VIEWS = sizeof(void*) == 8 ? 16 : 4; // Bounds the address space held by the cache
+
+    // One mapped window of the image, unmapped when the last span using it is gone
+    struct MappedView {
+        const uint8_t* base = nullptr;
+        uint64_t offset = 0; // Image byte offset of base
+        uint64_t size = 0;
+
+        MappedView() = default;
+        MappedView(const MappedView&) = delete;
+        MappedView& operator=(const MappedView&) = delete;
+        ~MappedView();
+    };
+
+    HANDLE hFile;
+    HANDLE hMapping;
+    std::wstring imagePath;
+    uint64_t imageBytes = 0;
+    uint64_t partitionOffset;  // First sector of the partition in the image
+    uint64_t partitionSectors; // 0 = up to the end of the image
+    uint32_t bytesPerSector;   // Found by the drive handler from the partition table or the boot sector
+    uint32_t allocationGranularity = 0;
+    bool mapsSectors = false;  // Spans are only handed out for images on a local fixed volume
+
+    std::list<std::pair<uint64_t, std::shared_ptr<MappedView>>> views; // By window index, most recently used first
+    std::mutex viewMutex; // Guards the view cache, engines read from several threads
+
+    bool openImage();
+    bool isInPartition(uint64_t sector, uint64_t count);
+    // Map length bytes at an image offset, nullptr on failure
+    std::shared_ptr<MappedView> mapView(uint64_t offset, uint64_t length) const;
+    // Cached window holding the range, or a dedicated view for ranges that don't fit one
+    std::shared_ptr<MappedView> getView(uint64_t offset, uint64_t length);
+    // Copy length bytes starting at a partition relative byte offset
+    bool readBytes(uint64_t byteOffset, uint64_t length, void* buffer);
+
+public:
+    ImageFileReader(const std::wstring& imagePath, uint64_t partitionOffset = 0, uint64_t partitionSectors = 0, uint32_t bytesPerSector = DEFAULT_SECTOR_BYTES);
+    ~ImageFileReader() override;
+
+    // Delete copy constructor and assignment to prevent handle duplication
+    ImageFileReader(const ImageFileReader&) = delete;
+    ImageFileReader& operator=(const ImageFileReader&) = delete;
+
+    // Implement SectorReader interface
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    bool readRange(uint64_t byteOffset, uint64_t length, void* buffer) override;
+    SectorSpan mapSectors(uint64_t startSector, uint32_t count) override;
+    uint64_t getTotalSectors() override;
+    uint32_t getBytesPerSector() override { return bytesPerSector; }
+    std::wstring getFilesystemType() override;
+    uint64_t getTotalMftRecords() override;
+    bool isOpen() const override { return hMapping != NULL; }
+    bool reopen() override;
+    void close() override;
+};
@@ -1,5 +1,7 @@
+#ifdef _WIN32
 #pragma once
 #include "LogicalDriveReader.h"
+#include "Metrics.h"
 #include "SectorReader.h"
 
 
@@ -17,7 +19,8 @@ LogicalDriveReader::~LogicalDriveReader() {
 
 LogicalDriveReader::LogicalDriveReader(LogicalDriveReader&& other) noexcept
     : hDrive(other.hDrive)
-    , drivePath(std::move(other.drivePath)) {
+    , drivePath(std::move(other.drivePath))
+    , bytesPerSector(other.bytesPerSector) {
     other.hDrive = INVALID_HANDLE_VALUE;
 }
 
@@ -26,6 +29,7 @@ LogicalDriveReader& LogicalDriveReader::operator=(LogicalDriveReader&& other) no
         close();
         hDrive = other.hDrive;
         drivePath = std::move(other.drivePath);
+        bytesPerSector = other.bytesPerSector;
         other.hDrive = INVALID_HANDLE_VALUE;
     }
     return *this;
@@ -65,6 +69,19 @@ void LogicalDriveReader::close() {
     }
 }
 
+bool LogicalDriveReader::readAt(uint64_t byteOffset, uint32_t length, void* buffer) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(byteOffset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(byteOffset >> 32);
+    DWORD bytesRead;
+
+    // The offset in OVERLAPPED replaces SetFilePointerEx on synchronous handles
+    auto start = std::chrono::steady_clock::now();
+    bool success = ReadFile(hDrive, buffer, length, &bytesRead, &overlapped) && bytesRead == length;
+    Metrics::getInstance().recordRead(length, start, success);
+    return success;
+}
+
 bool LogicalDriveReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
     if (!isOpen()) {
         if (!reopen()) {
@@ -72,24 +89,47 @@ bool LogicalDriveReader::readSector(uint64_t sector, void* buffer, uint32_t size
         }
     }
 
-    LARGE_INTEGER offset;
-    offset.QuadPart = sector * size;
-    DWORD bytesRead;
-
-    // Set file pointer to sector offset
-    if (!SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN)) {
+    if (!readAt(sector * size, size, buffer)) {
         return false;
     }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ);
+    return true;
+}
+
+bool LogicalDriveReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
 
-    // Read the sector
-    if (!ReadFile(hDrive, buffer, size, &bytesRead, NULL) || bytesRead != size) {
+    uint32_t sectorSize = getBytesPerSector();
+    if (sectorSize == 0) {
         return false;
     }
 
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    uint64_t byteOffset = startSector * sectorSize;
+    uint64_t remaining = static_cast<uint64_t>(count) * sectorSize;
+    uint32_t maxChunk = MAX_TRANSFER_BYTES - (MAX_TRANSFER_BYTES % sectorSize);
+
+    while (remaining > 0) {
+        uint32_t chunk = static_cast<uint32_t>((std::min)(remaining, static_cast<uint64_t>(maxChunk)));
+        if (!readAt(byteOffset, chunk, output)) {
+            return false;
+        }
+        output += chunk;
+        byteOffset += chunk;
+        remaining -= chunk;
+    }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ, count);
     return true;
 }
 
 uint32_t LogicalDriveReader::getBytesPerSector() {
+    if (bytesPerSector != 0) {
+        return bytesPerSector;
+    }
     if (!isOpen()) {
         if (!reopen()) {
             return 0;
@@ -103,7 +143,8 @@ uint32_t LogicalDriveReader::getBytesPerSector() {
         return 0;
     }
 
-    return dg.BytesPerSector;
+    bytesPerSector = dg.BytesPerSector;
+    return bytesPerSector;
 }
 
 std::wstring LogicalDriveReader::getFilesystemType() {
@@ -153,4 +194,5 @@ uint64_t LogicalDriveReader::getTotalMftRecords() {
     }
 
     return nvdb.MftValidDataLength.QuadPart / nvdb.BytesPerFileRecordSegment;
-}
\ No newline at end of file
+}
+#endif // _WIN32
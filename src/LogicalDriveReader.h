@@ -9,9 +9,14 @@
 
 class LogicalDriveReader : public SectorReader {
 private:
+    static constexpr uint32_t MAX_TRANSFER_BYTES = 16 * 1024 * 1024; // Largest single ReadFile request
+
     HANDLE hDrive;
     std::wstring drivePath;
+    uint32_t bytesPerSector = 0; // Cached drive geometry
     bool openDrive();
+    // Positional read that doesn't depend on the shared file pointer
+    bool readAt(uint64_t byteOffset, uint32_t length, void* buffer);
 public:
     explicit LogicalDriveReader(const std::wstring& drivePath);
     ~LogicalDriveReader() override;
@@ -26,6 +31,7 @@ public:
 
     // Implement SectorReader interface
     bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
     uint32_t getBytesPerSector() override;
     std::wstring getFilesystemType() override;
     uint64_t getTotalMftRecords() override;
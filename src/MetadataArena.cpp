@@ -0,0 +1,57 @@
+#include "MetadataArena.h"
+#include <algorithm>
+
+
+void* MetadataArena::allocate(size_t bytes, size_t alignment) {
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+    if (cursor == nullptr || padding + bytes > remaining) {
+        if (bytes + alignment > MAX_BLOCK_BYTES) {
+            // Oversized values keep the current block for the small ones that follow
+            blocks.push_back(std::make_unique<uint8_t[]>(bytes + alignment));
+            uint8_t* block = blocks.back().get();
+            usedBytes += bytes;
+            return block + (alignment - reinterpret_cast<uintptr_t>(block) % alignment) % alignment;
+        }
+        while (nextBlockBytes < bytes + alignment) nextBlockBytes *= 2;
+        blocks.push_back(std::make_unique<uint8_t[]>(nextBlockBytes));
+        cursor = blocks.back().get();
+        remaining = nextBlockBytes;
+        nextBlockBytes = (std::min)(nextBlockBytes * 2, MAX_BLOCK_BYTES);
+        padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+    }
+
+    uint8_t* result = cursor + padding;
+    cursor += padding + bytes;
+    remaining -= padding + bytes;
+    usedBytes += bytes;
+    return result;
+}
+
+std::wstring_view MetadataArena::internName(std::wstring_view name) {
+    if (name.empty()) return {};
+
+    auto it = names.find(name);
+    if (it != names.end()) {
+        return *it;
+    }
+    std::span<const wchar_t> stored = store(name.data(), name.size());
+    std::wstring_view view(stored.data(), stored.size());
+    names.insert(view);
+    return view;
+}
+
+void MetadataArena::adopt(MetadataArena& other) {
+    // The other arena's free space is given up, its partly used block stays with the rest
+    blocks.insert(blocks.end(), std::make_move_iterator(other.blocks.begin()), std::make_move_iterator(other.blocks.end()));
+    usedBytes += other.usedBytes;
+
+    other.blocks.clear();
+    other.cursor = nullptr;
+    other.remaining = 0;
+    other.usedBytes = 0;
+    other.names.clear();
+}
+
+void MetadataArena::releaseInternTable() {
+    std::unordered_set<std::wstring_view>().swap(names);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+// Bump allocator for scan results, file entries keep views into it instead of owning strings and buffers.
+// Memory is handed out from large blocks that never move, so views stay valid as long as the arena lives.
+// Names are interned, a name seen before is stored only once.
+class MetadataArena {
+private:
+    static constexpr size_t MIN_BLOCK_BYTES = 4 * 1024;    // Small arenas of MFT chunks stay small
+    static constexpr size_t MAX_BLOCK_BYTES = 1024 * 1024; // Larger requests get a block of their own
+
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    size_t nextBlockBytes = MIN_BLOCK_BYTES; // Doubles with every block
+    uint8_t* cursor = nullptr;
+    size_t remaining = 0;
+    uint64_t usedBytes = 0;
+    std::unordered_set<std::wstring_view> names; // Views into the blocks
+
+    void* allocate(size_t bytes, size_t alignment);
+
+public:
+    MetadataArena() = default;
+    MetadataArena(MetadataArena&&) = default;
+    MetadataArena& operator=(MetadataArena&&) = default;
+
+    // Prevent copying, entries point into the blocks
+    MetadataArena(const MetadataArena&) = delete;
+    MetadataArena& operator=(const MetadataArena&) = delete;
+
+    // Stored copy of the name, the same view for every equal name
+    std::wstring_view internName(std::wstring_view name);
+
+    // Stored copy of count plain values
+    template <typename T>
+    std::span<const T> store(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be stored");
+        if (count == 0) return {};
+        T* copy = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        std::memcpy(copy, values, count * sizeof(T));
+        return { copy, count };
+    }
+
+    // Take over the blocks of an arena filled by a worker, views into it stay valid
+    void adopt(MetadataArena& other);
+    // Drop the intern table once no more names are added, the stored names are kept
+    void releaseInternTable();
+
+    uint64_t getUsedBytes() const { return usedBytes; }
+};
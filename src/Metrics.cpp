@@ -0,0 +1,155 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+Metrics::Metrics()
+    : startTime(std::chrono::steady_clock::now())
+    , lastStatusTime(startTime) {}
+
+void Metrics::recordRead(uint64_t bytes, std::chrono::steady_clock::time_point start, bool success) {
+    uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    size_t bucket = (std::min)(static_cast<size_t>(std::bit_width(nanoseconds / 1000)), LATENCY_BUCKETS - 1);
+
+    latencyBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    totalReadNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    add(MetricCounter::READ_REQUESTS);
+    if (success) add(MetricCounter::BYTES_READ, bytes);
+    else add(MetricCounter::READ_FAILURES);
+}
+
+void Metrics::addPhaseTime(MetricPhase phase, std::chrono::steady_clock::duration elapsed) {
+    uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    phaseNanoseconds[static_cast<size_t>(phase)].fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+double Metrics::getPhaseSeconds(MetricPhase phase) const {
+    return phaseNanoseconds[static_cast<size_t>(phase)].load(std::memory_order_relaxed) / 1e9;
+}
+
+void Metrics::showStatus(uint64_t current, uint64_t total, bool force) {
+    bool finished = force || current >= total;
+    auto now = std::chrono::steady_clock::now();
+
+    // Workers that find the line being printed skip it instead of waiting for the console
+    std::unique_lock<std::mutex> lock(statusMutex, std::defer_lock);
+    if (finished) lock.lock();
+    else if (!lock.try_lock() || now - lastStatusTime < STATUS_INTERVAL) return;
+
+    uint64_t bytes = get(MetricCounter::BYTES_READ) + get(MetricCounter::BYTES_MAPPED);
+    double seconds = std::chrono::duration<double>(now - lastStatusTime).count();
+    double megabytesPerSecond = seconds > 0 ? (bytes - lastStatusBytes) / seconds / (1024 * 1024) : 0;
+    double progress = total > 0 ? static_cast<double>(current) / total * 100 : 100;
+
+    std::cout << "\r[*] Progress: " << std::setw(6) << std::fixed << std::setprecision(2) << progress << "%"
+        << " | " << std::setw(8) << std::setprecision(1) << megabytesPerSecond << " MB/s"
+        << " | " << get(MetricCounter::FILES_RECOVERED) << " files recovered   " << std::flush;
+
+    lastStatusTime = now;
+    lastStatusBytes = bytes;
+}
+
+const char* Metrics::getCounterName(MetricCounter counter) {
+    switch (counter) {
+    case MetricCounter::SECTORS_READ: return "sectorsRead";
+    case MetricCounter::BYTES_READ: return "bytesRead";
+    case MetricCounter::BYTES_MAPPED: return "bytesMapped";
+    case MetricCounter::READ_REQUESTS: return "readRequests";
+    case MetricCounter::READ_FAILURES: return "readFailures";
+    case MetricCounter::BAD_SECTORS: return "badSectors";
+    case MetricCounter::SECTORS_SKIPPED: return "sectorsSkipped";
+    case MetricCounter::FAT_LOOKUPS: return "fatLookups";
+    case MetricCounter::FAT_CACHE_MISSES: return "fatCacheMisses";
+    case MetricCounter::BLOCK_CACHE_LOOKUPS: return "blockCacheLookups";
+    case MetricCounter::BLOCK_CACHE_MISSES: return "blockCacheMisses";
+    case MetricCounter::BLOCKS_READ_AHEAD: return "blocksReadAhead";
+    case MetricCounter::DIRECTORIES_SCANNED: return "directoriesScanned";
+    case MetricCounter::DIRECTORY_ENTRIES: return "directoryEntries";
+    case MetricCounter::MFT_RECORDS: return "mftRecords";
+    case MetricCounter::FILES_RECOVERED: return "filesRecovered";
+    case MetricCounter::BYTES_RECOVERED: return "bytesRecovered";
+    case MetricCounter::SPARSE_BYTES: return "sparseBytes";
+    case MetricCounter::FILES_SCORED: return "filesScored";
+    default: return "unknown";
+    }
+}
+
+const char* Metrics::getPhaseName(MetricPhase phase) {
+    switch (phase) {
+    case MetricPhase::SCAN: return "scan";
+    case MetricPhase::SCAN_INDEX: return "scanIndex";
+    case MetricPhase::RECOVERY: return "recovery";
+    case MetricPhase::CONTENT_SCORING: return "contentScoring";
+    case MetricPhase::CARVING: return "carving";
+    default: return "unknown";
+    }
+}
+
+bool Metrics::writeJson(const fs::path& path) const {
+    std::ofstream output(path);
+    if (!output) {
+        return false;
+    }
+
+    auto rate = [](double value, double seconds) { return seconds > 0 ? value / seconds : 0.0; };
+    double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double scanSeconds = getPhaseSeconds(MetricPhase::SCAN);
+    double recoverySeconds = getPhaseSeconds(MetricPhase::RECOVERY);
+    double scoringSeconds = getPhaseSeconds(MetricPhase::CONTENT_SCORING);
+    uint64_t fatLookups = get(MetricCounter::FAT_LOOKUPS);
+    uint64_t fatMisses = get(MetricCounter::FAT_CACHE_MISSES);
+    uint64_t blockLookups = get(MetricCounter::BLOCK_CACHE_LOOKUPS);
+    uint64_t blockMisses = get(MetricCounter::BLOCK_CACHE_MISSES);
+    uint64_t readRequests = get(MetricCounter::READ_REQUESTS);
+    uint64_t readBytes = get(MetricCounter::BYTES_READ) + get(MetricCounter::BYTES_MAPPED);
+
+    output << std::fixed << std::setprecision(3);
+    output << "{\n";
+    output << "  \"elapsedSeconds\": " << elapsedSeconds << ",\n";
+
+    output << "  \"phases\": {\n";
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        output << "    \"" << getPhaseName(static_cast<MetricPhase>(i)) << "\": { \"seconds\": "
+            << getPhaseSeconds(static_cast<MetricPhase>(i)) << " }" << (i + 1 < PHASE_COUNT ? "," : "") << "\n";
+    }
+    output << "  },\n";
+
+    output << "  \"counters\": {\n";
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        output << "    \"" << getCounterName(static_cast<MetricCounter>(i)) << "\": "
+            << counters[i].value.load(std::memory_order_relaxed) << (i + 1 < COUNTER_COUNT ? "," : "") << "\n";
+    }
+    output << "  },\n";
+
+    // Scan rates use the scan time, recovery and scoring rates their own time
+    output << "  \"rates\": {\n";
+    output << "    \"readMegabytesPerSecond\": " << rate(readBytes / (1024.0 * 1024.0), elapsedSeconds) << ",\n";
+    output << "    \"fatCacheHitRate\": " << (fatLookups > 0 ? 1.0 - static_cast<double>(fatMisses) / fatLookups : 0.0) << ",\n";
+    output << "    \"blockCacheHitRate\": " << (blockLookups > 0 ? 1.0 - static_cast<double>(blockMisses) / blockLookups : 0.0) << ",\n";
+    output << "    \"directoryEntriesPerSecond\": " << rate(static_cast<double>(get(MetricCounter::DIRECTORY_ENTRIES)), scanSeconds) << ",\n";
+    output << "    \"mftRecordsPerSecond\": " << rate(static_cast<double>(get(MetricCounter::MFT_RECORDS)), scanSeconds) << ",\n";
+    output << "    \"filesRecoveredPerSecond\": " << rate(static_cast<double>(get(MetricCounter::FILES_RECOVERED)), recoverySeconds) << ",\n";
+    output << "    \"recoveredMegabytesPerSecond\": " << rate(get(MetricCounter::BYTES_RECOVERED) / (1024.0 * 1024.0), recoverySeconds) << ",\n";
+    output << "    \"filesScoredPerSecond\": " << rate(static_cast<double>(get(MetricCounter::FILES_SCORED)), scoringSeconds) << "\n";
+    output << "  },\n";
+
+    output << "  \"readLatency\": {\n";
+    output << "    \"count\": " << readRequests << ",\n";
+    output << "    \"meanMicroseconds\": "
+        << (readRequests > 0 ? totalReadNanoseconds.load(std::memory_order_relaxed) / 1000.0 / readRequests : 0.0) << ",\n";
+    output << "    \"buckets\": [\n";
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        output << "      { \"belowMicroseconds\": ";
+        if (i + 1 < LATENCY_BUCKETS) output << (1ull << i);
+        else output << "null";
+        output << ", \"count\": " << latencyBuckets[i].load(std::memory_order_relaxed) << " }"
+            << (i + 1 < LATENCY_BUCKETS ? "," : "") << "\n";
+    }
+    output << "    ]\n";
+    output << "  }\n";
+    output << "}\n";
+    return static_cast<bool>(output);
+}
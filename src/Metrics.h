@@ -0,0 +1,113 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+// Events counted on the hot paths
+enum class MetricCounter : size_t {
+    SECTORS_READ,        // Sectors read or mapped by the sector readers
+    BYTES_READ,          // Bytes copied by device reads
+    BYTES_MAPPED,        // Bytes exposed in place by mapped readers
+    READ_REQUESTS,       // Device reads, each one is timed
+    READ_FAILURES,
+    BAD_SECTORS,         // Sectors the degraded media reader found unreadable
+    SECTORS_SKIPPED,     // Sectors behind a bad sector that were zeroed without reading them
+    FAT_LOOKUPS,         // Every lookup that isn't a miss was served by the resident table or a resident page
+    FAT_CACHE_MISSES,    // Lookups that loaded a page
+    BLOCK_CACHE_LOOKUPS, // Blocks looked up by reads of at most one block, larger reads aren't counted
+    BLOCK_CACHE_MISSES,
+    BLOCKS_READ_AHEAD,   // Blocks loaded behind a missed block
+    DIRECTORIES_SCANNED,
+    DIRECTORY_ENTRIES,   // 32 byte FAT32 and exFAT directory entries parsed
+    MFT_RECORDS,
+    FILES_RECOVERED,
+    BYTES_RECOVERED,
+    SPARSE_BYTES,        // Zero bytes of recovered and carved files left as holes instead of written
+    FILES_SCORED,
+    COUNT
+};
+
+// Stages of a run, the time of every partition adds up
+enum class MetricPhase : size_t {
+    SCAN,
+    SCAN_INDEX,
+    RECOVERY,
+    CONTENT_SCORING,
+    CARVING,
+    COUNT
+};
+
+// Process wide counters, read latency histogram and phase timings.
+// Counters are relaxed atomics on their own cache line, so the scan and recovery workers don't contend on them.
+class Metrics {
+private:
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(MetricCounter::COUNT);
+    static constexpr size_t PHASE_COUNT = static_cast<size_t>(MetricPhase::COUNT);
+    static constexpr size_t LATENCY_BUCKETS = 24; // Bucket i holds reads below 2^i microseconds, the last one is open ended
+    static constexpr std::chrono::milliseconds STATUS_INTERVAL{ 500 };
+
+    struct alignas(64) Counter {
+        std::atomic<uint64_t> value{ 0 };
+    };
+
+    std::array<Counter, COUNTER_COUNT> counters;
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> latencyBuckets{};
+    std::atomic<uint64_t> totalReadNanoseconds{ 0 };
+    std::array<std::atomic<uint64_t>, PHASE_COUNT> phaseNanoseconds{};
+    std::chrono::steady_clock::time_point startTime;
+
+    // Status line state, the line is printed by whichever thread gets the lock
+    std::mutex statusMutex;
+    std::chrono::steady_clock::time_point lastStatusTime;
+    uint64_t lastStatusBytes = 0;
+
+    Metrics();
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    double getPhaseSeconds(MetricPhase phase) const;
+    static const char* getCounterName(MetricCounter counter);
+    static const char* getPhaseName(MetricPhase phase);
+
+public:
+    static Metrics& getInstance() {
+        static Metrics instance;
+        return instance;
+    }
+
+    void add(MetricCounter counter, uint64_t value = 1) {
+        counters[static_cast<size_t>(counter)].value.fetch_add(value, std::memory_order_relaxed);
+    }
+    uint64_t get(MetricCounter counter) const {
+        return counters[static_cast<size_t>(counter)].value.load(std::memory_order_relaxed);
+    }
+    // One device read that started at start
+    void recordRead(uint64_t bytes, std::chrono::steady_clock::time_point start, bool success);
+    void addPhaseTime(MetricPhase phase, std::chrono::steady_clock::duration elapsed);
+
+    // Progress, read throughput and recovered files on one line.
+    // Printed at most every STATUS_INTERVAL, unless forced or the task is done (current >= total).
+    void showStatus(uint64_t current, uint64_t total, bool force = false);
+
+    // Counters, rates, phase timings and the latency histogram as JSON
+    bool writeJson(const fs::path& path) const;
+};
+
+// Adds the time until it goes out of scope to a phase
+class ScopedTimer {
+private:
+    MetricPhase phase;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(MetricPhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { Metrics::getInstance().addPhaseTime(phase, std::chrono::steady_clock::now() - start); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
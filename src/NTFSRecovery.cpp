@@ -1,6 +1,12 @@
 #include "NTFSRecovery.h"
+#include "FileHasher.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <condition_variable>
 
 
 NTFSRecovery::NTFSRecovery(const DriveType& driveType, std::unique_ptr<SectorReader> reader) : IConfigurable(), driveType(driveType) {
@@ -37,6 +43,14 @@ bool NTFSRecovery::readSector(uint64_t sector, void* buffer, uint32_t size) {
     return sectorReader && sectorReader->readSector(sector, buffer, size);
 }
 
+bool NTFSRecovery::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    return sectorReader && sectorReader->readSectors(startSector, count, buffer);
+}
+
+bool NTFSRecovery::readBatch(std::vector<ReadRequest>& requests) {
+    return sectorReader && sectorReader->readBatch(requests);
+}
+
 void NTFSRecovery::readBootSector(uint64_t sector) {
     uint32_t bytesPerSector = getBytesPerSector();
 
@@ -132,7 +146,7 @@ bool NTFSRecovery::validateFileInfo(const NTFSFileInfo& fileInfo) const {
         return false;
     }
 
-    if (fileInfo.nonResident && (fileInfo.cluster == 0 || fileInfo.runLength == 0)) {
+    if (fileInfo.nonResident && (fileInfo.cluster == 0 || fileInfo.extents.empty())) {
         //std::cerr << "Data not found in non resident file." << std::endl;
         return false;
     }
@@ -147,23 +161,83 @@ bool NTFSRecovery::validateFileInfo(const NTFSFileInfo& fileInfo) const {
 void NTFSRecovery::clearFileInfo(NTFSFileInfo& fileInfo) const {
     fileInfo.cluster = 0;
     fileInfo.fileId = 0;
-    fileInfo.fileName = L"";
+    fileInfo.fileName = {};
     fileInfo.fileSize = 0;
     fileInfo.nonResident = false;
-    fileInfo.runLength = 0;
-    fileInfo.data.clear();
+    fileInfo.extents = {};
+    fileInfo.data = {};
 }
 
+std::vector<DataRun> NTFSRecovery::parseDataRuns(const uint8_t* runList, const uint8_t* runListEnd) const {
+    std::vector<DataRun> runs;
+    uint64_t totalClusters = driveInfo.bootSector.totalSectors / driveInfo.bootSector.sectorsPerCluster;
+    uint64_t currentLCN = 0;
 
-/* File scan */
-bool NTFSRecovery::readMftRecord(std::vector<uint8_t>& mftBuffer, const uint32_t sectorsPerMftRecord, const uint64_t currentSector) {
-    for (uint32_t i = 0; i < sectorsPerMftRecord; i++) {
-        if (!readSector(currentSector + i,
-            mftBuffer.data() + (static_cast<uint64_t>(i) * driveInfo.bootSector.bytesPerSector),
-            driveInfo.bootSector.bytesPerSector)) {
-            std::cerr << "Failed to read MFT sector " << (currentSector + i) << std::endl;
+    while (runList < runListEnd && *runList) {
+        uint8_t header = *runList++;
+        uint8_t lengthSize = header & 0x0F;
+        uint8_t offsetSize = (header >> 4) & 0x0F;
+
+        if (lengthSize == 0 || lengthSize > 8 || offsetSize > 8) break;
+        if (runListEnd - runList < lengthSize + offsetSize) break;
+
+        // Read run length
+        uint64_t runLength = 0;
+        for (int i = 0; i < lengthSize; i++) {
+            runLength |= static_cast<uint64_t>(*runList++) << (i * 8);
+        }
+
+        // Read run offset (can be negative)
+        int64_t runOffset = 0;
+        if (offsetSize > 0) {
+            for (int i = 0; i < offsetSize; i++) {
+                runOffset |= static_cast<uint64_t>(*runList++) << (i * 8);
+            }
+
+            // Sign extend if the highest bit is set
+            if (offsetSize < 8 && (runOffset & (1ULL << ((offsetSize * 8) - 1)))) {
+                runOffset |= ~((1LL << (offsetSize * 8)) - 1); // Apply sign extension
+            }
+        }
+
+        currentLCN += runOffset;
+        if (currentLCN > totalClusters) {
+            break;
+        }
+
+        // A run without an offset is sparse and keeps the previous LCN
+        runs.push_back({ currentLCN, runLength, offsetSize == 0 });
+    }
+    return runs;
+}
+
+bool NTFSRecovery::applyFixups(uint8_t* record, uint32_t recordSize) const {
+    const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(record);
+    uint32_t usaOffset = entry->updateSequenceOffset;
+    uint32_t usaCount = entry->updateSequenceSize; // Update sequence number followed by one entry per stride
+
+    if (usaCount < 2 || usaOffset + usaCount * sizeof(uint16_t) > recordSize || (usaCount - 1) * FIXUP_STRIDE > recordSize) {
+        return false;
+    }
+
+    uint16_t* usa = reinterpret_cast<uint16_t*>(record + usaOffset);
+    for (uint32_t i = 1; i < usaCount; i++) {
+        uint16_t* sectorTail = reinterpret_cast<uint16_t*>(record + i * FIXUP_STRIDE - sizeof(uint16_t));
+        if (*sectorTail != usa[0]) {
             return false;
         }
+        *sectorTail = usa[i];
+    }
+    return true;
+}
+
+
+/* File scan */
+bool NTFSRecovery::readMftRecord(std::vector<uint8_t>& mftBuffer, const uint32_t sectorsPerMftRecord, const uint64_t currentSector) {
+    // The whole record is fetched with one request
+    if (!readSectors(currentSector, sectorsPerMftRecord, mftBuffer.data())) {
+        std::cerr << "Failed to read MFT record at sector " << currentSector << std::endl;
+        return false;
     }
     return true;
 }
@@ -175,9 +249,11 @@ void NTFSRecovery::scanForDeletedFiles() {
         std::cout << "Exitting..." << std::endl;
         exit(1);
     }
+    ScopedTimer timer(MetricPhase::SCAN);
 
     scanMFT();
-    utils.closeLogFile();
+    // Files recovered during the scan already started the recovery log
+    utils.closeFileDataLog();
     utils.printFooter();
 }
 
@@ -186,28 +262,516 @@ void NTFSRecovery::scanMFT() {
     if (!isValidSector(mftSector)) return;
 
     uint32_t sectorsPerMftRecord = getSectorsPerMftRecord();
+    uint32_t bytesPerSector = driveInfo.bootSector.bytesPerSector;
+    uint32_t recordBytes = sectorsPerMftRecord * bytesPerSector;
+
+    std::vector<DataRun> mftRuns;
+    uint64_t totalMftRecords = 0;
+    if (!readMftLayout(mftSector, sectorsPerMftRecord, mftRuns, totalMftRecords)) {
+        std::cerr << "[!] Failed to read the $MFT data runs, assuming a contiguous MFT" << std::endl;
+        totalMftRecords = getTotalMftRecords();
+        uint64_t mftClusters = (totalMftRecords * recordBytes + driveInfo.bytesPerCluster - 1) / driveInfo.bytesPerCluster;
+        mftRuns = { { driveInfo.bootSector.mftCluster, mftClusters, false } };
+    }
 
-    std::vector<uint8_t> mftBuffer(driveInfo.mftRecordSize);
+    uint32_t recordsPerChunk = (std::max)(1u, MFT_CHUNK_BYTES / recordBytes);
+    uint64_t chunkCount = (totalMftRecords + recordsPerChunk - 1) / recordsPerChunk;
+    uint32_t threadCount = ThreadPool::resolveThreadCount(config.threadCount);
+
+    // Deleted files found in every chunk, taken into the recovery list in record order
+    std::vector<MftChunkResult> chunkResults(chunkCount);
+    std::vector<uint8_t> chunkParsed(chunkCount, 0);
+    std::mutex chunkMutex;
+
+    // Position in the MFT stream
+    size_t runIndex = 0;
+    uint64_t runSectorOffset = 0;
+
+    // Unfiltered scans list the files of a chunk once every chunk before it is parsed, that prefix is what
+    // a checkpoint stores. Folders need the directories of the whole MFT, they are resolved at the end.
+    // Path filters need the folder to pick a file, so filtered scans list every file at the end and aren't checkpointed.
+    MftScanProgress progress;
+    std::unique_ptr<ScanCheckpoint> checkpoint;
+    if (!scanFilter.isActive()) {
+        checkpoint = std::make_unique<ScanCheckpoint>(getVolumeKey());
+        if (config.resume && resumeMftScan(*checkpoint, recordsPerChunk, chunkCount, progress)) {
+            skipMftSectors(mftRuns, runIndex, runSectorOffset, progress.releasedChunks * recordsPerChunk * sectorsPerMftRecord);
+        }
+    }
+    bool deferFolders = scanFilter.tracksPaths() && !scanFilter.needsPaths();
+
+    // Unattended runs recover the listed files while the rest of the MFT is parsed, one batch at a time, unless they are scored first.
+    // Checkpoints keep the files of the finished batches and the finished files of the running one.
+    bool overlapRecovery = checkpoint && config.recover && config.recoverAll && !config.analyze && !config.scoreContent;
+    size_t handedOverFiles = recoveredDuringScan;
+    size_t recoveredFiles = recoveredDuringScan; // Every file before it is recovered
+    std::mutex recoveryMutex;
+    std::atomic<bool> recoveringBatch{ false };
+    std::unique_ptr<ThreadPool> recoveryPool;
+    if (overlapRecovery) {
+        recoveryPool = std::make_unique<ThreadPool>(1);
+        concurrentRecovery = true;
+        std::cout << "[*] Files are recovered while the scan continues" << std::endl;
+    }
+
+    std::unordered_map<uint64_t, const DirectoryLink*> directories;
+    std::unordered_map<uint64_t, std::wstring> resolvedPaths = { { ROOT_DIRECTORY_RECORD, L"" } };
+    // Ids follow the record order, independent of which worker parsed a record
+    auto releaseParsedChunks = [&] {
+        while (progress.releasedChunks < chunkCount) {
+            {
+                std::lock_guard<std::mutex> lock(chunkMutex);
+                if (!chunkParsed[progress.releasedChunks]) break;
+            }
+            MftChunkResult& results = chunkResults[progress.releasedChunks++];
+            for (size_t i = 0; i < results.files.size(); i++) {
+                NTFSFileInfo& fileInfo = results.files[i];
+                if (scanFilter.needsPaths()) {
+                    const std::wstring& folder = resolveDirectoryPath(results.parentRecords[i], directories, resolvedPaths);
+                    if (!scanFilter.matchesPath(ScanFilter::joinPath(folder, fileInfo.fileName))) continue;
+                    fileInfo.folder = arena.internName(folder);
+                }
+
+                fileInfo.fileId = fileId++;
+                if (!scanFilter.matchesId(fileInfo.fileId)) continue;
+                addToRecoveryList(fileInfo);
+                if (deferFolders) progress.parentRecords.push_back(results.parentRecords[i]);
+                else logFoundFile(fileInfo);
+
+                if (checkpoint) {
+                    writeIndexRecord(progress.files, fileInfo);
+                    if (deferFolders) progress.files.write(results.parentRecords[i]);
+                }
+            }
+            // The directories stay for the folders resolved at the end
+            if (checkpoint && deferFolders) {
+                for (const DirectoryLink& link : results.directories) {
+                    progress.links.write(link.recordNumber);
+                    progress.links.write(link.parentRecord);
+                    progress.links.writeString(link.name);
+                }
+            }
+            std::vector<NTFSFileInfo>().swap(results.files);
+            std::vector<uint64_t>().swap(results.parentRecords);
+            arena.adopt(results.arena);
+        }
 
-    uint64_t totalMftRecords = getTotalMftRecords();
-    for (uint64_t recordIndex = 0; recordIndex < totalMftRecords; recordIndex++) {
-        uint64_t currentSector = mftSector + (recordIndex * sectorsPerMftRecord);
+        // The batch is a copy, the recovery list keeps growing. Blocks adopted by the arena never move.
+        if (overlapRecovery && !recoveringBatch && handedOverFiles < recoveryList.size()) {
+            recoveringBatch = true;
+            std::vector<NTFSFileInfo> batch;
+            {
+                // Between batches the ids are those an interrupted run finished
+                std::lock_guard<std::mutex> lock(recoveryMutex);
+                std::sort(progress.recoveredIds.begin(), progress.recoveredIds.end());
+                for (size_t i = handedOverFiles; i < recoveryList.size(); i++) {
+                    if (!std::binary_search(progress.recoveredIds.begin(), progress.recoveredIds.end(), recoveryList[i].fileId)) {
+                        batch.push_back(recoveryList[i]);
+                    }
+                }
+            }
+            handedOverFiles = recoveryList.size();
+            recoveryPool->submit([this, &recoveryMutex, &recoveredFiles, &progress, &recoveringBatch, batch = std::move(batch), batchEnd = handedOverFiles] {
+                recoverFiles(batch, [&](uint32_t recoveredId) {
+                    std::lock_guard<std::mutex> lock(recoveryMutex);
+                    progress.recoveredIds.push_back(recoveredId);
+                });
+                {
+                    std::lock_guard<std::mutex> lock(recoveryMutex);
+                    recoveredFiles = batchEnd;
+                    progress.recoveredIds.clear();
+                }
+                recoveringBatch = false;
+            });
+        }
 
-        if (!readMftRecord(mftBuffer, sectorsPerMftRecord, currentSector)) {
+        if (checkpoint && checkpoint->isDue()) {
+            IndexWriter frontier;
+            frontier.write(recordsPerChunk);
+            frontier.write(static_cast<uint8_t>(deferFolders));
+            frontier.write(progress.releasedChunks);
+            frontier.write(static_cast<uint64_t>(recoveryList.size()));
+            {
+                std::lock_guard<std::mutex> lock(recoveryMutex);
+                frontier.write(static_cast<uint64_t>(recoveredFiles));
+                frontier.write(static_cast<uint32_t>(progress.recoveredIds.size()));
+                for (uint32_t recoveredId : progress.recoveredIds) frontier.write(recoveredId);
+            }
+            frontier.writeRaw(progress.links.getData());
+            checkpoint->save(fileId, frontier, progress.files);
+        }
+    };
+    auto markParsed = [&](uint64_t chunkIndex) {
+        std::lock_guard<std::mutex> lock(chunkMutex);
+        chunkParsed[chunkIndex] = 1;
+    };
+
+    // Chunk buffers cycle between the reader and the parser workers
+    std::vector<std::vector<uint8_t>> chunkBuffers(static_cast<size_t>(threadCount) * 2);
+    std::vector<size_t> freeBuffers;
+    for (size_t i = 0; i < chunkBuffers.size(); i++) {
+        chunkBuffers[i].resize(static_cast<uint64_t>(recordsPerChunk) * recordBytes);
+        freeBuffers.push_back(i);
+    }
+    std::mutex bufferMutex;
+    std::condition_variable bufferReleased;
+    auto releaseBuffer = [&](size_t bufferIndex) {
+        {
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            freeBuffers.push_back(bufferIndex);
+        }
+        bufferReleased.notify_one();
+    };
+
+    std::cout << "[*] Parsing MFT records with " << threadCount << " threads..." << std::endl;
+    ThreadPool pool(threadCount);
+
+    for (uint64_t chunkIndex = progress.releasedChunks; chunkIndex < chunkCount; chunkIndex++) {
+        if (checkpoint) releaseParsedChunks();
+
+        size_t bufferIndex;
+        {
+            std::unique_lock<std::mutex> lock(bufferMutex);
+            bufferReleased.wait(lock, [&] { return !freeBuffers.empty(); });
+            bufferIndex = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+
+        uint64_t firstRecord = chunkIndex * recordsPerChunk;
+        uint64_t chunkRecords = (std::min)(static_cast<uint64_t>(recordsPerChunk), totalMftRecords - firstRecord);
+        uint64_t sectorsRead = 0;
+
+        // Mapped readers expose the chunk in place, the run position only advances on success
+        std::vector<SectorSpan> pieces;
+        size_t mappedRunIndex = runIndex;
+        uint64_t mappedRunSectorOffset = runSectorOffset;
+        if (mapMftChunk(mftRuns, mappedRunIndex, mappedRunSectorOffset, chunkRecords * sectorsPerMftRecord, sectorsPerMftRecord, pieces, sectorsRead)) {
+            releaseBuffer(bufferIndex);
+            runIndex = mappedRunIndex;
+            runSectorOffset = mappedRunSectorOffset;
+            uint64_t recordsRead = sectorsRead / sectorsPerMftRecord;
+            Metrics::getInstance().add(MetricCounter::MFT_RECORDS, recordsRead);
+
+            pool.submit([this, &chunkResults, &markParsed, pieces = std::move(pieces), chunkIndex, recordBytes] {
+                parseMappedMftChunk(pieces, recordBytes, chunkResults[chunkIndex]);
+                markParsed(chunkIndex);
+            });
+
+            if (recordsRead < chunkRecords) break;
             continue;
         }
 
-        processMftRecord(mftBuffer);
+        uint8_t* chunk = chunkBuffers[bufferIndex].data();
+
+        if (!readMftChunk(mftRuns, runIndex, runSectorOffset, chunkRecords * sectorsPerMftRecord, chunk, sectorsRead)) {
+            std::cerr << "[-] Failed to read part of the MFT near record " << firstRecord << std::endl;
+        }
+
+        // The runs ended before the record count did
+        uint64_t recordsRead = sectorsRead / sectorsPerMftRecord;
+        Metrics::getInstance().add(MetricCounter::MFT_RECORDS, recordsRead);
+
+        pool.submit([this, &chunkResults, &releaseBuffer, &markParsed, chunk, chunkIndex, bufferIndex, recordsRead, recordBytes] {
+            try {
+                parseMftChunk(chunk, recordsRead, recordBytes, chunkResults[chunkIndex]);
+            }
+            catch (...) {
+                releaseBuffer(bufferIndex);
+                throw;
+            }
+            releaseBuffer(bufferIndex);
+            markParsed(chunkIndex);
+        });
+
+        if (recordsRead < chunkRecords) break;
+    }
+    pool.wait();
+
+    // Directories of every chunk, a file's parent may lie in any of them
+    if (scanFilter.tracksPaths()) {
+        for (const DirectoryLink& link : progress.directories) {
+            directories.emplace(link.recordNumber, &link);
+        }
+        for (const MftChunkResult& results : chunkResults) {
+            for (const DirectoryLink& link : results.directories) {
+                directories.emplace(link.recordNumber, &link);
+            }
+        }
+    }
+    releaseParsedChunks();
+
+    // Files listed before their folder was known
+    if (deferFolders) {
+        for (size_t i = 0; i < recoveryList.size(); i++) {
+            recoveryList[i].folder = arena.internName(resolveDirectoryPath(progress.parentRecords[i], directories, resolvedPaths));
+            logFoundFile(recoveryList[i]);
+        }
+    }
+
+    // Without a batch during the scan every file is recovered afterwards
+    recoveredDuringScan = 0;
+    if (overlapRecovery) {
+        recoveryPool->wait();
+        recoveredDuringScan = recoveredFiles;
+        concurrentRecovery = false;
+    }
+    if (checkpoint) checkpoint->remove();
+}
+
+bool NTFSRecovery::resumeMftScan(const ScanCheckpoint& checkpoint, uint32_t recordsPerChunk, uint64_t chunkCount, MftScanProgress& progress) {
+    uint32_t nextFileId = 0;
+    std::vector<uint8_t> frontier;
+    std::vector<uint8_t> results;
+    if (!checkpoint.load(nextFileId, frontier, results)) {
+        std::cout << "[*] No usable scan checkpoint, scanning from the first MFT record" << std::endl;
+        return false;
+    }
+
+    // A different chunk size would put the stored position in the middle of a chunk
+    IndexReader frontierReader(frontier.data(), frontier.size());
+    uint32_t checkpointRecordsPerChunk = frontierReader.read<uint32_t>();
+    bool checkpointDefersFolders = frontierReader.read<uint8_t>() != 0;
+    uint64_t nextChunk = frontierReader.read<uint64_t>();
+    uint64_t fileCount = frontierReader.read<uint64_t>();
+    uint64_t recoveredFiles = frontierReader.read<uint64_t>();
+    uint32_t recoveredIdCount = frontierReader.read<uint32_t>();
+    bool isValid = frontierReader.isValid() && checkpointRecordsPerChunk == recordsPerChunk && nextChunk <= chunkCount &&
+        fileCount <= results.size() && recoveredFiles <= fileCount && recoveredIdCount <= fileCount;
+    std::vector<uint32_t> recoveredIds(isValid ? recoveredIdCount : 0);
+    for (uint32_t& recoveredId : recoveredIds) recoveredId = frontierReader.read<uint32_t>();
+
+    // The directories follow until the end of the frontier
+    size_t linksStart = frontier.size() - frontierReader.getRemaining();
+    std::vector<DirectoryLink> links;
+    while (isValid && frontierReader.isValid() && !frontierReader.isAtEnd()) {
+        DirectoryLink link;
+        link.recordNumber = frontierReader.read<uint64_t>();
+        link.parentRecord = frontierReader.read<uint64_t>();
+        link.name = frontierReader.readString();
+        links.push_back(std::move(link));
+    }
+    isValid = isValid && frontierReader.isValid();
+
+    // Only kept if the whole checkpoint reads back
+    MetadataArena checkpointArena;
+    std::vector<DataRun> runs;
+    std::vector<NTFSFileInfo> files(isValid ? fileCount : 0);
+    std::vector<uint64_t> parentRecords;
+    IndexReader reader(results.data(), results.size());
+    for (NTFSFileInfo& fileInfo : files) {
+        readIndexRecord(reader, fileInfo, checkpointArena, runs);
+        if (checkpointDefersFolders) parentRecords.push_back(reader.read<uint64_t>());
+    }
+    if (!isValid || !reader.isValid() || !reader.isAtEnd()) {
+        std::cerr << "[!] The scan checkpoint is damaged, scanning from the first MFT record" << std::endl;
+        return false;
+    }
+
+    // Without the parents a file data log would put the files before it into the root folder
+    bool defersFolders = scanFilter.tracksPaths() && !scanFilter.needsPaths();
+    if (checkpointDefersFolders != defersFolders) {
+        std::cout << "[*] The scan checkpoint was written with a different file data log setting, scanning from the first MFT record" << std::endl;
+        return false;
+    }
+
+    std::cout << "[*] Resuming the scan at MFT record " << nextChunk * recordsPerChunk << ", " << files.size() << " files were found before" << std::endl;
+    if (!defersFolders) {
+        for (const NTFSFileInfo& fileInfo : files) {
+            logFoundFile(fileInfo);
+        }
+    }
+    recoveryList = std::move(files);
+    arena.adopt(checkpointArena);
+    fileId = nextFileId;
+    recoveredDuringScan = recoveredFiles;
+    progress.releasedChunks = nextChunk;
+    progress.parentRecords = std::move(parentRecords);
+    progress.directories = std::move(links);
+    progress.recoveredIds = std::move(recoveredIds);
+    progress.files.writeRaw(results);
+    progress.links.writeRaw(std::span<const uint8_t>(frontier).subspan(linksStart));
+    return true;
+}
+
+const std::wstring& NTFSRecovery::resolveDirectoryPath(uint64_t recordNumber, const std::unordered_map<uint64_t, const DirectoryLink*>& directories, std::unordered_map<uint64_t, std::wstring>& resolvedPaths) const {
+    // Walk up until the root, a directory resolved before or a broken link
+    std::vector<const DirectoryLink*> chain;
+    std::wstring path = ORPHAN_FOLDER;
+    uint64_t current = recordNumber;
+    while (chain.size() < MAX_PATH_DEPTH) {
+        auto resolved = resolvedPaths.find(current);
+        if (resolved != resolvedPaths.end()) {
+            path = resolved->second;
+            break;
+        }
+        auto link = directories.find(current);
+        if (link == directories.end()) break;
+        chain.push_back(link->second);
+        current = link->second->parentRecord;
+    }
+
+    // Every directory of the chain is remembered for the files that follow
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        path = ScanFilter::joinPath(path, (*it)->name);
+        resolvedPaths[(*it)->recordNumber] = path;
+    }
+    return resolvedPaths.emplace(recordNumber, path).first->second;
+}
+
+bool NTFSRecovery::readMftLayout(uint64_t mftSector, uint32_t sectorsPerMftRecord, std::vector<DataRun>& mftRuns, uint64_t& totalMftRecords) {
+    uint32_t recordBytes = sectorsPerMftRecord * driveInfo.bootSector.bytesPerSector;
+    std::vector<uint8_t> mftBuffer(recordBytes);
+
+    // Record 0 describes the $MFT itself
+    if (!readMftRecord(mftBuffer, sectorsPerMftRecord, mftSector)) return false;
+    if (!isValidFileRecord(reinterpret_cast<const MFTEntryHeader*>(mftBuffer.data())) || !applyFixups(mftBuffer.data(), recordBytes)) {
+        return false;
+    }
+
+    const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(mftBuffer.data());
+    uint32_t attributeOffset = entry->firstAttributeOffset;
+    while (attributeOffset + sizeof(AttributeHeader) <= recordBytes) {
+        const AttributeHeader* attr = reinterpret_cast<const AttributeHeader*>(mftBuffer.data() + attributeOffset);
+        if (attr->type == 0xFFFFFFFF) break;
+        if (attr->length == 0 || attributeOffset + attr->length > recordBytes) break;
+
+        // Unnamed non-resident $DATA
+        if (attr->type == 0x80 && attr->nonResident && attr->nameLength == 0) {
+            const uint8_t* attrData = mftBuffer.data() + attributeOffset;
+            const NonResidentAttributeHeader* nonResident = reinterpret_cast<const NonResidentAttributeHeader*>(attrData);
+            if (nonResident->dataRunOffset >= attr->length) return false;
+
+            mftRuns = parseDataRuns(attrData + nonResident->dataRunOffset, attrData + attr->length);
+            totalMftRecords = nonResident->realSize / driveInfo.mftRecordSize;
+
+            for (const DataRun& run : mftRuns) {
+                if (run.sparse || !isValidSector(clusterToSector(run.lcn + run.length) - 1)) return false;
+            }
+            return !mftRuns.empty() && totalMftRecords > 0;
+        }
+        attributeOffset += attr->length;
+    }
+    return false;
+}
+
+bool NTFSRecovery::readMftChunk(const std::vector<DataRun>& mftRuns, size_t& runIndex, uint64_t& runSectorOffset, uint64_t sectorCount, uint8_t* buffer, uint64_t& sectorsRead) {
+    uint32_t bytesPerSector = driveInfo.bootSector.bytesPerSector;
+    bool success = true;
+    sectorsRead = 0;
+
+    // A chunk may span several runs, each piece is one request
+    while (sectorsRead < sectorCount && runIndex < mftRuns.size()) {
+        const DataRun& run = mftRuns[runIndex];
+        uint64_t runSectors = clusterToSector(run.length);
+        uint32_t pieceSectors = static_cast<uint32_t>((std::min)(sectorCount - sectorsRead, runSectors - runSectorOffset));
+        uint64_t pieceStart = clusterToSector(run.lcn) + runSectorOffset;
+        uint8_t* destination = buffer + sectorsRead * bytesPerSector;
+
+        if (!readSectors(pieceStart, pieceSectors, destination)) {
+            // Salvage what is readable, zeroed sectors fail the signature check
+            std::vector<uint64_t> unreadableSectors;
+            success = sectorReader->salvageSectors(pieceStart, pieceSectors, destination, unreadableSectors) && success;
+        }
+
+        sectorsRead += pieceSectors;
+        runSectorOffset += pieceSectors;
+        if (runSectorOffset >= runSectors) {
+            runIndex++;
+            runSectorOffset = 0;
+        }
+    }
+    return success;
+}
+
+void NTFSRecovery::skipMftSectors(const std::vector<DataRun>& mftRuns, size_t& runIndex, uint64_t& runSectorOffset, uint64_t sectorCount) const {
+    while (sectorCount > 0 && runIndex < mftRuns.size()) {
+        uint64_t runSectors = clusterToSector(mftRuns[runIndex].length);
+        uint64_t pieceSectors = (std::min)(sectorCount, runSectors - runSectorOffset);
+        sectorCount -= pieceSectors;
+        runSectorOffset += pieceSectors;
+        if (runSectorOffset >= runSectors) {
+            runIndex++;
+            runSectorOffset = 0;
+        }
+    }
+}
+
+bool NTFSRecovery::mapMftChunk(const std::vector<DataRun>& mftRuns, size_t& runIndex, uint64_t& runSectorOffset, uint64_t sectorCount, uint32_t sectorsPerMftRecord, std::vector<SectorSpan>& pieces, uint64_t& sectorsRead) {
+    uint32_t bytesPerSector = driveInfo.bootSector.bytesPerSector;
+    sectorsRead = 0;
+
+    // Same walk as readMftChunk, but each piece stays in the reader's mapping
+    while (sectorsRead < sectorCount && runIndex < mftRuns.size()) {
+        const DataRun& run = mftRuns[runIndex];
+        uint64_t runSectors = clusterToSector(run.length);
+        uint32_t pieceSectors = static_cast<uint32_t>((std::min)(sectorCount - sectorsRead, runSectors - runSectorOffset));
+
+        // A record split between two runs has to be copied to be contiguous
+        if (pieceSectors % sectorsPerMftRecord != 0) return false;
+
+        SectorSpan piece = sectorReader->mapSectors(clusterToSector(run.lcn) + runSectorOffset, pieceSectors);
+        if (!piece || piece.size < static_cast<uint64_t>(pieceSectors) * bytesPerSector) return false;
+        pieces.push_back(std::move(piece));
+
+        sectorsRead += pieceSectors;
+        runSectorOffset += pieceSectors;
+        if (runSectorOffset >= runSectors) {
+            runIndex++;
+            runSectorOffset = 0;
+        }
+    }
+    return true;
+}
+
+void NTFSRecovery::parseMappedMftChunk(const std::vector<SectorSpan>& pieces, uint32_t recordBytes, MftChunkResult& results) const {
+    std::vector<uint8_t> record(recordBytes);
+    for (const SectorSpan& piece : pieces) {
+        uint64_t recordCount = piece.size / recordBytes;
+        for (uint64_t i = 0; i < recordCount; i++) {
+            const uint8_t* mappedRecord = piece.data + i * recordBytes;
+            const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(mappedRecord);
+
+            // The header lies before the first fixup, so records in use are skipped without a copy.
+            // Directories are kept when the paths are tracked.
+            bool isInUse = (entry->flags & 0x0001) != 0;
+            bool isDirectory = (entry->flags & 0x0002) != 0;
+            if (!isValidFileRecord(entry) || (isInUse && !(isDirectory && scanFilter.tracksPaths()))) continue;
+
+            std::memcpy(record.data(), mappedRecord, recordBytes);
+            if (!applyFixups(record.data(), recordBytes)) continue;
+            processMftRecord(record.data(), results);
+        }
+    }
+}
+
+void NTFSRecovery::parseMftChunk(uint8_t* chunk, uint64_t recordCount, uint32_t recordBytes, MftChunkResult& results) const {
+    // Records are processed in place
+    for (uint64_t i = 0; i < recordCount; i++) {
+        uint8_t* record = chunk + i * recordBytes;
+        if (!isValidFileRecord(reinterpret_cast<const MFTEntryHeader*>(record)) || !applyFixups(record, recordBytes)) {
+            continue;
+        }
+        processMftRecord(record, results);
     }
 }
 
-void NTFSRecovery::processMftRecord(std::vector<uint8_t>& mftBuffer) {
+void NTFSRecovery::processMftRecord(const uint8_t* record, MftChunkResult& results) const {
     try {
         // Process the complete MFT record
-        const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(mftBuffer.data());
+        const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(record);
 
         if (!isValidFileRecord(entry)) return;
 
+        // Directories give the files their paths, in use or not
+        bool isDirectory = (entry->flags & 0x0002) != 0;
+        if (isDirectory && scanFilter.tracksPaths() && entry->baseFileRecord == 0) {
+            std::wstring name;
+            uint64_t parentRecord = 0;
+            if (readFileNameLink(record, name, parentRecord)) {
+                results.directories.push_back({ entry->recordNumber, parentRecord, std::move(name) });
+            }
+        }
+
         // Check if record is in use
         bool isDeleted = (entry->flags & 0x0001) == 0;
         if (!isDeleted) return;
@@ -217,18 +781,27 @@ void NTFSRecovery::processMftRecord(std::vector<uint8_t>& mftBuffer) {
         bool hasFileName = false;
         bool hasData = false;
 
-        processAttribute(mftBuffer, fileInfo, attributeOffset, hasFileName, hasData, isDeleted);
+        processAttribute(record, fileInfo, results, attributeOffset, hasFileName, hasData, isDeleted);
 
         if (!hasFileName && !hasData) return;
 
         
         try {
-            if (validateFileInfo(fileInfo)) {
-                addToRecoveryList(fileInfo);
-                utils.logFileInfo(fileInfo.fileId, fileInfo.fileName, fileInfo.fileSize);
-                this->fileId++;
+            // The file id is assigned once all chunks are merged, paths are checked there too
+            if (validateFileInfo(fileInfo) && scanFilter.matchesExtension(fileInfo.fileName)
+                && scanFilter.matchesAttributes(fileInfo.fileSize, fileInfo.cluster)) {
+                if (scanFilter.tracksPaths()) {
+                    std::wstring linkName;
+                    uint64_t parentRecord = UINT64_MAX; // Unknown parents end up under $Orphan
+                    readFileNameLink(record, linkName, parentRecord);
+                    results.parentRecords.push_back(parentRecord);
+                }
+                // The name, runs and resident data still point into buffers that the next record reuses
+                fileInfo.fileName = results.arena.internName(fileInfo.fileName);
+                fileInfo.extents = results.arena.store(fileInfo.extents.data(), fileInfo.extents.size());
+                fileInfo.data = results.arena.store(fileInfo.data.data(), fileInfo.data.size());
+                results.files.push_back(fileInfo);
             }
-            clearFileInfo(fileInfo);
         }
         catch (const std::exception& e) {
             std::cerr << "\nException while validating file info or adding to recovery list: " << e.what() << std::endl;
@@ -242,10 +815,10 @@ void NTFSRecovery::processMftRecord(std::vector<uint8_t>& mftBuffer) {
     }
 }
 
-void NTFSRecovery::processAttribute(const std::vector<uint8_t>& mftBuffer, NTFSFileInfo& fileInfo, uint32_t attributeOffset, bool& hasFileName, bool& hasData, bool isDeleted) {
-    while (attributeOffset < driveInfo.mftRecordSize) {
+void NTFSRecovery::processAttribute(const uint8_t* record, NTFSFileInfo& fileInfo, MftChunkResult& results, uint32_t attributeOffset, bool& hasFileName, bool& hasData, bool isDeleted) const {
+    while (attributeOffset + sizeof(AttributeHeader) <= driveInfo.mftRecordSize) {
         const AttributeHeader* attr = reinterpret_cast<const AttributeHeader*>(
-            mftBuffer.data() + attributeOffset);
+            record + attributeOffset);
 
         // Check for end marker
         if (attr->type == 0xFFFFFFFF) break;
@@ -258,12 +831,12 @@ void NTFSRecovery::processAttribute(const std::vector<uint8_t>& mftBuffer, NTFSF
         // Process different attribute types
         switch (attr->type) {
         case 0x30:  // $FILE_NAME
-            processFileNameAttribute(attr, mftBuffer.data() + attributeOffset, isDeleted, fileInfo);
+            processFileNameAttribute(attr, record + attributeOffset, isDeleted, fileInfo, results);
             hasFileName = true;
             break;
 
         case 0x80:  // $DATA
-            processDataAttribute(attr, mftBuffer.data() + attributeOffset, isDeleted, fileInfo);
+            processDataAttribute(attr, record + attributeOffset, isDeleted, fileInfo, results);
             hasData = true;
             break;
         }
@@ -272,23 +845,25 @@ void NTFSRecovery::processAttribute(const std::vector<uint8_t>& mftBuffer, NTFSF
     }
 }
 
-void NTFSRecovery::processFileNameAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo) {
+void NTFSRecovery::processFileNameAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo, MftChunkResult& results) const {
     if (!attr->nonResident) {  // File name is always resident
         const ResidentAttributeHeader* resAttr = reinterpret_cast<const ResidentAttributeHeader*>(attrData);
         const uint8_t* filenameData = attrData + resAttr->contentOffset;
         const FileNameAttribute* fnAttr = reinterpret_cast<const FileNameAttribute*>(filenameData);
 
         if (fnAttr->nameLength > 255) return;
-        std::wstring wfilename(fnAttr->name, fnAttr->nameLength);
 
+        // Points into the record until the file is accepted
         if (isDeleted) {
-            fileInfo.fileName = wfilename;
-            fileInfo.fileId = fileId;
+            fileInfo.fileName = fileNameView(fnAttr, results.pendingName);
         }
     }
 }
 
-void NTFSRecovery::processDataAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo) {
+void NTFSRecovery::processDataAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo, MftChunkResult& results) const {
+    // Named $DATA attributes are alternate streams, the file content is the unnamed one
+    if (attr->nameLength != 0) return;
+
     if (attr->nonResident) {
         const NonResidentAttributeHeader* nonResident =
             reinterpret_cast<const NonResidentAttributeHeader*>(attrData);
@@ -296,44 +871,22 @@ void NTFSRecovery::processDataAttribute(const AttributeHeader* attr, const uint8
         fileInfo.fileSize = nonResident->realSize;
 
         const uint8_t* runList = attrData + nonResident->dataRunOffset;
-        uint64_t currentLCN = 0;
-
-        while (*runList) {
-            uint8_t header = *runList++;
-            uint8_t lengthSize = header & 0x0F;
-            uint8_t offsetSize = (header >> 4) & 0x0F;
+        if (nonResident->dataRunOffset >= attr->length) return;
 
-            if (lengthSize == 0) break;
-
-            // Read run length
-            uint64_t runLength = 0;
-            for (int i = 0; i < lengthSize; i++) {
-                runLength |= static_cast<uint64_t>(*runList++) << (i * 8);
-            }
-
-            // Read run offset (can be negative)
-            int64_t runOffset = 0;
-            if (offsetSize > 0) {
-                for (int i = 0; i < offsetSize; i++) {
-                    runOffset |= static_cast<uint64_t>(*runList++) << (i * 8);
-                }
-
-                // Sign extend if the highest bit is set
-                if (runOffset & (1ULL << ((offsetSize * 8) - 1))) {
-                    runOffset |= ~((1LL << (offsetSize * 8)) - 1); // Apply sign extension
+        if (isDeleted) {
+            // Kept aside until the file is accepted
+            results.pendingRuns = parseDataRuns(runList, attrData + attr->length);
+            fileInfo.extents = results.pendingRuns;
+            fileInfo.nonResident = true;
+
+            // First allocated cluster identifies the file
+            fileInfo.cluster = 0;
+            for (const DataRun& run : fileInfo.extents) {
+                if (!run.sparse) {
+                    fileInfo.cluster = run.lcn;
+                    break;
                 }
             }
-
-            currentLCN += runOffset;
-            if (currentLCN > driveInfo.bootSector.totalSectors / driveInfo.bootSector.sectorsPerCluster) {
-                break;
-            }
-
-            if (isDeleted) {
-                fileInfo.cluster = currentLCN;
-                fileInfo.runLength = runLength;
-                fileInfo.nonResident = true;
-            }
         }
     }
     else {
@@ -343,17 +896,95 @@ void NTFSRecovery::processDataAttribute(const AttributeHeader* attr, const uint8
         if (isDeleted) {
             fileInfo.fileSize = resident->contentLength;
             fileInfo.nonResident = false;
-            fileInfo.data.assign(residentData, residentData + resident->contentLength);
+            fileInfo.data = std::span<const uint8_t>(residentData, resident->contentLength);
         }
     }
 }
 
 
 
+std::wstring_view NTFSRecovery::fileNameView(const FileNameAttribute* fnAttr, std::wstring& widened) {
+    if constexpr (sizeof(wchar_t) == sizeof(char16_t)) {
+        return std::wstring_view(reinterpret_cast<const wchar_t*>(fnAttr->name), fnAttr->nameLength);
+    }
+    else {
+        // Code units are widened one by one like the FAT long names, surrogate pairs stay as they are
+        widened.assign(fnAttr->name, fnAttr->name + fnAttr->nameLength);
+        return widened;
+    }
+}
+
+bool NTFSRecovery::readFileNameLink(const uint8_t* record, std::wstring& name, uint64_t& parentRecord) const {
+    const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(record);
+    bool found = false;
+    uint32_t attributeOffset = entry->firstAttributeOffset;
+    while (attributeOffset + sizeof(AttributeHeader) <= driveInfo.mftRecordSize) {
+        const AttributeHeader* attr = reinterpret_cast<const AttributeHeader*>(record + attributeOffset);
+        if (attr->type == 0xFFFFFFFF || attr->length == 0 || attributeOffset + attr->length > driveInfo.mftRecordSize) break;
+
+        if (attr->type == 0x30 && !attr->nonResident) {
+            const ResidentAttributeHeader* resAttr = reinterpret_cast<const ResidentAttributeHeader*>(attr);
+            const FileNameAttribute* fnAttr = reinterpret_cast<const FileNameAttribute*>(record + attributeOffset + resAttr->contentOffset);
+            bool fits = resAttr->contentOffset + offsetof(FileNameAttribute, name) + fnAttr->nameLength * sizeof(char16_t) <= attr->length;
+
+            // The DOS 8.3 name is only used when there is no other
+            if (fits && (!found || fnAttr->nameType != 2)) {
+                name.assign(fnAttr->name, fnAttr->name + fnAttr->nameLength);
+                parentRecord = fnAttr->parentDirectory & MFT_REFERENCE_MASK;
+                found = true;
+            }
+        }
+        attributeOffset += attr->length;
+    }
+    return found;
+}
+
 void NTFSRecovery::addToRecoveryList(const NTFSFileInfo& fileInfo) {
     recoveryList.push_back(fileInfo);
 }
 
+void NTFSRecovery::logFoundFile(const NTFSFileInfo& fileInfo) {
+    LoggedFile file;
+    file.fileId = fileInfo.fileId;
+    file.path = ScanFilter::joinPath(fileInfo.folder, fileInfo.fileName);
+    file.fileSize = fileInfo.fileSize;
+    file.firstCluster = fileInfo.nonResident ? fileInfo.cluster : 0;
+    file.isExtensionPredicted = utils.hasDamagedExtension(fileInfo.fileName);
+    for (const DataRun& run : fileInfo.extents) {
+        file.extents.push_back({ run.lcn, run.length, run.sparse });
+    }
+    utils.logFileInfo(std::move(file));
+}
+
+
+// Predict file extension from the resident data or the first cluster of the file
+std::wstring NTFSRecovery::predictExtension(const NTFSFileInfo& fileInfo) {
+    if (reportsFileDetails()) std::wcout << "  [*] Predicting extension..." << std::endl;
+
+    std::wstring extension = L"bin";
+    if (!fileInfo.nonResident) {
+        extension = SignatureDB::guessExtension(fileInfo.data.data(), fileInfo.data.size());
+    }
+    else if (!fileInfo.extents.empty() && !fileInfo.extents.front().sparse) {
+        // A file starting with a sparse extent starts with zeros
+        std::vector<uint8_t> buffer(driveInfo.bootSector.bytesPerSector);
+        if (readSector(clusterToSector(fileInfo.extents.front().lcn), buffer.data(), driveInfo.bootSector.bytesPerSector)) {
+            extension = SignatureDB::guessExtension(buffer.data(), static_cast<size_t>((std::min)(static_cast<uint64_t>(buffer.size()), fileInfo.fileSize)));
+        }
+    }
+
+    // The result line of a concurrent recovery shows the chosen name
+    if (!reportsFileDetails()) return extension;
+
+    if (extension == L"bin") {
+        std::wcout << "  [-] Couldn't predict the extension. Defaulting to .bin" << std::endl;
+    }
+    else {
+        std::wcout << "  [*] Predicted extension: " << extension << std::endl;
+    }
+    return extension;
+}
+
 
 /* Recovery */
 std::vector<NTFSFileInfo> NTFSRecovery::selectFilesToRecover(const std::vector<NTFSFileInfo>& recoveryList) {
@@ -372,27 +1003,23 @@ std::vector<NTFSFileInfo> NTFSRecovery::selectFilesToRecover(const std::vector<N
         else if (userResponse == '1') return recoveryList;
         else if (userResponse == '2') {
             std::string fileIds;
-            std::cout << "\nEnter file IDs to recover (e.g., 1,2,3): ";
+            std::cout << "\nEnter file IDs to recover (e.g., 1,2,3 or 10-20): ";
             std::cin >> fileIds;
 
-            std::vector<int> fileIdVector;
-            std::stringstream ss(fileIds);
-            std::string id;
-            while (std::getline(ss, id, ',')) {
-                try {
-                    fileIdVector.push_back(std::stoi(id));
-                }
-                catch (const std::invalid_argument&) {
-                    std::cerr << "\nInvalid input. Please enter numeric IDs.\n";
-                    return recoveryList;
-                }
+            IdSelection selection;
+            try {
+                selection = IdSelection::parse(fileIds);
+            }
+            catch (const std::logic_error&) {
+                std::cerr << "\nInvalid input. Please enter numeric IDs.\n";
+                return recoveryList;
             }
             // Create a new vector to store the selected files
             std::vector<NTFSFileInfo> selectedFiles;
 
             // Iterate through the original deletedFiles vector and add the selected files to the new vector
             for (const auto& item : recoveryList) {
-                if (std::find(fileIdVector.begin(), fileIdVector.end(), item.fileId) != fileIdVector.end()) {
+                if (selection.contains(item.fileId)) {
                     selectedFiles.push_back(item);
                 }
             }
@@ -404,58 +1031,249 @@ std::vector<NTFSFileInfo> NTFSRecovery::selectFilesToRecover(const std::vector<N
     return recoveryList;
 }
 
+/*=============== Scan index ===============*/
+VolumeKey NTFSRecovery::getVolumeKey() {
+    // $Bitmap changes with every created, grown or deleted file
+    if (!allocationBitmap) loadAllocationBitmap();
+    return ScanIndex::makeKey(FilesystemType::NTFS_TYPE, driveInfo.bootSector.volumeSerialNumber,
+        &driveInfo.bootSector, sizeof(driveInfo.bootSector), *allocationBitmap);
+}
+
+void NTFSRecovery::writeIndexRecord(IndexWriter& writer, const NTFSFileInfo& fileInfo) {
+    writer.write(static_cast<uint32_t>(fileInfo.fileId));
+    writer.writeString(fileInfo.folder);
+    writer.writeString(fileInfo.fileName);
+    writer.write(fileInfo.fileSize);
+    writer.write(fileInfo.cluster);
+    writer.write(static_cast<uint8_t>(fileInfo.nonResident));
+    writer.write(static_cast<uint32_t>(fileInfo.extents.size()));
+    for (const DataRun& run : fileInfo.extents) {
+        writer.write(run.lcn);
+        writer.write(run.length);
+        writer.write(static_cast<uint8_t>(run.sparse));
+    }
+    writer.writeBytes(fileInfo.data);
+}
+
+void NTFSRecovery::readIndexRecord(IndexReader& reader, NTFSFileInfo& fileInfo, MetadataArena& recordArena, std::vector<DataRun>& runs) {
+    fileInfo.fileId = reader.read<uint32_t>();
+    fileInfo.folder = recordArena.internName(reader.readString());
+    fileInfo.fileName = recordArena.internName(reader.readString());
+    fileInfo.fileSize = reader.read<uint64_t>();
+    fileInfo.cluster = reader.read<uint64_t>();
+    fileInfo.nonResident = reader.read<uint8_t>() != 0;
+
+    // A damaged count fails the reader before the loop gets long
+    uint32_t extentCount = reader.read<uint32_t>();
+    runs.clear();
+    for (uint32_t i = 0; i < extentCount && reader.isValid(); i++) {
+        DataRun run = {};
+        run.lcn = reader.read<uint64_t>();
+        run.length = reader.read<uint64_t>();
+        run.sparse = reader.read<uint8_t>() != 0;
+        runs.push_back(run);
+    }
+    fileInfo.extents = recordArena.store(runs.data(), runs.size());
+    std::vector<uint8_t> data = reader.readBytes();
+    fileInfo.data = recordArena.store(data.data(), data.size());
+}
+
+void NTFSRecovery::saveScanIndex() {
+    IndexWriter writer;
+    for (const NTFSFileInfo& fileInfo : recoveryList) {
+        writeIndexRecord(writer, fileInfo);
+    }
+
+    ScanIndex index(getVolumeKey());
+    if (index.save(static_cast<uint32_t>(recoveryList.size()), fileId, writer)) {
+        std::wcout << "[*] Scan index saved to " << index.getPath().wstring() << std::endl;
+    }
+}
+
+bool NTFSRecovery::loadScanIndex() {
+    ScopedTimer timer(MetricPhase::SCAN_INDEX);
+    ScanIndex index(getVolumeKey());
+    uint32_t recordCount = 0;
+    uint32_t nextFileId = 0;
+    std::vector<uint8_t> records;
+    if (!index.load(recordCount, nextFileId, records)) {
+        std::cout << "[*] No usable scan index, scanning the volume" << std::endl;
+        return false;
+    }
+
+    // Only kept if the whole index reads back
+    MetadataArena indexArena;
+    std::vector<DataRun> runs;
+    std::vector<NTFSFileInfo> indexedFiles(recordCount);
+    IndexReader reader(records.data(), records.size());
+    for (NTFSFileInfo& fileInfo : indexedFiles) {
+        readIndexRecord(reader, fileInfo, indexArena, runs);
+    }
+    if (!reader.isValid() || !reader.isAtEnd()) {
+        std::cerr << "[!] The scan index is damaged, scanning the volume" << std::endl;
+        return false;
+    }
+
+    utils.printHeader("File Search (scan index):");
+    utils.openLogFile();
+    for (const NTFSFileInfo& fileInfo : indexedFiles) {
+        logFoundFile(fileInfo);
+    }
+    utils.closeLogFile();
+    recoveryList = std::move(indexedFiles);
+    arena.adopt(indexArena);
+    fileId = nextFileId;
+    utils.printFooter();
+    return true;
+}
+
 void NTFSRecovery::runLogicalDriveRecovery() {
-    scanForDeletedFiles();
+    // A matching index replaces the scan, every unfiltered scan refreshes it
+    if (scanFilter.isActive()) {
+        if (config.useIndex) std::cout << "[!] Filters are set, the scan index is not used" << std::endl;
+        if (config.resume) std::cout << "[!] Filters are set, the scan checkpoint is not used" << std::endl;
+        scanForDeletedFiles();
+    }
+    else if (!config.useIndex || !loadScanIndex()) {
+        scanForDeletedFiles();
+        saveScanIndex();
+    }
     recoverPartition();
+    if (config.carve) carveUnallocatedClusters();
+}
+// Carve files from the clusters the allocation bitmap reports as free
+void NTFSRecovery::carveUnallocatedClusters() {
+    if (!allocationBitmap) loadAllocationBitmap();
+
+    CarvingGeometry geometry = {
+        .firstClusterSector = clusterToSector(allocationBitmap->getFirstCluster()),
+        .sectorsPerCluster = driveInfo.bootSector.sectorsPerCluster,
+        .bytesPerSector = driveInfo.bootSector.bytesPerSector
+    };
+    FileCarver carver(*sectorReader, *allocationBitmap, geometry, utils, fileId);
+    carver.carveUnallocatedClusters();
+}
+
+// Sample the clusters recovery would read, the ranking goes to the content score log
+void NTFSRecovery::rankSelectedFiles(std::vector<NTFSFileInfo>& files) {
+    std::vector<ContentCandidate> candidates;
+    candidates.reserve(files.size());
+    for (const NTFSFileInfo& file : files) {
+        ContentCandidate candidate = { file.fileId, ScanFilter::joinPath(file.folder, file.fileName), file.fileSize, {}, {} };
+        if (file.nonResident) {
+            for (const DataRun& run : file.extents) {
+                candidate.extents.push_back({ run.lcn, run.length, run.sparse });
+            }
+        }
+        else {
+            candidate.residentData = file.data;
+        }
+        candidates.push_back(std::move(candidate));
+    }
+
+    RecoveryGeometry geometry = {
+        .firstCluster = 0,
+        .firstClusterSector = 0,
+        .sectorsPerCluster = driveInfo.bootSector.sectorsPerCluster,
+        .bytesPerSector = driveInfo.bootSector.bytesPerSector
+    };
+    ContentAnalyzer analyzer(*sectorReader, geometry, utils);
+    std::vector<ContentScore> scores = analyzer.rankFiles(candidates);
+    if (config.minConfidence == 0) return;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (scores[i].confidence >= config.minConfidence) files[kept++] = files[i];
+    }
+    std::cout << "[*] " << files.size() - kept << " files below " << config.minConfidence << "% confidence are not recovered" << std::endl;
+    files.resize(kept);
 }
 
 void NTFSRecovery::recoverPartition() {
     utils.printHeader("File Recovery and Analysis:");
     if (recoveryList.empty()) {
-        if (config.recover || config.analyze) std::cerr << "[-] No deleted files found" << std::endl;
-        else std::cout << "[!] Recovery or analysis is disabled. Use --recover and/or --analyze to proceed." << std::endl;
+        if (config.recover || config.analyze || config.scoreContent) std::cerr << (scanFilter.isActive() ? "[-] No deleted files match the filters" : "[-] No deleted files found") << std::endl;
+        else std::cout << "[!] Recovery or analysis is disabled. Use --recover, --analyze and/or --score to proceed." << std::endl;
 
         return;
     }
 
     std::vector<NTFSFileInfo> selectedDeletedFiles;
-    if (!config.targetCluster && !config.targetFileSize) {
+    // Filtered and --all runs are scripted, nobody is there to answer
+    if (!config.recoverAll && !scanFilter.isActive()) {
         selectedDeletedFiles = selectFilesToRecover(recoveryList);
         utils.printItemDivider();
     }
     else {
-        selectedDeletedFiles = recoveryList;
+        // Files recovered while the scan was running are on disk already
+        selectedDeletedFiles.assign(recoveryList.begin() + recoveredDuringScan, recoveryList.end());
+        if (recoveredDuringScan > 0) std::cout << "[*] " << recoveredDuringScan << " files were recovered during the scan" << std::endl;
     }
 
-    for (const auto& file : selectedDeletedFiles) {
-        processFileForRecovery(file);
+    if (config.scoreContent) {
+        rankSelectedFiles(selectedDeletedFiles);
+        if (!config.recover && !config.analyze) return;
     }
+
+    ScopedTimer timer(MetricPhase::RECOVERY);
+    recoverFiles(selectedDeletedFiles);
 }
 
-void NTFSRecovery::processFileForRecovery(const NTFSFileInfo& fileInfo) {
-    bool isExtensionPredicted = false;
+void NTFSRecovery::recoverFiles(const std::vector<NTFSFileInfo>& files, const std::function<void(uint32_t)>& onRecovered) {
+    // Files are recovered in on-disk order, several at a time when there is nothing to analyze
+    RecoveryScheduler scheduler;
+    for (size_t i = 0; i < files.size(); i++) {
+        // Resident data was read with the MFT, those files need no seeking at all
+        const NTFSFileInfo& file = files[i];
+        auto extent = std::find_if(file.extents.begin(), file.extents.end(), [](const DataRun& run) { return !run.sparse; });
+        scheduler.addFile(i, file.nonResident && extent != file.extents.end() ? clusterToSector(extent->lcn) : 0);
+    }
 
-    // Skip files that don't match the target cluster and size (if specified)
-    if (fileInfo.fileSize <= 0 || (config.targetCluster && config.targetFileSize && (fileInfo.cluster != config.targetCluster || fileInfo.fileSize != config.targetFileSize))) {
+    // Batches recovered during the scan always report single lines, the scan prints between them
+    bool duringScan = static_cast<bool>(onRecovered);
+    if (!duringScan) {
+        concurrentRecovery = scheduler.getWorkerCount() > 1;
+        if (concurrentRecovery) {
+            std::cout << "[*] Recovering " << files.size() << " files with " << scheduler.getWorkerCount() << " workers" << std::endl;
+        }
+    }
+    scheduler.run([&](size_t index) {
+        processFileForRecovery(files[index]);
+        if (onRecovered) onRecovered(files[index].fileId);
+    });
+    if (!duringScan) concurrentRecovery = false;
+}
+
+void NTFSRecovery::processFileForRecovery(const NTFSFileInfo& fileInfo) {
+    // The target cluster and size were already applied by the scan filter
+    if (fileInfo.fileSize <= 0) {
         return;
     }
 
 
-    fs::path outputPath = utils.getOutputPath(fileInfo.fileName, config.outputFolder);
     uint64_t expectedSize = fileInfo.fileSize;
-
     NTFSRecoveryStatus status = {};
 
+    std::wstring fileName(fileInfo.fileName);
+    // Damaged extension, guess it from the first bytes. Names without an extension are kept as they are.
+    if (utils.hasDamagedExtension(fileName)) {
+        fileName.erase(fileName.find_last_of(L'.'));
+        fileName += L"." + predictExtension(fileInfo);
+        status.hasInvalidExtension = true;
+    }
+
+    fs::path outputPath = utils.getOutputPath(fileName, config.outputFolder);
+
 
     status.expectedClusters = (expectedSize + driveInfo.bytesPerCluster - 1) / driveInfo.bytesPerCluster;
 
-    std::wcout << "[*] Current file: " << outputPath.filename() << " (" << expectedSize << " bytes)" << std::endl;
+    if (reportsFileDetails() || config.analyze) std::wcout << "[*] Current file: " << outputPath.filename() << " (" << expectedSize << " bytes)" << std::endl;
 
 
     if (fileInfo.nonResident) {
-        std::vector<uint64_t> clusterChain = validateClusterChain(status, fileInfo, expectedSize, outputPath, isExtensionPredicted);
-        if (config.recover) {
-            recoverNonResidentFile(clusterChain, status, outputPath, expectedSize);
+        bool isRecoverable = validateExtents(status, fileInfo);
+        if (config.recover && isRecoverable) {
+            recoverNonResidentFile(fileInfo, status, outputPath, expectedSize);
         }
     }
     else {
@@ -463,70 +1281,175 @@ void NTFSRecovery::processFileForRecovery(const NTFSFileInfo& fileInfo) {
             recoverResidentFile(fileInfo, outputPath);
         }
     }
-    utils.printItemDivider();
+    if (reportsFileDetails() || config.analyze) utils.printItemDivider();
 }
 
 void NTFSRecovery::recoverResidentFile(const NTFSFileInfo& fileInfo, const fs::path& outputPath) {
-    std::cout << "[*] Recovering file..." << std::endl;
+    if (reportsFileDetails()) std::cout << "[*] Recovering file..." << std::endl;
     std::ofstream outputFile(outputPath, std::ios::binary);
     if (!outputFile) {
         throw std::runtime_error("[-] Failed to create output file.");
     }
     outputFile.write(reinterpret_cast<const char*>(fileInfo.data.data()), fileInfo.data.size());
     outputFile.close();
-    showRecoveryResult(outputPath);
+    // Nothing is hashed or counted for a file that didn't reach the disk
+    if (!outputFile) {
+        std::cerr << "\n[-] Failed to write to the output file" << std::endl;
+        return;
+    }
+
+    FileHasher hasher;
+    if (hasher.isEnabled()) {
+        hasher.update(fileInfo.data.data(), fileInfo.data.size());
+        utils.logFileDigests(fileInfo.fileId, outputPath, fileInfo.data.size(), fileInfo.data.size(), hasher.finish());
+    }
+    Metrics::getInstance().add(MetricCounter::FILES_RECOVERED);
+    Metrics::getInstance().add(MetricCounter::BYTES_RECOVERED, fileInfo.data.size());
+    if (!reportsFileDetails()) utils.logRecoveredFile(outputPath, fileInfo.data.size(), fileInfo.data.size());
+    else showRecoveryResult(outputPath);
 }
 
-std::vector<uint64_t> NTFSRecovery::validateClusterChain(NTFSRecoveryStatus& status, const NTFSFileInfo& fileInfo, uint64_t expectedSize, const fs::path& outputPath, bool isExtensionPredicted) {
-    if (config.analyze) std::cout << "[!] Corruption analysis is not yet implemented for NTFS volumes." << std::endl;
-    std::set<uint64_t> usedClusters;
-    std::vector<uint64_t> clusterChain;
+bool NTFSRecovery::validateExtents(NTFSRecoveryStatus& status, const NTFSFileInfo& fileInfo) {
+    if (config.analyze) std::cout << "[*] Analyzing file extents..." << std::endl;
 
-    uint64_t startCluster = fileInfo.cluster;
-    uint64_t length = fileInfo.runLength;
-    for (uint64_t i = 0; i < length; ++i) {
-        uint64_t currentCluster = startCluster + i;
+    uint64_t totalClusters = driveInfo.bootSector.totalSectors / driveInfo.bootSector.sectorsPerCluster;
+    uint64_t mappedClusters = 0;
+    for (const DataRun& extent : fileInfo.extents) {
+        if (!extent.sparse && (extent.lcn + extent.length > totalClusters || extent.lcn + extent.length < extent.lcn)) {
+            std::cerr << "[-] Extent at cluster " << extent.lcn << " (" << extent.length << " clusters) is outside the volume" << std::endl;
+            status.isCorrupted = true;
+            return false;
+        }
+        mappedClusters += extent.length;
+    }
+
+    if (mappedClusters < status.expectedClusters) {
+        std::cout << "[!] Extents cover " << mappedClusters << " of " << status.expectedClusters
+            << " clusters, the end of the file will be missing" << std::endl;
+    }
 
-        // Avoid duplicates
-        if (usedClusters.insert(currentCluster).second) {
-            clusterChain.push_back(currentCluster);
+    // Clusters of a deleted file that are allocated again belong to another file now
+    if (config.analyze) {
+        if (!allocationBitmap) loadAllocationBitmap();
+
+        uint64_t allocatedClusters = 0;
+        for (const DataRun& extent : fileInfo.extents) {
+            if (!extent.sparse) allocatedClusters += allocationBitmap->countAllocated(extent.lcn, extent.length);
+        }
+
+        if (allocatedClusters > 0) {
+            status.isCorrupted = true;
+            status.hasOverwrittenClusters = true;
+            std::cout << "  [-] " << allocatedClusters << " of " << mappedClusters << " clusters are in use by other files" << std::endl;
+        }
+        else {
+            std::cout << "  [+] None of the file's clusters are in use" << std::endl;
         }
     }
-    return clusterChain;
+    return mappedClusters > 0;
 }
 
-void NTFSRecovery::recoverNonResidentFile(const std::vector<uint64_t>& clusterChain, NTFSRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize) {
-    std::cout << "[*] Recovering file..." << std::endl;
-    std::ofstream outputFile(outputPath, std::ios::binary);
-    if (!outputFile) {
-        throw std::runtime_error("[-] Failed to create output file.");
+void NTFSRecovery::loadAllocationBitmap() {
+    uint64_t totalClusters = driveInfo.bootSector.totalSectors / driveInfo.bootSector.sectorsPerCluster;
+    allocationBitmap = std::make_unique<AllocationBitmap>(0, totalClusters);
+
+    // The first MFT records are always stored right at mftCluster
+    uint32_t sectorsPerMftRecord = getSectorsPerMftRecord();
+    uint32_t recordBytes = sectorsPerMftRecord * driveInfo.bootSector.bytesPerSector;
+    uint64_t recordSector = clusterToSector(driveInfo.bootSector.mftCluster) + static_cast<uint64_t>(BITMAP_RECORD) * sectorsPerMftRecord;
+    std::vector<uint8_t> mftBuffer(recordBytes);
+
+    if (!readMftRecord(mftBuffer, sectorsPerMftRecord, recordSector) ||
+        !isValidFileRecord(reinterpret_cast<const MFTEntryHeader*>(mftBuffer.data())) || !applyFixups(mftBuffer.data(), recordBytes)) {
+        std::cerr << "[!] Failed to read $Bitmap, clusters are treated as free" << std::endl;
+        return;
     }
-    // Recovery
-    for (uint64_t cluster : clusterChain) {
-        uint64_t sector = clusterToSector(cluster);
 
-        for (uint64_t i = 0; i < driveInfo.bootSector.sectorsPerCluster; ++i) {
-            std::vector<uint8_t> sectorBuffer(driveInfo.bootSector.bytesPerSector);
-            if (!readSector(sector + i, sectorBuffer.data(), driveInfo.bootSector.bytesPerSector)) {
-                continue;
-            }
+    const MFTEntryHeader* entry = reinterpret_cast<const MFTEntryHeader*>(mftBuffer.data());
+    uint32_t attributeOffset = entry->firstAttributeOffset;
+    while (attributeOffset + sizeof(AttributeHeader) <= recordBytes) {
+        const AttributeHeader* attr = reinterpret_cast<const AttributeHeader*>(mftBuffer.data() + attributeOffset);
+        if (attr->type == 0xFFFFFFFF) break;
+        if (attr->length == 0 || attributeOffset + attr->length > recordBytes) break;
 
-            uint64_t bytesToWrite = (std::min)(
-                static_cast<uint64_t>(driveInfo.bootSector.bytesPerSector),
-                expectedSize - status.recoveredBytes
-                );
+        // Unnamed non-resident $DATA
+        if (attr->type == 0x80 && attr->nonResident && attr->nameLength == 0) {
+            const uint8_t* attrData = mftBuffer.data() + attributeOffset;
+            const NonResidentAttributeHeader* nonResident = reinterpret_cast<const NonResidentAttributeHeader*>(attrData);
+            if (nonResident->dataRunOffset >= attr->length) break;
 
-            outputFile.write(reinterpret_cast<char*>(sectorBuffer.data()), bytesToWrite);
-            status.recoveredBytes += bytesToWrite;
-            utils.showProgress(status.recoveredBytes, expectedSize);
+            uint64_t bitmapBytes = (std::min)(nonResident->realSize, (totalClusters + 7) / 8);
+            std::vector<uint8_t> bitmapData;
+            if (!readBitmapData(parseDataRuns(attrData + nonResident->dataRunOffset, attrData + attr->length), bitmapBytes, bitmapData)) {
+                break;
+            }
 
-            if (status.recoveredBytes >= expectedSize) break;
+            allocationBitmap->loadFromBytes(bitmapData.data(), bitmapBytes);
+            std::cout << "[*] Allocation bitmap loaded, " << allocationBitmap->countAllocated() << " of "
+                << totalClusters << " clusters in use" << std::endl;
+            return;
         }
-        status.recoveredClusters++;
-        if (status.recoveredBytes >= expectedSize) break;
+        attributeOffset += attr->length;
+    }
+    std::cerr << "[!] Failed to read $Bitmap, clusters are treated as free" << std::endl;
+}
+
+bool NTFSRecovery::readBitmapData(const std::vector<DataRun>& runs, uint64_t bitmapBytes, std::vector<uint8_t>& bitmapData) {
+    uint32_t sectorsPerCluster = driveInfo.bootSector.sectorsPerCluster;
+    uint64_t clustersPerRead = (std::max)(1u, BITMAP_CHUNK_BYTES / driveInfo.bytesPerCluster);
+    uint64_t clusterCount = 0;
+    for (const DataRun& run : runs) clusterCount += run.length;
+    if (clusterCount * driveInfo.bytesPerCluster < bitmapBytes) return false;
+
+    bitmapData.assign(clusterCount * driveInfo.bytesPerCluster, 0);
+    uint8_t* destination = bitmapData.data();
+    for (const DataRun& run : runs) {
+        if (!run.sparse) {
+            // Read the run in pieces that fit a single request
+            for (uint64_t offset = 0; offset < run.length; ) {
+                uint64_t pieceClusters = (std::min)(run.length - offset, clustersPerRead);
+                if (!readSectors(clusterToSector(run.lcn + offset), static_cast<uint32_t>(pieceClusters * sectorsPerCluster), destination + offset * driveInfo.bytesPerCluster)) {
+                    return false;
+                }
+                offset += pieceClusters;
+            }
+        }
+        destination += run.length * driveInfo.bytesPerCluster;
+    }
+    return true;
+}
+
+void NTFSRecovery::recoverNonResidentFile(const NTFSFileInfo& fileInfo, NTFSRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize) {
+    if (reportsFileDetails()) std::cout << "[*] Recovering file..." << std::endl;
+    std::vector<FileExtent> extents;
+    extents.reserve(fileInfo.extents.size());
+    for (const DataRun& extent : fileInfo.extents) {
+        extents.push_back({ extent.lcn, extent.length, extent.sparse });
+    }
+
+    RecoveryGeometry geometry = {
+        .firstCluster = 0,
+        .firstClusterSector = 0,
+        .sectorsPerCluster = driveInfo.bootSector.sectorsPerCluster,
+        .bytesPerSector = driveInfo.bootSector.bytesPerSector
+    };
+    RecoveryPipeline pipeline(*sectorReader, geometry, utils);
+    pipeline.setReportProgress(!concurrentRecovery);
+    PipelineResult result = pipeline.recoverFile(extents, expectedSize, outputPath);
+    status.recoveredBytes += result.recoveredBytes;
+    status.recoveredClusters += result.recoveredClusters;
+    status.unreadableBytes += result.unreadableBytes;
+    status.problematicClusters.insert(status.problematicClusters.end(), result.problematicClusters.begin(), result.problematicClusters.end());
+    if (!result.writeFailed) utils.logFileDigests(fileInfo.fileId, outputPath, result.recoveredBytes, expectedSize, std::move(result.digests));
+
+    if (!reportsFileDetails()) {
+        utils.logRecoveredFile(outputPath, status.recoveredBytes, expectedSize, status.unreadableBytes);
+        return;
     }
-    outputFile.close();
     std::cout << "\n";
+    if (status.unreadableBytes > 0) {
+        std::cout << "  [-] Unreadable bytes written as zeros: " << status.unreadableBytes << std::endl;
+    }
     showRecoveryResult(outputPath);
 }
 
@@ -543,7 +1466,8 @@ void NTFSRecovery::showRecoveryResult(const fs::path& outputPath) const {
 /* Entry point */
 void NTFSRecovery::startRecovery() {
 
-    if (this->driveType == DriveType::LOGICAL_TYPE) runLogicalDriveRecovery();
+    // A partition of a physical drive or an image is read through a partition relative reader, like a volume
+    if (this->driveType == DriveType::LOGICAL_TYPE || this->driveType == DriveType::PHYSICAL_TYPE || this->driveType == DriveType::IMAGE_TYPE) runLogicalDriveRecovery();
     else {
         throw std::runtime_error("Unknown drive type.");
     }
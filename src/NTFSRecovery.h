@@ -2,12 +2,26 @@
 #include "IConfigurable.h"
 #include "NTFSStructs.h"
 #include "Utils.h"
-#include "LogicalDriveReader.h"
+#include "SectorReader.h"
 #include "SectorReader.h"
 #include "Enums.h"
+#include "ThreadPool.h"
+#include "AllocationBitmap.h"
+#include "FileCarver.h"
+#include "RecoveryPipeline.h"
+#include "RecoveryScheduler.h"
+#include "ContentAnalyzer.h"
+#include "SignatureDB.h"
+#include "ScanIndex.h"
+#include "ScanCheckpoint.h"
+#include "ScanFilter.h"
+#include "MetadataArena.h"
 
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
 #include <filesystem>
@@ -17,6 +31,15 @@ namespace fs = std::filesystem;
 
 class NTFSRecovery : public IConfigurable{
 private:
+    static constexpr uint32_t MFT_CHUNK_BYTES = 4 * 1024 * 1024; // MFT bytes read per request while scanning
+    static constexpr uint32_t FIXUP_STRIDE = 512;                // Bytes covered by one update sequence entry
+    static constexpr uint32_t BITMAP_CHUNK_BYTES = 1024 * 1024;   // Largest single read while loading $Bitmap
+    static constexpr uint32_t BITMAP_RECORD = 6;                  // MFT record of $Bitmap
+    static constexpr uint64_t ROOT_DIRECTORY_RECORD = 5;
+    static constexpr uint64_t MFT_REFERENCE_MASK = 0x0000FFFFFFFFFFFF; // Record number part of a file reference
+    static constexpr size_t MAX_PATH_DEPTH = 256;                 // Longer parent chains are treated as loops
+    static constexpr const wchar_t* ORPHAN_FOLDER = L"$Orphan";   // Files whose parent chain is broken
+
     const DriveType& driveType;
 
     struct DriveInfo {
@@ -29,15 +52,52 @@ private:
 
     Utils utils;
 
+    // Name and parent of a directory record, collected only when the paths of files are tracked
+    struct DirectoryLink {
+        uint64_t recordNumber;
+        uint64_t parentRecord;
+        std::wstring name;
+    };
+
+    // Deleted files found in one MFT chunk, a worker stores their names and data in its own arena
+    struct MftChunkResult {
+        std::vector<NTFSFileInfo> files;
+        std::vector<uint64_t> parentRecords;    // Parent directory of every file, only when paths are tracked
+        std::vector<DirectoryLink> directories; // Only when paths are tracked
+        MetadataArena arena;
+        // Runs and widened name of the record being parsed, copied to the arena once the file is accepted
+        std::vector<DataRun> pendingRuns;
+        std::wstring pendingName;
+    };
+
+    // What an unfiltered scan listed before it ended, a checkpoint stores it
+    struct MftScanProgress {
+        uint64_t releasedChunks = 0;            // Chunks whose files are in the recovery list
+        std::vector<uint64_t> parentRecords;    // Parent directory of every listed file, only when paths are tracked
+        std::vector<DirectoryLink> directories; // Directories of the chunks a resumed scan skipped
+        std::vector<uint32_t> recoveredIds;     // Recovered files after recoveredDuringScan
+        IndexWriter files;                      // Listed files and their parents, serialized
+        IndexWriter links;                      // Directories of the released chunks, serialized
+    };
+
     std::unique_ptr<SectorReader> sectorReader;
+    MetadataArena arena; // Names, extents and resident data of recoveryList
     std::vector<NTFSFileInfo> recoveryList;
-    uint16_t fileId = 1;
+    bool concurrentRecovery = false; // Several workers recover files, each reports a single line
+    // A single worker prints a report for every file, unless --quiet is set
+    bool reportsFileDetails() const { return !concurrentRecovery && !config.quiet; }
+    ScanFilter scanFilter;
+    std::unique_ptr<AllocationBitmap> allocationBitmap; // Loaded from $Bitmap on first use
+    uint32_t fileId = 1;
+    size_t recoveredDuringScan = 0; // Files at the start of recoveryList that were recovered while scanning
 
     void printToolHeader() const;
 
     // Set the sector reader implementation
     void setSectorReader(std::unique_ptr<SectorReader> reader);
     bool readSector(uint64_t sector, void* buffer, uint32_t size);
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer);
+    bool readBatch(std::vector<ReadRequest>& requests);
     void readBootSector(uint64_t sector);
     uint32_t getBytesPerSector();
     uint64_t getTotalMftRecords();
@@ -49,27 +109,81 @@ private:
     bool isValidFileRecord(const MFTEntryHeader* entry) const;
     bool validateFileInfo(const NTFSFileInfo& fileInfo) const;
     void clearFileInfo(NTFSFileInfo& fileInfo) const;
+    // Decode a run list, stops at the terminator, at runListEnd or at an out of range cluster
+    std::vector<DataRun> parseDataRuns(const uint8_t* runList, const uint8_t* runListEnd) const;
+    // Restore the sector tails protected by the update sequence array, false if the record is torn
+    bool applyFixups(uint8_t* record, uint32_t recordSize) const;
 
 
     /* Search for deleted files */
     void scanForDeletedFiles();
     void scanMFT();
-    void processMftRecord(std::vector<uint8_t>& mftBuffer);
+    // Get the $MFT's own data runs and record count from record 0
+    bool readMftLayout(uint64_t mftSector, uint32_t sectorsPerMftRecord, std::vector<DataRun>& mftRuns, uint64_t& totalMftRecords);
+    // Read the next sectorCount sectors of the MFT stream, advancing the run position
+    bool readMftChunk(const std::vector<DataRun>& mftRuns, size_t& runIndex, uint64_t& runSectorOffset, uint64_t sectorCount, uint8_t* buffer, uint64_t& sectorsRead);
+    // Advance the run position past sectorCount sectors without reading them
+    void skipMftSectors(const std::vector<DataRun>& mftRuns, size_t& runIndex, uint64_t& runSectorOffset, uint64_t sectorCount) const;
+    // Restore the files of an interrupted scan from its checkpoint, false if the scan starts from the first record
+    bool resumeMftScan(const ScanCheckpoint& checkpoint, uint32_t recordsPerChunk, uint64_t chunkCount, MftScanProgress& progress);
+    // Map the next sectorCount sectors of the MFT stream in place, false if a piece can't be mapped
+    bool mapMftChunk(const std::vector<DataRun>& mftRuns, size_t& runIndex, uint64_t& runSectorOffset, uint64_t sectorCount, uint32_t sectorsPerMftRecord, std::vector<SectorSpan>& pieces, uint64_t& sectorsRead);
+    // Fix up and parse recordCount records of a chunk, deleted files are appended to results
+    void parseMftChunk(uint8_t* chunk, uint64_t recordCount, uint32_t recordBytes, MftChunkResult& results) const;
+    // Parse mapped records, only deleted ones are copied to apply their fixups
+    void parseMappedMftChunk(const std::vector<SectorSpan>& pieces, uint32_t recordBytes, MftChunkResult& results) const;
+    // Accepted files are copied out of the record into the chunk's arena
+    void processMftRecord(const uint8_t* record, MftChunkResult& results) const;
     bool readMftRecord(std::vector<uint8_t>& mftBuffer, const uint32_t sectorsPerMftRecord, const uint64_t currentSector);
-    void processAttribute(const std::vector<uint8_t>& mftBuffer, NTFSFileInfo& fileInfo, uint32_t attributeOffset, bool& hasFileName, bool& hasData, bool isDeleted);
-    void processFileNameAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo);
-    void processDataAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo);
+    void processAttribute(const uint8_t* record, NTFSFileInfo& fileInfo, MftChunkResult& results, uint32_t attributeOffset, bool& hasFileName, bool& hasData, bool isDeleted) const;
+    void processFileNameAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo, MftChunkResult& results) const;
+    void processDataAttribute(const AttributeHeader* attr, const uint8_t* attrData, bool isDeleted, NTFSFileInfo& fileInfo, MftChunkResult& results) const;
+    // Long name and parent directory record of a record, false without a $FILE_NAME attribute
+    bool readFileNameLink(const uint8_t* record, std::wstring& name, uint64_t& parentRecord) const;
+    // View of the name in the record where wchar_t is UTF-16, otherwise of a widened copy in widened
+    static std::wstring_view fileNameView(const FileNameAttribute* fnAttr, std::wstring& widened);
+    // Path of a directory below the root, under $Orphan when its parent chain is broken
+    const std::wstring& resolveDirectoryPath(uint64_t recordNumber, const std::unordered_map<uint64_t, const DirectoryLink*>& directories, std::unordered_map<uint64_t, std::wstring>& resolvedPaths) const;
     void addToRecoveryList(const NTFSFileInfo& fileInfo);
+    // Hand a found file to the result logger
+    void logFoundFile(const NTFSFileInfo& fileInfo);
 
 
+    // Predict file extension from the first bytes of the file
+    std::wstring predictExtension(const NTFSFileInfo& fileInfo);
+
+    /* Corruption analysis */
+    // Load $Bitmap, clusters stay free if it can't be read
+    void loadAllocationBitmap();
+    bool readBitmapData(const std::vector<DataRun>& runs, uint64_t bitmapBytes, std::vector<uint8_t>& bitmapData);
+
     /* Recover files */
     std::vector<NTFSFileInfo> selectFilesToRecover(const std::vector<NTFSFileInfo>& recoveryList);
+    // Score the content of the selected files, files below the minimum confidence are dropped
+    void rankSelectedFiles(std::vector<NTFSFileInfo>& files);
+    /*=============== Scan index ===============*/
+    // Identify the volume state, loads $Bitmap on first use
+    VolumeKey getVolumeKey();
+    // Record format shared by the scan index and the scan checkpoint
+    static void writeIndexRecord(IndexWriter& writer, const NTFSFileInfo& fileInfo);
+    static void readIndexRecord(IndexReader& reader, NTFSFileInfo& fileInfo, MetadataArena& recordArena, std::vector<DataRun>& runs);
+    // Persist the recovery list so a later run with --use-index can skip the scan
+    void saveScanIndex();
+    // Fill the recovery list from the index, false if it is missing or outdated
+    bool loadScanIndex();
+
     void runLogicalDriveRecovery();
+    // Carve signatures from free clusters, after the directory based recovery
+    void carveUnallocatedClusters();
     void recoverPartition();
+    // Recover files in on-disk order. Batches recovered during the scan report every finished file to onRecovered.
+    void recoverFiles(const std::vector<NTFSFileInfo>& files, const std::function<void(uint32_t)>& onRecovered = nullptr);
     void processFileForRecovery(const NTFSFileInfo& fileInfo);
     void recoverResidentFile(const NTFSFileInfo& fileInfo, const fs::path& outputPath);
-    std::vector<uint64_t> validateClusterChain(NTFSRecoveryStatus& status, const NTFSFileInfo& fileInfo, uint64_t expectedSize, const fs::path& outputPath, bool isExtensionPredicted);
-    void recoverNonResidentFile(const std::vector<uint64_t>& clusterChain, NTFSRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize);
+    // Check the extents against the volume and the file size, false if the file can't be recovered
+    bool validateExtents(NTFSRecoveryStatus& status, const NTFSFileInfo& fileInfo);
+    // Stream every extent to the output file, sparse extents are written as zeros
+    void recoverNonResidentFile(const NTFSFileInfo& fileInfo, NTFSRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize);
 
     void showRecoveryResult(const fs::path& outputPath) const;
 
@@ -1,18 +1,29 @@
 #pragma once
 #include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #pragma pack(push, 1)
 
+// Decoded entry of a non-resident attribute's run list
+struct DataRun {
+    uint64_t lcn;    // first cluster of the run
+    uint64_t length; // in clusters
+    bool sparse;     // run has no clusters on disk
+};
+
+// Scan result, the name, extents and resident data are views into a MetadataArena
 struct NTFSFileInfo {
-    std::wstring fileName;
-    uint16_t fileId;
+    std::wstring_view fileName;
+    std::wstring_view folder; // Relative to the volume root, empty if paths weren't tracked
+    uint32_t fileId;
     uint64_t fileSize;
-    uint64_t cluster; // non-resident
-    uint64_t runLength; // non-resident
-    std::vector<uint8_t> data; // resident
+    uint64_t cluster; // non-resident, first allocated cluster
+    std::span<const DataRun> extents; // non-resident, in file order
+    std::span<const uint8_t> data; // resident
     bool nonResident;
 };
 
@@ -105,7 +116,7 @@ struct FileNameAttribute {
     uint32_t reparseValue;
     uint8_t  nameLength;
     uint8_t  nameType;
-    wchar_t  name[1];
+    char16_t name[1];   // UTF-16, wchar_t is wider outside of Windows
 };
 
 struct NTFSRecoveryStatus {
@@ -124,6 +135,7 @@ struct NTFSRecoveryStatus {
     uint64_t expectedClusters;
     uint64_t recoveredClusters;
     uint64_t recoveredBytes;
+    uint64_t unreadableBytes; // Written as zeros
     std::vector<uint64_t> problematicClusters;
 };
 
@@ -0,0 +1,51 @@
+#include "NameRegistry.h"
+#include <cwctype>
+
+
+std::wstring NameRegistry::toLower(std::wstring_view value) {
+    std::wstring lower(value);
+    for (wchar_t& c : lower) {
+        c = static_cast<wchar_t>(std::towlower(c));
+    }
+    return lower;
+}
+
+NameRegistry::FolderNames& NameRegistry::getFolder(const fs::path& folder) {
+    std::wstring key = toLower(folder.lexically_normal().wstring());
+    auto it = folders.find(key);
+    if (it != folders.end()) {
+        return it->second;
+    }
+
+    // Files left by earlier runs, a missing folder simply has none yet
+    FolderNames& entry = folders[key];
+    std::error_code error;
+    for (fs::directory_iterator file(folder, error), end; !error && file != end; file.increment(error)) {
+        entry.names.insert(toLower(file->path().filename().wstring()));
+    }
+    return entry;
+}
+
+fs::path NameRegistry::reserve(std::wstring_view fullName, const std::wstring& folder) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    FolderNames& entry = getFolder(fs::path(folder));
+
+    std::wstring name(fullName);
+    std::wstring lowerName = toLower(fullName);
+    if (entry.names.count(lowerName) != 0) {
+        size_t dotPos = name.find_last_of(L".");
+        bool hasExtension = dotPos != std::wstring::npos && dotPos != 0;
+        std::wstring fileName = hasExtension ? name.substr(0, dotPos) : name;
+        std::wstring extension = hasExtension ? name.substr(dotPos) : L"";
+
+        // Continue where the last duplicate of this name stopped instead of counting up from 1 again
+        uint32_t& counter = entry.nextSuffix[lowerName];
+        if (counter == 0) counter = 1;
+        do {
+            name = fileName + L"_" + std::to_wstring(counter++) + extension;
+        } while (entry.names.count(toLower(name)) != 0);
+    }
+
+    entry.names.insert(toLower(name));
+    return fs::path(folder) / name;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+// Output names taken in each folder, so unique names are picked without probing the disk per file.
+// A folder is listed once on first use, after that every handed out name is recorded in memory.
+// Names are compared case insensitively like on NTFS and FAT volumes.
+class NameRegistry {
+private:
+    struct FolderNames {
+        std::unordered_set<std::wstring> names;             // Lower case
+        std::unordered_map<std::wstring, uint32_t> nextSuffix; // Next counter to try per requested name
+    };
+
+    std::unordered_map<std::wstring, FolderNames> folders; // By lower case folder path
+    std::mutex registryMutex; // Workers recover files concurrently
+
+    static std::wstring toLower(std::wstring_view value);
+    FolderNames& getFolder(const fs::path& folder);
+
+public:
+    // Reserve fullName in folder, or name_N.ext when it is taken
+    fs::path reserve(std::wstring_view fullName, const std::wstring& folder);
+};
@@ -0,0 +1,228 @@
+#ifdef _WIN32
+#include "OverlappedDriveReader.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+
+OverlappedDriveReader::OverlappedDriveReader(const std::wstring& path, uint32_t queueDepth)
+    : hDrive(INVALID_HANDLE_VALUE)
+    , hCompletionPort(NULL)
+    , drivePath(path)
+    , queueDepth((std::max)(1u, queueDepth))
+    , metadataReader(path) {
+    bytesPerSector = metadataReader.getBytesPerSector();
+    if (bytesPerSector == 0 || SLOT_BYTES % bytesPerSector != 0) {
+        throw std::runtime_error("Unsupported sector size for overlapped I/O");
+    }
+    if (!openDrive() || !allocateSlots()) {
+        close();
+        releaseSlots();
+        throw std::runtime_error("Failed to initialize overlapped drive reader");
+    }
+}
+
+OverlappedDriveReader::~OverlappedDriveReader() {
+    close();
+    releaseSlots();
+}
+
+bool OverlappedDriveReader::openDrive() {
+    close(); // Ensure any existing handle is closed
+
+    hDrive = CreateFileW(
+        drivePath.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, // Asynchronous, bypasses the cache manager
+        NULL
+    );
+
+    if (hDrive == INVALID_HANDLE_VALUE) {
+        DWORD error = GetLastError();
+        if (error == ERROR_ACCESS_DENIED) {
+            throw std::runtime_error("Administrator privileges required");
+        }
+        return false;
+    }
+
+    hCompletionPort = CreateIoCompletionPort(hDrive, NULL, 0, 0);
+    if (hCompletionPort == NULL) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool OverlappedDriveReader::allocateSlots() {
+    // VirtualAlloc returns page aligned memory which satisfies the FILE_FLAG_NO_BUFFERING alignment rules
+    slotMemory = static_cast<uint8_t*>(VirtualAlloc(NULL, static_cast<SIZE_T>(queueDepth) * SLOT_BYTES, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if (!slotMemory) {
+        return false;
+    }
+
+    slots.resize(queueDepth);
+    for (uint32_t i = 0; i < queueDepth; i++) {
+        slots[i] = {};
+        slots[i].buffer = slotMemory + static_cast<uint64_t>(i) * SLOT_BYTES;
+    }
+    return true;
+}
+
+void OverlappedDriveReader::releaseSlots() {
+    slots.clear();
+    if (slotMemory) {
+        VirtualFree(slotMemory, 0, MEM_RELEASE);
+        slotMemory = nullptr;
+    }
+}
+
+bool OverlappedDriveReader::reopen() {
+    return openDrive();
+}
+
+void OverlappedDriveReader::close() {
+    if (hCompletionPort != NULL) {
+        CloseHandle(hCompletionPort);
+        hCompletionPort = NULL;
+    }
+    if (hDrive != INVALID_HANDLE_VALUE) {
+        CloseHandle(hDrive);
+        hDrive = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool OverlappedDriveReader::submitChunk(IoSlot& slot, const IoChunk& chunk) {
+    std::memset(&slot.overlapped, 0, sizeof(slot.overlapped));
+    slot.overlapped.Offset = static_cast<DWORD>(chunk.byteOffset & 0xFFFFFFFF);
+    slot.overlapped.OffsetHigh = static_cast<DWORD>(chunk.byteOffset >> 32);
+    slot.destination = chunk.destination;
+    slot.length = chunk.length;
+    slot.requestIndex = chunk.requestIndex;
+    // Unbuffered reads only need sector alignment, aligned destinations skip the bounce buffer copy
+    slot.direct = reinterpret_cast<uintptr_t>(chunk.destination) % bytesPerSector == 0;
+    slot.submitTime = std::chrono::steady_clock::now();
+
+    // Completion is always posted to the port, even if ReadFile finishes synchronously
+    if (!ReadFile(hDrive, slot.direct ? slot.destination : slot.buffer, chunk.length, NULL, &slot.overlapped) && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    return true;
+}
+
+bool OverlappedDriveReader::runChunks(std::vector<IoChunk>& chunks, std::vector<ReadRequest>& requests) {
+    std::vector<IoSlot*> freeSlots;
+    for (IoSlot& slot : slots) {
+        freeSlots.push_back(&slot);
+    }
+
+    bool allSucceeded = true;
+    size_t nextChunk = 0;
+    uint32_t inFlight = 0;
+
+    while (nextChunk < chunks.size() || inFlight > 0) {
+        // Keep the queue full
+        while (nextChunk < chunks.size() && !freeSlots.empty()) {
+            const IoChunk& chunk = chunks[nextChunk++];
+            if (submitChunk(*freeSlots.back(), chunk)) {
+                freeSlots.pop_back();
+                inFlight++;
+            }
+            else {
+                requests[chunk.requestIndex].success = false;
+                allSucceeded = false;
+            }
+        }
+        if (inFlight == 0) break;
+
+        DWORD bytesTransferred = 0;
+        ULONG_PTR completionKey = 0;
+        LPOVERLAPPED overlapped = nullptr;
+        BOOL completed = GetQueuedCompletionStatus(hCompletionPort, &bytesTransferred, &completionKey, &overlapped, INFINITE);
+
+        if (overlapped == nullptr) {
+            // The port itself failed, nothing more will complete
+            std::cerr << "[-] I/O completion port failure. Error: " << GetLastError() << std::endl;
+            CancelIoEx(hDrive, NULL);
+            for (ReadRequest& request : requests) {
+                request.success = false;
+            }
+            close();
+            return false;
+        }
+
+        IoSlot* slot = reinterpret_cast<IoSlot*>(overlapped);
+        inFlight--;
+        bool success = completed && bytesTransferred == slot->length;
+        Metrics::getInstance().recordRead(slot->length, slot->submitTime, success);
+        if (success) {
+            if (!slot->direct) std::memcpy(slot->destination, slot->buffer, slot->length);
+            Metrics::getInstance().add(MetricCounter::SECTORS_READ, slot->length / bytesPerSector);
+        }
+        else {
+            requests[slot->requestIndex].success = false;
+            allSucceeded = false;
+        }
+        freeSlots.push_back(slot);
+    }
+    return allSucceeded;
+}
+
+bool OverlappedDriveReader::readBatch(std::vector<ReadRequest>& requests) {
+    std::lock_guard<std::mutex> lock(batchMutex);
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
+
+    // Split every request into slot sized chunks
+    std::vector<IoChunk> chunks;
+    for (size_t i = 0; i < requests.size(); i++) {
+        ReadRequest& request = requests[i];
+        request.success = true;
+
+        uint64_t byteOffset = request.startSector * bytesPerSector;
+        uint64_t remaining = static_cast<uint64_t>(request.sectorCount) * bytesPerSector;
+        uint8_t* destination = static_cast<uint8_t*>(request.buffer);
+        while (remaining > 0) {
+            uint32_t length = static_cast<uint32_t>((std::min)(remaining, static_cast<uint64_t>(SLOT_BYTES)));
+            chunks.push_back({ byteOffset, length, destination, i });
+            byteOffset += length;
+            destination += length;
+            remaining -= length;
+        }
+    }
+
+    return runChunks(chunks, requests);
+}
+
+bool OverlappedDriveReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    // Sizes that don't match the device geometry can't go through the unbuffered handle
+    if (size != bytesPerSector) {
+        return metadataReader.readSector(sector, buffer, size);
+    }
+    return readSectors(sector, 1, buffer);
+}
+
+bool OverlappedDriveReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    std::vector<ReadRequest> requests = { { startSector, count, buffer, false } };
+    return readBatch(requests);
+}
+
+uint32_t OverlappedDriveReader::getBytesPerSector() {
+    return bytesPerSector;
+}
+
+std::wstring OverlappedDriveReader::getFilesystemType() {
+    return metadataReader.getFilesystemType();
+}
+
+uint64_t OverlappedDriveReader::getTotalMftRecords() {
+    return metadataReader.getTotalMftRecords();
+}
+#endif // _WIN32
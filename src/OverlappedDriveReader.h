@@ -0,0 +1,73 @@
+#pragma once
+#include "SectorReader.h"
+#include "LogicalDriveReader.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <windows.h>
+#include <vector>
+#include <mutex>
+
+// Logical drive reader built on FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING and an I/O completion port.
+// Keeps up to queueDepth reads in flight, large requests are split into slot sized chunks.
+class OverlappedDriveReader : public SectorReader {
+private:
+    static constexpr uint32_t SLOT_BYTES = 1024 * 1024; // Size of one in-flight read
+
+    struct IoSlot {
+        OVERLAPPED overlapped;  // Must stay the first member, completions are mapped back to the slot
+        uint8_t* buffer;        // Sector aligned bounce buffer
+        uint8_t* destination;   // Caller's buffer
+        bool direct;            // Destination is sector aligned and read in place
+        uint32_t length;
+        size_t requestIndex;
+        std::chrono::steady_clock::time_point submitTime; // Start of the read latency
+    };
+
+    // Pending piece of a request that hasn't been submitted yet
+    struct IoChunk {
+        uint64_t byteOffset;
+        uint32_t length;
+        uint8_t* destination;
+        size_t requestIndex;
+    };
+
+    HANDLE hDrive;
+    HANDLE hCompletionPort;
+    std::wstring drivePath;
+    uint32_t queueDepth;
+    uint32_t bytesPerSector = 0;
+    uint8_t* slotMemory = nullptr;
+    std::vector<IoSlot> slots;
+    std::mutex batchMutex; // One batch owns the completion port at a time
+
+    // Geometry and volume queries go through a synchronous handle
+    LogicalDriveReader metadataReader;
+
+    bool openDrive();
+    bool allocateSlots();
+    void releaseSlots();
+    // Submit a chunk into a free slot, false if the read couldn't be started
+    bool submitChunk(IoSlot& slot, const IoChunk& chunk);
+    // Run all chunks through the queue and report failures into the requests
+    bool runChunks(std::vector<IoChunk>& chunks, std::vector<ReadRequest>& requests);
+
+public:
+    OverlappedDriveReader(const std::wstring& drivePath, uint32_t queueDepth);
+    ~OverlappedDriveReader() override;
+
+    // Delete copy constructor and assignment to prevent handle duplication
+    OverlappedDriveReader(const OverlappedDriveReader&) = delete;
+    OverlappedDriveReader& operator=(const OverlappedDriveReader&) = delete;
+
+    // Implement SectorReader interface
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    bool readBatch(std::vector<ReadRequest>& requests) override;
+    uint32_t getBytesPerSector() override;
+    std::wstring getFilesystemType() override;
+    uint64_t getTotalMftRecords() override;
+    bool isOpen() const override { return hDrive != INVALID_HANDLE_VALUE; }
+    bool reopen() override;
+    void close() override;
+};
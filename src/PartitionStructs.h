@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Enums.h"
+
+#pragma pack(push, 1)
+// Partition found in the MBR, an EBR chain or the GPT
+struct PartitionInfo {
+    uint32_t index;             // 1 based, in table order
+    uint64_t startSector;       // Absolute sector on the disk
+    uint64_t sectorCount;
+    PartitionType tableType;    // Table the partition was found in
+    FilesystemType fsType;      // Detected from the partition's boot sector
+};
+
+struct MBRPartitionEntry {
+    uint8_t BootIndicator; // 0x80 for bootable, 0x00 for non-bootable
+    uint8_t StartHead;
+    uint8_t StartSector; // lower 6 bits represent sector number
+    uint8_t StartCylinder;
+    uint8_t Type;      // File system type (e.g., NTFS, FAT32)
+    uint8_t EndHead;
+    uint8_t EndSector; // lower 6 bits represent sector number
+    uint8_t EndCylinder;
+    uint32_t StartLBA;     // Starting logical block address
+    uint32_t TotalSectors;  // Number of sectors in the partition
+};
+
+struct MBRHeader {
+    uint8_t bootCode[446];         // Bootstrap code (first 446 bytes)
+    MBRPartitionEntry PartitionTable[4];
+    uint16_t signature;            // Boot signature (0x55AA)
+};
+
+
+struct GPTHeader {
+    uint8_t  Signature[8];         // EFI PART (45 46 49 20 50 41 52 54)
+    uint32_t Revision;            // GPT Revision (usually 0x00010000 for version 1.0)
+    uint32_t HeaderSize;          // Size of GPT header (usually 92 bytes)
+    uint32_t HeaderCRC32;         // CRC32 of header
+    uint32_t Reserved;            // Must be zero
+    uint64_t CurrentLBA;          // Location of this header copy
+    uint64_t BackupLBA;           // Location of the other header copy
+    uint64_t FirstUsableLBA;      // First usable LBA for partitions
+    uint64_t LastUsableLBA;       // Last usable LBA for partitions
+    uint8_t  DiskGUID[16];        // Disk GUID (also known as UUID)
+    uint64_t PartitionEntryLBA;   // Starting LBA of partition entries
+    uint32_t NumberOfEntries;     // Number of partition entries
+    uint32_t SizeOfEntry;         // Size of a partition entry (usually 128)
+    uint32_t PartitionEntryArrayCRC32; // CRC32 of partition array
+    uint8_t  Reserved2[420];      // Reserved; must be zero for alignment
+};
+
+// GPT Partition Entry Structure
+struct GPTPartitionEntry {
+    uint8_t  PartitionTypeGUID[16];   // Partition type GUID
+    uint8_t  UniquePartitionGUID[16]; // Unique partition GUID
+    uint64_t StartingLBA;             // Starting LBA
+    uint64_t EndingLBA;               // Ending LBA
+    uint64_t Attributes;              // Partition attributes
+    uint16_t PartitionName[36];       // Partition name (72 bytes UTF-16LE).
+};
+#pragma pack(pop)
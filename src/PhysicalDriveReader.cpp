@@ -1,106 +1,188 @@
-//#include "PhysicalDriveReader.h"
-//
-//
-///*=============== Constructor & Destructor ===============*/
-//// Initialize reader with drive path
-//PhysicalDriveReader::PhysicalDriveReader(const std::wstring& drivePath, uint64_t startSector) : partitionOffset(startSector) {
-//    openDrive(drivePath);
-//}
-//// Ensure drive handle is closed
-//PhysicalDriveReader::~PhysicalDriveReader() {
-//    closeDrive();
-//}
-//
-//
-///*=============== Drive Access Methods ===============*/
-//// Read data from specified sector (implements SectorReader interface)
-//bool PhysicalDriveReader::getBytesPerSector(uint32_t& bytesPerSector) {
-//
-//    DISK_GEOMETRY dg;
-//    DWORD bytesReturned;
-//
-//    // Retrieve drive geometry using DeviceIoControl
-//    if (DeviceIoControl(hDrive, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &dg, sizeof(dg), &bytesReturned, NULL)) {
-//        bytesPerSector = dg.BytesPerSector;
-//        return true;
-//    }
-//    else {
-//        bytesPerSector = 0;
-//        return false;
-//    }
-//
-//}
-//
-//
-//std::wstring PhysicalDriveReader::getFilesystemType() {
-//    wchar_t fileSystemNameBuffer[MAX_PATH];
-//
-//    if (GetVolumeInformationByHandleW(
-//        hDrive,       
-//        NULL,                    // Volume name (not needed here)
-//        0,                       // Size of volume name buffer
-//        NULL,                    // Volume serial number
-//        NULL,                    // Maximum component length
-//        NULL,                    // File system flags
-//        fileSystemNameBuffer,    // File system name buffer
-//        MAX_PATH))               // Buffer size
-//    {
-//        std::wcout << L"Filesystem type is: " << fileSystemNameBuffer << std::endl;
-//        return std::wstring(fileSystemNameBuffer);
-//    }
-//    else {
-//        std::wcerr << L"Failed to retrieve filesystem type. Error: " << GetLastError() << std::endl;
-//        return L"";
-//    }
-//}
-//
-//// Get drive's bytes per sector (implements SectorReader interface)
-//bool PhysicalDriveReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
-//    LARGE_INTEGER offset;
-//    offset.QuadPart = (sector + partitionOffset) * size;
-//    DWORD bytesRead;
-//
-//    if (!SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN)) {
-//        std::cerr << "Failed to set file pointer to sector offset. (PhysicalDriveReader::readSector)" << std::endl;
-//        return false;
-//    }
-//
-//    if (!ReadFile(hDrive, buffer, size, &bytesRead, NULL)) {
-//        std::cerr << "Failed to read from drive. (PhysicalDriveReader::readSector)" << std::endl;
-//        return false;
-//    }
-//
-//    if (bytesRead != size) {
-//        std::cerr << "Incomplete sector read. (PhysicalDriveReader::readSector)" << std::endl;
-//        return false;
-//    }
-//    return true;
-//
-//}
-///*=============== Drive Handle Management ===============*/
-//// Open drive for reading
-//void PhysicalDriveReader::openDrive(const std::wstring& drivePath) {
-//    hDrive = CreateFileW(
-//        drivePath.c_str(),
-//        GENERIC_READ,
-//        FILE_SHARE_READ,
-//        NULL,
-//        OPEN_EXISTING,
-//        0,
-//        NULL
-//    );
-//    if (hDrive == INVALID_HANDLE_VALUE) {
-//        DWORD lastError = GetLastError();
-//        if (lastError == 5) {
-//            throw std::runtime_error("You have to run this program as Administrator when opening Physical drive.");
-//        }
-//        throw std::runtime_error("Failed to open physical drive. Please make sure to enter the correct drive.");
-//    }
-//}
-//// Close drive handle
-//void PhysicalDriveReader::closeDrive() {
-//    if (hDrive != INVALID_HANDLE_VALUE) {
-//        CloseHandle(hDrive);
-//    }
-//}
-//
+#ifdef _WIN32
+#include "PhysicalDriveReader.h"
+#include "Metrics.h"
+#include <cstring>
+#include <vector>
+
+
+PhysicalDriveReader::PhysicalDriveReader(const std::wstring& path, uint64_t partitionOffset, uint64_t partitionSectors)
+    : hDrive(INVALID_HANDLE_VALUE)
+    , drivePath(path)
+    , partitionOffset(partitionOffset)
+    , partitionSectors(partitionSectors) {
+    if (!openDrive()) {
+        throw std::runtime_error("Failed to open physical drive. Please make sure to enter the correct drive.");
+    }
+}
+
+PhysicalDriveReader::~PhysicalDriveReader() {
+    close();
+}
+
+bool PhysicalDriveReader::openDrive() {
+    close(); // Ensure any existing handle is closed
+
+    hDrive = CreateFileW(
+        drivePath.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, // The disk may have mounted volumes
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+        NULL
+    );
+
+    if (hDrive == INVALID_HANDLE_VALUE) {
+        DWORD error = GetLastError();
+        if (error == ERROR_ACCESS_DENIED) {
+            throw std::runtime_error("You have to run this program as Administrator when opening Physical drive.");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool PhysicalDriveReader::reopen() {
+    return openDrive();
+}
+
+void PhysicalDriveReader::close() {
+    if (hDrive != INVALID_HANDLE_VALUE) {
+        CloseHandle(hDrive);
+        hDrive = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool PhysicalDriveReader::readAt(uint64_t byteOffset, uint32_t length, void* buffer) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(byteOffset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(byteOffset >> 32);
+    DWORD bytesRead;
+
+    // The offset in OVERLAPPED replaces SetFilePointerEx on synchronous handles
+    auto start = std::chrono::steady_clock::now();
+    bool success = ReadFile(hDrive, buffer, length, &bytesRead, &overlapped) && bytesRead == length;
+    Metrics::getInstance().recordRead(length, start, success);
+    return success;
+}
+
+bool PhysicalDriveReader::isInPartition(uint64_t sector, uint64_t count) const {
+    return partitionSectors == 0 || (sector < partitionSectors && count <= partitionSectors - sector);
+}
+
+bool PhysicalDriveReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
+
+    uint32_t sectorSize = getBytesPerSector();
+    if (sectorSize == 0 || !isInPartition(sector, 1)) {
+        return false;
+    }
+    // Raw disk reads have to be whole sectors
+    if (size % sectorSize != 0) {
+        std::vector<uint8_t> bounce(((size + sectorSize - 1) / sectorSize) * sectorSize);
+        if (!readAt((partitionOffset + sector) * sectorSize, static_cast<uint32_t>(bounce.size()), bounce.data())) {
+            return false;
+        }
+        std::memcpy(buffer, bounce.data(), size);
+    }
+    else if (!readAt((partitionOffset + sector) * sectorSize, size, buffer)) {
+        return false;
+    }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ, (size + sectorSize - 1) / sectorSize);
+    return true;
+}
+
+bool PhysicalDriveReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
+
+    uint32_t sectorSize = getBytesPerSector();
+    if (sectorSize == 0 || !isInPartition(startSector, count)) {
+        return false;
+    }
+
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    uint64_t byteOffset = (partitionOffset + startSector) * sectorSize;
+    uint64_t remaining = static_cast<uint64_t>(count) * sectorSize;
+    uint32_t maxChunk = MAX_TRANSFER_BYTES - (MAX_TRANSFER_BYTES % sectorSize);
+
+    while (remaining > 0) {
+        uint32_t chunk = static_cast<uint32_t>((std::min)(remaining, static_cast<uint64_t>(maxChunk)));
+        if (!readAt(byteOffset, chunk, output)) {
+            return false;
+        }
+        output += chunk;
+        byteOffset += chunk;
+        remaining -= chunk;
+    }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ, count);
+    return true;
+}
+
+uint32_t PhysicalDriveReader::getBytesPerSector() {
+    if (bytesPerSector != 0) {
+        return bytesPerSector;
+    }
+    if (!isOpen()) {
+        if (!reopen()) {
+            return 0;
+        }
+    }
+
+    DISK_GEOMETRY dg = {};
+    DWORD bytesReturned;
+    if (!DeviceIoControl(hDrive, IOCTL_DISK_GET_DRIVE_GEOMETRY,
+        NULL, 0, &dg, sizeof(dg), &bytesReturned, NULL)) {
+        return 0;
+    }
+
+    bytesPerSector = dg.BytesPerSector;
+    return bytesPerSector;
+}
+
+uint64_t PhysicalDriveReader::getTotalSectors() {
+    if (partitionSectors != 0) {
+        return partitionSectors;
+    }
+    if (!isOpen()) {
+        if (!reopen()) {
+            return 0;
+        }
+    }
+
+    uint32_t sectorSize = getBytesPerSector();
+    GET_LENGTH_INFORMATION lengthInfo = {};
+    DWORD bytesReturned;
+    if (sectorSize == 0 || !DeviceIoControl(hDrive, IOCTL_DISK_GET_LENGTH_INFO,
+        NULL, 0, &lengthInfo, sizeof(lengthInfo), &bytesReturned, NULL)) {
+        return 0;
+    }
+    uint64_t diskSectors = static_cast<uint64_t>(lengthInfo.Length.QuadPart) / sectorSize;
+    return diskSectors > partitionOffset ? diskSectors - partitionOffset : 0;
+}
+
+std::wstring PhysicalDriveReader::getFilesystemType() {
+    uint32_t sectorSize = getBytesPerSector();
+    if (sectorSize < 512) {
+        return L"UNKNOWN_TYPE";
+    }
+
+    std::vector<uint8_t> bootSector(sectorSize);
+    if (!readSector(0, bootSector.data(), sectorSize)) {
+        return L"UNKNOWN_TYPE";
+    }
+    return detectFilesystem(bootSector.data());
+}
+
+uint64_t PhysicalDriveReader::getTotalMftRecords() {
+    // FSCTL_GET_NTFS_VOLUME_DATA needs a mounted volume, the MFT layout is read from record 0 instead
+    return 0;
+}
+#endif // _WIN32
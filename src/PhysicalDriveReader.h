@@ -7,29 +7,40 @@
 #include <fstream>
 #include <iostream>
 
-//class PhysicalDriveReader : public SectorReader {
-//private:
-//    HANDLE hDrive;
-//    uint64_t partitionOffset;
-//
-//public:
-//    /*=============== Constructor & Destructor ===============*/
-//    // Initialize reader with drive path
-//    PhysicalDriveReader(const std::wstring& drive, uint64_t startSector);
-//    // Ensure drive handle is closed
-//    ~PhysicalDriveReader();
-//
-//    /*=============== Drive Access Methods ===============*/
-//    // Read data from specified sector (implements SectorReader interface)
-//    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
-//    // Get drive's bytes per sector (implements SectorReader interface)
-//    bool getBytesPerSector(uint32_t& bytesPerSector) override;
-//    std::wstring getFilesystemType() override;
-//    /*=============== Drive Handle Management ===============*/
-//    // Open drive for reading
-//    void openDrive(const std::wstring& drivePath);
-//    // Close drive handle
-//    void closeDrive();
-//
-//
-//};
+// Raw reader for \\.\PhysicalDriveN, sectors are relative to partitionOffset.
+// Works on disks whose volumes Windows can't mount, the filesystem is detected from the boot sector.
+class PhysicalDriveReader : public SectorReader {
+private:
+    static constexpr uint32_t MAX_TRANSFER_BYTES = 16 * 1024 * 1024; // Largest single ReadFile request
+
+    HANDLE hDrive;
+    std::wstring drivePath;
+    uint64_t partitionOffset;    // First sector of the partition on the disk
+    uint64_t partitionSectors;   // 0 = up to the end of the disk
+    uint32_t bytesPerSector = 0; // Cached drive geometry
+
+    bool openDrive();
+    // Positional read that doesn't depend on the shared file pointer
+    bool readAt(uint64_t byteOffset, uint32_t length, void* buffer);
+    bool isInPartition(uint64_t sector, uint64_t count) const;
+
+public:
+    PhysicalDriveReader(const std::wstring& drivePath, uint64_t partitionOffset = 0, uint64_t partitionSectors = 0);
+    ~PhysicalDriveReader() override;
+
+    // Delete copy constructor and assignment to prevent handle duplication
+    PhysicalDriveReader(const PhysicalDriveReader&) = delete;
+    PhysicalDriveReader& operator=(const PhysicalDriveReader&) = delete;
+
+    // Implement SectorReader interface
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    uint32_t getBytesPerSector() override;
+    std::wstring getFilesystemType() override;
+    uint64_t getTotalMftRecords() override;
+    // Sectors of the partition, or of the whole disk without one
+    uint64_t getTotalSectors() override;
+    bool isOpen() const override { return hDrive != INVALID_HANDLE_VALUE; }
+    bool reopen() override;
+    void close() override;
+};
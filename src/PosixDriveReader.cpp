@@ -0,0 +1,511 @@
+#ifndef _WIN32
+#include "PosixDriveReader.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define POSIX_DRIVE_READER_USE_IO_URING 1
+#endif
+#endif
+
+
+#if defined(POSIX_DRIVE_READER_USE_IO_URING)
+// Submission and completion queues shared with the kernel, used through the raw system calls so
+// the tool doesn't depend on liburing
+struct PosixDriveReader::IoRing {
+    int ringFd = -1;
+    uint8_t* sqRing = nullptr;
+    uint8_t* cqRing = nullptr;
+    size_t sqRingBytes = 0;
+    size_t cqRingBytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesBytes = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    ~IoRing() {
+        if (sqes) munmap(sqes, sqesBytes);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingBytes);
+        if (sqRing) munmap(sqRing, sqRingBytes);
+        if (ringFd >= 0) ::close(ringFd);
+    }
+
+    bool setup(uint32_t entries) {
+        io_uring_params params = {};
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) return false;
+
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) sqRingBytes = cqRingBytes = (std::max)(sqRingBytes, cqRingBytes);
+
+        void* memory = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (memory == MAP_FAILED) return false;
+        sqRing = static_cast<uint8_t*>(memory);
+
+        if (singleMap) {
+            cqRing = sqRing;
+        }
+        else {
+            memory = mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (memory == MAP_FAILED) return false;
+            cqRing = static_cast<uint8_t*>(memory);
+        }
+
+        sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        memory = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (memory == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(memory);
+
+        sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+        sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+        sqMask = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+        cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+        return true;
+    }
+
+    // Queue a read, it reaches the kernel with the next enter
+    void push(int fd, void* buffer, uint64_t offset, uint32_t length, uint64_t userData) {
+        std::atomic_ref<unsigned> tail(*sqTail);
+        unsigned index = tail.load(std::memory_order_relaxed) & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.off = offset;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = length;
+        sqe.user_data = userData;
+        sqArray[index] = index;
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Submit queued reads and wait for at least minComplete completions, reads taken by the kernel or -errno
+    int enter(unsigned toSubmit, unsigned minComplete) {
+        int result = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0));
+        return result < 0 ? -errno : result;
+    }
+
+    bool pop(io_uring_cqe& cqe) {
+        std::atomic_ref<unsigned> head(*cqHead);
+        unsigned current = head.load(std::memory_order_relaxed);
+        if (current == std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire)) return false;
+        cqe = cqes[current & cqMask];
+        head.store(current + 1, std::memory_order_release);
+        return true;
+    }
+};
+#else
+// No io_uring on this system, batches are read synchronously
+struct PosixDriveReader::IoRing {};
+#endif
+
+void PosixDriveReader::AlignedDeleter::operator()(uint8_t* memory) const {
+    ::operator delete[](memory, std::align_val_t(IO_ALIGNMENT));
+}
+
+PosixDriveReader::PosixDriveReader(const std::wstring& drivePath, uint64_t partitionOffset, uint64_t partitionSectors, uint32_t queueDepth, uint32_t imageSectorBytes)
+    : devicePath(std::filesystem::path(drivePath).string())
+    , partitionOffset(partitionOffset)
+    , partitionSectors(partitionSectors)
+    , queueDepth((std::max)(1u, queueDepth))
+    , imageSectorBytes(imageSectorBytes) {
+    if (!openDrive()) {
+        throw std::runtime_error("Failed to open the drive. Please make sure to enter the correct device or image path.");
+    }
+    if (!queryGeometry()) {
+        close();
+        throw std::runtime_error("Failed to read the drive geometry");
+    }
+    // Deeper queues only pay off for batches, a single reader thread doesn't need the ring
+    if (this->queueDepth > 1 && !setupRing()) {
+        std::cerr << "[!] io_uring isn't available, batched reads are issued one at a time" << std::endl;
+    }
+}
+
+PosixDriveReader::~PosixDriveReader() {
+    releaseRing();
+    close();
+}
+
+bool PosixDriveReader::openDrive() {
+    close(); // Ensure any existing descriptor is closed
+
+    int flags = O_RDONLY | O_CLOEXEC;
+#if defined(O_DIRECT)
+    fd = ::open(devicePath.c_str(), flags | O_DIRECT);
+    directIo = fd >= 0;
+#endif
+    // tmpfs and some network filesystems refuse O_DIRECT, their images are read through the page cache
+    if (fd < 0 && errno == EINVAL) {
+        fd = ::open(devicePath.c_str(), flags);
+    }
+
+    if (fd < 0) {
+        if (errno == EACCES || errno == EPERM) {
+            throw std::runtime_error("Permission denied, block devices have to be opened as root or by a member of the disk group.");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool PosixDriveReader::queryGeometry() {
+    struct stat info = {};
+    if (fstat(fd, &info) != 0) {
+        return false;
+    }
+
+    if (S_ISBLK(info.st_mode)) {
+#if defined(__linux__)
+        int logicalSectorSize = 0;
+        uint64_t sizeBytes = 0;
+        if (ioctl(fd, BLKSSZGET, &logicalSectorSize) != 0 || ioctl(fd, BLKGETSIZE64, &sizeBytes) != 0 || logicalSectorSize <= 0) {
+            return false;
+        }
+        bytesPerSector = static_cast<uint32_t>(logicalSectorSize);
+        deviceBytes = sizeBytes;
+#else
+        off_t end = lseek(fd, 0, SEEK_END);
+        if (end < 0) return false;
+        bytesPerSector = DEFAULT_IMAGE_SECTOR_BYTES;
+        deviceBytes = static_cast<uint64_t>(end);
+#endif
+        // Direct reads of a block device have to cover whole logical sectors
+        ioAlignment = bytesPerSector;
+    }
+    else if (S_ISREG(info.st_mode)) {
+        bytesPerSector = imageSectorBytes;
+        deviceBytes = static_cast<uint64_t>(info.st_size);
+        ioAlignment = IO_ALIGNMENT;
+    }
+    else {
+        return false;
+    }
+
+    if (!directIo) ioAlignment = 1;
+    return bytesPerSector >= MIN_SECTOR_BYTES && ioAlignment <= IO_ALIGNMENT;
+}
+
+bool PosixDriveReader::setupRing() {
+#if defined(POSIX_DRIVE_READER_USE_IO_URING)
+    ring = std::make_unique<IoRing>();
+    uint64_t slotStride = SLOT_BYTES + 2ull * IO_ALIGNMENT;
+    if (!ring->setup(queueDepth)) {
+        ring.reset();
+        return false;
+    }
+
+    slotMemory.reset(new (std::align_val_t(IO_ALIGNMENT)) uint8_t[slotStride * queueDepth]);
+    slots.resize(queueDepth);
+    for (uint32_t i = 0; i < queueDepth; i++) {
+        slots[i] = {};
+        slots[i].buffer = slotMemory.get() + slotStride * i;
+    }
+
+    // Kernels before 5.6 create the ring but reject IORING_OP_READ, a first read tells
+    std::vector<ReadRequest> probe = { { 0, 1, slots[0].buffer + SLOT_BYTES, false } };
+    std::vector<IoChunk> chunks = { { partitionOffset * bytesPerSector, bytesPerSector, slots[0].buffer + SLOT_BYTES, 0 } };
+    if (!runChunks(chunks, probe)) {
+        releaseRing();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PosixDriveReader::drainRing([[maybe_unused]] uint32_t inKernel) {
+#if defined(POSIX_DRIVE_READER_USE_IO_URING)
+    io_uring_cqe cqe;
+    while (inKernel > 0) {
+        while (inKernel > 0 && ring->pop(cqe)) {
+            inKernel--;
+        }
+        if (inKernel == 0) break;
+
+        int waited = ring->enter(0, 1);
+        if (waited < 0 && waited != -EINTR && waited != -EAGAIN && waited != -EBUSY) {
+            // Freeing the slots or closing the ring could let a late read land in reused memory, both are leaked
+            std::cerr << "[-] io_uring reads can't be waited for. Error: " << -waited << std::endl;
+            slotMemory.release();
+            ring.release();
+            slots.clear();
+            return false;
+        }
+    }
+    return true;
+#else
+    return true;
+#endif
+}
+
+void PosixDriveReader::releaseRing() {
+    ring.reset();
+    slots.clear();
+    slotMemory.reset();
+}
+
+bool PosixDriveReader::reopen() {
+    return openDrive();
+}
+
+void PosixDriveReader::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool PosixDriveReader::isInPartition(uint64_t sector, uint64_t count) const {
+    return partitionSectors == 0 || (sector < partitionSectors && count <= partitionSectors - sector);
+}
+
+int64_t PosixDriveReader::preadAll(uint64_t byteOffset, uint64_t length, uint8_t* buffer) {
+    uint64_t received = 0;
+    while (received < length) {
+        ssize_t result = pread(fd, buffer + received, static_cast<size_t>(length - received), static_cast<off_t>(byteOffset + received));
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (result == 0) break; // End of the device
+        received += static_cast<uint64_t>(result);
+    }
+    return static_cast<int64_t>(received);
+}
+
+bool PosixDriveReader::readAt(uint64_t byteOffset, uint64_t length, void* buffer) {
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    auto start = std::chrono::steady_clock::now();
+    bool success = true;
+
+    bool aligned = byteOffset % ioAlignment == 0 && length % ioAlignment == 0 && reinterpret_cast<uintptr_t>(output) % ioAlignment == 0;
+    if (aligned) {
+        success = preadAll(byteOffset, length, output) == static_cast<int64_t>(length);
+    }
+    else {
+        // Each thread keeps its own bounce buffer, the scan workers read concurrently
+        thread_local AlignedBuffer bounce(new (std::align_val_t(IO_ALIGNMENT)) uint8_t[SLOT_BYTES + 2ull * IO_ALIGNMENT]);
+        uint64_t offset = byteOffset;
+        uint64_t remaining = length;
+        while (success && remaining > 0) {
+            uint64_t piece = (std::min)(remaining, static_cast<uint64_t>(SLOT_BYTES));
+            uint64_t alignedOffset = offset - offset % ioAlignment;
+            uint64_t headBytes = offset - alignedOffset;
+            uint64_t readLength = (headBytes + piece + ioAlignment - 1) / ioAlignment * ioAlignment;
+
+            // The rounded up length may run past the end of an image, only the requested bytes have to arrive
+            success = preadAll(alignedOffset, readLength, bounce.get()) >= static_cast<int64_t>(headBytes + piece);
+            if (success) std::memcpy(output, bounce.get() + headBytes, piece);
+            output += piece;
+            offset += piece;
+            remaining -= piece;
+        }
+    }
+    Metrics::getInstance().recordRead(length, start, success);
+    return success;
+}
+
+bool PosixDriveReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
+    if (!isInPartition(sector, 1)) {
+        return false;
+    }
+    if (!readAt((partitionOffset + sector) * bytesPerSector, size, buffer)) {
+        return false;
+    }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ, (size + bytesPerSector - 1) / bytesPerSector);
+    return true;
+}
+
+bool PosixDriveReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
+    if (!isInPartition(startSector, count)) {
+        return false;
+    }
+    if (!readAt((partitionOffset + startSector) * bytesPerSector, static_cast<uint64_t>(count) * bytesPerSector, buffer)) {
+        return false;
+    }
+    Metrics::getInstance().add(MetricCounter::SECTORS_READ, count);
+    return true;
+}
+
+void PosixDriveReader::prepareSlot(IoSlot& slot, const IoChunk& chunk) {
+    slot.destination = chunk.destination;
+    slot.length = chunk.length;
+    slot.requestIndex = chunk.requestIndex;
+    slot.readOffset = chunk.byteOffset - chunk.byteOffset % ioAlignment;
+    slot.headBytes = static_cast<uint32_t>(chunk.byteOffset - slot.readOffset);
+    slot.readLength = (slot.headBytes + chunk.length + ioAlignment - 1) / ioAlignment * ioAlignment;
+    // Aligned destinations skip the bounce buffer copy
+    slot.direct = slot.headBytes == 0 && slot.readLength == chunk.length && reinterpret_cast<uintptr_t>(chunk.destination) % ioAlignment == 0;
+    slot.submitTime = std::chrono::steady_clock::now();
+}
+
+bool PosixDriveReader::runChunks(std::vector<IoChunk>& chunks, std::vector<ReadRequest>& requests) {
+#if defined(POSIX_DRIVE_READER_USE_IO_URING)
+    std::vector<IoSlot*> freeSlots;
+    for (IoSlot& slot : slots) {
+        freeSlots.push_back(&slot);
+    }
+
+    bool allSucceeded = true;
+    size_t nextChunk = 0;
+    uint32_t inFlight = 0;
+    unsigned unsubmitted = 0; // Queued in the ring, not yet taken by the kernel
+
+    while (nextChunk < chunks.size() || inFlight > 0) {
+        // Keep the queue full
+        while (nextChunk < chunks.size() && !freeSlots.empty()) {
+            IoSlot* slot = freeSlots.back();
+            freeSlots.pop_back();
+            prepareSlot(*slot, chunks[nextChunk++]);
+            ring->push(fd, slot->direct ? slot->destination : slot->buffer, slot->readOffset, slot->readLength, static_cast<uint64_t>(slot - slots.data()));
+            unsubmitted++;
+            inFlight++;
+        }
+
+        // Interrupts and a full completion queue pass, the completions below are reaped before the next try
+        int submitted = ring->enter(unsubmitted, 1);
+        bool transient = submitted == -EINTR || submitted == -EAGAIN || submitted == -EBUSY;
+        if (submitted < 0 && !transient) {
+            // The ring itself failed, later batches are read synchronously once the taken reads are done
+            std::cerr << "[-] io_uring failure. Error: " << -submitted << std::endl;
+            bool drained = drainRing(inFlight - unsubmitted);
+            for (ReadRequest& request : requests) {
+                request.success = false;
+            }
+            if (drained) {
+                releaseRing();
+            }
+            return false;
+        }
+        if (submitted > 0) unsubmitted -= static_cast<unsigned>(submitted);
+
+        io_uring_cqe cqe;
+        while (ring->pop(cqe)) {
+            IoSlot* slot = &slots[static_cast<size_t>(cqe.user_data)];
+            uint8_t* target = slot->direct ? slot->destination : slot->buffer;
+            inFlight--;
+
+            // Short reads are finished synchronously, the end of an image may cut the rounded up length
+            uint64_t needed = static_cast<uint64_t>(slot->headBytes) + slot->length;
+            int64_t received = cqe.res;
+            if (received >= 0 && static_cast<uint64_t>(received) < needed) {
+                int64_t rest = preadAll(slot->readOffset + received, slot->readLength - received, target + received);
+                received = rest < 0 ? -1 : received + rest;
+            }
+
+            bool success = received >= 0 && static_cast<uint64_t>(received) >= needed;
+            Metrics::getInstance().recordRead(slot->length, slot->submitTime, success);
+            if (success) {
+                if (!slot->direct) std::memcpy(slot->destination, slot->buffer + slot->headBytes, slot->length);
+                Metrics::getInstance().add(MetricCounter::SECTORS_READ, slot->length / bytesPerSector);
+            }
+            else {
+                requests[slot->requestIndex].success = false;
+                allSucceeded = false;
+            }
+            freeSlots.push_back(slot);
+        }
+    }
+    return allSucceeded;
+#else
+    return false;
+#endif
+}
+
+bool PosixDriveReader::readBatch(std::vector<ReadRequest>& requests) {
+    std::lock_guard<std::mutex> lock(batchMutex);
+    if (!ring) {
+        return SectorReader::readBatch(requests);
+    }
+    if (!isOpen()) {
+        if (!reopen()) {
+            return false;
+        }
+    }
+
+    // Split every request into slot sized chunks
+    std::vector<IoChunk> chunks;
+    bool allInPartition = true;
+    for (size_t i = 0; i < requests.size(); i++) {
+        ReadRequest& request = requests[i];
+        request.success = isInPartition(request.startSector, request.sectorCount);
+        if (!request.success) {
+            allInPartition = false;
+            continue;
+        }
+
+        uint64_t byteOffset = (partitionOffset + request.startSector) * bytesPerSector;
+        uint64_t remaining = static_cast<uint64_t>(request.sectorCount) * bytesPerSector;
+        uint8_t* destination = static_cast<uint8_t*>(request.buffer);
+        while (remaining > 0) {
+            uint32_t length = static_cast<uint32_t>((std::min)(remaining, static_cast<uint64_t>(SLOT_BYTES)));
+            chunks.push_back({ byteOffset, length, destination, i });
+            byteOffset += length;
+            destination += length;
+            remaining -= length;
+        }
+    }
+
+    return runChunks(chunks, requests) && allInPartition;
+}
+
+uint64_t PosixDriveReader::getTotalSectors() {
+    if (partitionSectors != 0) {
+        return partitionSectors;
+    }
+    uint64_t deviceSectors = deviceBytes / bytesPerSector;
+    return deviceSectors > partitionOffset ? deviceSectors - partitionOffset : 0;
+}
+
+std::wstring PosixDriveReader::getFilesystemType() {
+    std::vector<uint8_t> bootSector(bytesPerSector);
+    if (!readSector(0, bootSector.data(), bytesPerSector)) {
+        return L"UNKNOWN_TYPE";
+    }
+    return detectFilesystem(bootSector.data());
+}
+
+uint64_t PosixDriveReader::getTotalMftRecords() {
+    // There is no mounted volume to query, the MFT layout is read from record 0 instead
+    return 0;
+}
+#endif // _WIN32
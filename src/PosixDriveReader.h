@@ -0,0 +1,101 @@
+#pragma once
+#include "SectorReader.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Reader for block devices (/dev/sdX, /dev/nvme0n1) and raw images on Linux and other POSIX systems,
+// sectors are relative to partitionOffset. The device is opened with O_DIRECT, so a recovery streaming
+// gigabytes doesn't push everything else out of the page cache; the block cache above keeps the metadata.
+// Batches go through io_uring with up to queueDepth reads in flight, single reads are positional preads.
+// Without io_uring support (older kernels, seccomp filters) batches are read one request after another.
+class PosixDriveReader : public SectorReader {
+private:
+    static constexpr uint32_t SLOT_BYTES = 1024 * 1024;   // Size of one in-flight read
+    static constexpr uint32_t MIN_SECTOR_BYTES = 512;
+    static constexpr uint32_t DEFAULT_IMAGE_SECTOR_BYTES = 512; // Raw images carry no geometry
+    static constexpr uint32_t IO_ALIGNMENT = 4096;        // Bounce buffers, and direct reads of images on 512 byte and 4K filesystems
+
+    struct AlignedDeleter {
+        void operator()(uint8_t* memory) const;
+    };
+    using AlignedBuffer = std::unique_ptr<uint8_t[], AlignedDeleter>;
+
+    struct IoSlot {
+        uint8_t* buffer;        // Aligned bounce buffer, SLOT_BYTES plus IO_ALIGNMENT on each side
+        uint8_t* destination;   // Caller's buffer
+        bool direct;            // Destination and range are aligned, read in place
+        uint64_t readOffset;    // Aligned range submitted to the kernel
+        uint32_t readLength;
+        uint32_t headBytes;     // Bytes of the aligned range before the requested data
+        uint32_t length;
+        size_t requestIndex;
+        std::chrono::steady_clock::time_point submitTime; // Start of the read latency
+    };
+
+    // Pending piece of a request that hasn't been submitted yet
+    struct IoChunk {
+        uint64_t byteOffset;
+        uint32_t length;
+        uint8_t* destination;
+        size_t requestIndex;
+    };
+
+    struct IoRing; // io_uring queues, defined with the Linux headers in the source file
+
+    int fd = -1;
+    std::string devicePath;      // Native path of the device or image
+    uint64_t partitionOffset;    // First sector of the partition on the device
+    uint64_t partitionSectors;   // 0 = up to the end of the device
+    uint32_t queueDepth;
+    uint32_t imageSectorBytes;   // Sector size of an image, found by the drive handler. Devices report their own.
+    uint32_t bytesPerSector = 0;
+    uint32_t ioAlignment = 0;    // Offsets, lengths and buffers of direct reads are multiples of it
+    uint64_t deviceBytes = 0;
+    bool directIo = false;       // O_DIRECT was accepted, otherwise reads go through the page cache
+
+    AlignedBuffer slotMemory;
+    std::vector<IoSlot> slots;
+    std::unique_ptr<IoRing> ring;
+    std::mutex batchMutex;       // One batch owns the ring at a time
+
+    bool openDrive();
+    bool queryGeometry();
+    bool isInPartition(uint64_t sector, uint64_t count) const;
+    // Positional read of a device byte range, anything unaligned goes through a bounce buffer
+    bool readAt(uint64_t byteOffset, uint64_t length, void* buffer);
+    // pread until length bytes arrived or the device ended, bytes read or -1 on an error
+    int64_t preadAll(uint64_t byteOffset, uint64_t length, uint8_t* buffer);
+    bool setupRing();
+    void releaseRing();
+    // Wait until the kernel finished the reads it took, it writes into the slots and the callers' buffers
+    // until then. False if the ring can't be waited on, the slot memory is then left to the kernel.
+    bool drainRing(uint32_t inKernel);
+    // Fill a free slot for a chunk, the caller submits it
+    void prepareSlot(IoSlot& slot, const IoChunk& chunk);
+    // Run all chunks through the ring and report failures into the requests
+    bool runChunks(std::vector<IoChunk>& chunks, std::vector<ReadRequest>& requests);
+
+public:
+    PosixDriveReader(const std::wstring& drivePath, uint64_t partitionOffset = 0, uint64_t partitionSectors = 0, uint32_t queueDepth = 1, uint32_t imageSectorBytes = DEFAULT_IMAGE_SECTOR_BYTES);
+    ~PosixDriveReader() override;
+
+    // Delete copy constructor and assignment to prevent descriptor duplication
+    PosixDriveReader(const PosixDriveReader&) = delete;
+    PosixDriveReader& operator=(const PosixDriveReader&) = delete;
+
+    // Implement SectorReader interface
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    bool readBatch(std::vector<ReadRequest>& requests) override;
+    uint64_t getTotalSectors() override;
+    uint32_t getBytesPerSector() override { return bytesPerSector; }
+    std::wstring getFilesystemType() override;
+    uint64_t getTotalMftRecords() override;
+    bool isOpen() const override { return fd >= 0; }
+    bool reopen() override;
+    void close() override;
+};
@@ -0,0 +1,211 @@
+#include "RecoveryPipeline.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+
+RecoveryPipeline::RecoveryPipeline(SectorReader& reader, const RecoveryGeometry& geometry, Utils& utils)
+    : sectorReader(reader)
+    , geometry(geometry)
+    , utils(utils)
+    , bytesPerCluster(geometry.sectorsPerCluster * geometry.bytesPerSector) {
+    if (bytesPerCluster == 0) {
+        throw std::runtime_error("Invalid cluster size for recovery");
+    }
+}
+
+uint64_t RecoveryPipeline::clusterToSector(uint64_t cluster) const {
+    return geometry.firstClusterSector + (cluster - geometry.firstCluster) * geometry.sectorsPerCluster;
+}
+
+void RecoveryPipeline::allocateRing(uint64_t slotBytes) {
+    ringMemory.reset(static_cast<uint8_t*>(::operator new(static_cast<size_t>(slotBytes * RING_SLOTS), std::align_val_t(BUFFER_ALIGNMENT))));
+
+    slots.assign(RING_SLOTS, {});
+    filledSlots.clear();
+    freeSlots.clear();
+    for (size_t i = 0; i < RING_SLOTS; i++) {
+        slots[i].buffer = ringMemory.get() + i * slotBytes;
+        freeSlots.push_back(i);
+    }
+    readerDone = false;
+    writeFailed = false;
+}
+
+bool RecoveryPipeline::acquireFreeSlot(size_t& slotIndex) {
+    std::unique_lock<std::mutex> lock(ringMutex);
+    slotDrained.wait(lock, [this] { return !freeSlots.empty() || writeFailed; });
+    if (writeFailed) return false;
+
+    slotIndex = freeSlots.front();
+    freeSlots.pop_front();
+    return true;
+}
+
+void RecoveryPipeline::submitFilledSlot(size_t slotIndex) {
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        filledSlots.push_back(slotIndex);
+    }
+    slotFilled.notify_one();
+}
+
+void RecoveryPipeline::finishReading() {
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        readerDone = true;
+    }
+    slotFilled.notify_one();
+}
+
+void RecoveryPipeline::salvageRequest(const ReadRequest& request, uint64_t firstCluster, uint64_t fileOffset, uint64_t expectedSize, PipelineResult& result) {
+    std::vector<uint64_t> unreadableSectors;
+    if (sectorReader.salvageSectors(request.startSector, request.sectorCount, request.buffer, unreadableSectors)) return;
+
+    for (uint64_t sector : unreadableSectors) {
+        // Only the bytes that are part of the file count, not the slack of its last cluster
+        uint64_t sectorOffset = fileOffset + (sector - request.startSector) * geometry.bytesPerSector;
+        if (sectorOffset < expectedSize) {
+            result.unreadableBytes += (std::min)(static_cast<uint64_t>(geometry.bytesPerSector), expectedSize - sectorOffset);
+        }
+        uint64_t cluster = firstCluster + (sector - request.startSector) / geometry.sectorsPerCluster;
+        if (result.problematicClusters.empty() || result.problematicClusters.back() != cluster) {
+            result.problematicClusters.push_back(cluster);
+        }
+    }
+}
+
+void RecoveryPipeline::drainSlots(SparseFileWriter& outputFile, FileHasher& hasher, uint64_t expectedSize, PipelineResult& result) {
+    while (true) {
+        size_t slotIndex;
+        {
+            std::unique_lock<std::mutex> lock(ringMutex);
+            slotFilled.wait(lock, [this] { return !filledSlots.empty() || readerDone; });
+            if (filledSlots.empty()) break;
+            slotIndex = filledSlots.front();
+            filledSlots.pop_front();
+        }
+
+        const Slot& slot = slots[slotIndex];
+        bool failed = !outputFile.write(slot.buffer, static_cast<size_t>(slot.bytes));
+        if (!failed) {
+            // Hashed before the slot is handed back, so the reader can't overwrite it yet
+            if (hasher.isEnabled()) hasher.update(slot.buffer, static_cast<size_t>(slot.bytes));
+            result.recoveredBytes += slot.bytes;
+            result.recoveredClusters += slot.clusters;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            freeSlots.push_back(slotIndex);
+            writeFailed = failed;
+        }
+        slotDrained.notify_one();
+        if (failed) {
+            std::cerr << "\n[-] Failed to write to the output file" << std::endl;
+            break;
+        }
+
+        // The status line is throttled, most chunks don't print it. The last one is printed once the file is counted.
+        if (reportProgress && result.recoveredBytes < expectedSize) utils.showProgress(result.recoveredBytes, expectedSize);
+    }
+}
+
+PipelineResult RecoveryPipeline::recoverFile(const std::vector<FileExtent>& extents, uint64_t expectedSize, const fs::path& outputPath) {
+    SparseFileWriter outputFile;
+    if (!outputFile.open(outputPath)) {
+        throw std::runtime_error("[-] Failed to create output file.");
+    }
+
+    // Slots never hold more than the whole file, small files don't pay for the full ring
+    uint64_t clustersPerChunk = (std::max)(1u, CHUNK_BYTES / bytesPerCluster);
+    uint32_t batchSize = (std::max)(1u, config.ioQueueDepth);
+    uint64_t fileClusters = (std::max)(static_cast<uint64_t>(1), (expectedSize + bytesPerCluster - 1) / bytesPerCluster);
+    uint64_t slotClusters = (std::min)(clustersPerChunk * batchSize, fileClusters);
+    allocateRing(slotClusters * bytesPerCluster);
+
+    PipelineResult result;
+    FileHasher hasher;
+    std::thread writer(&RecoveryPipeline::drainSlots, this, std::ref(outputFile), std::ref(hasher), expectedSize, std::ref(result));
+
+    try {
+        size_t extentIndex = 0;
+        uint64_t extentOffset = 0;
+        uint64_t queuedBytes = 0;
+        std::vector<ReadRequest> batch;
+        std::vector<uint64_t> batchClusters; // First cluster of every request
+        std::vector<uint64_t> batchOffsets;  // File offset of every request
+        size_t slotIndex;
+
+        while (extentIndex < extents.size() && queuedBytes < expectedSize && acquireFreeSlot(slotIndex)) {
+            Slot& slot = slots[slotIndex];
+            uint64_t slotFill = 0;
+            slot.clusters = 0;
+            batch.clear();
+            batchClusters.clear();
+            batchOffsets.clear();
+
+            // Consecutive chunks are submitted together, sparse ones are zeroed instead of read
+            for (uint32_t i = 0; i < batchSize && extentIndex < extents.size() && slot.clusters < slotClusters && queuedBytes + slotFill < expectedSize; i++) {
+                const FileExtent& extent = extents[extentIndex];
+                // Clusters past the end of the file are never read
+                uint64_t neededClusters = (expectedSize - queuedBytes - slotFill + bytesPerCluster - 1) / bytesPerCluster;
+                uint64_t chunkClusters = (std::min)({ clustersPerChunk, extent.length - extentOffset, neededClusters, slotClusters - slot.clusters });
+                uint64_t cluster = extent.startCluster + extentOffset;
+                uint8_t* destination = slot.buffer + slotFill;
+
+                if (extent.sparse) {
+                    std::memset(destination, 0, chunkClusters * bytesPerCluster);
+                }
+                else if (chunkClusters > 0) {
+                    batch.push_back({ clusterToSector(cluster), static_cast<uint32_t>(chunkClusters * geometry.sectorsPerCluster), destination, false });
+                    batchClusters.push_back(cluster);
+                    batchOffsets.push_back(queuedBytes + slotFill);
+                }
+                slotFill += chunkClusters * bytesPerCluster;
+                slot.clusters += chunkClusters;
+                extentOffset += chunkClusters;
+                if (extentOffset >= extent.length) {
+                    extentIndex++;
+                    extentOffset = 0;
+                }
+            }
+
+            if (!batch.empty()) {
+                sectorReader.readBatch(batch);
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (!batch[i].success) salvageRequest(batch[i], batchClusters[i], batchOffsets[i], expectedSize, result);
+            }
+
+            slot.bytes = (std::min)(slotFill, expectedSize - queuedBytes);
+            queuedBytes += slot.bytes;
+            submitFilledSlot(slotIndex);
+        }
+    }
+    catch (...) {
+        finishReading();
+        writer.join();
+        throw;
+    }
+    finishReading();
+    writer.join();
+
+    bool closed = outputFile.close();
+    if (!closed && !writeFailed) {
+        std::cerr << "\n[-] Failed to write to the output file" << std::endl;
+    }
+    // A digest of bytes that never reached the output file would be a false chain of custody record
+    if (writeFailed || !closed) {
+        result.writeFailed = true;
+        return result;
+    }
+    if (hasher.isEnabled()) result.digests = hasher.finish();
+    Metrics::getInstance().add(MetricCounter::FILES_RECOVERED);
+    Metrics::getInstance().add(MetricCounter::BYTES_RECOVERED, result.recoveredBytes);
+    if (reportProgress) utils.showProgress(result.recoveredBytes, expectedSize, true);
+    return result;
+}
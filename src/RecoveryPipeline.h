@@ -0,0 +1,94 @@
+#pragma once
+#include "FileHasher.h"
+#include "IConfigurable.h"
+#include "SectorReader.h"
+#include "SparseFileWriter.h"
+#include "Utils.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Maps the engine's cluster numbers to sectors of the reader
+struct RecoveryGeometry {
+    uint64_t firstCluster;       // Cluster stored at firstClusterSector
+    uint64_t firstClusterSector;
+    uint32_t sectorsPerCluster;
+    uint32_t bytesPerSector;
+};
+
+struct PipelineResult {
+    uint64_t recoveredBytes = 0;
+    uint64_t recoveredClusters = 0;
+    std::vector<uint64_t> problematicClusters; // Unreadable, written as zeros to keep the file layout
+    uint64_t unreadableBytes = 0;              // File bytes in unreadable sectors
+    FileDigests digests;                       // Of the bytes written, empty if hashing is disabled or writing failed
+    bool writeFailed = false;                  // The output file is incomplete, it isn't hashed or counted
+};
+
+// Streams the extents of a file into its output file.
+// The calling thread reads batches into a ring of aligned buffers while a writer thread drains them,
+// so reading the source and writing the destination overlap. The writer also hashes what it writes,
+// the hashing overlaps the next read instead of taking a second pass over the output.
+// Zero runs, sparse extents included, are left as holes in the output file.
+class RecoveryPipeline : public IConfigurable {
+private:
+    static constexpr uint32_t CHUNK_BYTES = 1024 * 1024;   // Largest single read
+    static constexpr uint32_t RING_SLOTS = 4;              // Buffers cycling between the reader and the writer
+    static constexpr size_t BUFFER_ALIGNMENT = 4096;       // Lets unbuffered readers fill the buffers in place
+
+    struct AlignedDeleter {
+        void operator()(uint8_t* memory) const { ::operator delete(memory, std::align_val_t(BUFFER_ALIGNMENT)); }
+    };
+
+    // One batch of consecutive file data
+    struct Slot {
+        uint8_t* buffer;
+        uint64_t bytes;    // File bytes to write
+        uint64_t clusters; // Clusters the batch covers
+    };
+
+    SectorReader& sectorReader;
+    RecoveryGeometry geometry;
+    Utils& utils;
+    uint32_t bytesPerCluster;
+    bool reportProgress = true;
+
+    std::unique_ptr<uint8_t, AlignedDeleter> ringMemory;
+    std::vector<Slot> slots;
+    std::mutex ringMutex;
+    std::condition_variable slotFilled;
+    std::condition_variable slotDrained;
+    std::deque<size_t> filledSlots;
+    std::deque<size_t> freeSlots;
+    bool readerDone = false;
+    bool writeFailed = false;
+
+    uint64_t clusterToSector(uint64_t cluster) const;
+    void allocateRing(uint64_t slotBytes);
+    // Wait for a buffer the writer is done with, false once writing failed
+    bool acquireFreeSlot(size_t& slotIndex);
+    void submitFilledSlot(size_t slotIndex);
+    void finishReading();
+    // Salvage the readable sectors of a failed request, unreadable sectors are zeroed
+    void salvageRequest(const ReadRequest& request, uint64_t firstCluster, uint64_t fileOffset, uint64_t expectedSize, PipelineResult& result);
+    // Writer thread, drains filled slots in order, hashes them and reports progress
+    void drainSlots(SparseFileWriter& outputFile, FileHasher& hasher, uint64_t expectedSize, PipelineResult& result);
+
+public:
+    RecoveryPipeline(SectorReader& reader, const RecoveryGeometry& geometry, Utils& utils);
+
+    // Prevent copying, the pipeline refers to the engine's reader
+    RecoveryPipeline(const RecoveryPipeline&) = delete;
+    RecoveryPipeline& operator=(const RecoveryPipeline&) = delete;
+
+    // Concurrent recoveries turn the progress line off, it would be shared by every file
+    void setReportProgress(bool enabled) { reportProgress = enabled; }
+    // Write up to expectedSize bytes of the extents to outputPath, throws if the file can't be created
+    PipelineResult recoverFile(const std::vector<FileExtent>& extents, uint64_t expectedSize, const fs::path& outputPath);
+};
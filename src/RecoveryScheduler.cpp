@@ -0,0 +1,49 @@
+#include "RecoveryScheduler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+
+void RecoveryScheduler::addFile(size_t index, uint64_t startSector) {
+    jobs.push_back({ startSector, index });
+}
+
+uint32_t RecoveryScheduler::getWorkerCount() const {
+    if (config.analyze || jobs.size() <= 1) {
+        return 1;
+    }
+    uint32_t workers = (std::min)(ThreadPool::resolveThreadCount(config.threadCount), MAX_WORKERS);
+    return static_cast<uint32_t>((std::min)(static_cast<size_t>(workers), jobs.size()));
+}
+
+void RecoveryScheduler::run(const std::function<void(size_t)>& recoverFile) {
+    // Files at the same sector keep their selection order
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.startSector < b.startSector; });
+
+    uint32_t workerCount = getWorkerCount();
+    if (workerCount == 1) {
+        for (const Job& job : jobs) {
+            recoverFile(job.index);
+        }
+        return;
+    }
+
+    // Workers pull from one cursor, so the files in flight are always the next ones on disk
+    std::atomic<size_t> nextJob{ 0 };
+    std::atomic<bool> failed{ false };
+    ThreadPool pool(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        pool.submit([&] {
+            try {
+                for (size_t job = nextJob++; job < jobs.size() && !failed; job = nextJob++) {
+                    recoverFile(jobs[job].index);
+                }
+            }
+            catch (...) {
+                failed = true;
+                throw;
+            }
+        });
+    }
+    pool.wait();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "IConfigurable.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Recovers the selected files of a volume in on-disk order.
+// Files are sorted by their first sector so the drive keeps reading forward instead of seeking
+// back and forth, a bounded set of workers takes the next file in that order from a shared cursor.
+class RecoveryScheduler : public IConfigurable {
+private:
+    static constexpr uint32_t MAX_WORKERS = 4; // Recovery is bound by the drive, more workers only add seeks
+
+    struct Job {
+        uint64_t startSector;
+        size_t index; // Position in the caller's file list
+    };
+
+    std::vector<Job> jobs;
+
+public:
+    void addFile(size_t index, uint64_t startSector);
+    // Workers run() will use, 1 recovers the files on the calling thread.
+    // Analysis prints a report per file, so it stays sequential.
+    uint32_t getWorkerCount() const;
+    // Call recoverFile for every added index in ascending sector order, the first exception is rethrown
+    void run(const std::function<void(size_t)>& recoverFile);
+};
@@ -0,0 +1,307 @@
+#include "ResilientSectorReader.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+
+ResilientSectorReader::ResilientSectorReader(std::unique_ptr<SectorReader> reader, const fs::path& mapPath, const std::wstring& drivePath)
+    : inner(std::move(reader))
+    , mapPath(mapPath)
+    , lastSave(std::chrono::steady_clock::now()) {
+    if (!inner) {
+        throw std::runtime_error("Invalid sector reader");
+    }
+    bytesPerSector = inner->getBytesPerSector();
+    if (bytesPerSector == 0) {
+        throw std::runtime_error("Invalid bytes per sector");
+    }
+    totalSectors = inner->getTotalSectors();
+
+    std::u8string utf8 = fs::path(drivePath).u8string();
+    mediaKey.assign(reinterpret_cast<const char*>(utf8.data()), utf8.size());
+    loadMap();
+}
+
+ResilientSectorReader::~ResilientSectorReader() {
+    std::unique_lock<std::shared_mutex> lock(mapMutex);
+    saveMap();
+    if (badSectors > 0 || skippedSectors > 0) {
+        std::cout << "[*] Degraded media: " << badSectors << " bad sectors found, " << skippedSectors
+            << " sectors skipped" << std::endl;
+    }
+}
+
+std::map<uint64_t, ResilientSectorReader::BadRange>::const_iterator ResilientSectorReader::findRange(uint64_t sector, uint64_t end) const {
+    auto it = ranges.upper_bound(sector);
+    if (it != ranges.begin() && std::prev(it)->second.end > sector) {
+        return std::prev(it);
+    }
+    return it != ranges.end() && it->first < end ? it : ranges.end();
+}
+
+bool ResilientSectorReader::overlapsRange(uint64_t startSector, uint64_t count) const {
+    std::shared_lock<std::shared_mutex> lock(mapMutex);
+    return !ranges.empty() && findRange(startSector, startSector + count) != ranges.end();
+}
+
+void ResilientSectorReader::insertRange(uint64_t start, uint64_t end, RangeKind kind) {
+    uint64_t sector = start;
+    while (sector < end) {
+        auto existing = findRange(sector, end);
+        if (existing != ranges.end() && existing->first <= sector) {
+            // Another thread mapped these sectors already
+            sector = existing->second.end;
+            continue;
+        }
+        uint64_t gapEnd = existing != ranges.end() ? existing->first : end;
+
+        uint64_t newSectors = gapEnd - sector;
+        if (kind == RangeKind::BAD) {
+            badSectors += newSectors;
+            Metrics::getInstance().add(MetricCounter::BAD_SECTORS, newSectors);
+        }
+        else {
+            skippedSectors += newSectors;
+            Metrics::getInstance().add(MetricCounter::SECTORS_SKIPPED, newSectors);
+        }
+
+        // Touching ranges of the same kind are kept as one
+        auto inserted = ranges.emplace(sector, BadRange{ gapEnd, kind }).first;
+        if (inserted != ranges.begin()) {
+            auto previous = std::prev(inserted);
+            if (previous->second.end == sector && previous->second.kind == kind) {
+                previous->second.end = gapEnd;
+                ranges.erase(inserted);
+                inserted = previous;
+            }
+        }
+        auto next = std::next(inserted);
+        if (next != ranges.end() && next->first == gapEnd && next->second.kind == kind) {
+            inserted->second.end = next->second.end;
+            ranges.erase(next);
+        }
+        sector = gapEnd;
+    }
+}
+
+uint64_t ResilientSectorReader::markFailure(uint64_t sector) {
+    std::unique_lock<std::shared_mutex> lock(mapMutex);
+
+    // A bad sector right behind the last skipped zone means the zone goes on, the skip doubles
+    bool sameZone = sector >= lastSkipEnd && sector - lastSkipEnd <= skipSectors;
+    skipSectors = sameZone ? (std::min)(skipSectors * 2, MAX_SKIP_SECTORS) : MIN_SKIP_SECTORS;
+
+    uint64_t skipEnd = sector + 1 + skipSectors;
+    if (totalSectors > 0) skipEnd = (std::min)(skipEnd, totalSectors);
+    insertRange(sector, sector + 1, RangeKind::BAD);
+    insertRange(sector + 1, skipEnd, RangeKind::SKIPPED);
+    lastSkipEnd = skipEnd;
+    mapChanged = true;
+
+    std::cerr << "\n[!] Bad sector " << sector << ", skipping " << (skipEnd - sector - 1) << " sectors" << std::endl;
+    if (std::chrono::steady_clock::now() - lastSave >= SAVE_INTERVAL) {
+        saveMap();
+    }
+    return skipEnd;
+}
+
+bool ResilientSectorReader::findBadSector(uint64_t start, uint64_t end, uint8_t* output, uint64_t& sector) {
+    // [start, low) has been read, [low, high) holds a sector the last failed read couldn't read
+    uint64_t low = start;
+    uint64_t high = end;
+    bool confirmed = end - start == 1;
+    while (high - low > 1) {
+        uint64_t middle = low + (high - low) / 2;
+        if (inner->readSectors(low, static_cast<uint32_t>(middle - low), output + (low - start) * bytesPerSector)) {
+            low = middle;
+            confirmed = false;
+        }
+        else {
+            high = middle;
+            confirmed = true;
+        }
+    }
+
+    // The upper half was never read on its own, the failure may have been transient
+    if (!confirmed && inner->readSectors(low, 1, output + (low - start) * bytesPerSector)) {
+        sector = low + 1;
+        return false;
+    }
+    sector = low;
+    return true;
+}
+
+void ResilientSectorReader::loadMap() {
+    std::ifstream mapFile(mapPath);
+    if (!mapFile) return;
+
+    std::ostringstream geometry;
+    geometry << "sectors " << totalSectors << " " << bytesPerSector;
+
+    std::string line;
+    bool matches = true;
+    while (matches && std::getline(mapFile, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        if (line.rfind("drive ", 0) == 0) {
+            matches = line.substr(6) == mediaKey;
+        }
+        else if (line.rfind("sectors ", 0) == 0) {
+            matches = line == geometry.str();
+        }
+        else {
+            uint64_t start = 0;
+            uint64_t count = 0;
+            std::istringstream range(line);
+            if (range >> start >> count && count > 0) {
+                ranges[start] = { start + count, RangeKind::BAD };
+            }
+        }
+    }
+
+    if (!matches) {
+        // Sector numbers of another drive or partition mean nothing here
+        std::wcerr << L"[!] Bad sector map " << mapPath << L" belongs to another drive, it will be replaced" << std::endl;
+        ranges.clear();
+        mapChanged = true;
+        return;
+    }
+    if (!ranges.empty()) {
+        std::wcout << L"[*] Loaded " << ranges.size() << L" bad sector ranges from " << mapPath << std::endl;
+    }
+}
+
+void ResilientSectorReader::saveMap() {
+    if (!mapChanged) return;
+
+    // Written next to the map and moved over it, an interrupted run can't leave half a map
+    std::error_code error;
+    fs::create_directories(mapPath.parent_path(), error);
+    fs::path tempPath = mapPath;
+    tempPath += L".tmp";
+    {
+        std::ofstream mapFile(tempPath, std::ios::trunc);
+        if (!mapFile) {
+            std::wcerr << L"[!] Couldn't save the bad sector map to " << mapPath << std::endl;
+            return;
+        }
+        mapFile << "# Bad sectors, one range per line: first sector and sector count\n";
+        mapFile << "drive " << mediaKey << "\n";
+        mapFile << "sectors " << totalSectors << " " << bytesPerSector << "\n";
+        for (const auto& [start, range] : ranges) {
+            if (range.kind == RangeKind::BAD) mapFile << start << " " << (range.end - start) << "\n";
+        }
+    }
+    fs::rename(tempPath, mapPath, error);
+    if (error) {
+        std::wcerr << L"[!] Couldn't save the bad sector map to " << mapPath << std::endl;
+        return;
+    }
+    mapChanged = false;
+    lastSave = std::chrono::steady_clock::now();
+}
+
+bool ResilientSectorReader::readSector(uint64_t sector, void* buffer, uint32_t size) {
+    uint64_t count = (std::max)(static_cast<uint64_t>(1), (static_cast<uint64_t>(size) + bytesPerSector - 1) / bytesPerSector);
+    if (overlapsRange(sector, count)) return false;
+    if (inner->readSector(sector, buffer, size)) return true;
+    markFailure(sector);
+    return false;
+}
+
+bool ResilientSectorReader::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    if (overlapsRange(startSector, count)) return false;
+    if (inner->readSectors(startSector, count, buffer)) return true;
+    // Larger reads are bisected by salvageSectors, callers that only need all or nothing don't pay for it
+    if (count == 1) markFailure(startSector);
+    return false;
+}
+
+bool ResilientSectorReader::readBatch(std::vector<ReadRequest>& requests) {
+    bool hasKnownRanges = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(mapMutex);
+        hasKnownRanges = !ranges.empty();
+    }
+    if (!hasKnownRanges) return inner->readBatch(requests);
+
+    std::vector<ReadRequest> forwarded;
+    std::vector<size_t> forwardedIndexes;
+    forwarded.reserve(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        requests[i].success = false;
+        if (!overlapsRange(requests[i].startSector, requests[i].sectorCount)) {
+            forwarded.push_back(requests[i]);
+            forwardedIndexes.push_back(i);
+        }
+    }
+    if (!forwarded.empty()) inner->readBatch(forwarded);
+
+    bool allSucceeded = forwarded.size() == requests.size();
+    for (size_t i = 0; i < forwarded.size(); i++) {
+        requests[forwardedIndexes[i]].success = forwarded[i].success;
+        allSucceeded = allSucceeded && forwarded[i].success;
+    }
+    return allSucceeded;
+}
+
+bool ResilientSectorReader::salvageSectors(uint64_t startSector, uint32_t count, void* buffer, std::vector<uint64_t>& unreadableSectors) {
+    uint8_t* output = static_cast<uint8_t*>(buffer);
+    uint64_t endSector = startSector + count;
+    uint64_t sector = startSector;
+    bool success = true;
+
+    while (sector < endSector) {
+        // Mapped sectors are zeroed without reading them, the rest is read up to the next mapped range
+        uint64_t rangeStart = endSector;
+        uint64_t rangeEnd = endSector;
+        {
+            std::shared_lock<std::shared_mutex> lock(mapMutex);
+            auto range = findRange(sector, endSector);
+            if (range != ranges.end()) {
+                rangeStart = (std::max)(range->first, sector);
+                rangeEnd = (std::min)(range->second.end, endSector);
+            }
+        }
+
+        if (rangeStart == sector) {
+            std::memset(output + (sector - startSector) * bytesPerSector, 0, (rangeEnd - sector) * bytesPerSector);
+            for (uint64_t i = sector; i < rangeEnd; i++) unreadableSectors.push_back(i);
+            success = false;
+            sector = rangeEnd;
+            continue;
+        }
+
+        uint8_t* destination = output + (sector - startSector) * bytesPerSector;
+        if (inner->readSectors(sector, static_cast<uint32_t>(rangeStart - sector), destination)) {
+            sector = rangeStart;
+            continue;
+        }
+
+        // The bad sector and the zone skipped behind it are zeroed by the next pass
+        uint64_t badSector;
+        if (findBadSector(sector, rangeStart, destination, badSector)) {
+            markFailure(badSector);
+        }
+        sector = badSector;
+    }
+    return success;
+}
+
+SectorSpan ResilientSectorReader::mapSectors([[maybe_unused]] uint64_t startSector, [[maybe_unused]] uint32_t count) {
+    // A failing source would raise an in-page error in the caller, every sector goes through a read instead
+    return {};
+}
+
+void ResilientSectorReader::close() {
+    {
+        std::unique_lock<std::shared_mutex> lock(mapMutex);
+        saveMap();
+    }
+    inner->close();
+}
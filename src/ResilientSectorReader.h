@@ -0,0 +1,84 @@
+#pragma once
+#include "SectorReader.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Reads a failing drive without stalling on its bad areas.
+// Every failed sector costs the drive's and the system's retries, so sectors are only read one by one
+// to find the first bad sector of a failed read: the read is bisected, the good half is kept.
+// Past a bad sector the next sectors are skipped without reading them, the skip doubles with every
+// bad sector found in a row, up to MAX_SKIP_SECTORS, and starts over after a good read.
+// Bad sectors are kept in a map that is saved next to the logs, so a later run doesn't read them again.
+// Skipped sectors are only avoided for the rest of the run, a later run gives them another try.
+class ResilientSectorReader : public SectorReader {
+private:
+    static constexpr uint64_t MIN_SKIP_SECTORS = 16;
+    static constexpr uint64_t MAX_SKIP_SECTORS = 32768; // 16 MiB of 512 byte sectors
+    static constexpr std::chrono::seconds SAVE_INTERVAL{ 10 };
+
+    enum class RangeKind : uint8_t { BAD, SKIPPED };
+
+    struct BadRange {
+        uint64_t end; // One past the last sector
+        RangeKind kind;
+    };
+
+    std::unique_ptr<SectorReader> inner;
+    fs::path mapPath;
+    std::string mediaKey;        // UTF-8 drive path, a map of another drive is ignored
+    uint32_t bytesPerSector;
+    uint64_t totalSectors;
+
+    mutable std::shared_mutex mapMutex;
+    std::map<uint64_t, BadRange> ranges; // By first sector, never overlapping
+    uint64_t badSectors = 0;
+    uint64_t skippedSectors = 0;
+    bool mapChanged = false;
+    std::chrono::steady_clock::time_point lastSave;
+    uint64_t skipSectors = MIN_SKIP_SECTORS; // Length of the last skipped zone
+    uint64_t lastSkipEnd = 0;
+
+    // First known range ending after sector and starting before end, ranges.end() if there is none
+    std::map<uint64_t, BadRange>::const_iterator findRange(uint64_t sector, uint64_t end) const;
+    bool overlapsRange(uint64_t startSector, uint64_t count) const;
+    // Add the sectors of [start, end) that aren't in the map yet, caller holds the exclusive lock
+    void insertRange(uint64_t start, uint64_t end, RangeKind kind);
+    // Record a bad sector and skip the sectors behind it, returns the end of the skipped zone
+    uint64_t markFailure(uint64_t sector);
+    // Bisect a failed read of [start, end) down to its first unreadable sector, the sectors before it are read
+    // into output. False if the failure didn't repeat, sector is then the first sector not read yet.
+    bool findBadSector(uint64_t start, uint64_t end, uint8_t* output, uint64_t& sector);
+
+    void loadMap();
+    // Write the bad ranges if the map changed, caller holds the exclusive lock
+    void saveMap();
+
+public:
+    ResilientSectorReader(std::unique_ptr<SectorReader> inner, const fs::path& mapPath, const std::wstring& drivePath);
+    ~ResilientSectorReader() override;
+
+    // Known bad or skipped sectors fail without touching the drive
+    bool readSector(uint64_t sector, void* buffer, uint32_t size) override;
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer) override;
+    // Requests over known bad sectors fail right away, the rest is forwarded as a batch
+    bool readBatch(std::vector<ReadRequest>& requests) override;
+    bool salvageSectors(uint64_t startSector, uint32_t count, void* buffer, std::vector<uint64_t>& unreadableSectors) override;
+    // Nothing is mapped, reads of a failing source have to be able to fail
+    SectorSpan mapSectors(uint64_t startSector, uint32_t count) override;
+    uint64_t getTotalSectors() override { return totalSectors; }
+    uint32_t getBytesPerSector() override { return bytesPerSector; }
+    std::wstring getFilesystemType() override { return inner->getFilesystemType(); }
+    uint64_t getTotalMftRecords() override { return inner->getTotalMftRecords(); }
+    bool isOpen() const override { return inner->isOpen(); }
+    bool reopen() override { return inner->reopen(); }
+    // Closing saves the bad sector map
+    void close() override;
+};
@@ -0,0 +1,347 @@
+#include "ResultLogger.h"
+#include <cstdio>
+#include <iostream>
+#include <system_error>
+
+
+namespace {
+    // Encode UTF-16 (or UTF-32 where wchar_t is 4 bytes) as UTF-8, lone surrogates become U+FFFD
+    void appendUtf8(std::wstring_view text, std::string& output) {
+        for (size_t i = 0; i < text.size(); i++) {
+            uint32_t c = static_cast<uint32_t>(text[i]);
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < text.size()
+                && static_cast<uint32_t>(text[i + 1]) >= 0xDC00 && static_cast<uint32_t>(text[i + 1]) <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<uint32_t>(text[++i]) - 0xDC00);
+            }
+            else if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+                c = 0xFFFD;
+            }
+
+            if (c < 0x80) {
+                output += static_cast<char>(c);
+            }
+            else if (c < 0x800) {
+                output += static_cast<char>(0xC0 | (c >> 6));
+                output += static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000) {
+                output += static_cast<char>(0xE0 | (c >> 12));
+                output += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                output += static_cast<char>(0x80 | (c & 0x3F));
+            }
+            else {
+                output += static_cast<char>(0xF0 | (c >> 18));
+                output += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                output += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                output += static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+    }
+
+    void appendJsonString(std::wstring_view text, std::string& output) {
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+        std::string utf8;
+        appendUtf8(text, utf8);
+
+        output += '"';
+        for (char c : utf8) {
+            if (c == '"' || c == '\\') {
+                output += '\\';
+                output += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20) {
+                output += "\\u00";
+                output += HEX_DIGITS[(c >> 4) & 0xF];
+                output += HEX_DIGITS[c & 0xF];
+            }
+            else {
+                output += c;
+            }
+        }
+        output += '"';
+    }
+
+    // Three decimals are plenty for the entropy of a few kilobytes
+    void appendFixed(double value, std::string& output) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", value);
+        output += text;
+    }
+
+    const char* getVerdictName(FormatVerdict verdict) {
+        switch (verdict) {
+        case FormatVerdict::VALID_VERDICT: return "valid";
+        case FormatVerdict::DAMAGED_VERDICT: return "damaged";
+        default: return "unchecked";
+        }
+    }
+
+    // Always quoted, quotes inside are doubled
+    void appendCsvString(std::wstring_view text, std::string& output) {
+        std::string utf8;
+        appendUtf8(text, utf8);
+
+        output += '"';
+        for (char c : utf8) {
+            if (c == '"') output += '"';
+            output += c;
+        }
+        output += '"';
+    }
+}
+
+ResultLogger::~ResultLogger() {
+    stop();
+}
+
+bool ResultLogger::start(const fs::path& logPath, LogFormat format, ResultLogType type, bool console) {
+    stop();
+    this->format = format;
+    this->type = type;
+    this->console = console;
+
+    if (!logPath.empty()) {
+        std::error_code error;
+        bool isNewFile = !fs::exists(logPath, error) || fs::file_size(logPath, error) == 0;
+        logFile.open(logPath, std::ios::binary | std::ios::app);
+        if (logFile && isNewFile && format == LogFormat::CSV_FORMAT) {
+            logFile << (type == ResultLogType::RECOVERED_FILES_TYPE ? "id,path,size,recovered,sha256,xxh3\n"
+                : type == ResultLogType::CONTENT_SCORES_TYPE ? "id,path,size,confidence,entropy,detected,format,samples,zero_samples,unreadable_samples\n"
+                : "id,path,size,first_cluster,extents,predicted\n");
+        }
+    }
+
+    writer = std::thread(&ResultLogger::run, this);
+    return logPath.empty() || logFile.is_open();
+}
+
+void ResultLogger::push(Node* node) {
+    node->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    // The writer only sleeps on an empty list
+    if (!node->next) head.notify_one();
+}
+
+void ResultLogger::log(LoggedFile&& file) {
+    push(new Node{ std::move(file) });
+}
+
+void ResultLogger::stop() {
+    if (!writer.joinable()) return;
+    push(&stopNode);
+    writer.join();
+    if (logFile.is_open()) logFile.close();
+}
+
+void ResultLogger::run() {
+    std::string logBuffer;
+    std::wstring consoleBuffer;
+    bool stopping = false;
+
+    while (!stopping) {
+        Node* batch = head.exchange(nullptr, std::memory_order_acquire);
+        if (!batch) {
+            // Nothing queued, what is buffered is written before waiting
+            flush(logBuffer, consoleBuffer);
+            head.wait(nullptr, std::memory_order_acquire);
+            continue;
+        }
+
+        // The list is newest first, reverse it to keep the order the files were found in
+        Node* ordered = nullptr;
+        while (batch) {
+            Node* next = batch->next;
+            batch->next = ordered;
+            ordered = batch;
+            batch = next;
+        }
+
+        while (ordered) {
+            Node* node = ordered;
+            ordered = node->next;
+            if (node == &stopNode) {
+                stopping = true;
+                continue;
+            }
+
+            if (console) consoleBuffer += formatConsoleLine(node->file);
+            if (logFile.is_open()) {
+                bool isJson = format == LogFormat::JSONL_FORMAT;
+                if (type == ResultLogType::RECOVERED_FILES_TYPE) {
+                    if (isJson) appendRecoveredJson(node->file, logBuffer);
+                    else appendRecoveredCsv(node->file, logBuffer);
+                }
+                else if (type == ResultLogType::CONTENT_SCORES_TYPE) {
+                    if (isJson) appendScoreJson(node->file, logBuffer);
+                    else appendScoreCsv(node->file, logBuffer);
+                }
+                else if (isJson) appendJson(node->file, logBuffer);
+                else appendCsv(node->file, logBuffer);
+            }
+            delete node;
+
+            if (logBuffer.size() >= FLUSH_BYTES || consoleBuffer.size() >= FLUSH_BYTES / sizeof(wchar_t)) {
+                flush(logBuffer, consoleBuffer);
+            }
+        }
+    }
+    flush(logBuffer, consoleBuffer);
+}
+
+void ResultLogger::flush(std::string& logBuffer, std::wstring& consoleBuffer) {
+    if (!consoleBuffer.empty()) {
+        std::wcout << consoleBuffer << std::flush;
+        consoleBuffer.clear();
+    }
+    if (!logBuffer.empty()) {
+        logFile.write(logBuffer.data(), logBuffer.size());
+        logFile.flush();
+        logBuffer.clear();
+    }
+}
+
+void ResultLogger::appendCsv(const LoggedFile& file, std::string& buffer) const {
+    buffer += std::to_string(file.fileId);
+    buffer += ',';
+    appendCsvString(file.path, buffer);
+    buffer += ',';
+    buffer += std::to_string(file.fileSize);
+    buffer += ',';
+    buffer += std::to_string(file.firstCluster);
+    buffer += ',';
+
+    // Extents as start+length separated by ';', sparse runs have no start
+    for (size_t i = 0; i < file.extents.size(); i++) {
+        if (i > 0) buffer += ';';
+        const FileExtent& extent = file.extents[i];
+        buffer += extent.sparse ? std::string("sparse") : std::to_string(extent.startCluster);
+        buffer += '+';
+        buffer += std::to_string(extent.length);
+    }
+    buffer += ',';
+    buffer += file.isExtensionPredicted ? '1' : '0';
+    buffer += '\n';
+}
+
+void ResultLogger::appendJson(const LoggedFile& file, std::string& buffer) const {
+    buffer += "{\"id\":";
+    buffer += std::to_string(file.fileId);
+    buffer += ",\"path\":";
+    appendJsonString(file.path, buffer);
+    buffer += ",\"size\":";
+    buffer += std::to_string(file.fileSize);
+    buffer += ",\"firstCluster\":";
+    buffer += std::to_string(file.firstCluster);
+
+    // Every extent is [start, length], sparse runs have a null start
+    buffer += ",\"extents\":[";
+    for (size_t i = 0; i < file.extents.size(); i++) {
+        if (i > 0) buffer += ',';
+        const FileExtent& extent = file.extents[i];
+        buffer += '[';
+        buffer += extent.sparse ? std::string("null") : std::to_string(extent.startCluster);
+        buffer += ',';
+        buffer += std::to_string(extent.length);
+        buffer += ']';
+    }
+    buffer += "],\"predicted\":";
+    buffer += file.isExtensionPredicted ? "true" : "false";
+    buffer += "}\n";
+}
+
+void ResultLogger::appendRecoveredCsv(const LoggedFile& file, std::string& buffer) const {
+    // Digests that weren't computed are left empty
+    buffer += std::to_string(file.fileId);
+    buffer += ',';
+    appendCsvString(file.path, buffer);
+    buffer += ',';
+    buffer += std::to_string(file.fileSize);
+    buffer += ',';
+    buffer += std::to_string(file.recoveredBytes);
+    buffer += ',';
+    buffer += file.digests.sha256;
+    buffer += ',';
+    buffer += file.digests.xxh3;
+    buffer += '\n';
+}
+
+void ResultLogger::appendRecoveredJson(const LoggedFile& file, std::string& buffer) const {
+    buffer += "{\"id\":";
+    buffer += std::to_string(file.fileId);
+    buffer += ",\"path\":";
+    appendJsonString(file.path, buffer);
+    buffer += ",\"size\":";
+    buffer += std::to_string(file.fileSize);
+    buffer += ",\"recovered\":";
+    buffer += std::to_string(file.recoveredBytes);
+
+    // Only the digests that were computed
+    if (!file.digests.sha256.empty()) {
+        buffer += ",\"sha256\":\"";
+        buffer += file.digests.sha256;
+        buffer += '"';
+    }
+    if (!file.digests.xxh3.empty()) {
+        buffer += ",\"xxh3\":\"";
+        buffer += file.digests.xxh3;
+        buffer += '"';
+    }
+    buffer += "}\n";
+}
+
+std::wstring ResultLogger::formatConsoleLine(const LoggedFile& file) {
+    return L"[+] #" + std::to_wstring(file.fileId) + L" Found file \"" + file.path + L"\" ("
+        + std::to_wstring(file.fileSize) + L" bytes)\n";
+}
+
+void ResultLogger::appendScoreCsv(const LoggedFile& file, std::string& buffer) const {
+    const ContentScore& score = file.score;
+    buffer += std::to_string(file.fileId);
+    buffer += ',';
+    appendCsvString(file.path, buffer);
+    buffer += ',';
+    buffer += std::to_string(file.fileSize);
+    buffer += ',';
+    buffer += std::to_string(score.confidence);
+    buffer += ',';
+    appendFixed(score.entropy, buffer);
+    buffer += ',';
+    appendUtf8(score.detectedType, buffer);
+    buffer += ',';
+    buffer += getVerdictName(score.format);
+    buffer += ',';
+    buffer += std::to_string(score.samples);
+    buffer += ',';
+    buffer += std::to_string(score.zeroSamples);
+    buffer += ',';
+    buffer += std::to_string(score.unreadableSamples);
+    buffer += '\n';
+}
+
+void ResultLogger::appendScoreJson(const LoggedFile& file, std::string& buffer) const {
+    const ContentScore& score = file.score;
+    buffer += "{\"id\":";
+    buffer += std::to_string(file.fileId);
+    buffer += ",\"path\":";
+    appendJsonString(file.path, buffer);
+    buffer += ",\"size\":";
+    buffer += std::to_string(file.fileSize);
+    buffer += ",\"confidence\":";
+    buffer += std::to_string(score.confidence);
+    buffer += ",\"entropy\":";
+    appendFixed(score.entropy, buffer);
+
+    // A file without a known signature has a null type
+    buffer += ",\"detected\":";
+    if (score.detectedType.empty()) buffer += "null";
+    else appendJsonString(score.detectedType, buffer);
+    buffer += ",\"format\":\"";
+    buffer += getVerdictName(score.format);
+    buffer += "\",\"samples\":";
+    buffer += std::to_string(score.samples);
+    buffer += ",\"zeroSamples\":";
+    buffer += std::to_string(score.zeroSamples);
+    buffer += ",\"unreadableSamples\":";
+    buffer += std::to_string(score.unreadableSamples);
+    buffer += "}\n";
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "Enums.h"
+#include "FileHasher.h"
+#include "Structures.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Found or recovered file as written to the console and the result logs
+struct LoggedFile {
+    uint32_t fileId = 0;
+    std::wstring path;               // Found files relative to the volume root, recovered ones to the output folder
+    uint64_t fileSize = 0;
+    uint64_t firstCluster = 0;       // 0 for data stored in the file's metadata record
+    std::vector<FileExtent> extents; // In file order, empty for resident data
+    bool isExtensionPredicted = false;
+    uint64_t recoveredBytes = 0;     // Recovered files only
+    FileDigests digests;             // Recovered files only
+    ContentScore score;              // Scored files only
+};
+
+// Writes found or recovered files on a background thread, so the workers never wait for the console or the log.
+// Producers push onto a lock-free list, the writer takes the whole list at once and formats it
+// into large buffers. The log is UTF-8 CSV or JSON lines with the same fields.
+class ResultLogger {
+private:
+    static constexpr size_t FLUSH_BYTES = 1024 * 1024; // Buffered output written at once
+
+    struct Node {
+        LoggedFile file;
+        Node* next = nullptr;
+    };
+
+    std::atomic<Node*> head{ nullptr }; // Most recently pushed first
+    Node stopNode;                      // Pushed by stop(), the writer exits once it reaches it
+    std::thread writer;
+    std::ofstream logFile;
+    LogFormat format = LogFormat::CSV_FORMAT;
+    ResultLogType type = ResultLogType::FOUND_FILES_TYPE;
+    bool console = true;
+
+    void push(Node* node);
+    void run();
+    // Write the buffers once they are large or the queue ran empty
+    void flush(std::string& logBuffer, std::wstring& consoleBuffer);
+    void appendCsv(const LoggedFile& file, std::string& buffer) const;
+    void appendJson(const LoggedFile& file, std::string& buffer) const;
+    void appendRecoveredCsv(const LoggedFile& file, std::string& buffer) const;
+    void appendRecoveredJson(const LoggedFile& file, std::string& buffer) const;
+    void appendScoreCsv(const LoggedFile& file, std::string& buffer) const;
+    void appendScoreJson(const LoggedFile& file, std::string& buffer) const;
+
+public:
+    ResultLogger() = default;
+    ~ResultLogger();
+
+    // Prevent copying, the writer thread refers to the logger
+    ResultLogger(const ResultLogger&) = delete;
+    ResultLogger& operator=(const ResultLogger&) = delete;
+
+    // Start the writer thread. An empty path logs to the console only, false if the log can't be created.
+    bool start(const fs::path& logPath, LogFormat format, ResultLogType type, bool console);
+    // Queue a found file, safe to call from any thread while the logger runs
+    void log(LoggedFile&& file);
+    // Write everything queued and stop the writer thread
+    void stop();
+    bool isRunning() const { return writer.joinable(); }
+    bool isLogOpen() const { return logFile.is_open(); }
+
+    // Console line of a found file, ends with a newline
+    static std::wstring formatConsoleLine(const LoggedFile& file);
+};
@@ -0,0 +1,104 @@
+#include "ScanCheckpoint.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+
+ScanCheckpoint::ScanCheckpoint(const VolumeKey& key)
+    : IConfigurable(), key(key), nextSave(std::chrono::steady_clock::now() + MIN_INTERVAL) {
+    std::wstringstream name;
+    name << L"ScanCheckpoint_" << std::hex << std::uppercase << std::setw(16) << std::setfill(L'0') << key.serial << L".bin";
+    checkpointPath = fs::path(config.outputFolder) / fs::path(config.logFolder) / name.str();
+}
+
+bool ScanCheckpoint::isDue() const {
+    return std::chrono::steady_clock::now() >= nextSave;
+}
+
+bool ScanCheckpoint::save(uint32_t nextFileId, const IndexWriter& frontier, const IndexWriter& results) {
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<uint8_t>& frontierData = frontier.getData();
+    const std::vector<uint8_t>& resultData = results.getData();
+
+    IndexWriter header;
+    for (char c : MAGIC) header.write(c);
+    header.write(VERSION);
+    header.write(static_cast<uint32_t>(sizeof(wchar_t)));
+    ScanIndex::writeKey(header, key);
+    header.write(nextFileId);
+    header.write(static_cast<uint64_t>(frontierData.size()));
+    header.write(static_cast<uint64_t>(resultData.size()));
+    header.write(ScanIndex::hash(resultData.data(), resultData.size(), ScanIndex::hash(frontierData.data(), frontierData.size())));
+
+    // Swapped in like the scan index, an interruption while saving leaves the previous checkpoint
+    fs::path temporaryPath = checkpointPath;
+    temporaryPath += L".tmp";
+    bool saved = true;
+    try {
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(header.getData().data()), header.getData().size());
+            file.write(reinterpret_cast<const char*>(frontierData.data()), frontierData.size());
+            file.write(reinterpret_cast<const char*>(resultData.data()), resultData.size());
+            saved = static_cast<bool>(file);
+        }
+        if (saved) fs::rename(temporaryPath, checkpointPath);
+    }
+    catch (const fs::filesystem_error& e) {
+        std::cerr << "[!] Failed to write the scan checkpoint: " << e.what() << std::endl;
+        saved = false;
+    }
+
+    // The results only grow, so a slow save pushes the next one further out
+    auto now = std::chrono::steady_clock::now();
+    nextSave = now + (std::max)(std::chrono::duration_cast<std::chrono::steady_clock::duration>(MIN_INTERVAL), (now - start) * SAVE_COST_FACTOR);
+    return saved;
+}
+
+bool ScanCheckpoint::load(uint32_t& nextFileId, std::vector<uint8_t>& frontier, std::vector<uint8_t>& results) const {
+    std::ifstream file(checkpointPath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> content(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(content.data()), content.size())) {
+        return false;
+    }
+
+    IndexReader reader(content.data(), content.size());
+    char magic[sizeof(MAGIC)];
+    for (char& c : magic) c = reader.read<char>();
+    if (!reader.isValid() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        reader.read<uint32_t>() != VERSION || reader.read<uint32_t>() != sizeof(wchar_t)) {
+        return false;
+    }
+
+    if (ScanIndex::readKey(reader) != key) {
+        std::cout << "[*] The volume changed since the scan checkpoint was written" << std::endl;
+        return false;
+    }
+
+    nextFileId = reader.read<uint32_t>();
+    uint64_t frontierBytes = reader.read<uint64_t>();
+    uint64_t resultBytes = reader.read<uint64_t>();
+    uint64_t payloadHash = reader.read<uint64_t>();
+    const uint8_t* payload = content.data() + (content.size() - reader.getRemaining());
+    if (!reader.isValid() || frontierBytes > reader.getRemaining() || frontierBytes + resultBytes != reader.getRemaining() ||
+        ScanIndex::hash(payload + frontierBytes, resultBytes, ScanIndex::hash(payload, frontierBytes)) != payloadHash) {
+        std::cerr << "[!] The scan checkpoint is damaged" << std::endl;
+        return false;
+    }
+
+    frontier.assign(payload, payload + frontierBytes);
+    results.assign(payload + frontierBytes, payload + frontierBytes + resultBytes);
+    return true;
+}
+
+void ScanCheckpoint::remove() const {
+    std::error_code error;
+    fs::remove(checkpointPath, error);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "IConfigurable.h"
+#include "ScanIndex.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Progress of an unfinished scan persisted under the log folder, so --resume continues an interrupted
+// scan instead of starting over. The frontier is the engine's position (the next MFT record, the directories
+// still to scan), the results are the files found before it. Like the scan index it is only used while the
+// volume key still matches, and it is removed once the scan completes.
+class ScanCheckpoint : public IConfigurable {
+private:
+    static constexpr char MAGIC[8] = { 'D', 'R', 'T', 'C', 'H', 'K', 'P', 'T' };
+    static constexpr uint32_t VERSION = 1;
+    static constexpr std::chrono::seconds MIN_INTERVAL{ 30 }; // Between two saves
+    static constexpr uint32_t SAVE_COST_FACTOR = 10;          // The interval is at least this many times the last save
+
+    VolumeKey key;
+    fs::path checkpointPath;
+    std::chrono::steady_clock::time_point nextSave;
+
+public:
+    explicit ScanCheckpoint(const VolumeKey& key);
+
+    // True once the interval since the last save passed
+    bool isDue() const;
+    // Replace the checkpoint of the volume
+    bool save(uint32_t nextFileId, const IndexWriter& frontier, const IndexWriter& results);
+    // Load the checkpoint if it belongs to this volume state, false means the scan starts from the beginning
+    bool load(uint32_t& nextFileId, std::vector<uint8_t>& frontier, std::vector<uint8_t>& results) const;
+    // Delete the checkpoint after the scan completed
+    void remove() const;
+    const fs::path& getPath() const { return checkpointPath; }
+};
@@ -0,0 +1,165 @@
+#include "ScanFilter.h"
+#include <cwctype>
+#include <sstream>
+#include <stdexcept>
+
+
+IdSelection IdSelection::parse(const std::string& list) {
+    IdSelection selection;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+
+        size_t consumed = 0;
+        size_t dashPos = item.find('-');
+        if (dashPos == std::string::npos) {
+            unsigned long id = std::stoul(item, &consumed);
+            if (consumed != item.size()) throw std::invalid_argument("Invalid file ID: " + item);
+            selection.ids.insert(static_cast<uint32_t>(id));
+            continue;
+        }
+
+        std::string first = item.substr(0, dashPos);
+        std::string last = item.substr(dashPos + 1);
+        unsigned long rangeStart = std::stoul(first, &consumed);
+        if (consumed != first.size()) throw std::invalid_argument("Invalid file ID range: " + item);
+        unsigned long rangeEnd = std::stoul(last, &consumed);
+        if (consumed != last.size() || rangeEnd < rangeStart) throw std::invalid_argument("Invalid file ID range: " + item);
+        selection.ranges.push_back({ static_cast<uint32_t>(rangeStart), static_cast<uint32_t>(rangeEnd) });
+    }
+    return selection;
+}
+
+bool IdSelection::contains(uint32_t fileId) const {
+    if (ids.count(fileId) != 0) return true;
+    for (const auto& range : ranges) {
+        if (fileId >= range.first && fileId <= range.second) return true;
+    }
+    return false;
+}
+
+ScanFilter::ScanFilter() {
+    inputFolder = toLower(normalizePath(config.inputFolder));
+    pathPattern = toLower(normalizePath(config.pathPattern));
+    idSelection = IdSelection::parse(config.fileIdFilter);
+
+    std::wstringstream ss(config.extensionFilter);
+    std::wstring extension;
+    while (std::getline(ss, extension, L',')) {
+        if (!extension.empty() && extension[0] == L'.') extension.erase(0, 1);
+        if (!extension.empty()) extensions.insert(toLower(extension));
+    }
+}
+
+std::wstring ScanFilter::toLower(std::wstring_view value) {
+    std::wstring lower(value);
+    for (wchar_t& c : lower) {
+        c = static_cast<wchar_t>(std::towlower(c));
+    }
+    return lower;
+}
+
+bool ScanFilter::matchesPattern(std::wstring_view pattern, std::wstring_view value) {
+    // Greedy match, a mismatch after a '*' retries with the star covering one more character
+    size_t p = 0, v = 0;
+    size_t starPos = std::wstring_view::npos, starValue = 0;
+    while (v < value.size()) {
+        if (p < pattern.size() && (pattern[p] == L'?' || pattern[p] == value[v])) {
+            p++;
+            v++;
+        }
+        else if (p < pattern.size() && pattern[p] == L'*') {
+            starPos = p++;
+            starValue = v;
+        }
+        else if (starPos != std::wstring_view::npos) {
+            p = starPos + 1;
+            v = ++starValue;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == L'*') p++;
+    return p == pattern.size();
+}
+
+bool ScanFilter::isWithin(std::wstring_view path, std::wstring_view prefix) {
+    if (prefix.empty()) return true;
+    if (path.size() < prefix.size() || path.compare(0, prefix.size(), prefix) != 0) return false;
+    return path.size() == prefix.size() || path[prefix.size()] == L'\\';
+}
+
+std::wstring ScanFilter::normalizePath(std::wstring_view path) {
+    std::wstring normalized(path);
+    for (wchar_t& c : normalized) {
+        if (c == L'/') c = L'\\';
+    }
+    if (normalized.size() >= 2 && normalized[1] == L':') normalized.erase(0, 2);
+
+    size_t first = normalized.find_first_not_of(L'\\');
+    size_t last = normalized.find_last_not_of(L'\\');
+    if (first == std::wstring::npos) return L"";
+    return normalized.substr(first, last - first + 1);
+}
+
+std::wstring ScanFilter::joinPath(std::wstring_view folder, std::wstring_view name) {
+    std::wstring path;
+    path.reserve(folder.size() + name.size() + 1);
+    path = folder;
+    if (!path.empty()) path += L'\\';
+    path += name;
+    return path;
+}
+
+bool ScanFilter::isActive() const {
+    return needsPaths() || !extensions.empty() || !idSelection.empty()
+        || config.minFileSize != 0 || config.maxFileSize != UINT64_MAX
+        || config.targetCluster != 0 || config.targetFileSize != 0;
+}
+
+bool ScanFilter::needsPaths() const {
+    return !inputFolder.empty() || !pathPattern.empty();
+}
+
+bool ScanFilter::tracksPaths() const {
+    return needsPaths() || config.createFileDataLog;
+}
+
+bool ScanFilter::matchesDirectory(std::wstring_view directoryPath) const {
+    if (inputFolder.empty()) return true;
+
+    // Directories on the way to the input folder are walked as well as everything below it
+    std::wstring lowerPath = toLower(directoryPath);
+    return isWithin(lowerPath, inputFolder) || isWithin(inputFolder, lowerPath);
+}
+
+bool ScanFilter::matchesPath(std::wstring_view filePath) const {
+    if (!needsPaths()) return true;
+
+    std::wstring lowerPath = toLower(filePath);
+    if (!inputFolder.empty() && (lowerPath.size() == inputFolder.size() || !isWithin(lowerPath, inputFolder))) {
+        return false;
+    }
+    return pathPattern.empty() || matchesPattern(pathPattern, lowerPath);
+}
+
+bool ScanFilter::matchesAttributes(uint64_t fileSize, uint64_t cluster) const {
+    if (fileSize < config.minFileSize || fileSize > config.maxFileSize) return false;
+    if (config.targetFileSize != 0 && fileSize != config.targetFileSize) return false;
+    if (config.targetCluster != 0 && cluster != config.targetCluster) return false;
+    return true;
+}
+
+bool ScanFilter::matchesExtension(std::wstring_view fileName) const {
+    if (extensions.empty()) return true;
+
+    size_t dotPos = fileName.find_last_of(L'.');
+    if (dotPos == std::wstring_view::npos || dotPos == 0) return false;
+    return extensions.count(toLower(fileName.substr(dotPos + 1))) != 0;
+}
+
+bool ScanFilter::matchesId(uint32_t fileId) const {
+    return idSelection.empty() || idSelection.contains(fileId);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "IConfigurable.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// File IDs picked on the command line or at the prompt, e.g. "1,5,10-20"
+class IdSelection {
+private:
+    std::unordered_set<uint32_t> ids;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges; // Inclusive bounds
+
+public:
+    // Throws std::invalid_argument or std::out_of_range if the list holds anything but IDs and ranges
+    static IdSelection parse(const std::string& list);
+
+    bool contains(uint32_t fileId) const;
+    bool empty() const { return ids.empty() && ranges.empty(); }
+};
+
+// Command line predicates, checked while scanning so entries that don't match are never stored.
+// Paths are relative to the volume root, separated by '\' and compared case insensitively.
+// File IDs count the files left by the other predicates, so they match a run with the same filters.
+class ScanFilter : public IConfigurable {
+private:
+    std::wstring inputFolder;                    // Lower case, empty = whole volume
+    std::wstring pathPattern;                    // Lower case, * and ? wildcards
+    std::unordered_set<std::wstring> extensions; // Lower case, without the dot
+    IdSelection idSelection;
+
+    static std::wstring toLower(std::wstring_view value);
+    static bool matchesPattern(std::wstring_view pattern, std::wstring_view value);
+    // True if path is prefix itself or lies below it
+    static bool isWithin(std::wstring_view path, std::wstring_view prefix);
+
+public:
+    ScanFilter();
+
+    // Separators turned into '\', a drive letter and leading or trailing separators removed
+    static std::wstring normalizePath(std::wstring_view path);
+    static std::wstring joinPath(std::wstring_view folder, std::wstring_view name);
+
+    // Any predicate is set, the recovery runs without asking and the scan index is not used
+    bool isActive() const;
+    // Folder or path predicates are set, scans have to track the path of every entry
+    bool needsPaths() const;
+    // Paths are tracked for the predicates or for the file data log
+    bool tracksPaths() const;
+
+    // False if no file below the directory can match, its subtree is skipped
+    bool matchesDirectory(std::wstring_view directoryPath) const;
+    bool matchesPath(std::wstring_view filePath) const;
+    // Size range, target cluster and target size
+    bool matchesAttributes(uint64_t fileSize, uint64_t cluster) const;
+    bool matchesExtension(std::wstring_view fileName) const;
+    bool matchesId(uint32_t fileId) const;
+};
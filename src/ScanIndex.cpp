@@ -0,0 +1,167 @@
+#include "ScanIndex.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+
+void IndexWriter::writeString(std::wstring_view value) {
+    write(static_cast<uint32_t>(value.size()));
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value.data());
+    buffer.insert(buffer.end(), bytes, bytes + value.size() * sizeof(wchar_t));
+}
+
+void IndexWriter::writeBytes(std::span<const uint8_t> value) {
+    write(static_cast<uint32_t>(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+void IndexWriter::writeRaw(std::span<const uint8_t> value) {
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+bool IndexReader::canRead(uint64_t size) {
+    if (failed || size > static_cast<uint64_t>(end - position)) {
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+std::wstring IndexReader::readString() {
+    uint32_t length = read<uint32_t>();
+    if (!canRead(static_cast<uint64_t>(length) * sizeof(wchar_t))) {
+        return {};
+    }
+    std::wstring value(length, L'\0');
+    std::memcpy(value.data(), position, length * sizeof(wchar_t));
+    position += length * sizeof(wchar_t);
+    return value;
+}
+
+std::vector<uint8_t> IndexReader::readBytes() {
+    uint32_t length = read<uint32_t>();
+    if (!canRead(length)) {
+        return {};
+    }
+    std::vector<uint8_t> value(position, position + length);
+    position += length;
+    return value;
+}
+
+
+ScanIndex::ScanIndex(const VolumeKey& key) : IConfigurable(), key(key) {
+    std::wstringstream name;
+    name << L"ScanIndex_" << std::hex << std::uppercase << std::setw(16) << std::setfill(L'0') << key.serial << L".bin";
+    indexPath = fs::path(config.outputFolder) / fs::path(config.logFolder) / name.str();
+}
+
+uint64_t ScanIndex::hash(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t value = seed;
+    for (size_t i = 0; i < size; i++) {
+        value ^= bytes[i];
+        value *= FNV_PRIME;
+    }
+    return value;
+}
+
+VolumeKey ScanIndex::makeKey(FilesystemType filesystem, uint64_t serial, const void* bootSector, size_t bootSectorBytes, const AllocationBitmap& allocationBitmap) {
+    const std::vector<uint64_t>& words = allocationBitmap.getWords();
+    return {
+        .filesystem = static_cast<uint32_t>(filesystem),
+        .serial = serial,
+        .bootSectorHash = hash(bootSector, bootSectorBytes),
+        .allocationHash = hash(words.data(), words.size() * sizeof(uint64_t))
+    };
+}
+
+void ScanIndex::writeKey(IndexWriter& writer, const VolumeKey& key) {
+    writer.write(key.filesystem);
+    writer.write(key.serial);
+    writer.write(key.bootSectorHash);
+    writer.write(key.allocationHash);
+}
+
+VolumeKey ScanIndex::readKey(IndexReader& reader) {
+    VolumeKey key = {};
+    key.filesystem = reader.read<uint32_t>();
+    key.serial = reader.read<uint64_t>();
+    key.bootSectorHash = reader.read<uint64_t>();
+    key.allocationHash = reader.read<uint64_t>();
+    return key;
+}
+
+bool ScanIndex::save(uint32_t recordCount, uint32_t nextFileId, const IndexWriter& records) const {
+    const std::vector<uint8_t>& payload = records.getData();
+
+    IndexWriter header;
+    for (char c : MAGIC) header.write(c);
+    header.write(VERSION);
+    header.write(static_cast<uint32_t>(sizeof(wchar_t)));
+    writeKey(header, key);
+    header.write(recordCount);
+    header.write(nextFileId);
+    header.write(static_cast<uint64_t>(payload.size()));
+    header.write(hash(payload.data(), payload.size()));
+
+    // Written next to the old index and swapped in, an interrupted run leaves the old one intact
+    fs::path temporaryPath = indexPath;
+    temporaryPath += L".tmp";
+    try {
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(header.getData().data()), header.getData().size());
+            file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+            if (!file) {
+                return false;
+            }
+        }
+        fs::rename(temporaryPath, indexPath);
+    }
+    catch (const fs::filesystem_error& e) {
+        std::cerr << "[!] Failed to write the scan index: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ScanIndex::load(uint32_t& recordCount, uint32_t& nextFileId, std::vector<uint8_t>& records) const {
+    std::ifstream file(indexPath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> content(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(content.data()), content.size())) {
+        return false;
+    }
+
+    IndexReader reader(content.data(), content.size());
+    char magic[sizeof(MAGIC)];
+    for (char& c : magic) c = reader.read<char>();
+    if (!reader.isValid() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        reader.read<uint32_t>() != VERSION || reader.read<uint32_t>() != sizeof(wchar_t)) {
+        return false;
+    }
+
+    if (readKey(reader) != key) {
+        std::cout << "[*] The volume changed since the scan index was written" << std::endl;
+        return false;
+    }
+
+    recordCount = reader.read<uint32_t>();
+    nextFileId = reader.read<uint32_t>();
+    uint64_t payloadBytes = reader.read<uint64_t>();
+    uint64_t payloadHash = reader.read<uint64_t>();
+    const uint8_t* payload = content.data() + (content.size() - reader.getRemaining());
+    // Every record takes at least a byte, a larger count can only come from a damaged header
+    if (!reader.isValid() || payloadBytes != reader.getRemaining() || recordCount > payloadBytes ||
+        hash(payload, payloadBytes) != payloadHash) {
+        std::cerr << "[!] The scan index is damaged" << std::endl;
+        return false;
+    }
+
+    records.assign(payload, payload + payloadBytes);
+    return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "IConfigurable.h"
+#include "AllocationBitmap.h"
+#include "Enums.h"
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+// Identifies the volume and its allocation state a scan index was written for
+struct VolumeKey {
+    uint32_t filesystem;     // FilesystemType
+    uint64_t serial;         // Volume serial number from the boot sector
+    uint64_t bootSectorHash;
+    uint64_t allocationHash; // Changes whenever a file is created, grown or deleted
+
+    bool operator==(const VolumeKey&) const = default;
+};
+
+// Serializes scan results for the index
+class IndexWriter {
+private:
+    std::vector<uint8_t> buffer;
+
+public:
+    template <typename T>
+    void write(T value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be written");
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+    // Length prefixed, the code units are stored as they are in memory
+    void writeString(std::wstring_view value);
+    void writeBytes(std::span<const uint8_t> value);
+    // Append records serialized earlier, without a length prefix
+    void writeRaw(std::span<const uint8_t> value);
+
+    const std::vector<uint8_t>& getData() const { return buffer; }
+};
+
+// Reads scan results back, reading past the end marks the reader as failed
+class IndexReader {
+private:
+    const uint8_t* position;
+    const uint8_t* end;
+    bool failed = false;
+
+    bool canRead(uint64_t size);
+
+public:
+    IndexReader(const uint8_t* data, size_t size) : position(data), end(data + size) {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be read");
+        T value = {};
+        if (canRead(sizeof(T))) {
+            std::memcpy(&value, position, sizeof(T));
+            position += sizeof(T);
+        }
+        return value;
+    }
+    std::wstring readString();
+    std::vector<uint8_t> readBytes();
+
+    bool isValid() const { return !failed; }
+    bool isAtEnd() const { return position == end; }
+    size_t getRemaining() const { return static_cast<size_t>(end - position); }
+};
+
+// Scan results of a volume persisted under the log folder, so repeat runs can skip the scan.
+// The index is only used while the volume key still matches, any change forces a rescan.
+class ScanIndex : public IConfigurable {
+private:
+    static constexpr char MAGIC[8] = { 'D', 'R', 'T', 'I', 'N', 'D', 'E', 'X' };
+    static constexpr uint32_t VERSION = 2; // 2 added the folder of every file
+    static constexpr uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+    static constexpr uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+    VolumeKey key;
+    fs::path indexPath;
+
+public:
+    explicit ScanIndex(const VolumeKey& key);
+
+    // Replace the index of the volume with recordCount serialized records
+    bool save(uint32_t recordCount, uint32_t nextFileId, const IndexWriter& records) const;
+    // Load the records if the index belongs to this volume state, false means a rescan is needed
+    bool load(uint32_t& recordCount, uint32_t& nextFileId, std::vector<uint8_t>& records) const;
+    const fs::path& getPath() const { return indexPath; }
+
+    // 64-bit FNV-1a
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS);
+    static VolumeKey makeKey(FilesystemType filesystem, uint64_t serial, const void* bootSector, size_t bootSectorBytes, const AllocationBitmap& allocationBitmap);
+    // Key fields in the order they are stored in the index and checkpoint headers
+    static void writeKey(IndexWriter& writer, const VolumeKey& key);
+    static VolumeKey readKey(IndexReader& reader);
+};
@@ -1,10 +1,102 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+
+// A single read of a batch submitted to SectorReader::readBatch
+struct ReadRequest {
+    uint64_t startSector;
+    uint32_t sectorCount;
+    void* buffer;
+    bool success;
+};
+
+// Sectors a backend exposes in place, the owner keeps the underlying mapping alive
+struct SectorSpan {
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+    std::shared_ptr<const void> owner;
+
+    explicit operator bool() const { return data != nullptr; }
+};
 
 class SectorReader {
 public:
     virtual bool readSector(uint64_t sector, void* buffer, uint32_t size) = 0;
+    // Read count consecutive sectors starting at startSector with a single request
+    virtual bool readSectors(uint64_t startSector, uint32_t count, void* buffer) = 0;
+    // Read length bytes starting at byteOffset, neither has to be sector aligned
+    virtual bool readRange(uint64_t byteOffset, uint64_t length, void* buffer) {
+        uint32_t bytesPerSector = getBytesPerSector();
+        if (bytesPerSector == 0) return false;
+
+        uint8_t* output = static_cast<uint8_t*>(buffer);
+        uint64_t headBytes = byteOffset % bytesPerSector;
+        uint64_t sector = byteOffset / bytesPerSector;
+
+        // Aligned requests go straight to the output buffer
+        if (headBytes == 0 && length % bytesPerSector == 0) {
+            uint64_t remaining = length / bytesPerSector;
+            while (remaining > 0) {
+                uint32_t count = static_cast<uint32_t>((std::min)(remaining, static_cast<uint64_t>(MAX_RANGE_SECTORS)));
+                if (!readSectors(sector, count, output)) return false;
+                output += static_cast<uint64_t>(count) * bytesPerSector;
+                sector += count;
+                remaining -= count;
+            }
+            return true;
+        }
+
+        // Unaligned requests are read through a bounce buffer covering whole sectors
+        std::vector<uint8_t> bounce;
+        while (length > 0) {
+            uint64_t spanSectors = (std::min)((headBytes + length + bytesPerSector - 1) / bytesPerSector, static_cast<uint64_t>(MAX_RANGE_SECTORS));
+            bounce.resize(spanSectors * bytesPerSector);
+            if (!readSectors(sector, static_cast<uint32_t>(spanSectors), bounce.data())) return false;
+
+            uint64_t copyBytes = (std::min)(length, bounce.size() - headBytes);
+            std::memcpy(output, bounce.data() + headBytes, copyBytes);
+            output += copyBytes;
+            length -= copyBytes;
+            sector += spanSectors;
+            headBytes = 0;
+        }
+        return true;
+    }
+    // Read a batch of independent requests, backends may keep several of them in flight
+    virtual bool readBatch(std::vector<ReadRequest>& requests) {
+        bool allSucceeded = true;
+        for (ReadRequest& request : requests) {
+            request.success = readSectors(request.startSector, request.sectorCount, request.buffer);
+            allSucceeded = allSucceeded && request.success;
+        }
+        return allSucceeded;
+    }
+    // Read what is readable of count sectors after a failed read. Unreadable sectors are zeroed
+    // and appended to unreadableSectors, false if there were any.
+    virtual bool salvageSectors(uint64_t startSector, uint32_t count, void* buffer, std::vector<uint64_t>& unreadableSectors) {
+        uint32_t bytesPerSector = getBytesPerSector();
+        bool success = true;
+        for (uint32_t i = 0; i < count; i++) {
+            uint8_t* sectorData = static_cast<uint8_t*>(buffer) + static_cast<uint64_t>(i) * bytesPerSector;
+            if (!readSector(startSector + i, sectorData, bytesPerSector)) {
+                std::memset(sectorData, 0, bytesPerSector);
+                unreadableSectors.push_back(startSector + i);
+                success = false;
+            }
+        }
+        return success;
+    }
+    // Expose count sectors without copying them, empty if the backend can't map them.
+    // Callers fall back to readSectors, so only memory mapped backends implement this.
+    // Touching a span reads the backing file directly: a media or network error then raises an in-page
+    // exception that ends the process instead of failing a read, so only reliable sources are mapped.
+    virtual SectorSpan mapSectors([[maybe_unused]] uint64_t startSector, [[maybe_unused]] uint32_t count) { return {}; }
+    // Number of readable sectors, 0 if unknown
+    virtual uint64_t getTotalSectors() { return 0; }
     virtual uint32_t getBytesPerSector() = 0;
     virtual std::wstring getFilesystemType() = 0;
     virtual uint64_t getTotalMftRecords() = 0;
@@ -12,4 +104,29 @@ public:
     virtual bool reopen() = 0;
     virtual void close() = 0;
     virtual ~SectorReader() = default;
+
+    // Filesystem name as reported by Windows for a mounted volume, from the boot sector signature
+    static std::wstring detectFilesystem(const uint8_t* bootSector) {
+        // Boot sector signature is required by all three filesystems
+        if (bootSector[510] != 0x55 || bootSector[511] != 0xAA) {
+            return L"UNKNOWN_TYPE";
+        }
+        if (std::memcmp(bootSector + 3, "EXFAT   ", 8) == 0) return L"exFAT";
+        if (std::memcmp(bootSector + 3, "NTFS    ", 8) == 0) return L"NTFS";
+        if (std::memcmp(bootSector + 82, "FAT32   ", 8) == 0) return L"FAT32";
+        return L"UNKNOWN_TYPE";
+    }
+    // Sector size a FAT32, exFAT or NTFS boot sector was formatted with, 0 if it isn't one
+    static uint32_t getDeclaredSectorSize(const uint8_t* bootSector) {
+        std::wstring filesystem = detectFilesystem(bootSector);
+        if (filesystem == L"exFAT") {
+            uint8_t shift = bootSector[108];
+            return shift >= 9 && shift <= 12 ? 1u << shift : 0;
+        }
+        if (filesystem == L"UNKNOWN_TYPE") return 0;
+        return static_cast<uint32_t>(bootSector[11]) | static_cast<uint32_t>(bootSector[12]) << 8;
+    }
+
+protected:
+    static constexpr uint32_t MAX_RANGE_SECTORS = 8192; // Largest single request issued by readRange
 };
\ No newline at end of file
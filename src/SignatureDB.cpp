@@ -0,0 +1,165 @@
+#include "SignatureDB.h"
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SIGNATURE_DB_USE_SSE2
+#endif
+
+using namespace std::string_view_literals;
+
+namespace {
+    constexpr uint64_t MB = 1024 * 1024;
+
+    // Magic bytes expected at an offset of the window
+    struct MagicPart {
+        size_t offset;
+        std::string_view bytes;
+    };
+
+    // Lay the magic parts out over the window, parts past WINDOW_BYTES fail to compile
+    constexpr FileSignature signature(const wchar_t* extension, std::initializer_list<MagicPart> parts, CarveRule carve = {}) {
+        FileSignature result = { extension, {}, {}, carve };
+        for (const MagicPart& part : parts) {
+            for (size_t i = 0; i < part.bytes.size(); i++) {
+                result.magic[part.offset + i] = static_cast<uint8_t>(part.bytes[i]);
+                result.mask[part.offset + i] = 0xFF;
+            }
+        }
+        return result;
+    }
+
+    // Checked in order, more specific signatures come first
+    constexpr FileSignature SIGNATURES[] = {
+        // Images
+        signature(L"jpg",    { { 0, "\xFF\xD8\xFF"sv } },                     { "\xFF\xD9"sv, 0, 32 * MB }),
+        signature(L"png",    { { 0, "\x89PNG\r\n\x1A\n"sv } },                { "IEND\xAE\x42\x60\x82"sv, 0, 32 * MB }),
+        signature(L"gif",    { { 0, "GIF87a"sv } },                           { "\x00\x3B"sv, 0, 16 * MB }),
+        signature(L"gif",    { { 0, "GIF89a"sv } },                           { "\x00\x3B"sv, 0, 16 * MB }),
+        signature(L"tif",    { { 0, "II\x2A\x00"sv } },                       { ""sv, 0, 64 * MB }),
+        signature(L"tif",    { { 0, "MM\x00\x2A"sv } },                       { ""sv, 0, 64 * MB }),
+        signature(L"webp",   { { 0, "RIFF"sv }, { 8, "WEBP"sv } },            { ""sv, 0, 32 * MB }),
+        signature(L"psd",    { { 0, "8BPS"sv } },                             { ""sv, 0, 256 * MB }),
+        signature(L"bmp",    { { 0, "BM"sv } }),
+
+        // Documents
+        signature(L"pdf",    { { 0, "%PDF-"sv } },                            { "%%EOF"sv, 0, 256 * MB }),
+        signature(L"zip",    { { 0, "PK\x03\x04"sv } },                       { "PK\x05\x06"sv, 18, 512 * MB }), // ZIP/DOCX/XLSX/PPTX
+        signature(L"doc",    { { 0, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1"sv } }, { ""sv, 0, 64 * MB }),          // DOC/XLS/PPT (Legacy Office)
+        signature(L"rtf",    { { 0, "{\\rtf"sv } },                           { ""sv, 0, 64 * MB }),
+
+        // Audio/Video
+        signature(L"wav",    { { 0, "RIFF"sv }, { 8, "WAVE"sv } },            { ""sv, 0, 512 * MB }),
+        signature(L"avi",    { { 0, "RIFF"sv }, { 8, "AVI "sv } },            { ""sv, 0, 1024 * MB }),
+        signature(L"mov",    { { 4, "ftypqt  "sv } },                         { ""sv, 0, 1024 * MB }),
+        signature(L"mp4",    { { 4, "ftyp"sv } },                             { ""sv, 0, 1024 * MB }),
+        signature(L"mkv",    { { 0, "\x1A\x45\xDF\xA3"sv } },                 { ""sv, 0, 1024 * MB }),
+        signature(L"mp3",    { { 0, "ID3"sv } },                              { ""sv, 0, 32 * MB }),
+        signature(L"flac",   { { 0, "fLaC"sv } },                             { ""sv, 0, 128 * MB }),
+        signature(L"ogg",    { { 0, "OggS"sv } },                             { ""sv, 0, 128 * MB }),
+
+        // Executables and Libraries
+        signature(L"elf",    { { 0, "\x7F" "ELF"sv } },                       { ""sv, 0, 64 * MB }),
+        signature(L"exe",    { { 0, "MZ"sv } }),                                                               // EXE/DLL
+
+        // Archives
+        signature(L"rar",    { { 0, "Rar!\x1A\x07"sv } },                     { ""sv, 0, 512 * MB }),
+        signature(L"gz",     { { 0, "\x1F\x8B\x08"sv } },                     { ""sv, 0, 512 * MB }),
+        signature(L"bz2",    { { 0, "BZh"sv } },                              { ""sv, 0, 512 * MB }),
+        signature(L"7z",     { { 0, "7z\xBC\xAF\x27\x1C"sv } },               { ""sv, 0, 512 * MB }),
+
+        // Database
+        signature(L"sqlite", { { 0, "SQLite format 3\0"sv } },                { ""sv, 0, 512 * MB }),
+
+        // Programming
+        signature(L"xml",    { { 0, "<?xml"sv } },                            { ""sv, 0, 16 * MB }),
+        signature(L"html",   { { 0, "<!DOCTYPE html"sv } },                   { "</html>"sv, 0, 16 * MB }),
+        signature(L"html",   { { 0, "<!DO"sv } }),
+        signature(L"json",   { { 0, "{\r\n "sv } }),
+
+        // Font files
+        signature(L"otf",    { { 0, "OTTO"sv } }),
+        signature(L"ttf",    { { 0, "\x00\x01\x00\x00\x00"sv } }),
+    };
+    constexpr size_t SIGNATURE_COUNT = std::size(SIGNATURES);
+    static_assert(SIGNATURE_COUNT <= UINT8_MAX, "Signature indices are stored in a byte");
+
+    // Signatures grouped by their first magic byte, in table order. Signatures whose magic doesn't
+    // start at byte 0 (ftyp) are candidates for every window.
+    struct FirstByteIndex {
+        std::array<uint8_t, 257> bucketStart = {};  // Bucket of byte b is buckets[bucketStart[b], bucketStart[b + 1])
+        std::array<uint8_t, SIGNATURE_COUNT> buckets = {};
+        std::array<uint8_t, SIGNATURE_COUNT> anyFirstByte = {};
+        size_t anyFirstByteCount = 0;
+    };
+
+    constexpr FirstByteIndex buildFirstByteIndex() {
+        FirstByteIndex index;
+        for (const FileSignature& signature : SIGNATURES) {
+            if (signature.mask[0] == 0xFF) index.bucketStart[signature.magic[0] + 1]++;
+        }
+        for (size_t value = 1; value < index.bucketStart.size(); value++) {
+            index.bucketStart[value] += index.bucketStart[value - 1];
+        }
+        std::array<uint8_t, 256> filled = {};
+        for (size_t i = 0; i < SIGNATURE_COUNT; i++) {
+            const FileSignature& signature = SIGNATURES[i];
+            if (signature.mask[0] == 0xFF) {
+                index.buckets[index.bucketStart[signature.magic[0]] + filled[signature.magic[0]]++] = static_cast<uint8_t>(i);
+            }
+            else {
+                index.anyFirstByte[index.anyFirstByteCount++] = static_cast<uint8_t>(i);
+            }
+        }
+        return index;
+    }
+
+    constexpr FirstByteIndex FIRST_BYTE_INDEX = buildFirstByteIndex();
+
+#ifdef SIGNATURE_DB_USE_SSE2
+    bool matchesWindow(__m128i bytes, const FileSignature& signature) {
+        __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature.mask.data()));
+        __m128i magic = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature.magic.data()));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(bytes, mask), magic)) == 0xFFFF;
+    }
+#else
+    bool matchesWindow(const uint8_t* window, const FileSignature& signature) {
+        for (size_t i = 0; i < SignatureDB::WINDOW_BYTES; i++) {
+            if ((window[i] & signature.mask[i]) != signature.magic[i]) return false;
+        }
+        return true;
+    }
+#endif
+}
+
+
+const FileSignature* SignatureDB::match(const uint8_t* data, size_t size) {
+    alignas(16) uint8_t window[WINDOW_BYTES] = {};
+    std::memcpy(window, data, (std::min)(size, WINDOW_BYTES));
+#ifdef SIGNATURE_DB_USE_SSE2
+    __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(window));
+#else
+    const uint8_t* bytes = window;
+#endif
+
+    // Only the bucket of the first byte and the signatures without a first byte are compared,
+    // both lists are in table order and are merged so the earlier signature still wins
+    const uint8_t* bucket = FIRST_BYTE_INDEX.buckets.data() + FIRST_BYTE_INDEX.bucketStart[window[0]];
+    const uint8_t* bucketEnd = FIRST_BYTE_INDEX.buckets.data() + FIRST_BYTE_INDEX.bucketStart[window[0] + 1];
+    const uint8_t* anyFirstByte = FIRST_BYTE_INDEX.anyFirstByte.data();
+    const uint8_t* anyFirstByteEnd = anyFirstByte + FIRST_BYTE_INDEX.anyFirstByteCount;
+    while (bucket != bucketEnd || anyFirstByte != anyFirstByteEnd) {
+        bool fromBucket = anyFirstByte == anyFirstByteEnd || (bucket != bucketEnd && *bucket < *anyFirstByte);
+        const FileSignature& signature = SIGNATURES[fromBucket ? *bucket++ : *anyFirstByte++];
+        if (matchesWindow(bytes, signature)) return &signature;
+    }
+    return nullptr;
+}
+
+std::wstring SignatureDB::guessExtension(const uint8_t* data, size_t size) {
+    const FileSignature* signature = match(data, size);
+    return signature ? signature->extension : L"bin";
+}
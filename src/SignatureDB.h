@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// How a file type is carved from free clusters, maxSize 0 means the signature is too weak to carve
+struct CarveRule {
+    std::string_view footer;            // Empty if the format has no end marker
+    uint32_t footerTrailingBytes = 0;   // Bytes that still belong to the file after the footer
+    uint64_t maxSize = 0;               // Carving stops here when no footer is found
+};
+
+// Magic bytes of a file type laid out over the first SignatureDB::WINDOW_BYTES of the file
+struct FileSignature {
+    const wchar_t* extension;
+    std::array<uint8_t, 16> magic;      // Expected bytes, zero where the mask is zero
+    std::array<uint8_t, 16> mask;       // 0xFF for every byte that is compared
+    CarveRule carve;
+};
+
+// Build time table of file signatures shared by the recovery engines and the carver.
+// A build time index by the first magic byte picks the candidates of a window, each is compared with one
+// masked 16 byte compare (SSE2 when available).
+class SignatureDB {
+public:
+    static constexpr size_t WINDOW_BYTES = 16;
+
+    // First signature matching the start of data, nullptr if none matches.
+    // Data shorter than WINDOW_BYTES is zero padded.
+    static const FileSignature* match(const uint8_t* data, size_t size);
+    // Extension of the matching signature, L"bin" if none matches
+    static std::wstring guessExtension(const uint8_t* data, size_t size);
+};
@@ -0,0 +1,189 @@
+#include "SparseFileWriter.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SPARSE_FILE_WRITER_USE_SSE2
+#endif
+
+
+namespace {
+    // Source of the short zero runs that are written instead of skipped
+    const std::array<uint8_t, 64 * 1024> ZEROS{};
+}
+
+SparseFileWriter::~SparseFileWriter() {
+    close();
+}
+
+bool SparseFileWriter::isZeroBlock(const uint8_t* data, size_t size) {
+    size_t i = 0;
+#ifdef SPARSE_FILE_WRITER_USE_SSE2
+    // 64 bytes per step, a non-zero byte anywhere in them leaves a non-zero lane after the ORs
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= size; i += 64) {
+        __m128i bytes = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16))),
+            _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)) != 0xFFFF) return false;
+    }
+#endif
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word != 0) return false;
+    }
+    for (; i < size; i++) {
+        if (data[i] != 0) return false;
+    }
+    return true;
+}
+
+bool SparseFileWriter::open(const fs::path& path) {
+    close();
+    failed = false;
+    position = writtenEnd = zeroRunStart = holeBytes = 0;
+
+#ifdef _WIN32
+    markedSparse = false;
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    handle = file == INVALID_HANDLE_VALUE ? nullptr : file;
+#else
+    do {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    } while (fd < 0 && errno == EINTR);
+#endif
+    return isOpen();
+}
+
+bool SparseFileWriter::isOpen() const {
+#ifdef _WIN32
+    return handle != nullptr;
+#else
+    return fd >= 0;
+#endif
+}
+
+bool SparseFileWriter::writeAt(uint64_t offset, const uint8_t* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        // A synchronous handle still takes the write position from the OVERLAPPED
+        DWORD requested = static_cast<DWORD>((std::min)(size, static_cast<size_t>(1u << 30)));
+        DWORD written = 0;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        if (!WriteFile(handle, data, requested, &written, &overlapped) || written == 0) {
+            return false;
+        }
+#else
+        ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+#endif
+        offset += written;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool SparseFileWriter::writeRange(uint64_t from, uint64_t to, const uint8_t* data, uint64_t dataStart) {
+    while (from < to && from < dataStart) {
+        size_t zeroBytes = static_cast<size_t>((std::min)({ to, dataStart, from + ZEROS.size() }) - from);
+        if (!writeAt(from, ZEROS.data(), zeroBytes)) return false;
+        from += zeroBytes;
+    }
+    return from >= to || writeAt(from, data + (from - dataStart), static_cast<size_t>(to - from));
+}
+
+void SparseFileWriter::beginHole() {
+#ifdef _WIN32
+    // Without the sparse attribute NTFS allocates the skipped range when the file grows past it
+    if (!markedSparse) {
+        DWORD returned = 0;
+        DeviceIoControl(handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr);
+        markedSparse = true;
+    }
+#endif
+}
+
+bool SparseFileWriter::write(const uint8_t* data, size_t size) {
+    if (failed || !isOpen()) return false;
+
+    uint64_t dataStart = position;
+    size_t i = 0;
+    while (i < size) {
+        size_t blockBytes = (std::min)(size - i, static_cast<size_t>(BLOCK_BYTES - (dataStart + i) % BLOCK_BYTES));
+        if (!isZeroBlock(data + i, blockBytes)) {
+            uint64_t blockStart = dataStart + i;
+            // A long enough zero run ends here, the data before it is written and the run is skipped
+            if (blockStart - zeroRunStart >= MIN_HOLE_BYTES) {
+                if (!writeRange(writtenEnd, zeroRunStart, data, dataStart)) {
+                    failed = true;
+                    return false;
+                }
+                beginHole();
+                holeBytes += blockStart - zeroRunStart;
+                writtenEnd = blockStart;
+            }
+            zeroRunStart = blockStart + blockBytes;
+        }
+        i += blockBytes;
+    }
+    position = dataStart + size;
+
+    // The caller reuses its buffer, only the zero run at the end is held back
+    if (zeroRunStart > writtenEnd) {
+        if (!writeRange(writtenEnd, zeroRunStart, data, dataStart)) {
+            failed = true;
+            return false;
+        }
+        writtenEnd = zeroRunStart;
+    }
+    return true;
+}
+
+bool SparseFileWriter::close() {
+    if (!isOpen()) return !failed;
+
+    // Trailing zeros are a hole as well, setting the size covers them
+    if (!failed && position > writtenEnd) {
+        if (position - writtenEnd >= MIN_HOLE_BYTES) {
+            beginHole();
+            holeBytes += position - writtenEnd;
+#ifdef _WIN32
+            LARGE_INTEGER size;
+            size.QuadPart = static_cast<LONGLONG>(position);
+            failed = !SetFilePointerEx(handle, size, nullptr, FILE_BEGIN) || !SetEndOfFile(handle);
+#else
+            failed = ftruncate(fd, static_cast<off_t>(position)) != 0;
+#endif
+        }
+        else {
+            failed = !writeRange(writtenEnd, position, nullptr, position);
+        }
+        writtenEnd = position;
+    }
+
+#ifdef _WIN32
+    failed = !CloseHandle(handle) || failed;
+    handle = nullptr;
+#else
+    failed = ::close(fd) != 0 || failed;
+    fd = -1;
+#endif
+    Metrics::getInstance().add(MetricCounter::SPARSE_BYTES, holeBytes);
+    return !failed;
+}
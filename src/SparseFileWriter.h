@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Output file that leaves holes where the recovered data is zero.
+// Writes are scanned in BLOCK_BYTES blocks at file offsets that are multiples of BLOCK_BYTES, runs of zero
+// blocks of at least MIN_HOLE_BYTES are skipped instead of written, shorter runs are written with the data
+// around them so mostly non-zero files don't turn into many small writes. On Windows the file is marked
+// sparse before its first hole, other systems leave a hole wherever nothing was written.
+// Destinations without sparse files (FAT32, exFAT) fill the holes with zeros, the content is the same.
+class SparseFileWriter {
+private:
+    static constexpr size_t BLOCK_BYTES = 4096;             // Unit of the zero scan, the page size of the file system cache
+    static constexpr uint64_t MIN_HOLE_BYTES = 64 * 1024;   // Smallest skipped run, the allocation unit of sparse NTFS files
+
+#ifdef _WIN32
+    void* handle = nullptr;
+    bool markedSparse = false;  // FSCTL_SET_SPARSE was sent, it is only tried once
+#else
+    int fd = -1;
+#endif
+    bool failed = false;
+    uint64_t position = 0;      // Bytes passed to write, the size of the file once it's closed
+    uint64_t writtenEnd = 0;    // Everything before it is written or left as a hole
+    uint64_t zeroRunStart = 0;  // Start of the zero blocks up to position
+    uint64_t holeBytes = 0;
+
+    // Write the file range [from, to), bytes before dataStart are zeros that were held back
+    bool writeRange(uint64_t from, uint64_t to, const uint8_t* data, uint64_t dataStart);
+    bool writeAt(uint64_t offset, const uint8_t* data, size_t size);
+    void beginHole();
+
+public:
+    SparseFileWriter() = default;
+    ~SparseFileWriter();
+
+    // Prevent copying, the writer owns the file handle
+    SparseFileWriter(const SparseFileWriter&) = delete;
+    SparseFileWriter& operator=(const SparseFileWriter&) = delete;
+
+    // Create or truncate path, false if it can't be opened for writing
+    bool open(const fs::path& path);
+    bool isOpen() const;
+    // Append size bytes, false once a write failed
+    bool write(const uint8_t* data, size_t size);
+    // Set the final size and close the file, false if a write or the size change failed
+    bool close();
+
+    // Zero bytes of the file that weren't written
+    uint64_t getHoleBytes() const { return holeBytes; }
+
+    // True if size bytes are all zero, vectorized where SSE2 is available
+    static bool isZeroBlock(const uint8_t* data, size_t size);
+};
@@ -1,24 +1,50 @@
 #pragma once
 
+#include "Enums.h"
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 
 
+// Clusters of a file, in file order
+struct FileExtent {
+    uint64_t startCluster;
+    uint64_t length; // in clusters
+    bool sparse;     // no clusters on disk, written as zeros
+};
+
+// How likely the clusters of a deleted file still hold its content, see ContentAnalyzer
+struct ContentScore {
+    uint32_t confidence = 0;         // 0 to 100
+    double entropy = 0.0;            // Mean bits per byte of the samples that aren't all zeros
+    uint32_t samples = 0;            // Sparse ranges aren't sampled
+    uint32_t zeroSamples = 0;
+    uint32_t unreadableSamples = 0;  // Failed reads and ranges the extents don't reach
+    std::wstring_view detectedType;  // Extension of the signature at the start of the file, empty if none matches
+    FormatVerdict format = FormatVerdict::UNCHECKED_VERDICT;
+};
+
 #pragma pack(push, 1)
 
-struct ClusterUsage {
-    uint64_t timestamp;  // When this cluster was used
-    uint32_t fileId;     // Identifier for the deleted file
-    bool isDeleted;      // Whether this usage was from a deleted file
-    uint64_t writeOffset; // Offset within the file where this cluster was used
+// Consecutive clusters of a FAT cluster chain
+struct ClusterRun {
+    uint32_t startCluster;
+    uint32_t length; // in clusters
+};
+
+// Part of a file's clusters that is also claimed by another deleted file
+struct ClusterOverlap {
+    uint64_t startCluster;
+    uint64_t length;  // in clusters
+    uint32_t fileId;  // the other file
 };
 
 struct OverwriteAnalysis {
     bool hasOverwrite;
-    std::vector<uint32_t> overwrittenClusters;
-    std::map<uint32_t, std::vector<uint32_t>> overwrittenBy; // cluster -> list of file IDs that overwrote it
+    uint64_t overwrittenClusters;          // clusters shared with at least one other file
+    std::vector<ClusterOverlap> overlaps;
     double overwritePercentage;
 };
 
@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace {
+    // Pool and queue of the worker running on this thread
+    thread_local ThreadPool* currentPool = nullptr;
+    thread_local size_t currentQueue = 0;
+}
+
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    uint32_t count = resolveThreadCount(threadCount);
+    for (uint32_t i = 0; i < count; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    workers.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+uint32_t ThreadPool::resolveThreadCount(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    return (std::max)(1u, threadCount);
+}
+
+bool ThreadPool::takeTask(size_t index, std::function<void()>& task) {
+    // Newest task of the own queue keeps the working set small
+    {
+        WorkQueue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Oldest task of another queue is the largest piece of remaining work
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& victim = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+
+    while (true) {
+        std::function<void()> task;
+        if (!takeTask(index, task)) {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            if (stopping && queuedTasks == 0) return; // Stopping and drained
+            taskAvailable.wait(lock, [this] { return stopping || queuedTasks > 0; });
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            queuedTasks--;
+        }
+
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (!firstError) firstError = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            pendingTasks--;
+            if (pendingTasks == 0) {
+                allDone.notify_all();
+            }
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target;
+    {
+        // Counted before the task becomes visible so workers never see a negative count
+        std::lock_guard<std::mutex> lock(stateMutex);
+        queuedTasks++;
+        pendingTasks++;
+        target = (currentPool == this) ? currentQueue : nextQueue++ % queues.size();
+    }
+    {
+        WorkQueue& queue = *queues[target];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return pendingTasks == 0; });
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+// Work-stealing pool of worker threads.
+// Tasks submitted from a worker go to that worker's own queue and are taken newest first,
+// idle workers steal the oldest tasks from the other queues.
+// The first exception thrown by a task is rethrown from wait().
+class ThreadPool {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues; // One per worker
+    std::vector<std::thread> workers;
+    std::mutex stateMutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    size_t queuedTasks = 0;   // Submitted and not yet taken
+    size_t pendingTasks = 0;  // Submitted and not yet finished
+    size_t nextQueue = 0;     // Round robin target for tasks submitted from outside the pool
+    bool stopping = false;
+    std::exception_ptr firstError;
+
+    void workerLoop(size_t index);
+    // Take a task from the worker's own queue or steal one from another queue
+    bool takeTask(size_t index, std::function<void()>& task);
+
+public:
+    // threadCount of 0 uses the number of hardware threads
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    // Prevent copying, workers refer to the pool
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // Block until every submitted task has finished, including tasks submitted by tasks
+    void wait();
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    // Resolve a configured thread count, 0 means hardware concurrency
+    static uint32_t resolveThreadCount(uint32_t threadCount);
+};
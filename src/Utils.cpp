@@ -1,6 +1,7 @@
 #include "Utils.h"
+#include "Metrics.h"
+#include <algorithm>
 #include <iostream>
-#include <Windows.h>
 
 Utils::Utils() : IConfigurable() {}
 Utils::~Utils() {
@@ -20,59 +21,107 @@ void Utils::ensureOutputDirectory() const {
     }
 }
 
-fs::path Utils::getOutputPath(const std::wstring& fullName, const std::wstring& folder) const {
-    //std::wstring fullName = fileName + L"." + extension;
-    fs::path outputPath = fs::path(folder) / fullName;
-
-    size_t dotPos = fullName.find_last_of(L".");
-    if (dotPos != std::wstring::npos && dotPos != 0) {
-        std::wstring fileName = fullName.substr(0, dotPos);
-        std::wstring extension = fullName.substr(dotPos + 1);
+fs::path Utils::getOutputPath(std::wstring_view fullName, const std::wstring& folder) const {
+    return nameRegistry.reserve(fullName, folder);
+}
 
-        int counter = 1;
-        while (fs::exists(outputPath)) {
-            std::wstring newName = fileName + L"_" + std::to_wstring(counter);
-            if (!extension.empty() && extension != L"") {
-                newName += L"." + extension;
-            }
-            outputPath = fs::path(folder) / newName;
-            counter++;
-        }
+bool Utils::hasDamagedExtension(std::wstring_view fileName) const {
+    size_t dotPos = fileName.find_last_of(L'.');
+    if (dotPos == std::wstring_view::npos || dotPos == 0) {
+        return false;
     }
-    return outputPath;
+    return dotPos + 1 == fileName.size() || !std::all_of(fileName.begin() + dotPos + 1, fileName.end(), ::iswalnum);
+}
+
+void Utils::showProgress(uint64_t currentValue, uint64_t maxValue, bool force) const {
+    Metrics::getInstance().showStatus(currentValue, maxValue, force);
 }
 
-void Utils::showProgress(uint64_t currentValue, uint64_t maxValue) const {
-    float progress = static_cast<float>(currentValue) / maxValue * 100;
-    std::cout << "\r[*] Progress: " << std::setw(5) << std::fixed << std::setprecision(2)
-        << progress << "%" << std::flush;
+std::vector<ClusterRun> Utils::coalesceClusterChain(const std::vector<uint32_t>& clusterChain) const {
+    std::vector<ClusterRun> runs;
+    for (uint32_t cluster : clusterChain) {
+        if (!runs.empty() && runs.back().startCluster + runs.back().length == cluster) {
+            runs.back().length++;
+        }
+        else {
+            runs.push_back({ cluster, 1 });
+        }
+    }
+    return runs;
 }
 
 bool Utils::openLogFile() {
-    if (config.createFileDataLog && !logFile.is_open()) {
-        fs::path logFolder = fs::path(config.outputFolder) / fs::path(config.logFolder);
-        fs::path logFilePath = getOutputPath(config.logFile, logFolder);
-        logFile.open(logFilePath, std::ios::app);
+    if (!resultLogger.isRunning()) {
+        // The extension follows the format, whatever the configured name ends with
+        if (config.createFileDataLog && fileDataLogPath.empty()) {
+            fs::path logFolder = fs::path(config.outputFolder) / fs::path(config.logFolder);
+            fs::path logName = fs::path(config.logFile).replace_extension(config.logFormat == LogFormat::JSONL_FORMAT ? L".jsonl" : L".csv");
+            fileDataLogPath = getOutputPath(logName.wstring(), logFolder.wstring());
+        }
+        resultLogger.start(fileDataLogPath, config.logFormat, ResultLogType::FOUND_FILES_TYPE, !config.quiet);
     }
-    return logFile.is_open();
+    return resultLogger.isLogOpen();
 }
-void Utils::logFileInfo(const uint16_t fileId, const std::wstring& fileName, const uint64_t fileSize) {
-    std::wcout << "[+] #" << fileId << " Found file \"" << fileName << "\"" << " (" << fileSize << " bytes)" << std::endl;
-    if (config.createFileDataLog) {
-        writeToLogFile(fileId, fileName, fileSize);
+void Utils::logFileInfo(LoggedFile&& file) {
+    if (resultLogger.isRunning()) {
+        resultLogger.log(std::move(file));
     }
+    else if (!config.quiet) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::wcout << ResultLogger::formatConsoleLine(file);
+    }
+}
+void Utils::logRecoveredFile(const fs::path& outputPath, const uint64_t recoveredBytes, const uint64_t expectedSize, const uint64_t unreadableBytes) {
+    if (config.quiet) return;
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::wcout << (recoveredBytes == expectedSize && unreadableBytes == 0 ? L"[+] Recovered " : L"[-] Partially recovered ") << outputPath.filename()
+        << L" (" << recoveredBytes << L" / " << expectedSize << L" bytes";
+    if (unreadableBytes > 0) std::wcout << L", " << unreadableBytes << L" unreadable bytes zeroed";
+    std::wcout << L")" << std::endl;
+}
+void Utils::logFileDigests(uint32_t fileId, const fs::path& outputPath, uint64_t recoveredBytes, uint64_t expectedSize, FileDigests&& digests) {
+    if (digests.empty()) return;
+    {
+        // Digests are the chain of custody record, they are logged even without the file data log
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (!recoveryLogger.isRunning()) {
+            fs::path logFolder = fs::path(config.outputFolder) / fs::path(config.logFolder);
+            fs::path logName = fs::path(config.recoveryLogFile).replace_extension(config.logFormat == LogFormat::JSONL_FORMAT ? L".jsonl" : L".csv");
+            if (!recoveryLogger.start(getOutputPath(logName.wstring(), logFolder.wstring()), config.logFormat, ResultLogType::RECOVERED_FILES_TYPE, false)) {
+                std::wcerr << L"[!] Couldn't open the recovery log, digests are not saved" << std::endl;
+            }
+        }
+    }
+
+    LoggedFile file;
+    file.fileId = fileId;
+    file.path = outputPath.lexically_relative(config.outputFolder).wstring();
+    file.fileSize = expectedSize;
+    file.recoveredBytes = recoveredBytes;
+    file.digests = std::move(digests);
+    recoveryLogger.log(std::move(file));
 }
-void Utils::writeToLogFile(const uint16_t fileId, const std::wstring& fileName, const uint64_t fileSize) {
-    if (logFile) {
-        std::wstringstream ss;
-        ss << L"#" << fileId << L" Filename: \"" << fileName << L"\" (" << fileSize << L" bytes)" << "\n";
-        logFile << ss.str();
+bool Utils::writeContentScoreLog(std::vector<LoggedFile>&& files) {
+    // Written once per partition, the ranking is complete before the first line
+    fs::path logFolder = fs::path(config.outputFolder) / fs::path(config.logFolder);
+    fs::path logName = fs::path(config.contentScoreFile).replace_extension(config.logFormat == LogFormat::JSONL_FORMAT ? L".jsonl" : L".csv");
+    ResultLogger scoreLogger;
+    if (!scoreLogger.start(getOutputPath(logName.wstring(), logFolder.wstring()), config.logFormat, ResultLogType::CONTENT_SCORES_TYPE, false)) {
+        scoreLogger.stop();
+        return false;
+    }
+    for (LoggedFile& file : files) {
+        scoreLogger.log(std::move(file));
     }
+    scoreLogger.stop();
+    return true;
+}
+void Utils::closeFileDataLog() {
+    resultLogger.stop();
 }
 void Utils::closeLogFile() {
-    if (logFile.is_open()) {
-        logFile.close();
-    }
+    resultLogger.stop();
+    recoveryLogger.stop();
 }
 bool Utils::confirmProceedWithoutLogFile() const {
 
@@ -1,9 +1,15 @@
 #pragma once
 #include "IConfigurable.h"
+#include "Structures.h"
+#include "NameRegistry.h"
+#include "ResultLogger.h"
 #include <filesystem>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <fstream>
+#include <mutex>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -11,21 +17,41 @@ namespace fs = std::filesystem;
 
 class Utils : public IConfigurable{
 private:
-    std::wofstream logFile;
+    ResultLogger resultLogger;    // Found files, written on its own thread
+    fs::path fileDataLogPath;     // Reserved by the first open, the carver appends to the same log
+    ResultLogger recoveryLogger;  // Recovered files and their digests, started by the first one
+    std::mutex logMutex;          // Serializes the console lines of recovered files and starting the recovery log
+    mutable NameRegistry nameRegistry;
 public:
     Utils();
     ~Utils();
     
     // Creates output folder and log folder
     void ensureOutputDirectory() const;
-    fs::path getOutputPath(const std::wstring& fullName, const std::wstring& folder) const;
-    void showProgress(uint64_t currentValue, uint64_t maxValue) const;
+    // Unique path for a new output file, the name is reserved so concurrent callers never get the same one
+    fs::path getOutputPath(std::wstring_view fullName, const std::wstring& folder) const;
+    // True if the name has an extension that is empty or not made of letters and digits
+    bool hasDamagedExtension(std::wstring_view fileName) const;
+    // Throttled one line status with the read throughput, force prints it even if the last one was recent
+    void showProgress(uint64_t currentValue, uint64_t maxValue, bool force = false) const;
+    // Collapse a cluster chain into runs of consecutive clusters
+    std::vector<ClusterRun> coalesceClusterChain(const std::vector<uint32_t>& clusterChain) const;
 
     /*=============== File Log Operations ===============*/
+    // Start the result logger, false if the file data log is disabled or can't be created
     bool openLogFile();
-    void logFileInfo(const uint16_t fileId, const std::wstring& fileName, const uint64_t fileSize);
-    void writeToLogFile(const uint16_t fileId, const std::wstring& fileName, const uint64_t fileSize);
+    // Queue a found file for the console and the log, printed right away if the logger isn't running
+    void logFileInfo(LoggedFile&& file);
+    // One line result of a file recovered by a concurrent worker
+    void logRecoveredFile(const fs::path& outputPath, const uint64_t recoveredBytes, const uint64_t expectedSize, const uint64_t unreadableBytes = 0);
+    // Record the digests of a recovered file in the recovery log, nothing happens if hashing is disabled
+    void logFileDigests(uint32_t fileId, const fs::path& outputPath, uint64_t recoveredBytes, uint64_t expectedSize, FileDigests&& digests);
+    // Write scored files to a new content score log in the given order, false if the log can't be created
+    bool writeContentScoreLog(std::vector<LoggedFile>&& files);
     bool confirmProceedWithoutLogFile() const;
+    // Write the queued found files and stop their logger, digests of files recovered meanwhile keep their log
+    void closeFileDataLog();
+    // Write the queued files and stop the result loggers
     void closeLogFile();
 
     /*=============== Print terminal dividers for better readability ===============*/
@@ -1,5 +1,6 @@
 #include "SectorReader.h"
 #include "exFATRecovery.h"
+#include "Metrics.h"
 #include <cstdint>
 #include <memory>
 #include <vector>
@@ -7,6 +8,8 @@
 #include <sstream>
 #include <iostream>
 #include <set>
+#include <algorithm>
+#include <iterator>
 
 exFATRecovery::exFATRecovery(const DriveType& driveType, std::unique_ptr<SectorReader> reader)
     : IConfigurable(), driveType(driveType) {
@@ -15,6 +18,7 @@ exFATRecovery::exFATRecovery(const DriveType& driveType, std::unique_ptr<SectorR
     utils.ensureOutputDirectory();
     setSectorReader(std::move(reader));
     readBootSector(0);
+    initializeFATCache();
 }
 
 exFATRecovery::~exFATRecovery() {
@@ -65,6 +69,14 @@ bool exFATRecovery::readSector(uint64_t sector, void* buffer, uint32_t size) {
     return sectorReader && sectorReader->readSector(sector, buffer, size);
 }
 
+bool exFATRecovery::readSectors(uint64_t startSector, uint32_t count, void* buffer) {
+    return sectorReader && sectorReader->readSectors(startSector, count, buffer);
+}
+
+bool exFATRecovery::readBatch(std::vector<ReadRequest>& requests) {
+    return sectorReader && sectorReader->readBatch(requests);
+}
+
 void exFATRecovery::readBootSector(uint32_t sector) {
     uint32_t bytesPerSector = getBytesPerSector();
     std::vector<uint8_t> buffer(bytesPerSector);
@@ -96,6 +108,11 @@ void exFATRecovery::readBootSector(uint32_t sector) {
     //driveInfo.volumeLength = driveInfo.bootSector.VolumeLength;
 }
 
+void exFATRecovery::initializeFATCache() {
+    fatCache = std::make_unique<FATCache>(*sectorReader, driveInfo.bootSector.FatOffset, driveInfo.bootSector.FatLength,
+        driveInfo.bytesPerSector, driveInfo.bootSector.ClusterCount, config.fatCacheLimit);
+}
+
 uint32_t exFATRecovery::getBytesPerSector() {
     if (!sectorReader) {
         throw std::runtime_error("Sector reader not initialized");
@@ -137,17 +154,11 @@ uint32_t exFATRecovery::clusterToSector(uint32_t cluster) {
     return driveInfo.bootSector.ClusterHeapOffset + ((cluster - 2) * driveInfo.sectorsPerCluster);
 }
 uint32_t exFATRecovery::getNextCluster(uint32_t cluster) {
-    uint32_t fatOffset = cluster * 4;
-    uint32_t fatSector = driveInfo.bootSector.ClusterHeapOffset + (fatOffset / driveInfo.bytesPerSector);
-    uint32_t entryOffset = fatOffset % driveInfo.bytesPerSector;
-
-    std::vector<uint8_t> sectorBuffer(driveInfo.bytesPerSector);
-    if (!readSector(fatSector, sectorBuffer.data(), driveInfo.bytesPerSector)) {
-        std::cerr << "Error: Failed to read FAT sector " << fatSector << std::endl;
+    uint32_t fatEntry;
+    if (!fatCache->getEntry(cluster, fatEntry)) {
         return 0xFFFFFFFF;
     }
-    
-    uint32_t fatEntry = *reinterpret_cast<uint32_t*>(sectorBuffer.data() + entryOffset);
+
     uint32_t nextCluster = fatEntry & 0x0FFFFFFF;  // Mask the lower 28 bits
 
         // Check for special cluster values
@@ -170,118 +181,289 @@ void exFATRecovery::scanForDeletedFiles() {
         std::cout << "Exitting..." << std::endl;
         exit(1);
     }
-    scanDirectory(driveInfo.bootSector.RootDirectoryCluster);
+    ScopedTimer timer(MetricPhase::SCAN);
+
+    visitedClusters = std::make_unique<VisitedClusterSet>(static_cast<uint64_t>(driveInfo.bootSector.ClusterCount) + 2);
+    // Unfiltered walks are checkpointed, filtered ones skip directories and aren't a prefix of the full scan
+    if (!scanFilter.isActive()) {
+        checkpoint = std::make_unique<ScanCheckpoint>(getVolumeKey());
+    }
+    {
+        ThreadPool pool(config.threadCount);
+        scanPool = &pool;
+        std::vector<DirectoryTask> tasks;
+        if (!checkpoint || !config.resume || !resumeDirectoryScan(tasks)) {
+            tasks = { { driveInfo.bootSector.RootDirectoryCluster, 0, {}, L"", 0 } };
+            if (checkpoint) scanFrontier.add(tasks.front());
+        }
+        for (DirectoryTask& task : tasks) {
+            scheduleDirectory(std::move(task));
+        }
+        pool.wait();
+        scanPool = nullptr;
+    }
+    visitedClusters.reset();
+    if (checkpoint) {
+        checkpoint->remove();
+        checkpoint.reset();
+        scanFrontier = {};
+        checkpointResults = {};
+    }
+    mergeScanResults();
+
     utils.closeLogFile();
     utils.printFooter();
 }
 
-void exFATRecovery::scanDirectory(uint32_t cluster, uint32_t depth) {
+void exFATRecovery::scheduleDirectory(DirectoryTask task) {
+    scanPool->submit([this, task = std::move(task)] {
+        DirectoryScanState<exFATScanEntry> state(task);
+        scanDirectory(state);
+        finishDirectory(state);
+    });
+}
+
+void exFATRecovery::scanDirectory(DirectoryScanState<exFATScanEntry>& state) {
+    const DirectoryTask& task = state.task;
     try {
         
-        if (depth >= MAX_RECURSION_DEPTH) {
+        if (task.depth >= MAX_RECURSION_DEPTH) {
             throw std::runtime_error("[-] Maximum directory depth exceeded");
         }
 
-        if (!isValidCluster(cluster)) {
+        if (!isValidCluster(task.cluster)) {
             std::cerr << "[!] Invalid cluster detected: 0x"
-                << std::hex << cluster << std::dec << std::endl;
+                << std::hex << task.cluster << std::dec << std::endl;
             return;
         }
 
-        uint64_t sector = clusterToSector(cluster);
-        uint32_t entriesPerSector = driveInfo.bytesPerSector / sizeof(DirectoryEntryCommon);
-        uint64_t maxSectorCount = static_cast<uint64_t>(driveInfo.bootSector.ClusterCount) * static_cast<uint64_t>(driveInfo.sectorsPerCluster);
-        //sectorBuffer.resize(bytesPerSector);
-        std::vector<uint8_t> sectorBuffer(driveInfo.bytesPerSector);
-        for (uint32_t i = 0; i < driveInfo.sectorsPerCluster; i++) {
-            uint64_t currentSector = sector + static_cast<uint64_t>(i);
-           
-            if (currentSector >= maxSectorCount) {
-                std::cerr << "[!] Sector number exceeds device bounds: " << currentSector << std::endl;
-                continue;
-            }
-
-            if (!readSector(currentSector, sectorBuffer.data(), driveInfo.bytesPerSector)) {
-                std::cerr << "[!] Failed to read sector: " << currentSector << std::endl;
-                continue;
-            }
-            processEntriesInSector(entriesPerSector, sectorBuffer);
-        }
+        // Entry sets may cross sector and cluster boundaries, so the directory is parsed as a whole
+        std::vector<uint8_t> directoryData;
+        readDirectory(task, directoryData, state.clusters);
 
-        uint32_t nextCluster = getNextCluster(cluster);
-        if (isValidCluster(nextCluster) && nextCluster != cluster) {
-            scanDirectory(nextCluster, depth + 1);
-        }
+        size_t entryCount = directoryData.size() / sizeof(DirectoryEntryCommon);
+        processEntrySets(directoryData.data(), entryCount, state);
+        Metrics::getInstance().add(MetricCounter::DIRECTORIES_SCANNED);
+        Metrics::getInstance().add(MetricCounter::DIRECTORY_ENTRIES, entryCount);
     }
     catch (const std::exception& e) {
         std::cerr << "[-] Error in scanDirectory " << e.what() << std::endl;
     }
 }
 
-void exFATRecovery::processEntriesInSector(uint32_t entriesPerSector, const std::vector<uint8_t>& sectorBuffer) {
-    exFATDirEntryData dirData{};
+void exFATRecovery::finishDirectory(DirectoryScanState<exFATScanEntry>& state) {
+    // Results, frontier and checkpoint change together, so a checkpoint never holds half a directory
+    std::lock_guard<std::mutex> lock(scanResultsMutex);
+    if (checkpoint) {
+        for (const exFATScanEntry& found : state.found) {
+            writeScanEntry(checkpointResults, found);
+        }
+        scanFrontier.finish(state.task, state.clusters);
+    }
+    std::move(state.found.begin(), state.found.end(), std::back_inserter(scanResults));
+
+    for (DirectoryTask& subdirectory : state.subdirectories) {
+        if (checkpoint) scanFrontier.add(subdirectory);
+        scheduleDirectory(std::move(subdirectory));
+    }
+
+    if (checkpoint && checkpoint->isDue()) {
+        IndexWriter frontier;
+        frontier.write(static_cast<uint64_t>(scanResults.size()));
+        scanFrontier.write(frontier);
+        checkpoint->save(fileId, frontier, checkpointResults);
+    }
+}
+
+bool exFATRecovery::resumeDirectoryScan(std::vector<DirectoryTask>& pendingTasks) {
+    uint32_t nextFileId = 0;
+    std::vector<uint8_t> frontier;
+    std::vector<uint8_t> results;
+    if (!checkpoint->load(nextFileId, frontier, results)) {
+        std::cout << "[*] No usable scan checkpoint, scanning from the root directory" << std::endl;
+        return false;
+    }
+
+    // Only kept if the whole checkpoint reads back
+    IndexReader frontierReader(frontier.data(), frontier.size());
+    uint64_t entryCount = frontierReader.read<uint64_t>();
+    ScanFrontier storedFrontier;
+    bool isValid = storedFrontier.read(frontierReader) && frontierReader.isAtEnd() && entryCount <= results.size();
+    std::vector<exFATScanEntry> entries(isValid ? entryCount : 0);
+    IndexReader reader(results.data(), results.size());
+    for (exFATScanEntry& entry : entries) {
+        readScanEntry(reader, entry);
+    }
+    if (!isValid || !reader.isValid() || !reader.isAtEnd()) {
+        std::cerr << "[!] The scan checkpoint is damaged, scanning from the root directory" << std::endl;
+        return false;
+    }
 
-    for (uint32_t j = 0; j < entriesPerSector; j++) {
-        if ((static_cast<uint64_t>(j) + 1) * sizeof(DirectoryEntryCommon) > sectorBuffer.size()) {
-            std::cerr << "Buffer overflow prevented in processEntriesInSector " << j << std::endl;
+    std::cout << "[*] Resuming the scan with " << storedFrontier.getPending().size() << " directories left, "
+        << entries.size() << " files were found before" << std::endl;
+    for (uint32_t cluster : storedFrontier.getFinishedClusters()) {
+        visitedClusters->tryVisit(cluster);
+    }
+    for (const auto& [id, task] : storedFrontier.getPending()) {
+        pendingTasks.push_back(task);
+    }
+    std::lock_guard<std::mutex> lock(scanResultsMutex);
+    scanResults = std::move(entries);
+    scanFrontier = std::move(storedFrontier);
+    checkpointResults.writeRaw(results);
+    fileId = nextFileId;
+    return true;
+}
+
+void exFATRecovery::writeScanEntry(IndexWriter& writer, const exFATScanEntry& entry) {
+    ScanFrontier::writeOrderKey(writer, entry.orderKey);
+    writer.writeString(entry.folder);
+    writer.writeString(entry.dirData.longFilename);
+    writer.write(entry.dirData.startingCluster);
+    writer.write(entry.dirData.fileSize);
+    writer.write(static_cast<uint8_t>(entry.dirData.noFatChain));
+}
+
+void exFATRecovery::readScanEntry(IndexReader& reader, exFATScanEntry& entry) {
+    // Only deleted files are kept as entries
+    entry.orderKey = ScanFrontier::readOrderKey(reader);
+    entry.folder = reader.readString();
+    entry.dirData.longFilename = reader.readString();
+    entry.dirData.startingCluster = reader.read<uint32_t>();
+    entry.dirData.fileSize = reader.read<uint64_t>();
+    entry.dirData.noFatChain = reader.read<uint8_t>() != 0;
+    entry.dirData.inFileEntry = true;
+    entry.dirData.isDirectory = false;
+    entry.dirData.isDeleted = true;
+}
+
+void exFATRecovery::readDirectory(const DirectoryTask& task, std::vector<uint8_t>& directoryData, std::vector<uint32_t>& clusterChain) {
+    uint32_t bytesPerCluster = driveInfo.sectorsPerCluster * driveInfo.bytesPerSector;
+    uint64_t maxClusters = MAX_DIRECTORY_BYTES / bytesPerCluster;
+
+    // NoFatChain directories are one run, the others follow the FAT. A cluster seen before means the tree loops.
+    uint32_t cluster = task.cluster;
+    while (clusterChain.size() < maxClusters && isValidCluster(cluster) && visitedClusters->tryVisit(cluster)) {
+        clusterChain.push_back(cluster);
+        if (task.contiguousClusters == 0) {
+            cluster = getNextCluster(cluster);
+        }
+        else if (clusterChain.size() < task.contiguousClusters) {
+            cluster++;
+        }
+        else {
             break;
         }
+    }
 
-        const DirectoryEntryCommon* entry = reinterpret_cast<const DirectoryEntryCommon*>(sectorBuffer.data() + j * sizeof(DirectoryEntryCommon));
-        uint8_t entryType = entry->EntryType;
+    // Unreadable clusters stay zeroed, which parses as unused entries
+    directoryData.assign(clusterChain.size() * static_cast<uint64_t>(bytesPerCluster), 0);
+    uint64_t offset = 0;
+    for (const ClusterRun& run : utils.coalesceClusterChain(clusterChain)) {
+        uint64_t sector = clusterToSector(run.startCluster);
+        uint32_t sectorCount = run.length * driveInfo.sectorsPerCluster;
 
-        if (IsDirectoryEntry(entryType) && dirData.inFileEntry) {
-            finalizeDirectoryEntry(dirData);
+        if (sector + sectorCount > driveInfo.bootSector.VolumeLength) {
+            std::cerr << "[!] Sector number exceeds device bounds: " << sector + sectorCount - 1 << std::endl;
         }
+        else if (!readSectors(sector, sectorCount, directoryData.data() + offset)) {
+            std::cerr << "[!] Failed to read clusters: " << run.startCluster << " - " << run.startCluster + run.length - 1
+                << " (sector " << sector << ")" << std::endl;
+        }
+        offset += static_cast<uint64_t>(run.length) * bytesPerCluster;
+    }
+}
+
+void exFATRecovery::processEntrySets(const uint8_t* directoryData, size_t entryCount, DirectoryScanState<exFATScanEntry>& state) {
+    const DirectoryEntryCommon* entries = reinterpret_cast<const DirectoryEntryCommon*>(directoryData);
+
+    size_t index = 0;
+    while (index < entryCount) {
+        uint8_t entryType = entries[index].EntryType;
+        exFATDirEntryData dirData{};
+        size_t consumed = 1;
 
-        try {
-            processDirectoryEntry(entry, dirData);
+        // A deleted set whose File entry was reused can still be read from its stream extension
+        if (IsDirectoryEntry(entryType) || (IsStreamExtensionEntry(entryType) && !IsEntryInUse(entryType))) {
+            try {
+                consumed = parseEntrySet(entries, index, entryCount, dirData);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error processing directory entry: " << e.what() << std::endl;
+                dirData = {};
+            }
         }
-        catch (const std::exception& e) {
-            std::cerr << "Error processing directory entry: " << e.what() << std::endl;
-            dirData = {};
-            continue;
+
+        if (dirData.inFileEntry) {
+            finalizeDirectoryEntry(dirData, state);
         }
-    }
-    if (dirData.inFileEntry) {
-        finalizeDirectoryEntry(dirData);
+        index += (std::max)(consumed, static_cast<size_t>(1));
     }
 }
 
-void exFATRecovery::processDirectoryEntry(const DirectoryEntryCommon* entry, exFATDirEntryData& dirData) {
-    uint8_t entryType = entry->EntryType;
+size_t exFATRecovery::parseEntrySet(const DirectoryEntryCommon* entries, size_t index, size_t entryCount, exFATDirEntryData& dirData) {
+    uint8_t entryType = entries[index].EntryType;
+    size_t streamIndex = index;
+    size_t setEnd = entryCount;
 
-    if (!IsEntryInUse(entryType)) {
-        dirData.isDeleted = true;
-        if (IsFileNameEntry(entryType)) {
-            const FileNameEntry* fnEntry = reinterpret_cast<const FileNameEntry*>(entry);
-            dirData.longFilename += extractFileName(fnEntry);
-            dirData.inFileEntry = true;
-        }
-        else if (IsStreamExtensionEntry(entryType)) {
-            const StreamExtensionEntry* streamEntry = reinterpret_cast<const StreamExtensionEntry*>(entry);
-            dirData.startingCluster = streamEntry->FirstCluster;
-            dirData.fileSize = streamEntry->DataLength;
+    if (IsDirectoryEntry(entryType)) {
+        const DirectoryEntryExFAT* fileEntry = reinterpret_cast<const DirectoryEntryExFAT*>(&entries[index]);
+        if (fileEntry->SecondaryCount < MIN_SECONDARY_COUNT || fileEntry->SecondaryCount > MAX_SECONDARY_COUNT
+            || index + 1 >= entryCount || !IsStreamExtensionEntry(entries[index + 1].EntryType)) {
+            return 1; // Not a usable set, resume with the next entry
         }
-        else if (IsDirectoryEntry(entryType)) {
-            const DirectoryEntryExFAT* dirEntry = reinterpret_cast<const DirectoryEntryExFAT*>(entry);
-            dirData.isDirectory = (dirEntry->FileAttributes & 0x10) != 0;
+        dirData.isDirectory = (fileEntry->FileAttributes & 0x10) != 0;
+        setEnd = (std::min)(index + 1 + fileEntry->SecondaryCount, entryCount);
+        streamIndex = index + 1;
+
+        // Files in use are skipped as a whole, folders in use are still walked
+        if (IsEntryInUse(entryType) && !dirData.isDirectory) {
+            return setEnd - index;
         }
     }
+
+    const StreamExtensionEntry* streamEntry = reinterpret_cast<const StreamExtensionEntry*>(&entries[streamIndex]);
+    if (streamIndex == index) {
+        // Without the File entry the name length tells how many name entries follow
+        setEnd = (std::min)(index + 1 + (streamEntry->NameLength + NAME_CHARS_PER_ENTRY - 1) / NAME_CHARS_PER_ENTRY, entryCount);
+    }
+
+    dirData.isDeleted = !IsEntryInUse(entryType);
+    dirData.startingCluster = streamEntry->FirstCluster;
+    dirData.fileSize = streamEntry->DataLength;
+    dirData.noFatChain = (streamEntry->GeneralFlags & NO_FAT_CHAIN_FLAG) != 0;
+
+    // A set cut short by a foreign entry ends there, so that entry is parsed next
+    size_t next = streamIndex + 1;
+    for (; next < setEnd && IsFileNameEntry(entries[next].EntryType); next++) {
+        appendFileName(reinterpret_cast<const FileNameEntry*>(&entries[next]), dirData.longFilename);
+    }
+    if (streamEntry->NameLength != 0 && dirData.longFilename.size() > streamEntry->NameLength) {
+        dirData.longFilename.resize(streamEntry->NameLength);
+    }
+    dirData.inFileEntry = !dirData.longFilename.empty();
+
+    return next - index;
 }
 
-void exFATRecovery::finalizeDirectoryEntry(exFATDirEntryData& dirData) {
+void exFATRecovery::finalizeDirectoryEntry(exFATDirEntryData& dirData, DirectoryScanState<exFATScanEntry>& state) {
     if (dirData.inFileEntry && !dirData.longFilename.empty() && dirData.startingCluster > 0) {
         if (isValidDeletedEntry(dirData.startingCluster, dirData.fileSize)) {
             try {
+                // Paths are only built when a filter or the file data log asks for them
+                std::wstring path = scanFilter.tracksPaths() ? ScanFilter::joinPath(state.task.path, dirData.longFilename) : std::wstring();
                 if (dirData.isDirectory) {
-                    scanDirectory(dirData.startingCluster, currentRecursionDepth + 1);
+                    if (scanFilter.matchesDirectory(path)) {
+                        uint32_t bytesPerCluster = driveInfo.sectorsPerCluster * driveInfo.bytesPerSector;
+                        uint64_t clusters = (std::min)(dirData.fileSize, MAX_DIRECTORY_BYTES);
+                        clusters = (clusters + bytesPerCluster - 1) / bytesPerCluster;
+                        state.subdirectories.push_back({ dirData.startingCluster, state.task.depth + 1, state.nextKey(), std::move(path),
+                            dirData.noFatChain ? static_cast<uint32_t>(clusters) : 0 });
+                    }
                 }
-                else if (dirData.isDeleted) {
-                    exFATFileInfo fileInfo = parseFileInfo(dirData);
-                    addToRecoveryList(fileInfo);
-
-                    utils.logFileInfo(fileInfo.fileId, fileInfo.fileName, fileInfo.fileSize);
+                else if (dirData.isDeleted && scanFilter.matchesPath(path) && scanFilter.matchesExtension(dirData.longFilename)
+                    && scanFilter.matchesAttributes(dirData.fileSize, dirData.startingCluster)) {
+                    state.found.push_back({ state.nextKey(), state.task.path, dirData });
                 }
             }
             catch (const std::exception& e) {
@@ -292,39 +474,159 @@ void exFATRecovery::finalizeDirectoryEntry(exFATDirEntryData& dirData) {
     dirData = {};
 }
 
+void exFATRecovery::mergeScanResults() {
+    // Sorting by the order key gives the same ids as a serial depth-first walk
+    std::sort(scanResults.begin(), scanResults.end(), [](const exFATScanEntry& a, const exFATScanEntry& b) {
+        return a.orderKey < b.orderKey;
+    });
+
+    for (const exFATScanEntry& found : scanResults) {
+        // Ids count the files the filters kept
+        if (!scanFilter.matchesId(fileId)) {
+            ++fileId;
+            continue;
+        }
+        exFATFileInfo fileInfo = parseFileInfo(found.dirData);
+        fileInfo.folder = arena.internName(found.folder);
+        addToRecoveryList(fileInfo);
+        logFoundFile(fileInfo);
+    }
+    std::vector<exFATScanEntry>().swap(scanResults);
+    arena.releaseInternTable();
+}
+
 exFATFileInfo exFATRecovery::parseFileInfo(const exFATDirEntryData& dirData) {
     exFATFileInfo fileInfo = {};
     fileInfo.fileId = this->fileId;
-    fileInfo.fileName = dirData.longFilename;
+    fileInfo.fileName = arena.internName(dirData.longFilename);
     fileInfo.fileSize = dirData.fileSize;
     fileInfo.cluster = dirData.startingCluster;
+    fileInfo.noFatChain = dirData.noFatChain;
     ++this->fileId;
     return fileInfo;
 }
 
-std::wstring exFATRecovery::extractFileName(const FileNameEntry* fnEntry) const {
-    std::wstring fileName;
+void exFATRecovery::appendFileName(const FileNameEntry* fnEntry, std::wstring& fileName) const {
     for (int i = 0; i < sizeof(fnEntry->FileName) / 2; i++) {
         wchar_t character = fnEntry->FileName[i];
         if (character == 0x0000) break;  // Null-terminated character sequence
         fileName += character;
     }
-    return fileName;
 }
 
 void exFATRecovery::addToRecoveryList(const exFATFileInfo& fileInfo) {
-    if (config.recover || config.analyze) {
-        recoveryList.push_back(fileInfo);
+    // Kept without --recover too, the scan index stores every file found
+    recoveryList.push_back(fileInfo);
+}
+
+void exFATRecovery::logFoundFile(const exFATFileInfo& fileInfo) {
+    LoggedFile file;
+    file.fileId = fileInfo.fileId;
+    file.path = ScanFilter::joinPath(fileInfo.folder, fileInfo.fileName);
+    file.fileSize = fileInfo.fileSize;
+    file.firstCluster = fileInfo.cluster;
+    file.isExtensionPredicted = utils.hasDamagedExtension(fileInfo.fileName);
+
+    // NoFatChain files are one run. A freed chain falls back to the following clusters as well.
+    uint64_t bytesPerCluster = static_cast<uint64_t>(driveInfo.sectorsPerCluster) * driveInfo.bytesPerSector;
+    uint64_t clusterCount = (fileInfo.fileSize + bytesPerCluster - 1) / bytesPerCluster;
+    if (clusterCount > 0) file.extents.push_back({ fileInfo.cluster, clusterCount, false });
+    utils.logFileInfo(std::move(file));
+}
+
+
+
+// Predict file extension from the signature in the first sector
+std::wstring exFATRecovery::predictExtension(uint32_t cluster, uint64_t expectedSize) {
+    std::vector<uint8_t> buffer(driveInfo.bytesPerSector);
+    if (reportsFileDetails()) std::wcout << "  [*] Predicting extension..." << std::endl;
+
+    std::wstring extension = L"bin";
+    if (isValidCluster(cluster) && readSector(clusterToSector(cluster), buffer.data(), driveInfo.bytesPerSector)) {
+        extension = SignatureDB::guessExtension(buffer.data(), static_cast<size_t>((std::min)(static_cast<uint64_t>(buffer.size()), expectedSize)));
     }
+
+    // The result line of a concurrent recovery shows the chosen name
+    if (!reportsFileDetails()) return extension;
+
+    if (extension == L"bin") {
+        std::wcout << "  [-] Couldn't predict the extension. Defaulting to .bin" << std::endl;
+    }
+    else {
+        std::wcout << "  [*] Predicted extension: " << extension << std::endl;
+    }
+    return extension;
 }
 
 
 
 /* Corruption analysis */
 // Check if cluster is marked as in use in the FAT
+bool exFATRecovery::findAllocationBitmapEntry(AllocationBitmapEntry& bitmapEntry) {
+    uint32_t bytesPerCluster = driveInfo.sectorsPerCluster * driveInfo.bytesPerSector;
+    uint32_t entriesPerCluster = bytesPerCluster / sizeof(AllocationBitmapEntry);
+    std::vector<uint8_t> clusterBuffer(bytesPerCluster);
+
+    uint32_t cluster = driveInfo.bootSector.RootDirectoryCluster;
+    for (uint32_t steps = 0; isValidCluster(cluster) && steps < driveInfo.bootSector.ClusterCount; steps++) {
+        if (!readSectors(clusterToSector(cluster), driveInfo.sectorsPerCluster, clusterBuffer.data())) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < entriesPerCluster; i++) {
+            const AllocationBitmapEntry* entry = reinterpret_cast<const AllocationBitmapEntry*>(clusterBuffer.data() + i * sizeof(AllocationBitmapEntry));
+            if (entry->EntryType == 0x00) return false; // End of directory
+
+            if (entry->EntryType == ALLOCATION_BITMAP_ENTRY && (entry->BitmapFlags & 0x01) == 0) {
+                bitmapEntry = *entry;
+                return true;
+            }
+        }
+        cluster = getNextCluster(cluster);
+    }
+    return false;
+}
+
+void exFATRecovery::loadAllocationBitmap() {
+    allocationBitmap = std::make_unique<AllocationBitmap>(MIN_DATA_CLUSTER, driveInfo.bootSector.ClusterCount);
+
+    AllocationBitmapEntry bitmapEntry = {};
+    if (!findAllocationBitmapEntry(bitmapEntry) || !isValidCluster(bitmapEntry.FirstCluster)) {
+        std::cerr << "[!] Allocation bitmap not found, clusters are treated as free" << std::endl;
+        return;
+    }
+
+    uint32_t bytesPerCluster = driveInfo.sectorsPerCluster * driveInfo.bytesPerSector;
+    uint64_t bitmapBytes = (std::min)(bitmapEntry.DataLength, (static_cast<uint64_t>(driveInfo.bootSector.ClusterCount) + 7) / 8);
+    uint64_t bitmapClusters = (bitmapBytes + bytesPerCluster - 1) / bytesPerCluster;
+
+    // Walk the bitmap's chain, it is contiguous when the FAT has no better answer
+    std::vector<uint32_t> clusterChain;
+    uint32_t cluster = bitmapEntry.FirstCluster;
+    while (clusterChain.size() < bitmapClusters && isValidCluster(cluster)) {
+        clusterChain.push_back(cluster);
+        uint32_t nextCluster = getNextCluster(cluster);
+        cluster = isValidCluster(nextCluster) ? nextCluster : cluster + 1;
+    }
+
+    std::vector<uint8_t> bitmapData(clusterChain.size() * static_cast<uint64_t>(bytesPerCluster));
+    uint64_t offset = 0;
+    for (const ClusterRun& run : utils.coalesceClusterChain(clusterChain)) {
+        if (!readSectors(clusterToSector(run.startCluster), run.length * driveInfo.sectorsPerCluster, bitmapData.data() + offset)) {
+            std::cerr << "[!] Failed to read the allocation bitmap, clusters are treated as free" << std::endl;
+            return;
+        }
+        offset += static_cast<uint64_t>(run.length) * bytesPerCluster;
+    }
+
+    allocationBitmap->loadFromBytes(bitmapData.data(), bitmapBytes);
+    std::cout << "[*] Allocation bitmap loaded, " << allocationBitmap->countAllocated() << " of "
+        << driveInfo.bootSector.ClusterCount << " clusters in use" << std::endl;
+}
+
 bool exFATRecovery::isClusterInUse(uint32_t cluster) {
-    uint32_t fatValue = getNextCluster(cluster);
-    return (fatValue != 0 && fatValue != 0xF8FFFFFF);
+    if (!allocationBitmap) loadAllocationBitmap();
+    return allocationBitmap->isAllocated(cluster);
 }
 // Analyzes clusters for repetition, gaps, backward jumps and calculates the fragmentation score
 void exFATRecovery::analyzeClusterPattern(const std::vector<uint32_t>& clusters, exFATRecoveryStatus& status) const {
@@ -408,43 +710,64 @@ bool exFATRecovery::isFileNameCorrupted(const std::wstring& filename) const {
     // flag as corrupted if half of the filename contains suspicious characters
     return (controlCharCount > 0 || unusualCharCount > static_cast<int>(filename.length() / 2));
 }
-// Calculate the percentage of deleted file being overwritten by another deleted file
-OverwriteAnalysis exFATRecovery::analyzeClusterOverwrites(uint32_t startCluster, uint64_t expectedSize) {
-    OverwriteAnalysis analysis;
-    analysis.hasOverwrite = false;
-    analysis.overwritePercentage = 0.0;
-    
-
-    uint32_t bytesPerCluster = driveInfo.sectorsPerCluster * driveInfo.bytesPerSector;
-    uint64_t expectedClusters = (expectedSize + bytesPerCluster - 1) / bytesPerCluster;
-
+// Follow the cluster chain for expectedClusters clusters, assumes the next cluster when the chain is broken
+std::vector<uint32_t> exFATRecovery::walkClusterChain(uint32_t startCluster, uint64_t expectedClusters, bool noFatChain) {
+    std::vector<uint32_t> clusterChain;
     uint32_t currentCluster = startCluster;
-    uint64_t currentOffset = 0;
-
-    while (currentOffset < expectedSize && currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
-        auto overlaps = clusterHistory.findOverlappingUsage(currentCluster);
 
-        if (!overlaps.empty()) {
-            analysis.hasOverwrite = true;
-            analysis.overwrittenClusters.push_back(currentCluster);
+    while (clusterChain.size() < expectedClusters && currentCluster >= 2 && currentCluster < 0x0FFFFFF8) {
+        clusterChain.push_back(currentCluster);
 
-            for (const auto& overlap : overlaps) {
-                analysis.overwrittenBy[currentCluster].push_back(overlap.second.fileId);
+        uint32_t nextCluster = (noFatChain ? currentCluster + 1 : getNextCluster(currentCluster));
+        if (nextCluster == currentCluster || nextCluster < 2 || nextCluster >= 0x0FFFFFF8) {
+            nextCluster = currentCluster + 1;
+        }
+        currentCluster = nextCluster;
+    }
+    return clusterChain;
+}
+// Register the clusters claimed by every deleted file so overlaps can be looked up per extent
+void exFATRecovery::buildClusterHistory() {
+    clusterHistory.clear();
+    uint64_t bytesPerCluster = static_cast<uint64_t>(driveInfo.sectorsPerCluster * driveInfo.bytesPerSector);
+
+    for (const auto& file : recoveryList) {
+        uint64_t expectedClusters = (file.fileSize + bytesPerCluster - 1) / bytesPerCluster;
+        for (const ClusterRun& run : utils.coalesceClusterChain(walkClusterChain(file.cluster, expectedClusters, file.noFatChain))) {
+            clusterHistory.addExtent(file.fileId, run.startCluster, run.length);
+        }
+    }
+    clusterHistory.finalize();
+}
+// Calculate the percentage of deleted file being overwritten by another deleted file
+OverwriteAnalysis exFATRecovery::analyzeClusterOverwrites(uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, uint64_t expectedClusters) {
+    OverwriteAnalysis analysis = {};
+
+    for (const ClusterRun& run : clusterRuns) {
+        size_t firstOverlap = analysis.overlaps.size();
+        clusterHistory.findOverlaps(fileId, run.startCluster, run.length, analysis.overlaps);
+        if (analysis.overlaps.size() == firstOverlap) continue;
+
+        // Several files may claim the same clusters, count each cluster once
+        std::sort(analysis.overlaps.begin() + firstOverlap, analysis.overlaps.end(), [](const ClusterOverlap& a, const ClusterOverlap& b) {
+            return a.startCluster < b.startCluster;
+        });
+        uint64_t coveredEnd = 0;
+        for (size_t i = firstOverlap; i < analysis.overlaps.size(); i++) {
+            const ClusterOverlap& overlap = analysis.overlaps[i];
+            uint64_t overlapStart = (std::max)(overlap.startCluster, coveredEnd);
+            uint64_t overlapEnd = overlap.startCluster + overlap.length;
+            if (overlapEnd > overlapStart) {
+                analysis.overwrittenClusters += overlapEnd - overlapStart;
+                coveredEnd = overlapEnd;
             }
         }
-
-        clusterHistory.recordClusterUsage(currentCluster, nextFileId, currentOffset);
-
-        currentOffset += bytesPerCluster;
-        currentCluster = getNextCluster(currentCluster);
     }
 
-    if (!analysis.overwrittenClusters.empty()) {
-        analysis.overwritePercentage =
-            static_cast<double>(analysis.overwrittenClusters.size()) / expectedClusters * 100.0;
+    analysis.hasOverwrite = analysis.overwrittenClusters > 0;
+    if (analysis.hasOverwrite && expectedClusters > 0) {
+        analysis.overwritePercentage = static_cast<double>(analysis.overwrittenClusters) / expectedClusters * 100.0;
     }
-
-    nextFileId++;
     return analysis;
 }
 
@@ -466,27 +789,23 @@ std::vector<exFATFileInfo> exFATRecovery::selectFilesToRecover(const std::vector
         else if (userResponse == '1') return recoveryList;
         else if (userResponse == '2') {
             std::string fileIds;
-            std::cout << "\nEnter file IDs to recover (e.g., 1,2,3): ";
+            std::cout << "\nEnter file IDs to recover (e.g., 1,2,3 or 10-20): ";
             std::cin >> fileIds;
 
-            std::vector<int> fileIdVector;
-            std::stringstream ss(fileIds);
-            std::string id;
-            while (std::getline(ss, id, ',')) {
-                try {
-                    fileIdVector.push_back(std::stoi(id));
-                }
-                catch (const std::invalid_argument&) {
-                    std::cerr << "\nInvalid input. Please enter numeric IDs.\n";
-                    return recoveryList;
-                }
+            IdSelection selection;
+            try {
+                selection = IdSelection::parse(fileIds);
+            }
+            catch (const std::logic_error&) {
+                std::cerr << "\nInvalid input. Please enter numeric IDs.\n";
+                return recoveryList;
             }
             // Create a new vector to store the selected files
             std::vector<exFATFileInfo> selectedFiles;
 
             // Iterate through the original deletedFiles vector and add the selected files to the new vector
             for (const auto& item : recoveryList) {
-                if (std::find(fileIdVector.begin(), fileIdVector.end(), item.fileId) != fileIdVector.end()) {
+                if (selection.contains(item.fileId)) {
                     selectedFiles.push_back(item);
                 }
             }
@@ -498,29 +817,151 @@ std::vector<exFATFileInfo> exFATRecovery::selectFilesToRecover(const std::vector
     return recoveryList;
 }
 
+/*=============== Scan index ===============*/
+VolumeKey exFATRecovery::getVolumeKey() {
+    // The allocation bitmap changes with every created or deleted file
+    if (!allocationBitmap) loadAllocationBitmap();
+    return ScanIndex::makeKey(FilesystemType::EXFAT_TYPE, driveInfo.bootSector.VolumeSerialNumber,
+        &driveInfo.bootSector, sizeof(driveInfo.bootSector), *allocationBitmap);
+}
+
+void exFATRecovery::saveScanIndex() {
+    IndexWriter writer;
+    for (const exFATFileInfo& fileInfo : recoveryList) {
+        writer.write(static_cast<uint32_t>(fileInfo.fileId));
+        writer.writeString(fileInfo.folder);
+        writer.writeString(fileInfo.fileName);
+        writer.write(fileInfo.fileSize);
+        writer.write(fileInfo.cluster);
+        writer.write(static_cast<uint8_t>(fileInfo.noFatChain));
+    }
+
+    ScanIndex index(getVolumeKey());
+    if (index.save(static_cast<uint32_t>(recoveryList.size()), fileId, writer)) {
+        std::wcout << "[*] Scan index saved to " << index.getPath().wstring() << std::endl;
+    }
+}
+
+bool exFATRecovery::loadScanIndex() {
+    ScopedTimer timer(MetricPhase::SCAN_INDEX);
+    ScanIndex index(getVolumeKey());
+    uint32_t recordCount = 0;
+    uint32_t nextFileId = 0;
+    std::vector<uint8_t> records;
+    if (!index.load(recordCount, nextFileId, records)) {
+        std::cout << "[*] No usable scan index, scanning the volume" << std::endl;
+        return false;
+    }
+
+    // Only kept if the whole index reads back
+    MetadataArena indexArena;
+    std::vector<exFATFileInfo> indexedFiles(recordCount);
+    IndexReader reader(records.data(), records.size());
+    for (exFATFileInfo& fileInfo : indexedFiles) {
+        fileInfo.fileId = reader.read<uint32_t>();
+        fileInfo.folder = indexArena.internName(reader.readString());
+        fileInfo.fileName = indexArena.internName(reader.readString());
+        fileInfo.fileSize = reader.read<uint64_t>();
+        fileInfo.cluster = reader.read<uint32_t>();
+        fileInfo.noFatChain = reader.read<uint8_t>() != 0;
+    }
+    if (!reader.isValid() || !reader.isAtEnd()) {
+        std::cerr << "[!] The scan index is damaged, scanning the volume" << std::endl;
+        return false;
+    }
+
+    utils.printHeader("File Search (scan index):");
+    utils.openLogFile();
+    for (const exFATFileInfo& fileInfo : indexedFiles) {
+        logFoundFile(fileInfo);
+    }
+    utils.closeLogFile();
+    recoveryList = std::move(indexedFiles);
+    arena.adopt(indexArena);
+    fileId = nextFileId;
+    utils.printFooter();
+    return true;
+}
+
 void exFATRecovery::runLogicalDriveRecovery() {
-    scanForDeletedFiles();
+    // A matching index replaces the scan, every unfiltered scan refreshes it
+    if (scanFilter.isActive()) {
+        if (config.useIndex) std::cout << "[!] Filters are set, the scan index is not used" << std::endl;
+        if (config.resume) std::cout << "[!] Filters are set, the scan checkpoint is not used" << std::endl;
+        scanForDeletedFiles();
+    }
+    else if (!config.useIndex || !loadScanIndex()) {
+        scanForDeletedFiles();
+        saveScanIndex();
+    }
     recoverPartition();
+    if (config.carve) carveUnallocatedClusters();
+}
+// Carve files from the clusters the allocation bitmap reports as free
+void exFATRecovery::carveUnallocatedClusters() {
+    if (!allocationBitmap) loadAllocationBitmap();
+
+    CarvingGeometry geometry = {
+        .firstClusterSector = clusterToSector(static_cast<uint32_t>(allocationBitmap->getFirstCluster())),
+        .sectorsPerCluster = driveInfo.sectorsPerCluster,
+        .bytesPerSector = driveInfo.bytesPerSector
+    };
+    FileCarver carver(*sectorReader, *allocationBitmap, geometry, utils, fileId);
+    carver.carveUnallocatedClusters();
+}
+
+// Sample the clusters recovery would read, the ranking goes to the content score log
+void exFATRecovery::rankSelectedFiles(std::vector<exFATFileInfo>& files) {
+    uint64_t bytesPerCluster = static_cast<uint64_t>(driveInfo.sectorsPerCluster) * driveInfo.bytesPerSector;
+    std::vector<ContentCandidate> candidates;
+    candidates.reserve(files.size());
+    for (const exFATFileInfo& file : files) {
+        ContentCandidate candidate = { file.fileId, ScanFilter::joinPath(file.folder, file.fileName), file.fileSize, {}, {} };
+        uint64_t expectedClusters = (file.fileSize + bytesPerCluster - 1) / bytesPerCluster;
+        for (const ClusterRun& run : utils.coalesceClusterChain(walkClusterChain(file.cluster, expectedClusters, file.noFatChain))) {
+            candidate.extents.push_back({ run.startCluster, run.length, false });
+        }
+        candidates.push_back(std::move(candidate));
+    }
+
+    RecoveryGeometry geometry = {
+        .firstCluster = 2,
+        .firstClusterSector = driveInfo.bootSector.ClusterHeapOffset,
+        .sectorsPerCluster = driveInfo.sectorsPerCluster,
+        .bytesPerSector = driveInfo.bytesPerSector
+    };
+    ContentAnalyzer analyzer(*sectorReader, geometry, utils);
+    std::vector<ContentScore> scores = analyzer.rankFiles(candidates);
+    if (config.minConfidence == 0) return;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (scores[i].confidence >= config.minConfidence) files[kept++] = files[i];
+    }
+    std::cout << "[*] " << files.size() - kept << " files below " << config.minConfidence << "% confidence are not recovered" << std::endl;
+    files.resize(kept);
 }
 
 void exFATRecovery::recoverPartition() {
     utils.printHeader("File Recovery and Analysis:");
+    if (!config.recover && !config.analyze && !config.scoreContent) {
+        std::cout << "Recovery or analysis is disabled. Use --recover, --analyze or --score to proceed." << std::endl;
+        return;
+    }
     if (recoveryList.empty()) {
-        if (config.inputFolder.empty()) {
+        if (!config.inputFolder.empty()) {
             std::wcerr << "[-] Could not find any deleted files in \"" << config.inputFolder << "\"" << std::endl;
             return;
         }
-        if (config.recover || config.analyze) {
-            std::cerr << "[-] No deleted files found" << std::endl;
-        }
-        else std::cout << "Recovery or analysis is disabled. Use --recover or --analyze to proceed." << std::endl;
+        std::cerr << (scanFilter.isActive() ? "[-] No deleted files match the filters" : "[-] No deleted files found") << std::endl;
         return;
     }
 
 
 
     std::vector<exFATFileInfo> selectedDeletedFiles;
-    if (!config.targetCluster && !config.targetFileSize) {
+    // Filtered and --all runs are scripted, nobody is there to answer
+    if (!config.recoverAll && !scanFilter.isActive()) {
         selectedDeletedFiles = selectFilesToRecover(recoveryList);
         utils.printItemDivider();
     }
@@ -528,23 +969,51 @@ void exFATRecovery::recoverPartition() {
         selectedDeletedFiles = recoveryList;
     }
 
-    for (const auto& file : selectedDeletedFiles) {
-        processFileForRecovery(file);
+    if (config.scoreContent) {
+        rankSelectedFiles(selectedDeletedFiles);
+        if (!config.recover && !config.analyze) return;
     }
+
+    // Overlaps are checked against every deleted file, not only the selected ones
+    if (config.analyze) {
+        buildClusterHistory();
+    }
+
+    // Files are recovered in on-disk order, several at a time when there is nothing to analyze
+    RecoveryScheduler scheduler;
+    for (size_t i = 0; i < selectedDeletedFiles.size(); i++) {
+        uint32_t cluster = selectedDeletedFiles[i].cluster;
+        scheduler.addFile(i, isValidCluster(cluster) ? clusterToSector(cluster) : 0);
+    }
+    concurrentRecovery = scheduler.getWorkerCount() > 1;
+    if (concurrentRecovery) {
+        std::cout << "[*] Recovering " << selectedDeletedFiles.size() << " files with " << scheduler.getWorkerCount() << " workers" << std::endl;
+    }
+    ScopedTimer timer(MetricPhase::RECOVERY);
+    scheduler.run([&](size_t index) { processFileForRecovery(selectedDeletedFiles[index]); });
+    concurrentRecovery = false;
 }
 
 // Processes each file for recovery based on config options
 void exFATRecovery::processFileForRecovery(const exFATFileInfo& fileInfo) {
     bool isExtensionPredicted = false;
 
-    // Skip files that don't match the target cluster and size (if specified)
-    if (fileInfo.fileSize <= 0 || (config.targetCluster && config.targetFileSize && (fileInfo.cluster != config.targetCluster || fileInfo.fileSize != config.targetFileSize))) {
+    // The target cluster and size were already applied by the scan filter
+    if (fileInfo.fileSize <= 0) {
         return;
     }
 
 
-    fs::path outputPath = utils.getOutputPath(fileInfo.fileName, config.outputFolder);
     uint64_t expectedSize = fileInfo.fileSize;
+    std::wstring fileName(fileInfo.fileName);
+    // Damaged extension, guess it from the first bytes. Names without an extension are kept as they are.
+    if (utils.hasDamagedExtension(fileName)) {
+        fileName.erase(fileName.find_last_of(L'.'));
+        fileName += L"." + predictExtension(fileInfo.cluster, expectedSize);
+        isExtensionPredicted = true;
+    }
+
+    fs::path outputPath = utils.getOutputPath(fileName, config.outputFolder);
 
     exFATRecoveryStatus status = {};
     
@@ -552,20 +1021,30 @@ void exFATRecovery::processFileForRecovery(const exFATFileInfo& fileInfo) {
     uint64_t bytesPerCluster = static_cast<uint64_t>(driveInfo.sectorsPerCluster) * static_cast<uint64_t>(driveInfo.bytesPerSector);
     status.expectedClusters = (expectedSize + bytesPerCluster - 1) / bytesPerCluster;
 
-    std::wcout << "[*] Current file: " << outputPath.filename() << " cluster " << fileInfo.cluster << " (" << expectedSize << " bytes)" << std::endl;
+    if (reportsFileDetails() || config.analyze) std::wcout << "[*] Current file: " << outputPath.filename() << " cluster " << fileInfo.cluster << " (" << expectedSize << " bytes)" << std::endl;
     std::vector<uint32_t> clusterChain;
-
-
-    validateClusterChain(status, fileInfo.cluster, clusterChain, expectedSize, outputPath, isExtensionPredicted);
-
+    std::vector<ClusterRun> clusterRuns;
+
+    if (fileInfo.noFatChain && !config.analyze) {
+        // Contiguous file, no need to walk the chain cluster by cluster
+        uint64_t availableClusters = isValidCluster(fileInfo.cluster) ? static_cast<uint64_t>(driveInfo.bootSector.ClusterCount) + 2 - fileInfo.cluster : 0;
+        uint64_t runLength = (std::min)(status.expectedClusters, availableClusters);
+        if (runLength > 0) {
+            clusterRuns.push_back({ fileInfo.cluster, static_cast<uint32_t>(runLength) });
+        }
+    }
+    else {
+        validateClusterChain(status, fileInfo.fileId, fileInfo.cluster, clusterChain, outputPath, isExtensionPredicted, fileInfo.noFatChain);
+        clusterRuns = utils.coalesceClusterChain(clusterChain);
+    }
 
     if (config.recover) {
-        recoverFile(clusterChain, status, outputPath, expectedSize);
+        recoverFile(fileInfo.fileId, clusterRuns, status, outputPath, expectedSize);
     }
-    utils.printItemDivider();
+    if (reportsFileDetails() || config.analyze) utils.printItemDivider();
 }
 // Validates cluster chain and finds potential signs of corruption
-void exFATRecovery::validateClusterChain(exFATRecoveryStatus& status, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, uint64_t expectedSize, const fs::path& outputPath, bool isExtensionPredicted){
+void exFATRecovery::validateClusterChain(exFATRecoveryStatus& status, const uint32_t fileId, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, const fs::path& outputPath, bool isExtensionPredicted, bool noFatChain){
     if (config.analyze) std::cout << "[*] Analyzing file clusters..." << std::endl;
 
     uint32_t currentCluster = startCluster;
@@ -591,7 +1070,8 @@ void exFATRecovery::validateClusterChain(exFATRecoveryStatus& status, const uint
             }
         }
 
-        uint32_t nextCluster = getNextCluster(currentCluster);
+        // Files without a FAT chain are contiguous
+        uint32_t nextCluster = noFatChain ? currentCluster + 1 : getNextCluster(currentCluster);
 
         if (nextCluster == currentCluster || nextCluster < 2 || nextCluster >= 0x0FFFFFF8) {
             nextCluster = currentCluster + 1;
@@ -600,9 +1080,13 @@ void exFATRecovery::validateClusterChain(exFATRecoveryStatus& status, const uint
     }
 
     if (config.analyze) {
-        auto overwriteAnalysis = analyzeClusterOverwrites(startCluster, expectedSize);
-        status.hasOverwrittenClusters = overwriteAnalysis.hasOverwrite;
-        if (status.hasOverwrittenClusters) status.isCorrupted = true;
+        auto overwriteAnalysis = analyzeClusterOverwrites(fileId, utils.coalesceClusterChain(clusterChain), status.expectedClusters);
+        if (overwriteAnalysis.hasOverwrite) {
+            status.hasOverwrittenClusters = true;
+            status.isCorrupted = true;
+            std::cout << "  [!] " << overwriteAnalysis.overwrittenClusters << " cluster(s) (" << std::fixed << std::setprecision(2)
+                << overwriteAnalysis.overwritePercentage << "%) also claimed by " << overwriteAnalysis.overlaps.size() << " extent(s) of other deleted files" << std::endl;
+        }
 
         status.hasInvalidFileName = isFileNameCorrupted(outputPath.filename().wstring());
         if (status.hasInvalidFileName) {
@@ -626,40 +1110,31 @@ void exFATRecovery::validateClusterChain(exFATRecoveryStatus& status, const uint
 
 }
 
-void exFATRecovery::recoverFile(const std::vector<uint32_t>& clusterChain, exFATRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize) {
-    std::cout << "[*] Recovering file..." << std::endl;
-    std::ofstream outputFile(outputPath, std::ios::binary);
-    if (!outputFile) {
-        throw std::runtime_error("[-] Failed to create output file.");
-    }
-    // Recovery
-    std::vector<uint8_t> sectorBuffer(driveInfo.bytesPerSector);
-    for (uint32_t cluster : clusterChain) {
-        uint32_t sector = clusterToSector(cluster);
-
-        for (uint64_t i = 0; i < driveInfo.sectorsPerCluster; ++i) {
-            
-            if (!readSector(static_cast<uint64_t>(sector) + i, sectorBuffer.data(), driveInfo.bytesPerSector)) {
-                continue;
-            }
-
-            uint64_t bytesToWrite = (std::min)(
-                static_cast<uint64_t>(driveInfo.bytesPerSector),
-                expectedSize - status.recoveredBytes
-                );
-
-            outputFile.write(reinterpret_cast<char*>(sectorBuffer.data()), bytesToWrite);
-            status.recoveredBytes += bytesToWrite;
-            utils.showProgress(status.recoveredBytes, expectedSize);
-
-            if (status.recoveredBytes >= expectedSize) break;
-        }
-        status.recoveredClusters++;
-        if (status.recoveredBytes >= expectedSize) break;
+void exFATRecovery::recoverFile(const uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, exFATRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize) {
+    if (reportsFileDetails()) std::cout << "[*] Recovering file..." << std::endl;
+    std::vector<FileExtent> extents;
+    extents.reserve(clusterRuns.size());
+    for (const ClusterRun& run : clusterRuns) {
+        extents.push_back({ run.startCluster, run.length, false });
     }
-    outputFile.close();
 
-    showRecoveryResult(status, outputPath, expectedSize);
+    RecoveryGeometry geometry = {
+        .firstCluster = 2,
+        .firstClusterSector = driveInfo.bootSector.ClusterHeapOffset,
+        .sectorsPerCluster = driveInfo.sectorsPerCluster,
+        .bytesPerSector = driveInfo.bytesPerSector
+    };
+    RecoveryPipeline pipeline(*sectorReader, geometry, utils);
+    pipeline.setReportProgress(!concurrentRecovery);
+    PipelineResult result = pipeline.recoverFile(extents, expectedSize, outputPath);
+    status.recoveredBytes += result.recoveredBytes;
+    status.recoveredClusters += result.recoveredClusters;
+    status.unreadableBytes += result.unreadableBytes;
+    status.problematicClusters.insert(status.problematicClusters.end(), result.problematicClusters.begin(), result.problematicClusters.end());
+    if (!result.writeFailed) utils.logFileDigests(fileId, outputPath, result.recoveredBytes, expectedSize, std::move(result.digests));
+
+    if (!reportsFileDetails()) utils.logRecoveredFile(outputPath, status.recoveredBytes, expectedSize, status.unreadableBytes);
+    else showRecoveryResult(status, outputPath, expectedSize);
 }
 
 /* Recovery and analysis results */
@@ -668,6 +1143,9 @@ void exFATRecovery::showRecoveryResult(const exFATRecoveryStatus& status, const
         << " / " << status.expectedClusters << std::endl;
     std::cout << "  [*] Bytes recovered: " << status.recoveredBytes
         << " / " << expectedSize << std::endl;
+    if (status.unreadableBytes > 0) {
+        std::cout << "  [-] Unreadable bytes written as zeros: " << status.unreadableBytes << std::endl;
+    }
     if (fs::exists(fs::absolute(outputPath))) {
         std::wcout << "  [+] File saved to " << fs::absolute(outputPath) << L"\n";
     }
@@ -726,7 +1204,8 @@ void exFATRecovery::showAnalysisResult(const exFATRecoveryStatus& status) const
 
 /* Entry point */
 void exFATRecovery::startRecovery() {
-    if (this->driveType == DriveType::LOGICAL_TYPE) runLogicalDriveRecovery();
+    // A partition of a physical drive or an image is read through a partition relative reader, like a volume
+    if (this->driveType == DriveType::LOGICAL_TYPE || this->driveType == DriveType::PHYSICAL_TYPE || this->driveType == DriveType::IMAGE_TYPE) runLogicalDriveRecovery();
     else {
         throw std::runtime_error("Unknown drive type.");
     }
@@ -4,11 +4,25 @@
 #include "SectorReader.h"
 #include "Structures.h"
 #include "exFATStructs.h"
-#include "LogicalDriveReader.h"
+#include "SectorReader.h"
 #include "Enums.h"
 #include "ClusterHistory.h"
+#include "FATCache.h"
+#include "AllocationBitmap.h"
+#include "FileCarver.h"
+#include "RecoveryPipeline.h"
+#include "RecoveryScheduler.h"
+#include "ContentAnalyzer.h"
+#include "SignatureDB.h"
+#include "DirectoryScan.h"
+#include "ThreadPool.h"
+#include "ScanIndex.h"
+#include "ScanCheckpoint.h"
+#include "ScanFilter.h"
+#include "MetadataArena.h"
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <fstream>
 #include <filesystem>
@@ -24,17 +38,23 @@ private:
     static constexpr double SUSPICIOUS_PATTERN_THRESHOLD = 0.1; // 10%
     static constexpr double SEVERE_PATTERN_THRESHOLD = 0.25;    // 25%
     static constexpr double FILENAME_CORRUTPION_THRESHOLD = 0.5; // 50% bad chars in name
-    ClusterHistory clusterHistory;
-    uint32_t nextFileId = 0;
+    ClusterHistory clusterHistory; // Extents of every deleted file
 
     // Cluster values
     static constexpr uint32_t MIN_DATA_CLUSTER = 2;         // First valid data cluster for exFAT
     static constexpr uint32_t BAD_CLUSTER = 0xFFFFFFF7;     // exFAT bad cluster marker
     static constexpr uint32_t END_OF_CHAIN = 0xFFFFFFFF;    // exFAT end of chain marker
+    static constexpr uint8_t NO_FAT_CHAIN_FLAG = 0x02;      // Stream extension GeneralFlags bit
+    static constexpr uint8_t ALLOCATION_BITMAP_ENTRY = 0x81;
+
+    // Directory entry sets
+    static constexpr uint8_t MIN_SECONDARY_COUNT = 2;          // Stream extension and one name entry
+    static constexpr uint8_t MAX_SECONDARY_COUNT = 18;         // Stream extension and 17 name entries
+    static constexpr uint32_t NAME_CHARS_PER_ENTRY = 15;
+    static constexpr uint64_t MAX_DIRECTORY_BYTES = 256ull * 1024 * 1024; // Largest directory exFAT allows
 
-    // Prevent infinite loops in file scan
+    // Prevent runaway descent in file scan
     static constexpr uint32_t MAX_RECURSION_DEPTH = 100;
-    uint32_t currentRecursionDepth = 0;
 
     struct DriveInfo {
         ExFATBootSector bootSector;
@@ -45,10 +65,26 @@ private:
     Utils utils;
 
     const DriveType& driveType;
+    MetadataArena arena; // Names of recoveryList
     std::vector<exFATFileInfo> recoveryList;
-    uint16_t fileId = 1;
+    bool concurrentRecovery = false; // Several workers recover files, each reports a single line
+    // A single worker prints a report for every file, unless --quiet is set
+    bool reportsFileDetails() const { return !concurrentRecovery && !config.quiet; }
+    ScanFilter scanFilter;
+    uint32_t fileId = 1;
 
     std::unique_ptr<SectorReader> sectorReader;
+    std::unique_ptr<FATCache> fatCache;
+    std::unique_ptr<AllocationBitmap> allocationBitmap; // Loaded on first use
+
+    // Parallel directory scan state
+    ThreadPool* scanPool = nullptr;                     // Pool running the directory tasks
+    std::unique_ptr<VisitedClusterSet> visitedClusters; // Directory clusters already scanned
+    std::mutex scanResultsMutex;                        // Guards the results, the frontier and the checkpoint
+    std::vector<exFATScanEntry> scanResults;
+    std::unique_ptr<ScanCheckpoint> checkpoint;         // Unfiltered scans only
+    ScanFrontier scanFrontier;
+    IndexWriter checkpointResults;                      // scanResults serialized as they are found
 
     /* Prints exFAT Recovery to terminal */
     void printToolHeader() const;
@@ -61,8 +97,12 @@ private:
 
     void setSectorReader(std::unique_ptr<SectorReader> reader);
     bool readSector(uint64_t sector, void* buffer, uint32_t size);
+    bool readSectors(uint64_t startSector, uint32_t count, void* buffer);
+    bool readBatch(std::vector<ReadRequest>& requests);
     void readBootSector(uint32_t sector);
     uint32_t getBytesPerSector();
+    // Load the FAT into memory for chain walks
+    void initializeFATCache();
     
     bool isValidCluster(uint32_t cluster) const;
     bool isValidDeletedEntry(uint32_t cluster, uint64_t size) const;
@@ -73,27 +113,70 @@ private:
 
     /* File scan */
     void scanForDeletedFiles();
-    void scanDirectory(uint32_t cluster, uint32_t depth = 0);
-    void processEntriesInSector(uint32_t entriesPerSector, const std::vector<uint8_t>& sectorBuffer);
-    void processDirectoryEntry(const DirectoryEntryCommon* entry, exFATDirEntryData& dirData);
-    void finalizeDirectoryEntry(exFATDirEntryData& dirData);
+    // Queue a directory for the scan workers
+    void scheduleDirectory(DirectoryTask task);
+    // Scan every cluster of a directory, subdirectories are collected in the state
+    void scanDirectory(DirectoryScanState<exFATScanEntry>& state);
+    // Take the entries of a scanned directory and schedule its subdirectories, saves a checkpoint when one is due
+    void finishDirectory(DirectoryScanState<exFATScanEntry>& state);
+    // Restore the entries and the pending directories of an interrupted scan, false starts from the root
+    bool resumeDirectoryScan(std::vector<DirectoryTask>& pendingTasks);
+    static void writeScanEntry(IndexWriter& writer, const exFATScanEntry& entry);
+    static void readScanEntry(IndexReader& reader, exFATScanEntry& entry);
+    // Read the whole directory into one buffer, each run of consecutive clusters with one request.
+    // The clusters read are appended to clusterChain.
+    void readDirectory(const DirectoryTask& task, std::vector<uint8_t>& directoryData, std::vector<uint32_t>& clusterChain);
+    // Walk the entry sets of a directory, SecondaryCount gives the length of each set
+    void processEntrySets(const uint8_t* directoryData, size_t entryCount, DirectoryScanState<exFATScanEntry>& state);
+    // Parse the set starting at entries[index], returns the number of entries it covers
+    size_t parseEntrySet(const DirectoryEntryCommon* entries, size_t index, size_t entryCount, exFATDirEntryData& dirData);
+    void finalizeDirectoryEntry(exFATDirEntryData& dirData, DirectoryScanState<exFATScanEntry>& state);
+    // Turn the sorted scan results into the recovery list
+    void mergeScanResults();
+    // The name is stored in the arena
     exFATFileInfo parseFileInfo(const exFATDirEntryData& dirData);
-    std::wstring extractFileName(const FileNameEntry* fnEntry) const;
+    // Append the characters of a File Name entry to the name being assembled
+    void appendFileName(const FileNameEntry* fnEntry, std::wstring& fileName) const;
     void addToRecoveryList(const exFATFileInfo& fileInfo);
+    // Hand a found file to the result logger
+    void logFoundFile(const exFATFileInfo& fileInfo);
     void recoverPartition();
 
+    // Predict file extension from the first sector of the file
+    std::wstring predictExtension(uint32_t cluster, uint64_t expectedSize);
+
     /* Corruption analysis */
+    // Find the first Allocation Bitmap entry in the root directory
+    bool findAllocationBitmapEntry(AllocationBitmapEntry& bitmapEntry);
+    // Load the volume's allocation bitmap, clusters stay free if it can't be read
+    void loadAllocationBitmap();
     bool isClusterInUse(uint32_t cluster);
     void analyzeClusterPattern(const std::vector<uint32_t>& clusters, exFATRecoveryStatus& status) const;
     bool isFileNameCorrupted(const std::wstring& filename) const;
-    OverwriteAnalysis analyzeClusterOverwrites(uint32_t startCluster, uint64_t expectedSize);
+    // Follow the FAT from startCluster, broken links continue with the next cluster
+    std::vector<uint32_t> walkClusterChain(uint32_t startCluster, uint64_t expectedClusters, bool noFatChain);
+    void buildClusterHistory();
+    OverwriteAnalysis analyzeClusterOverwrites(uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, uint64_t expectedClusters);
 
     /* Recovery */
     std::vector<exFATFileInfo> selectFilesToRecover(const std::vector<exFATFileInfo>& recoveryList);
+    // Score the content of the selected files, files below the minimum confidence are dropped
+    void rankSelectedFiles(std::vector<exFATFileInfo>& files);
+    /*=============== Scan index ===============*/
+    // Identify the volume state, loads the allocation bitmap on first use
+    VolumeKey getVolumeKey();
+    // Persist the recovery list so a later run with --use-index can skip the scan
+    void saveScanIndex();
+    // Fill the recovery list from the index, false if it is missing or outdated
+    bool loadScanIndex();
+
     void runLogicalDriveRecovery();
+    // Carve signatures from free clusters, after the directory based recovery
+    void carveUnallocatedClusters();
     void processFileForRecovery(const exFATFileInfo& fileInfo);
-    void validateClusterChain(exFATRecoveryStatus& status, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, uint64_t expectedSize, const fs::path& outputPath, bool isExtensionPredicted);
-    void recoverFile(const std::vector<uint32_t>& clusterChain, exFATRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize);
+    void validateClusterChain(exFATRecoveryStatus& status, const uint32_t fileId, const uint32_t startCluster, std::vector<uint32_t>& clusterChain, const fs::path& outputPath, bool isExtensionPredicted, bool noFatChain);
+    // Recover specific file, each run of consecutive clusters is streamed with large reads
+    void recoverFile(const uint32_t fileId, const std::vector<ClusterRun>& clusterRuns, exFATRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize);
 
     /* Recovery and analysis results */
     void showRecoveryResult(const exFATRecoveryStatus& status, const fs::path& outputPath, const uint64_t expectedSize) const;
@@ -2,13 +2,18 @@
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
+#include "DirectoryScan.h"
 
 #pragma pack(push, 1)
+// Scan result, the name is a view into the engine's MetadataArena
 struct exFATFileInfo {
-    uint16_t fileId;
-    std::wstring fileName;
+    uint32_t fileId;
+    std::wstring_view folder; // Relative to the volume root, empty if paths weren't tracked
+    std::wstring_view fileName;
     uint64_t fileSize;
     uint32_t cluster;
+    bool noFatChain; // data is one contiguous run, the FAT is not used
 };
 
 struct ExFATBootSector {
@@ -74,6 +79,15 @@ struct StreamExtensionEntry {
     uint64_t DataLength;      // Total length of file data
 };
 
+// Type 0x81: Allocation Bitmap Entry
+struct AllocationBitmapEntry {
+    uint8_t EntryType;      // Must be 0x81
+    uint8_t BitmapFlags;    // Bit 0 selects the first or second FAT's bitmap
+    uint8_t Reserved[18];
+    uint32_t FirstCluster;  // First cluster of the bitmap
+    uint64_t DataLength;    // Size of the bitmap in bytes
+};
+
 // Type 0xC1: File Name Entry
 struct FileNameEntry {
     uint8_t EntryType;      // Must be 0xC1
@@ -88,6 +102,7 @@ struct exFATDirEntryData {
     bool inFileEntry;
     bool isDirectory;
     bool isDeleted;
+    bool noFatChain;
 };
 
 struct exFATRecoveryStatus {
@@ -106,7 +121,15 @@ struct exFATRecoveryStatus {
     uint64_t expectedClusters;
     uint64_t recoveredClusters;
     uint64_t recoveredBytes;
+    uint64_t unreadableBytes; // Written as zeros
     std::vector<uint64_t> problematicClusters;
 };
 
+// Deleted file found by a directory worker, turned into exFATFileInfo once the scan is merged
+struct exFATScanEntry {
+    ScanOrderKey orderKey;
+    std::wstring folder;
+    exFATDirEntryData dirData;
+};
+
 #pragma pack(pop)
\ No newline at end of file
@@ -1,20 +1,48 @@
 
 #include "Config.h"
 #include "DriveHandler.h"
+#include "Metrics.h"
+#include "ScanFilter.h"
 #include <iostream>
-#include <windows.h>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <clocale>
+#endif
 // Helper function to convert string to wstring
 std::wstring stringToWstring(const std::string& str) {
     if (str.empty()) {
         return std::wstring();
     }
 
+#ifdef _WIN32
     int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
     std::wstring wstrTo(size_needed, 0);
     MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
     return wstrTo;
+#else
+    // Arguments are UTF-8, wchar_t holds whole code points here
+    std::wstring wstrTo;
+    for (size_t i = 0; i < str.size();) {
+        unsigned char lead = static_cast<unsigned char>(str[i]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (length == 0 || i + length > str.size()) {
+            wstrTo += L'\uFFFD'; // Invalid sequence
+            i++;
+            continue;
+        }
+        uint32_t codePoint = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t j = 1; j < length; j++) {
+            codePoint = (codePoint << 6) | (static_cast<unsigned char>(str[i + j]) & 0x3F);
+        }
+        wstrTo += static_cast<wchar_t>(codePoint);
+        i += length;
+    }
+    return wstrTo;
+#endif
 }
 
 // Helper function to print usage information
@@ -22,22 +50,66 @@ void printUsage(const char* programName) {
     std::cerr << "Usage: " << programName << " [OPTIONS]\n"
         << "Options:\n"
         << "  -h, --help                          Show this help message\n"
-        << "  -d, --drive <drive>                 [REQUIRED] Specify the drive path\n"
+        << "  -d, --drive <drive>                 [REQUIRED] Specify the drive path or a raw image file\n"
         << "  -r, --recover                       [OPTIONAL] Perform file recovery\n"
         << "  -a, --analyze                       [OPTIONAL] Analyze clusters for corruption (time-consuming)\n"
-        << "  -l, --no-log                        [OPTIONAL] Disable logging found files and their location\n";
+        << "  -c, --carve                         [OPTIONAL] Carve files by signature from unallocated clusters\n"
+        << "      --score                         [OPTIONAL] Rank the selected files by sampling their clusters, written to Log/ContentScores.csv\n"
+        << "      --min-confidence <percent>      [OPTIONAL] Score the selected files and don't recover those below this confidence, implies --score\n"
+        << "  -l, --no-log                        [OPTIONAL] Disable logging found files and their location\n"
+        << "      --log-format <csv|jsonl>        [OPTIONAL] Format of the file data log (default: csv)\n"
+        << "  -q, --quiet                         [OPTIONAL] Don't print a line for every found or recovered file\n"
+        << "      --hash <list>                   [OPTIONAL] Hash recovered files while they are written, sha256 and/or xxh3, e.g. sha256,xxh3\n"
+        << "      --use-index                     [OPTIONAL] Reuse the scan result of an earlier run if the volume is unchanged\n"
+        << "      --resume                        [OPTIONAL] Continue an interrupted scan from its last checkpoint\n"
+        << "      --fat-cache-mb <size>           [OPTIONAL] Memory limit for the in-memory FAT in MB (default: 512)\n"
+        << "      --cache-mb <size>               [OPTIONAL] Memory limit for cached drive blocks in MB, 0 disables the cache (default: 256)\n"
+        << "      --cache-block-kb <size>         [OPTIONAL] Size of a cached block in KB, 64 to 1024 (default: 256)\n"
+        << "      --degraded                      [OPTIONAL] Failing drive: bisect failed reads, skip past bad areas and keep a bad sector map\n"
+        << "      --queue-depth <n>               [OPTIONAL] Number of overlapped (io_uring on Linux) reads kept in flight (default: 1)\n"
+        << "      --threads <n>                   [OPTIONAL] Worker threads used while scanning, up to 4 also recover files (default: all cores)\n"
+        << "      --all                           [OPTIONAL] Process every file found without asking\n"
+        << "      --input-folder <path>           [OPTIONAL] Only files below this folder of the volume, e.g. Users\\Docs\n"
+        << "      --path <pattern>                [OPTIONAL] Only files whose path matches the pattern (* and ?), e.g. *\\DCIM\\*.jpg\n"
+        << "      --ext <list>                    [OPTIONAL] Only files with these extensions, e.g. jpg,png\n"
+        << "      --min-size <bytes>              [OPTIONAL] Only files at least this large\n"
+        << "      --max-size <bytes>              [OPTIONAL] Only files at most this large\n"
+        << "      --ids <list>                    [OPTIONAL] Only files with these IDs, e.g. 1,5,10-20\n"
+        << "      --target-cluster <n>            [OPTIONAL] Only files starting at this cluster\n"
+        << "      --target-size <bytes>           [OPTIONAL] Only files of exactly this size\n"
+        << "      --metrics <file.json>           [OPTIONAL] Write I/O, scan and recovery metrics to a JSON file at exit\n";
 
     std::cerr << "\nExamples:\n"
         << "  1. Logical Drive:\n"
-        << "        " << programName << " --drive F: --recover --analyze\n";
+        << "        " << programName << " --drive F: --recover --analyze\n"
+        << "  2. Physical Drive (every FAT32, exFAT and NTFS partition):\n"
+        << "        " << programName << " --drive 1 --recover\n"
+        << "  3. Disk or volume image (.dd, .img), no administrator rights needed:\n"
+        << "        " << programName << " --drive C:\\Images\\usb.img --recover\n"
+        << "  4. Scripted run, photos of a single folder without any prompt:\n"
+        << "        " << programName << " --drive F: --recover --input-folder DCIM --ext jpg,heic --min-size 4096\n"
+        << "  5. Linux, a whole disk (as root or a member of the disk group) or an image:\n"
+        << "        " << programName << " --drive /dev/sdb --recover --queue-depth 8\n"
+        << "        " << programName << " --drive ~/images/usb.img --recover\n";
 
     std::cerr << "\nNotes:\n"
         << "  - Selecting specific files for recovery:\n"
         << "      1. Run the program with the '--recover' argument to interactively choose files to recover.\n"
+        << "      2. Filters are applied during the scan and skip the prompt, '--all' skips it without filtering.\n"
+        << "      3. File IDs count the files left by the other filters, '--ids' refers to a run with the same filters.\n"
+        << "      4. Filtered scans neither use nor update the scan index.\n"
         << "  - Log file format:\n"
-        << "      * The `FileDataLog.txt` is in CSV format, facilitating easy automation.\n"
+        << "      * `FileDataLog.csv` has one row per found file: id, path, size, first cluster, extents and whether the extension is predicted.\n"
+        << "      * With '--log-format jsonl' the same fields are written as one JSON object per line to `FileDataLog.jsonl`.\n"
+        << "      * With '--hash', `RecoveredFiles.csv` (or .jsonl) has one row per recovered file: id, output path, size, recovered bytes and digests.\n"
         << "  - File corruption analysis:\n"
         << "      * Use '--analyze' argument to scan recovered file for potential corruption.\n"
+        << "      * Use '--score' to estimate before recovery which files still hold their content, best first in `ContentScores.csv`.\n"
+        << "  - File carving:\n"
+        << "      * Use '--carve' to recover files without a surviving directory entry, they are written to the 'Carved' folder.\n"
+        << "  - Scan index:\n"
+        << "      * Every scan is saved to the 'Log' folder, '--use-index' loads it instead of rescanning an unchanged volume.\n"
+        << "      * Unfinished scans are checkpointed to the 'Log' folder, '--resume' continues one after an interruption.\n"
         << "  - Supported file systems:\n"
         << "      * Currently, only FAT32 and exFAT file recovery is supported.\n";
 
@@ -54,9 +126,22 @@ void printConfig(const Config& config) {
         << L"  Output Folder          | " << (!config.outputFolder.empty() ? config.outputFolder : L"Recovered") << L"\n"
         << L"  Target Cluster         | " << (config.targetCluster ? std::to_wstring(config.targetCluster) : L"Not specified") << L"\n"
         << L"  Target File Size       | " << (config.targetFileSize ? std::to_wstring(config.targetFileSize) : L"Not specified") << L"\n"
-        << L"  Create File Data Log   | " << (config.createFileDataLog ? L"Yes" : L"No") << L"\n"
+        << L"  Path Pattern           | " << (!config.pathPattern.empty() ? config.pathPattern : L"Not specified") << L"\n"
+        << L"  Extensions             | " << (!config.extensionFilter.empty() ? config.extensionFilter : L"All") << L"\n"
+        << L"  File Size Range        | " << config.minFileSize << L" - " << (config.maxFileSize != UINT64_MAX ? std::to_wstring(config.maxFileSize) : L"unlimited") << L"\n"
+        << L"  File IDs               | " << (!config.fileIdFilter.empty() ? stringToWstring(config.fileIdFilter) : L"All") << L"\n"
+        << L"  Create File Data Log   | " << (config.createFileDataLog ? (config.logFormat == LogFormat::JSONL_FORMAT ? L"Yes (JSONL)" : L"Yes (CSV)") : L"No") << L"\n"
+        << L"  Quiet                  | " << (config.quiet ? L"Yes" : L"No") << L"\n"
+        << L"  Hashes                 | " << (config.hashSha256 && config.hashXxh3 ? L"SHA-256, XXH3" : config.hashSha256 ? L"SHA-256" : config.hashXxh3 ? L"XXH3" : L"None") << L"\n"
         << L"  Recover Files          | " << (config.recover ? L"Yes" : L"No") << L"\n"
-        << L"  Analyze Files          | " << (config.analyze ? "Yes" : "No") << L"\n";
+        << L"  Analyze Files          | " << (config.analyze ? "Yes" : "No") << L"\n"
+        << L"  Carve Files            | " << (config.carve ? L"Yes" : L"No") << L"\n"
+        << L"  Score Content          | " << (config.scoreContent ? (config.minConfidence > 0 ? L"Yes (min " + std::to_wstring(config.minConfidence) + L"%)" : L"Yes") : L"No") << L"\n"
+        << L"  Read Cache             | " << (config.readCacheLimit > 0 ? std::to_wstring(config.readCacheLimit / (1024 * 1024)) + L" MB in " + std::to_wstring(config.readCacheBlockSize / 1024) + L" KB blocks" : L"Disabled") << L"\n"
+        << L"  Degraded Media         | " << (config.degradedMedia ? L"Yes" : L"No") << L"\n"
+        << L"  Use Scan Index         | " << (config.useIndex ? L"Yes" : L"No") << L"\n"
+        << L"  Resume Scan            | " << (config.resume ? L"Yes" : L"No") << L"\n"
+        << L"  Metrics File           | " << (!config.metricsFile.empty() ? config.metricsFile : L"Not specified") << L"\n";
     std::cout << std::string(60, '_') << "\n\n";
 }
 // Function to parse command line arguments
@@ -76,12 +161,180 @@ void parseCommandLine(int argc, char* argv[], Config& config) {
             else if (arg == "-l" || arg == "--no-log") {
                 config.createFileDataLog = false;
             }
+            else if (arg == "--log-format") {
+                if (i + 1 < argc) {
+                    std::string format = argv[++i];
+                    if (format == "csv") config.logFormat = LogFormat::CSV_FORMAT;
+                    else if (format == "jsonl") config.logFormat = LogFormat::JSONL_FORMAT;
+                    else throw std::runtime_error("Unknown log format: " + format);
+                }
+                else {
+                    throw std::runtime_error("--log-format argument is missing");
+                }
+            }
+            else if (arg == "-q" || arg == "--quiet") {
+                config.quiet = true;
+            }
+            else if (arg == "--hash") {
+                if (i + 1 < argc) {
+                    std::stringstream algorithms(argv[++i]);
+                    std::string algorithm;
+                    while (std::getline(algorithms, algorithm, ',')) {
+                        if (algorithm == "sha256") config.hashSha256 = true;
+                        else if (algorithm == "xxh3") config.hashXxh3 = true;
+                        else throw std::runtime_error("Unknown hash algorithm: " + algorithm);
+                    }
+                }
+                else {
+                    throw std::runtime_error("--hash argument is missing");
+                }
+            }
             else if (arg == "-r" || arg == "--recover") {
                 config.recover = true;
             }
             else if (arg == "-a" || arg == "--analyze") {
                 config.analyze = true;
             }
+            else if (arg == "-c" || arg == "--carve") {
+                config.carve = true;
+            }
+            else if (arg == "--score") {
+                config.scoreContent = true;
+            }
+            else if (arg == "--min-confidence") {
+                if (i + 1 < argc) {
+                    config.minConfidence = static_cast<uint32_t>((std::min)(100ul, std::stoul(argv[++i])));
+                    config.scoreContent = true;
+                }
+                else {
+                    throw std::runtime_error("--min-confidence argument is missing");
+                }
+            }
+            else if (arg == "--use-index") {
+                config.useIndex = true;
+            }
+            else if (arg == "--resume") {
+                config.resume = true;
+            }
+            else if (arg == "--fat-cache-mb") {
+                if (i + 1 < argc) {
+                    config.fatCacheLimit = std::stoull(argv[++i]) * 1024 * 1024;
+                }
+                else {
+                    throw std::runtime_error("--fat-cache-mb argument is missing");
+                }
+            }
+            else if (arg == "--degraded") {
+                config.degradedMedia = true;
+            }
+            else if (arg == "--cache-mb") {
+                if (i + 1 < argc) {
+                    config.readCacheLimit = std::stoull(argv[++i]) * 1024 * 1024;
+                }
+                else {
+                    throw std::runtime_error("--cache-mb argument is missing");
+                }
+            }
+            else if (arg == "--cache-block-kb") {
+                if (i + 1 < argc) {
+                    config.readCacheBlockSize = static_cast<uint32_t>(std::stoul(argv[++i]) * 1024);
+                }
+                else {
+                    throw std::runtime_error("--cache-block-kb argument is missing");
+                }
+            }
+            else if (arg == "--queue-depth") {
+                if (i + 1 < argc) {
+                    config.ioQueueDepth = (std::max)(1ul, std::stoul(argv[++i]));
+                }
+                else {
+                    throw std::runtime_error("--queue-depth argument is missing");
+                }
+            }
+            else if (arg == "--threads") {
+                if (i + 1 < argc) {
+                    config.threadCount = std::stoul(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--threads argument is missing");
+                }
+            }
+            else if (arg == "--all") {
+                config.recoverAll = true;
+            }
+            else if (arg == "--input-folder") {
+                if (i + 1 < argc) {
+                    config.inputFolder = stringToWstring(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--input-folder argument is missing");
+                }
+            }
+            else if (arg == "--path") {
+                if (i + 1 < argc) {
+                    config.pathPattern = stringToWstring(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--path argument is missing");
+                }
+            }
+            else if (arg == "--ext") {
+                if (i + 1 < argc) {
+                    config.extensionFilter = stringToWstring(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--ext argument is missing");
+                }
+            }
+            else if (arg == "--min-size") {
+                if (i + 1 < argc) {
+                    config.minFileSize = std::stoull(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--min-size argument is missing");
+                }
+            }
+            else if (arg == "--max-size") {
+                if (i + 1 < argc) {
+                    config.maxFileSize = std::stoull(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--max-size argument is missing");
+                }
+            }
+            else if (arg == "--ids") {
+                if (i + 1 < argc) {
+                    config.fileIdFilter = argv[++i];
+                    IdSelection::parse(config.fileIdFilter); // Rejects a bad list before the scan starts
+                }
+                else {
+                    throw std::runtime_error("--ids argument is missing");
+                }
+            }
+            else if (arg == "--target-cluster") {
+                if (i + 1 < argc) {
+                    config.targetCluster = std::stoull(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--target-cluster argument is missing");
+                }
+            }
+            else if (arg == "--target-size") {
+                if (i + 1 < argc) {
+                    config.targetFileSize = std::stoull(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--target-size argument is missing");
+                }
+            }
+            else if (arg == "--metrics") {
+                if (i + 1 < argc) {
+                    config.metricsFile = stringToWstring(argv[++i]);
+                }
+                else {
+                    throw std::runtime_error("--metrics argument is missing");
+                }
+            }
             else if (arg == "-h" || arg == "--help") {
                 printUsage(argv[0]);
                 exit(0);
@@ -108,15 +361,30 @@ void parseCommandLine(int argc, char* argv[], Config& config) {
 
 
 int main(int argc, char* argv[]) {
+#ifndef _WIN32
+    // Wide output is converted with the user's locale, the C locale only knows ASCII
+    std::setlocale(LC_ALL, "");
+#endif
+    auto& config = Config::getInstance();
+    int exitCode = 0;
     try {
-        auto& config = Config::getInstance();
         parseCommandLine(argc, argv, config);
         DriveHandler driveHandler;
         driveHandler.recoverDrive();
     }
     catch (const std::exception& e) {
         std::cerr << "[-] Error: " << e.what() << std::endl;
-        return 1;
+        exitCode = 1;
+    }
+
+    // Failed runs are written too, the counters show how far they got
+    if (!config.metricsFile.empty()) {
+        if (Metrics::getInstance().writeJson(config.metricsFile)) {
+            std::wcout << L"[+] Metrics written to " << config.metricsFile << std::endl;
+        }
+        else {
+            std::wcerr << L"[-] Failed to write metrics to " << config.metricsFile << std::endl;
+        }
     }
-    return 0;
+    return exitCode;
 }
\ No newline at end of file